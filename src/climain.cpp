@@ -4,7 +4,7 @@
  * $Id$
  *
  * Written by Keith Marshall <keithmarshall@users.sourceforge.net>
- * Copyright (C) 2009-2013, MinGW.org Project
+ * Copyright (C) 2009-2013, 2026, MinGW.org Project
  *
  *
  * Implementation of the main program function, which is invoked by
@@ -283,6 +283,16 @@ EXTERN_C int climain( int argc, char **argv )
 	    delete pkgProcessedArchives;
 	    break;
 
+	  case ACTION_VERIFY:
+	    /*
+	     * Check all installed packages, in all sysroots, against
+	     * their manifests; any discrepancy is reported as failure,
+	     * (but nothing is changed, so we don't update the map).
+	     */
+	    if( dbase.VerifyInstallation() > 0 )
+	      return EXIT_FAILURE;
+	    break;
+
 	  case ACTION_UPGRADE:
 	    if( argc < 2 )
 	      /*
@@ -379,9 +389,14 @@ void pkgActionItem::GetSourceArchive( pkgXmlNode *package, unsigned long categor
 	char source_archive[mkpath( NULL, path_template, src, NULL )];
 	mkpath( source_archive, path_template, src, NULL );
 
-	/* ...and extract the content from the source archive.
+	/* ...and extract the content from the source archive; (when
+	 * the --member option is in effect, we extract only the member
+	 * which it names, and for an xz archive, the extractor will use
+	 * its sidecar index to locate it, when available).
 	 */
-	pkgTarArchiveExtractor unpack( source_archive, "." );
+	pkgTarArchiveExtractor unpack( source_archive, ".",
+	    pkgOptions()->GetString( OPTION_MEMBER_ARGS )
+	  );
       }
       /* The path_template was allocated on the heap; we are
        * done with it, so release the memory allocation...
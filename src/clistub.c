@@ -4,7 +4,7 @@
  * $Id$
  *
  * Written by Keith Marshall <keithmarshall@users.sourceforge.net>
- * Copyright (C) 2009, 2010, 2011, 2012, MinGW.org Project
+ * Copyright (C) 2009, 2010, 2011, 2012, 2026, MinGW.org Project
  *
  *
  * Initiation stub for command line invocation of mingw-get
@@ -51,7 +51,8 @@ static const char *help_text =
 
 "  mingw-get update\n"
 "  mingw-get [OPTIONS] {install | upgrade | remove} package-spec ...\n"
-"  mingw-get [OPTIONS] {show | list} [package-spec ...]\n\n"
+"  mingw-get [OPTIONS] {show | list} [package-spec ...]\n"
+"  mingw-get verify\n\n"
 
 "Options:\n"
 "  --help, -h        Show this help text\n"
@@ -129,6 +130,10 @@ static const char *help_text =
 "                    onus lies with individual package maintainers\n"
 "                    to provide scripting to support this capability\n"
 "\n"
+"  --member=name     When unpacking source or licence archives, extract\n"
+"                    only the named archive member, rather than the\n"
+"                    entire archive\n"
+"\n"
 "Actions:\n"
 "  update            Update local copy of repository catalogues\n"
 "  list, show        List and show details of available packages\n"
@@ -137,7 +142,10 @@ static const char *help_text =
 "                    handling them as if they are source packages\n"
 "  install           Install new packages\n"
 "  upgrade           Upgrade previously installed packages\n"
-"  remove            Remove previously installed packages\n\n"
+"  remove            Remove previously installed packages\n"
+"  verify            Check installed files against the manifests of\n"
+"                    their packages, reporting any which are missing\n"
+"                    or modified, and any which no package owns\n\n"
 
 "Package Specifications:\n"
 "  [subsystem-]name[-component]:\n"
@@ -244,6 +252,8 @@ int main( int argc, char **argv )
       { "desktop",        optional_argument,   &optref,   OPTION_DESKTOP     },
       { "start-menu",     optional_argument,   &optref,   OPTION_START_MENU  },
 
+      { "member",         required_argument,   &optref,   OPTION_MEMBER      },
+
 #     if DEBUG_ENABLED( DEBUG_TRACE_DYNAMIC )
 	/* The "--trace" option is supported only when dynamic tracing
 	 * debugging support has been compiled in.
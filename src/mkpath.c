@@ -4,7 +4,7 @@
  * $Id$
  *
  * Written by Keith Marshall <keithmarshall@users.sourceforge.net>
- * Copyright (C) 2009, 2011, 2013, MinGW.org Project
+ * Copyright (C) 2009, 2011, 2013, 2026, MinGW.org Project
  *
  *
  * Helper functions for constructing path names, creating directory
@@ -37,6 +37,7 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <windows.h>
 
 #ifdef _WIN32
  /*
@@ -92,6 +93,14 @@ const char *pkgSourceArchivePath()
   return "%R" "var/cache/mingw-get/source" "%/M/%F";
 }
 
+const char *pkgTranscodedArchivePath()
+{
+  /* Specify where transcoded copies of cached packages
+   * are stored, within the local file system.
+   */
+  return "%R" "var/cache/mingw-get/transcoded" "%/M/%F";
+}
+
 int mkpath( char *buf, const char *fmt, const char *file, const char *modifier )
 {
   /* A helper function, for constructing package URL strings.
@@ -242,6 +251,195 @@ int mkpath( char *buf, const char *fmt, const char *file, const char *modifier )
   return len;
 }
 
+/* While extracting archives, we maintain a cache of the path names of
+ * all directories which are known to exist; this allows us to avoid
+ * repeated mkdir() and stat() calls, when many archive entries, (or
+ * many packages within a single transaction), refer to the same
+ * directories.  The cache is a simple open addressed hash
+ * table, which may be shared by concurrent writer threads; it persists
+ * from the outermost mkdir_cache_enable() call, until the matching
+ * mkdir_cache_disable() call.
+ */
+static struct
+{ CRITICAL_SECTION lock;
+  char **slot;
+  size_t size, count;
+  unsigned long hits;
+  int depth;
+} mkdir_cache;
+
+/* Removed entries are marked by a distinctive, (and otherwise unused),
+ * pointer value, so that any subsequent probe sequence which passes
+ * through the slot is not prematurely terminated.
+ */
+static char mkdir_cache_removed[] = "";
+
+static size_t mkdir_cache_hash( const char *pathname )
+{
+  /* Helper to compute the FNV-1a hash of any directory path name.
+   */
+  size_t hash = 2166136261U;
+  while( *pathname ) hash = (hash ^ (unsigned char)(*pathname++)) * 16777619U;
+  return hash;
+}
+
+static char **mkdir_cache_probe( const char *pathname )
+{
+  /* Helper to locate the cache slot which holds "pathname", or, if it
+   * is not present, the empty slot which terminates its probe sequence;
+   * (the caller must hold the lock, and the table must not be full).
+   */
+  size_t mask = mkdir_cache.size - 1;
+  size_t index = mkdir_cache_hash( pathname ) & mask;
+  while( (mkdir_cache.slot[index] != NULL)
+  &&  ((mkdir_cache.slot[index] == mkdir_cache_removed)
+       || (strcmp( mkdir_cache.slot[index], pathname ) != 0))  )
+    index = (index + 1) & mask;
+  return mkdir_cache.slot + index;
+}
+
+static int mkdir_cache_lookup( const char *pathname )
+{
+  /* Check if "pathname" is known to be an existing directory,
+   * counting each occasion on which it is.
+   */
+  int found = 0;
+  if( mkdir_cache.depth > 0 )
+  {
+    EnterCriticalSection( &mkdir_cache.lock );
+    if( (mkdir_cache.slot != NULL) && (*mkdir_cache_probe( pathname ) != NULL) )
+    {
+      ++mkdir_cache.hits;
+      found = 1;
+    }
+    LeaveCriticalSection( &mkdir_cache.lock );
+  }
+  return found;
+}
+
+static void mkdir_cache_insert( const char *pathname )
+{
+  /* Record "pathname" as an existing directory; the table is doubled
+   * in size, whenever it would become more than half full, (counting
+   * removed entries, which are discarded when the table is rebuilt).
+   */
+  if( mkdir_cache.depth > 0 )
+  {
+    EnterCriticalSection( &mkdir_cache.lock );
+    if( (mkdir_cache.count + 1) > (mkdir_cache.size >> 1) )
+    {
+      size_t index, size = mkdir_cache.size;
+      char **slot = mkdir_cache.slot;
+      mkdir_cache.size = (size > 0) ? size << 1 : 256;
+      if( (mkdir_cache.slot = (char **)(calloc( mkdir_cache.size, sizeof( char * ) ))) == NULL )
+      {
+	/* We couldn't grow the table; keep the original.
+	 */
+	mkdir_cache.slot = slot;
+	mkdir_cache.size = size;
+      }
+      else
+      { mkdir_cache.count = 0;
+	for( index = 0; index < size; index++ )
+	  if( (slot[index] != NULL) && (slot[index] != mkdir_cache_removed) )
+	  {
+	    *mkdir_cache_probe( slot[index] ) = slot[index];
+	    ++mkdir_cache.count;
+	  }
+	free( slot );
+      }
+    }
+    if( (mkdir_cache.count + 1) <= (mkdir_cache.size >> 1) )
+    {
+      char **ref = mkdir_cache_probe( pathname );
+      if( (*ref == NULL) && ((*ref = strdup( pathname )) != NULL) )
+	++mkdir_cache.count;
+    }
+    LeaveCriticalSection( &mkdir_cache.lock );
+  }
+}
+
+static void mkdir_cache_remove( const char *pathname )
+{
+  /* Discard any cache entry for "pathname", when we have discovered
+   * that it does not, (or no longer does), exist.
+   */
+  if( mkdir_cache.depth > 0 )
+  {
+    EnterCriticalSection( &mkdir_cache.lock );
+    if( mkdir_cache.slot != NULL )
+    {
+      char **ref = mkdir_cache_probe( pathname );
+      if( *ref != NULL )
+      {
+	free( *ref );
+	*ref = mkdir_cache_removed;
+      }
+    }
+    LeaveCriticalSection( &mkdir_cache.lock );
+  }
+}
+
+void mkdir_cache_enable( void )
+{
+  /* Public entry point, to activate the cache; calls may be nested,
+   * but only the outermost establishes the (initially empty) cache.
+   */
+  if( mkdir_cache.depth++ == 0 )
+  {
+    InitializeCriticalSection( &mkdir_cache.lock );
+    mkdir_cache.slot = NULL;
+    mkdir_cache.size = mkdir_cache.count = 0;
+    mkdir_cache.hits = 0;
+  }
+}
+
+static void mkdir_cache_discard( void )
+{
+  /* Helper to discard all cached entries, (the caller must hold the
+   * lock, or otherwise have exclusive access to the cache).
+   */
+  size_t index;
+  for( index = 0; index < mkdir_cache.size; index++ )
+    if( mkdir_cache.slot[index] != mkdir_cache_removed )
+      free( mkdir_cache.slot[index] );
+  free( mkdir_cache.slot );
+  mkdir_cache.slot = NULL;
+  mkdir_cache.size = mkdir_cache.count = 0;
+}
+
+void mkdir_cache_flush( void )
+{
+  /* Public entry point, to discard all cached entries, while leaving
+   * the cache active; this must be called whenever any directory may
+   * have been removed, (e.g. when a package is uninstalled, within a
+   * transaction which will subsequently install others).
+   */
+  if( mkdir_cache.depth > 0 )
+  {
+    EnterCriticalSection( &mkdir_cache.lock );
+    mkdir_cache_discard();
+    LeaveCriticalSection( &mkdir_cache.lock );
+  }
+}
+
+int mkdir_cache_disable( unsigned long *hits )
+{
+  /* Public entry point, to deactivate the cache; when this matches the
+   * outermost mkdir_cache_enable() call, we discard all entries, and
+   * report how many lookups were satisfied from the cache, (each of
+   * which saved both a mkdir() and a stat() call).  Returns the number
+   * of enabling calls which remain unmatched.
+   */
+  if( (mkdir_cache.depth > 0) && (--mkdir_cache.depth == 0) )
+  {
+    mkdir_cache_discard();
+    DeleteCriticalSection( &mkdir_cache.lock );
+    if( hits != NULL ) *hits = mkdir_cache.hits;
+  }
+  return mkdir_cache.depth;
+}
+
 static
 void create_parent_directory_hierarchy( const char *pathname, int mode )
 {
@@ -298,9 +496,12 @@ void create_parent_directory_hierarchy( const char *pathname, int mode )
       /* We found a valid point, at which to split the current leaf
        * of "pathname" from its parent branch hierarchy; split it and
        * recurse through the "mkdir" function, to create the parent
-       * directory hierarchy, as required.
+       * directory hierarchy, as required.  Since we are called only
+       * when the parent has been found not to exist, we must first
+       * discard any stale record, which claims that it does.
        */
       *stop = '\0';
+      mkdir_cache_remove( parent );
       mkdir_recursive( parent, mode );
     }
 
@@ -315,12 +516,19 @@ int mkdir_recursive( const char *pathname, int mode )
 {
   /* Public entry point for the recursive "mkdir" function.
    *
-   * First, we attempt a simple "mkdir"; if this succeeds, the
-   * parent directory branch is already in place, and we have
-   * nothing more to do.
+   * When the directory is already known to exist, there is nothing
+   * to do; otherwise, we attempt a simple "mkdir"; if this succeeds,
+   * the parent directory branch is already in place, and we have
+   * nothing more to do, but to record the new directory.
    */
+  if( mkdir_cache_lookup( pathname ) )
+    return 0;
+
   if( mkdir( pathname, mode ) == 0 )
+  {
+    mkdir_cache_insert( pathname );
     return 0;
+  }
 
   /* Otherwise...
    */
@@ -335,7 +543,10 @@ int mkdir_recursive( const char *pathname, int mode )
       /*
        * ...before making a further attempt to add the leaf.
        */
-      return mkdir( pathname, mode );
+      if( mkdir( pathname, mode ) != 0 )
+	return -1;
+      mkdir_cache_insert( pathname );
+      return 0;
 
     case EEXIST:
       {
@@ -346,7 +557,10 @@ int mkdir_recursive( const char *pathname, int mode )
 	 */
 	struct stat target;
 	if( (stat( pathname, &target ) == 0) && S_ISDIR( target.st_mode ) )
+	{
+	  mkdir_cache_insert( pathname );
 	  return 0;
+	}
       }
   }
   /* ...otherwise we simply fall through and fail...
@@ -383,4 +597,43 @@ int set_output_stream( const char *pathname, int mode )
   return fd;
 }
 
+int flush_parent_directory( const char *pathname )
+{
+  /* Ask the file system to commit the directory which contains the
+   * specified entity, (and thus, any entry which has been created, or
+   * renamed, within it), to disk; returns zero on success, or -1 on
+   * failure.  CreateFile() will open a directory only with backup
+   * semantics, and FlushFileBuffers() requires a writable handle.
+   */
+  int status = -1;
+  const char *p, *sep = NULL;
+  for( p = pathname; *p; p++ )
+    if( (*p == '/') || (*p == '\\') )
+      sep = p;
+
+  if( sep != NULL )
+  {
+    /* When the parent is the root directory of a drive, we must
+     * retain its separator.
+     */
+    HANDLE dir;
+    size_t len = sep - pathname;
+    char dirname[2 + len];
+    if( (len == 2) && (pathname[1] == ':') ) ++len;
+    memcpy( dirname, pathname, len );
+    dirname[len] = '\0';
+
+    if( (dir = CreateFileA( dirname, GENERIC_WRITE,
+	    FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL,
+	    OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, NULL
+	  )) != INVALID_HANDLE_VALUE  )
+    {
+      if( FlushFileBuffers( dir ) )
+	status = 0;
+      CloseHandle( dir );
+    }
+  }
+  return status;
+}
+
 /* $RCSfile$: end of file */
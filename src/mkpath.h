@@ -5,7 +5,7 @@
  * $Id$
  *
  * Written by Keith Marshall <keithmarshall@users.sourceforge.net>
- * Copyright (C) 2009, 2011, MinGW Project
+ * Copyright (C) 2009, 2011, 2026, MinGW Project
  *
  *
  * Prototype declarations for the path name constructor functions,
@@ -38,10 +38,15 @@
 #endif
 
 EXTERN_C int mkdir_recursive( const char *, int );
+EXTERN_C void mkdir_cache_enable( void );
+EXTERN_C void mkdir_cache_flush( void );
+EXTERN_C int mkdir_cache_disable( unsigned long * );
 EXTERN_C int set_output_stream( const char *, int );
+EXTERN_C int flush_parent_directory( const char * );
 EXTERN_C int mkpath( char *, const char *, const char *, const char * );
 
 EXTERN_C const char *pkgArchivePath();
 EXTERN_C const char *pkgSourceArchivePath();
+EXTERN_C const char *pkgTranscodedArchivePath();
 
 #endif /* MKPATH_H: $RCSfile$: end of file */
@@ -5,7 +5,7 @@
  * $Id$
  *
  * Written by Keith Marshall <keith@users.osdn.me>
- * Copyright (C) 2009-2013, 2020, MinGW.org Project
+ * Copyright (C) 2009-2013, 2020, 2026, MinGW.org Project
  *
  *
  * Public interface for the package directory management routines;
@@ -387,13 +387,11 @@ class pkgXmlDocument : public TiXmlDocument
 	delete oldroot;
       LinkEndChild( root );
     }
-    inline bool Save( const char *filename )
-    {
-      /* This wxXmlDocument method for saving the database is equivalent
-       * to the corresponding tinyxml SaveFile( const char* ) method.
-       */
-      return SaveFile( filename );
-    }
+    /* This wxXmlDocument method for saving the database is equivalent
+     * to the corresponding tinyxml SaveFile( const char* ) method, except
+     * when durable installation has been requested.
+     */
+    bool Save( const char* );
 
   private:
     /* Properties specifying the schedule of actions.
@@ -428,6 +426,12 @@ class pkgXmlDocument : public TiXmlDocument
      */
     void UpdateSystemMap();
 
+    /* Method to check the installed files, within every sysroot, against
+     * the manifests of the packages which installed them; it returns the
+     * number of discrepancies found.
+     */
+    unsigned long VerifyInstallation();
+
     /* Method to locate the XML database entry for a named package.
      */
     pkgXmlNode* FindPackageByName( const char*, const char* = NULL );
@@ -0,0 +1,647 @@
+/*
+ * pkgcache.cpp
+ *
+ * $Id$
+ *
+ * Copyright (C) 2026, MinGW.org Project
+ *
+ *
+ * Implementation of the optional package cache transcoder; when this is
+ * enabled, each archive in the package cache is decoded once, and then
+ * recompressed into zstd format, which is substantially faster to decode
+ * than xz, lzma, or bzip2; subsequent requests to open the archive, via
+ * pkgOpenArchiveStream(), will then read the transcoded copy in place of
+ * the original, which is retained unchanged, (so that its digest may
+ * continue to be verified against that published in the catalogue).
+ *
+ *
+ * This is free software.  Permission is granted to copy, modify and
+ * redistribute this software, under the provisions of the GNU General
+ * Public License, Version 3, (or, at your option, any later version),
+ * as published by the Free Software Foundation; see the file COPYING
+ * for licensing details.
+ *
+ * Note, in particular, that this software is provided "as is", in the
+ * hope that it may prove useful, but WITHOUT WARRANTY OF ANY KIND; not
+ * even an implied WARRANTY OF MERCHANTABILITY, nor of FITNESS FOR ANY
+ * PARTICULAR PURPOSE.  Under no circumstances will the author, or the
+ * MinGW Project, accept liability for any damages, however caused,
+ * arising from the use of this software.
+ *
+ */
+#define  PKGSTRM_H_SPECIAL  1
+
+#include "pkgimpl.h"
+#include "pkgstrm.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <utime.h>
+#include <dirent.h>
+#include <windows.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "dmh.h"
+#include "mkpath.h"
+#include "pkgopts.h"
+
+#ifndef O_BINARY
+/* POSIX hosts don't distinguish binary from text files.
+ */
+# define O_BINARY  0
+#endif
+
+/* Each transcoded copy is a regular zstd compressed file, (which may
+ * be decompressed by any zstd utility), but it is introduced by a zstd
+ * "skippable frame", which carries a record of the size and modification
+ * time of the original archive, (so that we may detect when the copy has
+ * become stale), together with the time which was required to decode the
+ * original, (so that we may report the time saved, when we use the copy
+ * in its place); all numeric fields are stored in little-endian order.
+ */
+#define TRANSCODE_FRAME_MAGIC		0x184D2A5EUL
+#define TRANSCODE_PAYLOAD_SIZE		32
+#define TRANSCODE_HEADER_SIZE		(8 + TRANSCODE_PAYLOAD_SIZE)
+
+static const char transcode_tag[8] = { 'm','g','-','x','c','o','d','e' };
+
+/* Unless the user specifies otherwise, transcoded copies may occupy up
+ * to this many megabytes of disk space, in aggregate.
+ */
+#define TRANSCODE_DEFAULT_BUDGET	1024
+
+/* When a transcoded copy would exceed the budget, in its own right, we
+ * record a header only "declined" marker in its place, (noting the size
+ * which would have been required, in the decode time field, together
+ * with the following flag), so that we don't repeatedly waste time in
+ * creating a copy, only to discard it, unless the budget is increased.
+ */
+#define TRANSCODE_DECLINED		(1ULL << 63)
+
+struct transcode_header
+{
+  /* The decoded form of the information which is recorded in the
+   * skippable frame, at the start of each transcoded copy.
+   */
+  uint64_t	source_size;
+  int64_t	source_mtime;
+  uint64_t	decode_time;
+};
+
+static void put_u32( uint8_t *p, uint32_t value )
+{
+  /* Helper to store a 32-bit value, in little-endian byte order.
+   */
+  for( int i = 0; i < 4; i++, value >>= 8 ) p[i] = (uint8_t)(value);
+}
+
+static void put_u64( uint8_t *p, uint64_t value )
+{
+  /* Helper to store a 64-bit value, in little-endian byte order.
+   */
+  for( int i = 0; i < 8; i++, value >>= 8 ) p[i] = (uint8_t)(value);
+}
+
+static uint64_t get_u64( const uint8_t *p )
+{
+  /* Helper to retrieve a 64-bit value, from little-endian byte order.
+   */
+  uint64_t value = 0;
+  for( int i = 7; i >= 0; i-- ) value = (value << 8) | p[i];
+  return value;
+}
+
+static bool write_header( int fd, const transcode_header *header )
+{
+  /* Helper to write the skippable frame, which introduces any
+   * transcoded copy, at the current position of the file "fd".
+   */
+  uint8_t frame[TRANSCODE_HEADER_SIZE];
+  put_u32( frame, TRANSCODE_FRAME_MAGIC );
+  put_u32( frame + 4, TRANSCODE_PAYLOAD_SIZE );
+  memcpy( frame + 8, transcode_tag, sizeof( transcode_tag ) );
+  put_u64( frame + 16, header->source_size );
+  put_u64( frame + 24, (uint64_t)(header->source_mtime) );
+  put_u64( frame + 32, header->decode_time );
+  return write( fd, frame, sizeof( frame ) ) == (int)(sizeof( frame ));
+}
+
+static bool read_header( int fd, transcode_header *header )
+{
+  /* Helper to read, and validate, the skippable frame which introduces
+   * a transcoded copy; on return, "fd" is positioned at the start of
+   * the zstd compressed data which follows it.
+   */
+  uint8_t frame[TRANSCODE_HEADER_SIZE], expected[8];
+  put_u32( expected, TRANSCODE_FRAME_MAGIC );
+  put_u32( expected + 4, TRANSCODE_PAYLOAD_SIZE );
+  if( (read( fd, frame, sizeof( frame )) != (int)(sizeof( frame )))
+  ||  (memcmp( frame, expected, sizeof( expected )) != 0)
+  ||  (memcmp( frame + 8, transcode_tag, sizeof( transcode_tag )) != 0)  )
+    return false;
+
+  header->source_size = get_u64( frame + 16 );
+  header->source_mtime = (int64_t)(get_u64( frame + 24 ));
+  header->decode_time = get_u64( frame + 32 );
+  return true;
+}
+
+static uint64_t elapsed_time()
+{
+  /* Helper to read a high resolution clock, returning an arbitrarily
+   * based time stamp, in microseconds.
+   */
+  static LARGE_INTEGER frequency;
+  LARGE_INTEGER count;
+  if( frequency.QuadPart == 0 ) QueryPerformanceFrequency( &frequency );
+  QueryPerformanceCounter( &count );
+  return (uint64_t)(count.QuadPart) * 1000000ULL / frequency.QuadPart;
+}
+
+/* Accumulated statistics, from which pkgTranscodedArchiveReport() will
+ * compute the decoding time saved, by using transcoded copies.
+ */
+static struct
+{
+  unsigned	archives;
+  uint64_t	source_time;
+  uint64_t	decode_time;
+} transcode_stats;
+
+/*****
+ *
+ * Class Implementation: pkgTranscodedArchiveStream
+ *
+ */
+class pkgTranscodedArchiveStream : public pkgArchiveStream
+{
+  /* A pkgArchiveStream specialisation, which delivers the content of
+   * an archive from its transcoded copy; the decoding is delegated to
+   * the zstd stream which is attached to the copy, but we keep account
+   * of the time spent decoding, and we refer any digest check to the
+   * original archive.
+   */
+  public:
+    pkgTranscodedArchiveStream( pkgArchiveStream*, const char*, uint64_t );
+    virtual ~pkgTranscodedArchiveStream();
+
+    inline bool IsReady(){ return decoder->IsReady(); }
+
+    virtual int GetView( const char** );
+    virtual void ReleaseView( size_t );
+
+    virtual void EnableDigest(){ digest_requested = true; }
+    virtual bool DigestMatches( const char* );
+
+  private:
+    pkgArchiveStream *decoder;
+    char *source;
+    uint64_t source_time, decode_time;
+    bool digest_requested, used, failed;
+
+    virtual int Decode( char*, size_t );
+};
+
+pkgTranscodedArchiveStream::pkgTranscodedArchiveStream
+( pkgArchiveStream *stream, const char *original, uint64_t original_time ):
+decoder( stream ), source( strdup( original ) ), source_time( original_time ),
+decode_time( 0 ), digest_requested( false ), used( false ), failed( false ){}
+
+pkgTranscodedArchiveStream::~pkgTranscodedArchiveStream()
+{
+  /* Destructor releases the decoder; if the archive was read, and
+   * no decoding error occurred, it also contributes to the statistics.
+   * Note that we cannot insist that the archive was read to its very
+   * end, since tar archive processing stops at the archive's end marker,
+   * so disregarding any trailing padding; however, that is so trivial
+   * a fraction of the whole, that the decoding time remains directly
+   * comparable with that of the original.
+   */
+  if( used && ! failed )
+  {
+    transcode_stats.archives++;
+    transcode_stats.source_time += source_time;
+    transcode_stats.decode_time += decode_time;
+  }
+  delete decoder;
+  free( source );
+}
+
+int pkgTranscodedArchiveStream::GetView( const char **ref )
+{
+  /* Lend access to decoded data, by way of the decoder's own view
+   * API, while keeping account of the time spent in doing so.
+   */
+  uint64_t start = elapsed_time();
+  int count = decoder->GetView( ref );
+  decode_time += elapsed_time() - start;
+  if( count > 0 ) used = true;
+  else if( count < 0 ) failed = true;
+  return count;
+}
+
+void pkgTranscodedArchiveStream::ReleaseView( size_t count )
+{
+  /* Views are lent by the decoder, so it must be the decoder which
+   * marks them as consumed.
+   */
+  decoder->ReleaseView( count );
+}
+
+int pkgTranscodedArchiveStream::Decode( char *buf, size_t max )
+{
+  /* Since we override the generic view API, the only requirement for
+   * this method is to satisfy direct calls; the generic Read() method,
+   * (which uses our own view API), will serve.
+   */
+  return Read( buf, max );
+}
+
+bool pkgTranscodedArchiveStream::DigestMatches( const char *expected )
+{
+  /* The published digest relates to the original archive, rather than
+   * to the transcoded copy; we must compute it from the original, which
+   * requires no decoding, so we may simply read it as a raw stream.
+   */
+  if( ! digest_requested )
+    return false;
+
+  pkgRawArchiveStream original( source );
+  if( ! original.IsReady() )
+    return false;
+
+  char scratch[BUFSIZ];
+  original.EnableDigest();
+  while( original.Read( scratch, sizeof( scratch ) ) > 0 )
+    ;
+  return original.DigestMatches( expected );
+}
+
+/*****
+ *
+ * Auxiliary functions: the transcoder, and its cache budget manager.
+ *
+ */
+struct transcoded_file
+{
+  /* Helper structure, to record the name, size, and time of last use,
+   * for each existing transcoded copy, when we must make space for a
+   * new one.
+   */
+  char *name;
+  uint64_t size;
+  time_t last_used;
+};
+
+static int compare_last_used( const void *a, const void *b )
+{
+  /* qsort() helper, to order transcoded copies, such that the least
+   * recently used comes first.
+   */
+  time_t ta = ((const transcoded_file *)(a))->last_used;
+  time_t tb = ((const transcoded_file *)(b))->last_used;
+  return (ta < tb) ? -1 : (ta > tb) ? 1 : 0;
+}
+
+static uint64_t transcode_budget()
+{
+  /* Helper to retrieve the budget for transcoded copies, in bytes;
+   * zero represents an unlimited budget.
+   */
+  pkgOpts *options = pkgOptions();
+  uint64_t budget = options->IsSet( OPTION_CACHE_TRANSCODE_BUDGET )
+    ? options->GetValue( OPTION_CACHE_TRANSCODE_BUDGET )
+    : TRANSCODE_DEFAULT_BUDGET;
+  return budget << 20;
+}
+
+static bool allocate_budget( const char *dir, const char *keep, uint64_t size )
+{
+  /* Ensure that the aggregate size of all transcoded copies in "dir",
+   * (specified with its trailing directory separator), but excluding
+   * any stale copy of "keep", (which is about to be replaced), together
+   * with a new copy of "size" bytes, will not exceed the budget; if
+   * necessary, we discard the least recently used copies, to make space,
+   * but we fail if the new copy could never fit.
+   */
+  uint64_t budget = transcode_budget();
+  if( budget == 0 )
+    return true;
+
+  if( budget < size )
+    return false;
+
+  DIR *listing;
+  if( (listing = opendir( dir )) == NULL )
+    return false;
+
+  /* Survey the existing transcoded copies...
+   */
+  struct dirent *entry;
+  transcoded_file *files = NULL;
+  unsigned count = 0, capacity = 0;
+  uint64_t total = size;
+  while( (entry = readdir( listing )) != NULL )
+  {
+    struct stat info;
+    size_t len = strlen( entry->d_name );
+    if( (len < 4) || (strcmp( entry->d_name + len - 4, ".zst" ) != 0)
+    ||  (strcmp( entry->d_name, keep ) == 0)  )
+      continue;
+
+    char path[mkpath( NULL, "%F%M", dir, entry->d_name )];
+    mkpath( path, "%F%M", dir, entry->d_name );
+    if( (stat( path, &info ) != 0) || ! S_ISREG( info.st_mode ) )
+      continue;
+
+    if( count == capacity )
+    {
+      capacity = capacity ? capacity << 1 : 32;
+      files = (transcoded_file *)(realloc( files, capacity * sizeof( transcoded_file ) ));
+    }
+    files[count].name = strdup( path );
+    files[count].size = info.st_size;
+    files[count].last_used = info.st_mtime;
+    total += files[count++].size;
+  }
+  closedir( listing );
+
+  /* ...then, if necessary, discard the least recently used of them,
+   * until the new copy will fit within the budget.
+   */
+  if( (total > budget) && (count > 1) )
+    qsort( files, count, sizeof( transcoded_file ), compare_last_used );
+  for( unsigned i = 0; i < count; i++ )
+  {
+    if( (total > budget) && (unlink( files[i].name ) == 0) )
+      total -= files[i].size;
+    free( files[i].name );
+  }
+  free( files );
+  return total <= budget;
+}
+
+static bool is_transcode_candidate( int fd )
+{
+  /* Inspect the leading content of the archive file "fd", to determine
+   * whether transcoding would be worthwhile; it is not, if the archive
+   * is already zstd compressed, or not compressed at all, nor if it is
+   * in a format which we cannot decode.  We return with "fd" rewound.
+   */
+  int count, residual;
+  uint8_t sample[pkgArchiveSignature::SampleSize];
+  for( count = 0; (count < (int)(sizeof( sample )))
+  &&  ((residual = read( fd, sample + count, sizeof( sample ) - count )) > 0);
+       count += residual )
+    ;
+  lseek( fd, 0, SEEK_SET );
+
+  const pkgArchiveSignature *format;
+  return ((format = pkgArchiveSignature::Identify( sample, count )) != NULL)
+    && (format->Factory() != NULL)
+    && (strcmp( format->FormatName(), "zstd" ) != 0)
+    && (strcmp( format->FormatName(), "tar" ) != 0);
+}
+
+static bool transcode( const char *source, const char *dest, const char *dir,
+    const char *name, const struct stat *info, unsigned level )
+{
+  /* Create a transcoded copy, "dest", of the archive "source"; this is
+   * written to a temporary file initially, and moved into place only on
+   * successful completion, within the budget.
+   */
+  int fd;
+  if( (fd = open( source, O_RDONLY | O_BINARY )) < 0 )
+    return false;
+
+  if( ! is_transcode_candidate( fd ) )
+  {
+    close( fd );
+    return false;
+  }
+  pkgArchiveStream *input = pkgAttachArchiveStream( fd, source );
+  if( ! input->IsReady() )
+  {
+    delete input;
+    return false;
+  }
+  input->EnableReadAhead( fd );
+
+  char temp[strlen( dest ) + 5];
+  sprintf( temp, "%s.tmp", dest );
+  unlink( temp );
+  int out;
+  if( (out = set_output_stream( temp, 0644 )) < 0 )
+  {
+    delete input;
+    return false;
+  }
+
+  /* Reserve space for the header, (which we will rewrite when we know
+   * how long it took to decode the original), then recompress all of
+   * the decoded content of the original...
+   */
+  transcode_header header;
+  header.source_size = info->st_size;
+  header.source_mtime = info->st_mtime;
+  header.decode_time = 0;
+  bool ok = write_header( out, &header );
+
+  ZSTD_CCtx *encoder = ZSTD_createCCtx();
+  ok = ok && (encoder != NULL)
+    && ! ZSTD_isError( ZSTD_CCtx_setParameter( encoder, ZSTD_c_compressionLevel, level ));
+
+  size_t outbuf_size = ZSTD_CStreamOutSize();
+  uint8_t *outbuf = (uint8_t *)(malloc( outbuf_size ));
+  ok = ok && (outbuf != NULL);
+
+  const char *data;
+  int count = 1;
+  while( ok && (count > 0) )
+  {
+    /* ...timing only the decoding phase of each cycle.
+     */
+    uint64_t cycle = elapsed_time();
+    count = input->GetView( &data );
+    header.decode_time += elapsed_time() - cycle;
+    if( count < 0 ) ok = false;
+
+    else
+    { ZSTD_EndDirective mode = (count > 0) ? ZSTD_e_continue : ZSTD_e_end;
+      ZSTD_inBuffer in = { data, (size_t)(count), 0 };
+      size_t pending;
+      do { ZSTD_outBuffer zout = { outbuf, outbuf_size, 0 };
+	   pending = ZSTD_compressStream2( encoder, &zout, &in, mode );
+	   if( ZSTD_isError( pending )
+	   ||  (write( out, outbuf, zout.pos ) != (int)(zout.pos))  )
+	     ok = false;
+	 } while( ok && ((mode == ZSTD_e_end) ? (pending > 0) : (in.pos < in.size)) );
+      input->ReleaseView( count );
+    }
+  }
+  free( outbuf );
+  ZSTD_freeCCtx( encoder );
+  delete input;
+
+  /* Complete the header, and check the size of the transcoded copy
+   * against the budget; if all is well, move it into place.
+   */
+  struct stat result;
+  ok = ok && (lseek( out, 0, SEEK_SET ) == 0) && write_header( out, &header );
+  ok = (close( out ) == 0) && ok && (stat( temp, &result ) == 0)
+    && allocate_budget( dir, name, result.st_size );
+
+  unlink( dest );
+  if( ! ok && (stat( temp, &result ) == 0)
+  &&  (transcode_budget() != 0) && ((uint64_t)(result.st_size) > transcode_budget())
+  &&  ((out = set_output_stream( dest, 0644 )) >= 0)  )
+  {
+    /* The copy could never fit within the budget; rather than simply
+     * discard it, we leave a marker to record this.
+     */
+    header.decode_time = TRANSCODE_DECLINED | result.st_size;
+    write_header( out, &header );
+    close( out );
+    unlink( temp );
+    dmh_notify( DMH_WARNING,
+	"%s: transcoded copy would exceed cache budget\n", source
+      );
+    return false;
+  }
+  if( ok && (rename( temp, dest ) == 0) )
+  {
+    if( pkgOptions()->Test( OPTION_VERBOSE ) > 1 )
+      dmh_printf( "transcode: %s: %.3f s decode time\n",
+	  name, header.decode_time / 1000000.0
+	);
+    return true;
+  }
+  unlink( temp );
+  dmh_notify( DMH_WARNING, "%s: cannot create transcoded copy\n", source );
+  return false;
+}
+
+static pkgArchiveStream *open_transcoded_copy
+( const char *source, const char *dest, const struct stat *info, bool *declined )
+{
+  /* Open the transcoded copy "dest", of the archive "source", provided
+   * it exists, and is not stale; return NULL otherwise, also indicating,
+   * via "declined", when creation of a copy has been declined, due to
+   * insufficient budget.
+   */
+  int fd;
+  *declined = false;
+  if( (fd = open( dest, O_RDONLY | O_BINARY )) < 0 )
+    return NULL;
+
+  transcode_header header;
+  if( ! read_header( fd, &header )
+  ||  (header.source_size != (uint64_t)(info->st_size))
+  ||  (header.source_mtime != (int64_t)(info->st_mtime))  )
+  {
+    close( fd );
+    return NULL;
+  }
+  if( (header.decode_time & TRANSCODE_DECLINED) != 0 )
+  {
+    /* This is a "declined" marker; it remains applicable, unless the
+     * budget has since been increased sufficiently to accommodate the
+     * copy which was previously declined.
+     */
+    uint64_t budget = transcode_budget();
+    *declined = (budget != 0) && ((header.decode_time & ~TRANSCODE_DECLINED) > budget);
+    close( fd );
+    return NULL;
+  }
+  pkgArchiveStream *stream = pkgAttachArchiveStream( fd, dest );
+  if( ! stream->IsReady() )
+  {
+    delete stream;
+    return NULL;
+  }
+  /* We have a valid copy; update its modification time, so that the
+   * budget manager will recognise it as recently used.
+   */
+  utime( dest, NULL );
+  stream->EnableReadAhead( fd );
+  return new pkgTranscodedArchiveStream( stream, source, header.decode_time );
+}
+
+EXTERN_C pkgArchiveStream *pkgOpenTranscodedArchive( const char *filename )
+{
+  /* Open a transcoded copy of the archive "filename", creating it if
+   * necessary, provided the user has enabled the transcoder, and that
+   * the archive is stored within the package cache; return NULL, if no
+   * transcoded copy is available, so that the caller may fall back to
+   * opening the original.
+   */
+  unsigned level = pkgOptions()->GetValue( OPTION_CACHE_TRANSCODE );
+  if( level == 0 )
+    return NULL;
+
+  /* Identify the package cache directory, (including its trailing
+   * directory separator), and confirm that the archive is stored
+   * within it...
+   */
+  const char *cache = pkgArchivePath(), *nothing = "";
+  char cache_dir[mkpath( NULL, cache, nothing, NULL )];
+  mkpath( cache_dir, cache, nothing, NULL );
+  size_t len = strlen( cache_dir );
+  if( strncmp( filename, cache_dir, len ) != 0 )
+    return NULL;
+
+  struct stat info;
+  if( stat( filename, &info ) != 0 )
+    return NULL;
+
+  /* ...then identify the corresponding transcoded copy, (which has the
+   * same name, with an additional ".zst" suffix, but is stored in its
+   * own directory).
+   */
+  const char *name = filename + len;
+  char dest_name[strlen( name ) + 5];
+  sprintf( dest_name, "%s.zst", name );
+
+  const char *transcoded = pkgTranscodedArchivePath();
+  char dir[mkpath( NULL, transcoded, nothing, NULL )];
+  mkpath( dir, transcoded, nothing, NULL );
+  char dest[mkpath( NULL, transcoded, dest_name, NULL )];
+  mkpath( dest, transcoded, dest_name, NULL );
+
+  /* Use any existing copy, which is not stale, or otherwise, (unless
+   * we have previously declined to do so), try to create a new one, and
+   * use that.
+   */
+  bool declined;
+  pkgArchiveStream *stream;
+  if( ((stream = open_transcoded_copy( filename, dest, &info, &declined )) == NULL)
+  &&  ! declined && transcode( filename, dest, dir, dest_name, &info, level )  )
+    stream = open_transcoded_copy( filename, dest, &info, &declined );
+  return stream;
+}
+
+EXTERN_C void pkgTranscodedArchiveReport()
+{
+  /* Report the aggregate decoding time saved, by use of transcoded
+   * copies in place of the original archives, if any were used.
+   */
+  if( transcode_stats.archives > 0 )
+  {
+    double saved = (double)(transcode_stats.source_time) - transcode_stats.decode_time;
+    dmh_notify( DMH_INFO,
+	"cache transcoder: %u archive(s); decode time %.3f s, (%.3f s saved)\n",
+	transcode_stats.archives, transcode_stats.decode_time / 1000000.0,
+	saved / 1000000.0
+      );
+  }
+  /* Having reported them, discard the statistics, so that any later
+   * report will not include them again.
+   */
+  memset( &transcode_stats, 0, sizeof( transcode_stats ) );
+}
+
+/* $RCSfile$: end of file */
@@ -4,7 +4,7 @@
  * $Id$
  *
  * Written by Keith Marshall <keith@users.osdn.me>
- * Copyright (C) 2009-2013, 2020, MinGW.org Project
+ * Copyright (C) 2009-2013, 2020, 2026, MinGW.org Project
  *
  *
  * Implementation of package management task scheduler and executive.
@@ -24,6 +24,8 @@
  * arising from the use of this software.
  *
  */
+#include <unistd.h>
+
 #include "dmh.h"
 #include "mkpath.h"
 
@@ -88,7 +90,9 @@ EXTERN_C const char *action_name( unsigned long index )
 
     "update",		/* update local copy of repository catalogues	    */
     "licence",		/* retrieve licence sources from repository	    */
-    "source"		/* retrieve package sources from repository	    */
+    "source",		/* retrieve package sources from repository	    */
+
+    "verify"		/* check installed files against their manifests    */
   };
 
   /* For specified "index", return a pointer to the associated keyword,
@@ -504,12 +508,76 @@ int reinstall_action_scheduled( pkgActionItem *package )
     );
 }
 
+static
+bool in_place_update_permitted( pkgActionItem *package )
+{
+  /* Helper function to identify scheduled removals, (in preparation
+   * for upgrade, or reinstallation), which may be performed in place;
+   * this is permitted, (unless disabled by the user), when the package
+   * is to be replaced from a tar archive.
+   */
+  const char *archive;
+  pkgOpts *options = pkgOptions();
+  return
+    ( (package->HasAttribute( ACTION_INSTALL ) == ACTION_INSTALL)
+      && (options->IsSet( OPTION_IN_PLACE_UPGRADE )
+	  ? (options->GetValue( OPTION_IN_PLACE_UPGRADE ) != 0) : true)
+      && (package->Selection() != NULL)
+      && ! match_if_explicit( archive = package->Selection()->ArchiveName(), value_none )
+      && ! pkgIsZipArchive( archive )
+    );
+}
+
+static
+bool durable_update_permitted( pkgActionItem *package )
+{
+  /* Helper function to identify scheduled removals, (in preparation
+   * for upgrade, or reinstallation), which must be deferred until the
+   * replacement has been installed, because the user has requested
+   * durable installation; as for in-place updates, this applies only
+   * when the package is to be replaced from a tar archive.
+   */
+  const char *archive;
+  return
+    ( (package->HasAttribute( ACTION_INSTALL ) == ACTION_INSTALL)
+      && (pkgOptions()->GetValue( OPTION_DURABLE_INSTALL ) != 0)
+      && (package->Selection() != NULL)
+      && ! match_if_explicit( archive = package->Selection()->ArchiveName(), value_none )
+      && ! pkgIsZipArchive( archive )
+    );
+}
+
 void pkgActionItem::Execute( bool with_download )
 {
   pkgActionItem *current = this;
   bool init_rites_pending = true;
   while( current->prev != NULL ) current = current->prev;
 
+  /* When the user has enabled streaming installation, and we are to
+   * perform the downloads, (but neither solely to populate the local
+   * cache, nor merely to list the package URIs), identify packages
+   * which may be installed as they are downloaded; these are packages
+   * which are not already present in the local cache, and which are to
+   * be freshly installed, (i.e. not replacing any existing installation,
+   * which must not be removed until its replacement has been secured);
+   * zip archives are excluded, since they cannot be read sequentially.
+   */
+  if( with_download && (pkgOptions()->GetValue( OPTION_STREAM_INSTALL ) != 0)
+  &&  (pkgOptions()->Test( OPTION_DOWNLOAD_ONLY ) != OPTION_DOWNLOAD_ONLY)  )
+    for( pkgActionItem *item = current; item != NULL; item = item->next )
+    {
+      const char *archive;
+      if( ((item->flags & ACTION_MASK) == ACTION_INSTALL)
+      &&  (item->Selection() != NULL) && (item->Selection( to_remove ) == NULL)
+      &&  ! match_if_explicit( archive = item->Selection()->ArchiveName(), value_none )
+      &&  ! pkgIsZipArchive( archive )  )
+      {
+	char archive_path[mkpath( NULL, pkgArchivePath(), archive, NULL )];
+	mkpath( archive_path, pkgArchivePath(), archive, NULL );
+	if( access( archive_path, R_OK ) != 0 ) item->flags |= ACTION_STREAM;
+      }
+    }
+
   /* Unless normal operations have been suppressed by the
    * --print-uris option, (in order to obtain a list of all
    * package URIs which the operation would access)...
@@ -541,8 +609,10 @@ void pkgActionItem::Execute( bool with_download )
    */
   if( pkgOptions()->Test( OPTION_DOWNLOAD_ONLY ) != OPTION_DOWNLOAD_ONLY )
   {
-    /* ...otherwise...
+    /* ...otherwise, keeping track of directories which are known to
+     * exist, throughout all package installations in the transaction...
      */
+    mkdir_cache_enable();
     while( current != NULL )
     {
       /* ...processing only those packages with assigned actions...
@@ -622,8 +692,15 @@ void pkgActionItem::Execute( bool with_download )
 	  {
 	    /* The selected package has been marked for removal, either
 	     * explicitly, or as an implicit prerequisite for upgrade, or
-	     * in preparation for reinstallation.
+	     * in preparation for reinstallation; when it is to be replaced
+	     * from a tar archive, we may update it in place, (and we must
+	     * do so, when installing durably, so that the prior installation
+	     * remains intact, should its replacement fail).
 	     */
+	    if( in_place_update_permitted( current ) )
+	      current->flags |= ACTION_IN_PLACE;
+	    if( durable_update_permitted( current ) )
+	      current->flags |= ACTION_IN_PLACE | ACTION_DURABLE;
 	    pkgRemove( current );
 	  }
 
@@ -638,6 +715,13 @@ void pkgActionItem::Execute( bool with_download )
 	      current->selection[ to_remove ] = NULL;
 	    pkgInstall( current );
 	    current->selection[ to_remove ] = tmp;
+
+	    /* After an in-place update, any files which the replacement
+	     * did not reinstate must still be removed, (or, after a durable
+	     * update which failed, the prior installation reinstated).
+	     */
+	    if( (current->flags & ACTION_IN_PLACE) == ACTION_IN_PLACE )
+	      pkgRemoveRetainedFiles( current );
 	  }
 	}
       }
@@ -646,6 +730,12 @@ void pkgActionItem::Execute( bool with_download )
       pkgSpinWait::Report( "Processing... (%c)", pkgSpinWait::Indicator() );
       current = current->next;
     }
+    /* Finally, if any transcoded archives were used, report the time
+     * which they saved, and similarly, report the file system calls
+     * which were saved by the directory cache.
+     */
+    pkgTranscodedArchiveReport();
+    report_mkdir_cache_savings();
   }
 }
 
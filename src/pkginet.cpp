@@ -4,7 +4,7 @@
  * $Id$
  *
  * Written by Keith Marshall <keith@users.osdn.me>
- * Copyright (C) 2009-2013, 2017, 2020, MinGW.org Project
+ * Copyright (C) 2009-2013, 2017, 2020, 2026, MinGW.org Project
  *
  *
  * Implementation of the package download machinery for mingw-get.
@@ -916,6 +916,15 @@ void pkgActionItem::DownloadArchiveFiles( pkgActionItem *current )
 	 */
 	current->flags &= ~(ACTION_DOWNLOAD);
 
+      else if( (current->flags & ACTION_STREAM) == ACTION_STREAM )
+	/*
+	 * ...as is also the case, at this stage, for any package which
+	 * is to be streamed from the download host, during installation;
+	 * (we clear the pending flag, so that the installer will not take
+	 * it as evidence of a prior download failure)...
+	 */
+	current->flags &= ~(ACTION_DOWNLOAD);
+
       else
 	/* ...but we expect any other package to provide real content,
 	 * for which we may need to download the package archive...
@@ -946,7 +955,7 @@ void pkgActionItem::DownloadArchiveFiles( pkgActionItem *current )
  * we will decompress them "on the fly", as we download them.  To achieve
  * this, we will use a variant of the pkgInternetStreamingAgent, using a
  * specialised TransferData method; additionally, this will incorporate
- * a special derivative of a pkgLzmaArchiveStream, with its GetRawData
+ * a special derivative of a pkgLzmaArchiveStream, with its ReadRawData
  * method adapted to stream data from an internet URI, instead of
  * reading from a local file.
  *
@@ -975,7 +984,7 @@ public pkgInternetStreamingAgent, public pkgLzmaArchiveStream
      * methods, (the first from the pkgLzmaArchiveStream base class;
      * the second from pkgInternetStreamingAgent).
      */
-    virtual int GetRawData( int, uint8_t*, size_t );
+    virtual int ReadRawData( int, uint8_t*, size_t );
     virtual int TransferData( int );
 };
 
@@ -998,7 +1007,7 @@ pkgInternetStreamingAgent( local_name, dest_specification ),
  */
 pkgLzmaArchiveStream( -2 ){}
 
-int pkgInternetLzmaStreamingAgent::GetRawData( int fd, uint8_t *buf, size_t max )
+int pkgInternetLzmaStreamingAgent::ReadRawData( int fd, uint8_t *buf, size_t max )
 {
   /* Fetch raw (compressed) data from the Internet host, and load it into
    * the decompression filter's input buffer, whence the TransferData routine
@@ -1015,9 +1024,207 @@ int pkgInternetLzmaStreamingAgent::TransferData( int fd )
    * stream it through the lzma decompression filter, and write a copy
    * of the resultant decompressed data to the destination file.
    */
-  char buf[8192]; unsigned long count;
-  do { count = pkgLzmaArchiveStream::Read( buf, sizeof( buf ) );
+  const char *buf; int count;
+
+  /* Network latency may be hidden, by allowing a separate thread to
+   * read ahead of the decompression filter, (when the user permits);
+   * this must be stopped again, before the caller closes the URL.  The
+   * decompressed data is written directly from the filter's own output
+   * buffer, by way of the archive stream's view API.
+   */
+  EnableReadAhead( -2 );
+  while( dl_status && ((count = GetView( &buf )) > 0) )
+  { write( fd, buf, count );
+    ReleaseView( count );
+  }
+  DisableReadAhead();
+
+  DEBUG_INVOKE_IF(
+      DEBUG_REQUEST( DEBUG_TRACE_INTERNET_REQUESTS ) && (dl_status == 0),
+      dmh_printf( "\nInternetReadFile:download error:%d\n", GetLastError() )
+    );
+  return dl_status;
+}
+
+/* Package archives may similarly be installed as they are downloaded,
+ * (when the user has enabled this); however, in this case we cannot know
+ * which decompression filter is required, until we have examined the
+ * leading content of the archive, so rather than deriving from any one
+ * specific archive stream class, we direct the downloaded data into a
+ * pipe, to which we then attach whichever archive stream is required.
+ * The download proceeds on a separate thread, which writes the raw data
+ * into both the pipe, and the "transit-file"; the latter is moved into
+ * the local package cache, on successful completion, exactly as it is
+ * for any regular download.
+ */
+#include <io.h>
+#include <fcntl.h>
+#include <process.h>
+
+class pkgInternetArchiveStream:
+public pkgArchiveStream, public pkgInternetStreamingAgent
+{
+  /* Specialisation of the pkgArchiveStream base class, delivering the
+   * decoded content of a package archive while it is being downloaded;
+   * the decoding is delegated to the archive stream which is attached
+   * to the pipe, and we also forward any digest requests to it.
+   */
+  public:
+    pkgInternetArchiveStream( const char*, const char*, const char* );
+    virtual ~pkgInternetArchiveStream();
+
+    inline bool IsReady(){ return decoder->IsReady(); }
+
+    virtual int GetView( const char** );
+    virtual void ReleaseView( size_t );
+
+    virtual void EnableDigest(){ decoder->EnableDigest(); }
+    virtual bool DigestMatches( const char *expected )
+    { return decoder->DigestMatches( expected ); }
+
+  private:
+    char *url;
+    pkgArchiveStream *decoder;
+    HANDLE thread;
+    int pipe_fd;
+
+    virtual int Decode( char*, size_t );
+    virtual int TransferData( int );
+    bool DownloadCompleted();
+
+    static unsigned __stdcall Downloader( void* );
+    static const unsigned PipeBufferSize = 1 << 20;
+};
+
+pkgInternetArchiveStream::pkgInternetArchiveStream
+( const char *local_name, const char *dest_specification, const char *from_url ):
+pkgInternetStreamingAgent( local_name, dest_specification ),
+url( strdup( from_url ) ), thread( NULL ), pipe_fd( -1 )
+{
+  /* Constructor creates the pipe, and starts the download thread to
+   * write into it...
+   */
+  int fd[2];
+  dl_status = 0;
+  if( _pipe( fd, PipeBufferSize, _O_BINARY | _O_NOINHERIT ) == 0 )
+  {
+    uintptr_t handle;
+    pipe_fd = fd[1];
+    if( (handle = _beginthreadex( NULL, 0, Downloader, this, 0, NULL )) != 0 )
+      thread = (HANDLE)(handle);
+
+    else
+    { /* We couldn't start the download thread; closing the input
+       * end of the pipe will ensure that the decoder sees nothing.
+       */
+      dmh_notify( DMH_ERROR, "Get package: %s: cannot start download\n", url );
+      close( pipe_fd ); pipe_fd = -1;
+    }
+    /* ...then attaches the appropriate archive stream to the output
+     * end of the pipe; (since this must read the leading content of
+     * the archive, to identify the required decompression filter, it
+     * will wait for the download to begin).
+     */
+    decoder = pkgAttachArchiveStream( fd[0], filename );
+  }
+  else
+  { /* We couldn't create the pipe; substitute an archive stream
+     * which will never be ready, so that the installer will decline
+     * to process it.
+     */
+    dmh_notify( DMH_ERROR, "Get package: %s: cannot create pipe\n", url );
+    decoder = new pkgRawArchiveStream( -1 );
+  }
+}
+
+pkgInternetArchiveStream::~pkgInternetArchiveStream()
+{
+  /* The destructor discards the decoder, thus closing the output end
+   * of the pipe; if the download is still in progress, (e.g. because
+   * the decoder didn't need the padding at the end of the archive), it
+   * will continue, to complete the copy in the "transit-file", so we
+   * must wait for it, before we release the remaining resources.
+   */
+  delete decoder;
+  DownloadCompleted();
+  free( url );
+}
+
+bool pkgInternetArchiveStream::DownloadCompleted()
+{
+  /* Helper method, to wait for termination of the download thread,
+   * (if it is still active), diagnosing any failure, and to report
+   * whether or not the download completed successfully.
+   */
+  if( thread != NULL )
+  {
+    WaitForSingleObject( thread, INFINITE );
+    CloseHandle( thread ); thread = NULL;
+    if( dl_status == 0 )
+      dmh_notify( DMH_ERROR, "Get package: %s: download failed\n", url );
+  }
+  return dl_status != 0;
+}
+
+int pkgInternetArchiveStream::GetView( const char **ref )
+{
+  /* Lend access to decoded data, by way of the decoder's own view
+   * API; if the decoder reaches the end of its stream, then we must
+   * confirm that the download was not terminated prematurely.
+   */
+  int count = decoder->GetView( ref );
+  if( (count == 0) && ! DownloadCompleted() )
+    return -1;
+  return count;
+}
+
+void pkgInternetArchiveStream::ReleaseView( size_t count )
+{
+  /* Views are lent by the decoder, so it must be the decoder which
+   * marks them as consumed.
+   */
+  decoder->ReleaseView( count );
+}
+
+int pkgInternetArchiveStream::Decode( char *buf, size_t max )
+{
+  /* Since we override the generic view API, the only requirement for
+   * this method is to satisfy direct calls; the generic Read() method,
+   * (which uses our own view API), will serve.
+   */
+  return Read( buf, max );
+}
+
+unsigned __stdcall pkgInternetArchiveStream::Downloader( void *ref )
+{
+  /* The thread procedure, which performs the download; this is simply
+   * a regular download, (with our TransferData() method writing to the
+   * pipe, as well as to the "transit-file"), after which we close the
+   * input end of the pipe, so that the decoder will see end of stream.
+   */
+  pkgInternetArchiveStream *stream = (pkgInternetArchiveStream *)(ref);
+  stream->Get( stream->url );
+  if( stream->pipe_fd != -1 ) close( stream->pipe_fd );
+  stream->pipe_fd = -1;
+  return 0;
+}
+
+int pkgInternetArchiveStream::TransferData( int fd )
+{
+  /* In this case, we read the file's data from the Internet source,
+   * and write a verbatim copy both to the destination file, and into
+   * the pipe; should the decoder close the pipe, (having read all the
+   * data it needs), we continue to write to the destination file only.
+   */
+  char buf[8192]; unsigned long count, tally = 0;
+  do { dl_status = pkgDownloadAgent.Read( dl_host, buf, sizeof( buf ), &count );
+       dl_meter->Update( tally += count );
        write( fd, buf, count );
+       if( (pipe_fd != -1) && (write( pipe_fd, buf, count ) != (int)(count)) )
+       {
+	 close( pipe_fd );
+	 pipe_fd = -1;
+       }
      } while( dl_status && (count > 0) );
 
   DEBUG_INVOKE_IF(
@@ -1027,6 +1234,33 @@ int pkgInternetLzmaStreamingAgent::TransferData( int fd )
   return dl_status;
 }
 
+EXTERN_C pkgArchiveStream *pkgOpenDownloadStream( pkgXmlNode *pkg )
+{
+  /* Open an archive stream, to deliver the content of the archive for
+   * the specified package release as it is downloaded; the download URL
+   * is constructed in the same manner as for DownloadSingleArchive().
+   */
+  const char *package_name = pkg->ArchiveName();
+  const char *url_template = get_host_info( pkg, uri_key );
+  if( url_template != NULL )
+  {
+    const char *mirror = get_host_info( pkg, mirror_key );
+    char package_url[mkpath( NULL, url_template, package_name, mirror )];
+    mkpath( package_url, url_template, package_name, mirror );
+
+    pkgDownloadAgent.SetRetryOptions( pkg, url_template );
+    return new pkgInternetArchiveStream( package_name, pkgArchivePath(), package_url );
+  }
+  /* If we get to here, we cannot download; the repository catalogue
+   * didn't specify a template, from which to construct a download URL;
+   * diagnose, and return a stream which will never be ready.
+   */
+  dmh_notify( DMH_ERROR,
+      "Get package: %s: no URL specified for download\n", package_name
+    );
+  return new pkgRawArchiveStream( -1 );
+}
+
 EXTERN_C const char *serial_number( const char *catalogue )
 {
   /* Local helper function to retrieve issue numbers from any repository
@@ -4,7 +4,7 @@
  * $Id$
  *
  * Written by Keith Marshall <keithmarshall@users.sourceforge.net>
- * Copyright (C) 2010, 2011, 2012, MinGW.org Project
+ * Copyright (C) 2010, 2011, 2012, 2026, MinGW.org Project
  *
  *
  * Implementation of the primary package installation and package
@@ -48,6 +48,7 @@ pkgManifest::pkgManifest( const char *tag, const char *tarname )
    */
   manifest = NULL;
   inventory = NULL;
+  read_only = false;
 
   /* Then we check that a package tarname has been provided...
    */
@@ -243,6 +244,54 @@ void pkgManifest::AddEntry( const char *key, const char *pathname )
   }
 }
 
+static const char *format_decimal( char *buf, uint64_t value, bool negative )
+{
+  /* Helper to format a 64-bit magnitude, (with optional sign), as
+   * a decimal string, filling the caller's buffer from its end; (we
+   * cannot rely on the C runtime's printf() to support 64-bit integer
+   * conversions, in any consistent fashion).  The buffer must be at
+   * least 22 bytes long; returns a pointer to the first digit, (or
+   * the sign, if any), within it.
+   */
+  char *p = buf + 21;
+  *p = '\0';
+  do { *--p = '0' + (char)(value % 10); value /= 10; } while( value > 0 );
+  if( negative ) *--p = '-';
+  return p;
+}
+
+void pkgManifest::AddEntry
+( const char *key, const char *pathname, uint64_t size, int64_t mtime,
+  const char *digest
+)
+{
+  /* Variant of the preceding method, invoked by package installers
+   * to record a regular file entry, together with the size and time
+   * stamp of the file, and (optionally) the hash of its content.
+   *
+   * These additional attributes are purely informative; they allow
+   * the installed content to be verified, without reference to the
+   * package archive, but any consumer which is interested only in
+   * the path name, (as pkgRemove() is), simply ignores them, and
+   * they may be absent from any entry, (as they are from entries
+   * recorded by earlier versions of mingw-get).
+   */
+  if( inventory != NULL )
+  {
+    char buf[22];
+    pkgXmlNode *entry = new pkgXmlNode( key );
+    entry->SetAttribute( pathname_key, pathname );
+    entry->SetAttribute( size_key, format_decimal( buf, size, false ) );
+    entry->SetAttribute( mtime_key, (mtime < 0)
+	? format_decimal( buf, -(uint64_t)(mtime), true )
+	: format_decimal( buf, mtime, false )
+      );
+    if( digest != NULL )
+      entry->SetAttribute( xxh64_key, digest );
+    inventory->AddChild( entry );
+  }
+}
+
 pkgManifest::~pkgManifest()
 {
   /* Destructor for package manifest images; it releases
@@ -253,10 +302,11 @@ pkgManifest::~pkgManifest()
   pkgXmlNode *ref;
   const char *sigfile;
 
-  /* First confirm that an identification signature has been
-   * assigned for this manifest...
+  /* First confirm that the manifest is not read only, and that an
+   * identification signature has been assigned for it...
    */
-  if(  ((manifest != NULL)) && ((ref = manifest->GetRoot()) != NULL)
+  if( ! read_only
+  &&   ((manifest != NULL)) && ((ref = manifest->GetRoot()) != NULL)
   &&   ((sigfile = ref->GetPropVal( id_key, NULL )) != NULL)          )
   {
     /* ...and map this to a file system reference path name.
@@ -436,12 +486,40 @@ EXTERN_C void pkgInstall( pkgActionItem *current )
 	}
 	else
 	{ /* Here we have a "real" (physical) package to install;
-	   * for the time being, we assume it is packaged in our
-	   * standard "tar" archive format.
+	   * this may be packaged as a zip archive, which we must read
+	   * from the local cache, but more usually, it is packaged in
+	   * our standard "tar" archive format.  Normally, the archive
+	   * will have been downloaded to the local cache, but when
+	   * its download has been deferred, we stream its content
+	   * directly from the download host.
 	   */
-	  pkgTarArchiveInstaller install( pkg );
-	  if( install.IsOk() )
-	    install.Process();
+	  if( pkgIsZipArchive( pkgfile ) )
+	  {
+	    pkgZipArchiveInstaller install( pkg );
+	    if( ! install.IsOk() || (install.Process() < 0) )
+	      /*
+	       * As in the tar archive case, below, we must not record
+	       * any installation which could not be completed.
+	       */
+	      return;
+	  }
+	  else
+	  { pkgTarArchiveInstaller install( pkg,
+		current->HasAttribute( ACTION_STREAM )
+		  ? pkgOpenDownloadStream( pkg ) : NULL
+	      );
+	    install.UpdateInPlace( current->HasAttribute( ACTION_IN_PLACE ) != 0 );
+	    if( ! install.IsOk() || (install.Process() < 0) )
+	      /*
+	       * The archive could not be read, (e.g. because its download
+	       * failed), or it was incomplete, or its content did not match
+	       * its published digest; in any such case, the installer will
+	       * have declined to register it, so we must neither record it
+	       * as installed, nor run its post-install script, and our
+	       * original assertion of failure must stand.
+	       */
+	      return;
+	  }
 	}
 	/* Update the internal record of installed state; although no
 	 * running CLI instance will return to any point where it needs
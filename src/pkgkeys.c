@@ -4,7 +4,7 @@
  * $Id$
  *
  * Written by Keith Marshall <keithmarshall@users.sourceforge.net>
- * Copyright (C) 2010, 2012, MinGW Project
+ * Copyright (C) 2010, 2012, 2026, MinGW Project
  *
  *
  * Implementation of the global definitions for the string constants
@@ -36,6 +36,7 @@ const char *dirname_key 	    =	"dir";
 const char *download_key	    =	"download";
 const char *download_host_key	    =	"download-host";
 const char *eq_key		    =	"eq";
+const char *excluded_key	    =	"excluded";
 const char *filename_key	    =	"file";
 const char *ge_key		    =	"ge";
 const char *gt_key		    =	"gt";
@@ -47,6 +48,7 @@ const char *lt_key		    =	"lt";
 const char *manifest_key	    =	"manifest";
 const char *mirror_key		    =	"mirror";
 const char *modified_key	    =	"modified";
+const char *mtime_key		    =	"mtime";
 const char *name_key		    =	"name";
 const char *package_key 	    =	"package";
 const char *package_collection_key  =	"package-collection";
@@ -58,6 +60,8 @@ const char *reference_key	    =	"references";
 const char *release_key 	    =	"release";
 const char *repository_key	    =	"repository";
 const char *requires_key	    =	"requires";
+const char *sha256_key		    =	"sha256";
+const char *size_key		    =	"size";
 const char *source_key		    =	"source";
 const char *subsystem_key	    =	"subsystem";
 const char *sysmap_key		    =	"system-map";
@@ -65,6 +69,7 @@ const char *sysroot_key 	    =	"sysroot";
 const char *tarname_key 	    =	"tarname";
 const char *title_key		    =	"title";
 const char *uri_key		    =	"uri";
+const char *xxh64_key		    =	"xxh64";
 
 /* Some standard values, which may be associated with certain
  * of the above keys.
@@ -5,7 +5,7 @@
  * $Id$
  *
  * Written by Keith Marshall <keithmarshall@users.sourceforge.net>
- * Copyright (C) 2010, 2012, MinGW Project
+ * Copyright (C) 2010, 2012, 2026, MinGW Project
  *
  *
  * Public declarations of the global definitions for the string
@@ -47,6 +47,7 @@ EXTERN_C_DECL const char *dirname_key;
 EXTERN_C_DECL const char *download_key;
 EXTERN_C_DECL const char *download_host_key;
 EXTERN_C_DECL const char *eq_key;
+EXTERN_C_DECL const char *excluded_key;
 EXTERN_C_DECL const char *filename_key;
 EXTERN_C_DECL const char *ge_key;
 EXTERN_C_DECL const char *gt_key;
@@ -58,6 +59,7 @@ EXTERN_C_DECL const char *lt_key;
 EXTERN_C_DECL const char *manifest_key;
 EXTERN_C_DECL const char *mirror_key;
 EXTERN_C_DECL const char *modified_key;
+EXTERN_C_DECL const char *mtime_key;
 EXTERN_C_DECL const char *name_key;
 EXTERN_C_DECL const char *package_key;
 EXTERN_C_DECL const char *package_collection_key;
@@ -69,6 +71,8 @@ EXTERN_C_DECL const char *reference_key;
 EXTERN_C_DECL const char *release_key;
 EXTERN_C_DECL const char *repository_key;
 EXTERN_C_DECL const char *requires_key;
+EXTERN_C_DECL const char *sha256_key;
+EXTERN_C_DECL const char *size_key;
 EXTERN_C_DECL const char *source_key;
 EXTERN_C_DECL const char *subsystem_key;
 EXTERN_C_DECL const char *sysmap_key;
@@ -76,6 +80,7 @@ EXTERN_C_DECL const char *sysroot_key;
 EXTERN_C_DECL const char *tarname_key;
 EXTERN_C_DECL const char *title_key;
 EXTERN_C_DECL const char *uri_key;
+EXTERN_C_DECL const char *xxh64_key;
 
 /* Some standard values, which may be associated with certain
  * of the above XML database keys.
@@ -4,7 +4,7 @@
  * $Id$
  *
  * Written by Keith Marshall <keith@users.osdn.me>
- * Copyright (C) 2012, 2013, 2020, MinGW.org Project
+ * Copyright (C) 2012, 2013, 2020, 2026, MinGW.org Project
  *
  *
  * Implementation of XML interpreter for configuation of preferences.
@@ -69,6 +69,8 @@ class pkgPreferenceEvaluator
     const char *SetName( const char *name ){ return optname = name; }
     void PresetScriptHook( int, const char *, ... );
     void SetScriptHook( const char *, ... );
+    bool SetNumericOption( const char * );
+    bool SetExtractionFilter( const char * );
     pkgXmlNode *Current(){ return ref; }
 
   private:
@@ -87,6 +89,41 @@ static const char *client_key = "client";
 static const char *option_key = "option";
 static const char *value_key = "value";
 
+/* Numeric tuning options, which may be assigned in preferences sections;
+ * each maps an XML option name to its options table index.
+ */
+static const struct
+{ const char *name;
+  int index;
+} numeric_options[] =
+{ { "decoder-threads", OPTION_DECODER_THREADS },
+  { "read-ahead-buffers", OPTION_READ_AHEAD_BUFFERS },
+  { "read-ahead-size", OPTION_READ_AHEAD_SIZE },
+  { "stream-install", OPTION_STREAM_INSTALL },
+  { "cache-transcode", OPTION_CACHE_TRANSCODE },
+  { "cache-transcode-budget", OPTION_CACHE_TRANSCODE_BUDGET },
+  { "writer-threads", OPTION_WRITER_THREADS },
+  { "preallocate-threshold", OPTION_PREALLOCATE_THRESHOLD },
+  { "in-place-upgrade", OPTION_IN_PLACE_UPGRADE },
+  { "verify-threads", OPTION_VERIFY_THREADS },
+  { "durable-install", OPTION_DURABLE_INSTALL },
+  { NULL, 0 }
+};
+
+/* Archive member selection rules, which may also be assigned in
+ * preferences sections; each "exclude", or "include" option nominates
+ * a glob pattern, to be matched against the sysroot relative path name
+ * of each tar archive member, as it is installed.
+ */
+static const char *exclude_option = "exclude";
+static const char *include_option = "include";
+
+static struct extraction_filter
+{ const char *pattern;
+  bool include;
+} *extraction_filters = NULL;
+static unsigned extraction_filter_count = 0;
+
 STATIC_INLINE int pkg_setenv( const char *varname, const char *value )
 {
   /* A helper function, approximating the effect of POSIX' setenv(),
@@ -308,6 +345,137 @@ void pkgPreferenceEvaluator::SetScriptHook( const char *key, ... )
   }
 }
 
+bool pkgPreferenceEvaluator::SetNumericOption( const char *name )
+{
+  /* Method to interpret numeric tuning options, specified as XML
+   * preferences; returns false, if the named option is not one which
+   * is listed in the numeric_options table, or true otherwise.
+   */
+  for( int i = 0; numeric_options[i].name != NULL; i++ )
+    if( strcmp( name, numeric_options[i].name ) == 0 )
+    {
+      /* We have a match; provided there is no prior assignment
+       * of this option, and it specifies a valid unsigned numeric
+       * value, store it into the options table.
+       */
+      pkgOpts *options = pkgOptions();
+      int index = numeric_options[i].index;
+      if( (options != NULL) && (options->IsSet( index ) == 0) )
+      {
+	char *brk; unsigned long value;
+	const char *spec = ref->GetPropVal( value_key, "" );
+	if( (*spec == '\0') || ((value = strtoul( spec, &brk, 0 )), *brk != '\0') )
+	  dmh_notify( DMH_WARNING,
+	      "option '%s': invalid value '%s' ignored\n", name, spec
+	    );
+	else
+	  options->SetValue( index, value );
+      }
+      return true;
+    }
+
+  /* If we fall through the loop, there was no match.
+   */
+  return false;
+}
+
+bool pkgPreferenceEvaluator::SetExtractionFilter( const char *name )
+{
+  /* Method to interpret "exclude" and "include" options, specified as
+   * XML preferences; returns false, if the named option is neither of
+   * these, or true otherwise.
+   */
+  bool include;
+  if( ! (include = (strcmp( name, include_option ) == 0))
+  &&  (strcmp( name, exclude_option ) != 0)  )
+    return false;
+
+  /* We have a match; provided it specifies a non-empty pattern, add
+   * it to the list of extraction filters, (which we never release; it
+   * remains in use until the program terminates).
+   */
+  const char *spec = ref->GetPropVal( value_key, "" );
+  if( *spec == '\0' )
+    dmh_notify( DMH_WARNING, "option '%s': no pattern specified\n", name );
+
+  else
+  { void *tmp = realloc( extraction_filters,
+	(1 + extraction_filter_count) * sizeof( struct extraction_filter )
+      );
+    if( (tmp != NULL) && ((spec = strdup( spec )) != NULL) )
+    {
+      extraction_filters = (struct extraction_filter *)(tmp);
+      extraction_filters[extraction_filter_count].pattern = spec;
+      extraction_filters[extraction_filter_count++].include = include;
+    }
+  }
+  return true;
+}
+
+static bool glob_match( const char *pattern, const char *name )
+{
+  /* Helper function, to match a path name against a glob pattern; "?"
+   * matches any single character, and "*" matches any sequence of zero
+   * or more characters, (including directory separators, so that the
+   * pattern "share/man/*" matches the entire "share/man" hierarchy).
+   * Matching is case insensitive, and either "/" or "\\" matches any
+   * directory separator.
+   */
+  const char *resume_pattern = NULL, *resume_name = NULL;
+  while( *name )
+  {
+    if( *pattern == '*' )
+    {
+      /* Note where we may resume matching, should the remainder of
+       * the pattern fail to match, when the "*" matches only the empty
+       * sequence; we then extend the sequence, one character at a time.
+       */
+      resume_pattern = ++pattern;
+      resume_name = name;
+    }
+    else if( (*pattern == '?')
+    ||  (tolower( *pattern ) == tolower( *name ))
+    ||  (((*pattern == '/') || (*pattern == '\\'))
+	  && ((*name == '/') || (*name == '\\')))  )
+      ++pattern, ++name;
+
+    else if( resume_pattern != NULL )
+      pattern = resume_pattern, name = ++resume_name;
+
+    else
+      return false;
+  }
+  /* The name is exhausted; any remaining "*" may match the empty
+   * sequence, but the name matches only if that leaves nothing of the
+   * pattern unmatched.
+   */
+  while( *pattern == '*' )
+    ++pattern;
+  return *pattern == '\0';
+}
+
+EXTERN_C bool pkgIsExcludedEntry( const char *pathname )
+{
+  /* Global accessor function, which the tar archive installer calls
+   * to determine whether the archive member with specified (sysroot
+   * relative) path name is to be installed; it is excluded, if it
+   * matches any "exclude" pattern, and does not match any "include"
+   * pattern, (which thus takes precedence).
+   */
+  bool excluded = false;
+  while( (pathname[0] == '.') && ((pathname[1] == '/') || (pathname[1] == '\\')) )
+    pathname += 2;
+  for( unsigned i = 0; i < extraction_filter_count; i++ )
+    if( (extraction_filters[i].include || ! excluded)
+    &&  glob_match( extraction_filters[i].pattern, pathname )  )
+    {
+      if( extraction_filters[i].include )
+	return false;
+      excluded = true;
+    }
+  return excluded;
+}
+
 void pkgXmlDocument::EstablishPreferences( const char *client )
 {
   /* Method to interpret the content of any "preferences" sections
@@ -355,6 +523,19 @@ void pkgXmlDocument::EstablishPreferences( const char *client )
 	       */
 	      opt.SetScriptHook( PKG_START_MENU_HOOK, NULL );
 
+	    else if( opt.SetNumericOption( optname ) )
+	      /*
+	       * Numeric tuning options are interpreted directly, within
+	       * the evaluator method itself; nothing more to do here.
+	       */
+	      ;
+
+	    else if( opt.SetExtractionFilter( optname ) )
+	      /*
+	       * Likewise, for archive member selection rules.
+	       */
+	      ;
+
 	    else
 	      /* Any unrecognised option specification is simply ignored,
 	       * after posting an appropriate diagnostic message.
@@ -426,4 +607,15 @@ void pkgOpts::SetFlags( pkgOpts *ref, unsigned value )
   }
 }
 
+void pkgOpts::SetValue( pkgOpts *ref, int index, unsigned value )
+{
+  /* Store a numeric data entry, marking it as having been assigned,
+   * (so that any subsequent preference settings will not override it).
+   */
+  if( ref )
+  { ref->flags[index & 0xFFF].numeric = value;
+    mark_option_as_set( *ref, index );
+  }
+}
+
 /* $RCSfile$: end of file */
@@ -4,7 +4,7 @@
  * $Id$
  *
  * Written by Keith Marshall <keith@users.osdn.me>
- * Copyright (C) 2011, 2012, 2020, MinGW Project
+ * Copyright (C) 2011, 2012, 2020, 2026, MinGW Project
  *
  *
  * Public declarations of the data structures, values and functions
@@ -42,6 +42,23 @@ enum
   OPTION_DESKTOP_ARGS,
   OPTION_START_MENU_ARGS,
   OPTION_DEBUGLEVEL,
+  OPTION_MEMBER_ARGS,
+
+  /* Numeric tuning parameters, (and feature switches), which are not
+   * currently assigned from the command line, but may be specified as
+   * XML preferences.
+   */
+  OPTION_DECODER_THREADS,
+  OPTION_READ_AHEAD_BUFFERS,
+  OPTION_READ_AHEAD_SIZE,
+  OPTION_STREAM_INSTALL,
+  OPTION_CACHE_TRANSCODE,
+  OPTION_CACHE_TRANSCODE_BUDGET,
+  OPTION_WRITER_THREADS,
+  OPTION_PREALLOCATE_THRESHOLD,
+  OPTION_IN_PLACE_UPGRADE,
+  OPTION_VERIFY_THREADS,
+  OPTION_DURABLE_INSTALL,
 
   /* This final entry specifies the size of the parameter array which
    * comprises the data content of the options structure; it MUST be the
@@ -108,6 +125,7 @@ struct pkgopts
 
 #define OPTION_DESKTOP		(OPTION_STORE_STRING | OPTION_DESKTOP_ARGS)
 #define OPTION_START_MENU	(OPTION_STORE_STRING | OPTION_START_MENU_ARGS)
+#define OPTION_MEMBER		(OPTION_STORE_STRING | OPTION_MEMBER_ARGS)
 
 #if __cplusplus
 /*
@@ -132,12 +150,15 @@ class pkgOpts : protected pkgopts
     static const char *GetString( pkgOpts *, int );
     static unsigned Test( pkgOpts *, unsigned, int );
     static void SetFlags( pkgOpts *, unsigned );
+    static void SetValue( pkgOpts *, int, unsigned );
 
   public:
     inline unsigned IsSet( int index ){ return IsSet( this, index ); }
     inline unsigned GetValue( int index ){ return GetValue( this, index ); }
     inline const char *GetString( int index ){ return GetString( this, index ); }
     inline void SetFlags( unsigned value ){ SetFlags( this, value ); }
+    inline void SetValue( int index, unsigned value )
+    { SetValue( this, index, value ); }
     inline unsigned Test( unsigned mask, int index = OPTION_FLAGS )
     { return Test( this, mask, index ); }
 };
@@ -160,6 +181,12 @@ enum { OPTION_TABLE_LOOKUP, OPTION_TABLE_ASSIGN };
  */
 EXTERN_C pkgOpts *pkgOptions( int = OPTION_TABLE_LOOKUP, struct pkgopts* = NULL );
 
+/* Accessor for the "exclude" and "include" rules, which may be assigned
+ * as preferences, to select the archive members which are installed; it
+ * returns true, for any sysroot relative path name which is excluded.
+ */
+EXTERN_C bool pkgIsExcludedEntry( const char* );
+
 #endif /* __cplusplus */
 
 #endif /* PKGOPTS_H: $RCSfile$: end of file */
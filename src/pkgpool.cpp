@@ -0,0 +1,188 @@
+/*
+ * pkgpool.cpp
+ *
+ * $Id$
+ *
+ * Copyright (C) 2026, MinGW.org Project
+ *
+ *
+ * Implementation of the worker thread pool, which is used to perform
+ * independent units of package processing work, concurrently.
+ *
+ *
+ * This is free software.  Permission is granted to copy, modify and
+ * redistribute this software, under the provisions of the GNU General
+ * Public License, Version 3, (or, at your option, any later version),
+ * as published by the Free Software Foundation; see the file COPYING
+ * for licensing details.
+ *
+ * Note, in particular, that this software is provided "as is", in the
+ * hope that it may prove useful, but WITHOUT WARRANTY OF ANY KIND; not
+ * even an implied WARRANTY OF MERCHANTABILITY, nor of FITNESS FOR ANY
+ * PARTICULAR PURPOSE.  Under no circumstances will the author, or the
+ * MinGW Project, accept liability for any damages, however caused,
+ * arising from the use of this software.
+ *
+ */
+#include "pkgpool.h"
+#include "pkgopts.h"
+
+#include <stdlib.h>
+#include <limits.h>
+#include <process.h>
+
+/*****
+ *
+ * Class Implementation: pkgWorkerTask
+ *
+ */
+pkgWorkerTask::pkgWorkerTask():next( NULL )
+{
+  /* Each task carries its own manual reset event, which remains
+   * in its non-signalled state until the task has been executed.
+   */
+  completed = CreateEvent( NULL, TRUE, FALSE, NULL );
+}
+
+pkgWorkerTask::~pkgWorkerTask()
+{
+  /* The destructor need only release the completion event.
+   */
+  CloseHandle( completed );
+}
+
+void pkgWorkerTask::WaitForCompletion()
+{
+  /* Block the calling thread, until the task's completion
+   * event has been signalled.
+   */
+  WaitForSingleObject( completed, INFINITE );
+}
+
+/*****
+ *
+ * Class Implementation: pkgWorkerPool
+ *
+ */
+pkgWorkerPool::pkgWorkerPool( unsigned threads ):
+thread( NULL ), head( NULL ), tail( NULL ), count( 0 )
+{
+  /* The constructor sets up the queue access lock, and a semaphore
+   * which counts tasks awaiting dispatch, before starting the worker
+   * threads; note that there is no advantage in starting a pool of
+   * only one thread, so in that case we start none, and Submit()
+   * will then execute each task synchronously.
+   */
+  InitializeCriticalSection( &lock );
+  queued = CreateSemaphore( NULL, 0, LONG_MAX, NULL );
+  if( (threads > 1) && (queued != NULL)
+  &&  ((thread = (HANDLE *)(calloc( threads, sizeof( HANDLE ) ))) != NULL)  )
+    while( count < threads )
+    {
+      /* Start each of the requested threads in turn, or as many
+       * of them as we may, if we are unable to start them all.
+       */
+      uintptr_t handle = _beginthreadex( NULL, 0, Worker, this, 0, NULL );
+      if( handle == 0 ) break;
+      thread[count++] = (HANDLE)(handle);
+    }
+}
+
+pkgWorkerPool::~pkgWorkerPool()
+{
+  /* The destructor signals all worker threads to stop, once they
+   * have exhausted the queue; to achieve this, we post one additional
+   * semaphore count per thread, each of which will be matched by an
+   * empty queue, when all pending tasks have been dispatched; (since
+   * Submit() always appends to the queue before it posts a count, no
+   * worker can otherwise ever find the queue to be empty).
+   */
+  if( count > 0 ) ReleaseSemaphore( queued, count, NULL );
+
+  /* Wait for each thread to terminate, before we release the
+   * resources which they share.
+   */
+  while( count > 0 )
+  {
+    WaitForSingleObject( thread[--count], INFINITE );
+    CloseHandle( thread[count] );
+  }
+  free( thread );
+  if( queued != NULL ) CloseHandle( queued );
+  DeleteCriticalSection( &lock );
+}
+
+void pkgWorkerPool::Submit( pkgWorkerTask *task )
+{
+  /* Add a task to the pool's queue of pending work.
+   */
+  if( count == 0 )
+  {
+    /* When there are no worker threads, we simply execute the
+     * task immediately, on the caller's thread.
+     */
+    task->Execute();
+    SetEvent( task->completed );
+  }
+  else
+  { /* Otherwise, we append the task to the FIFO queue, and signal
+     * its availability to the worker threads.
+     */
+    task->next = NULL;
+    EnterCriticalSection( &lock );
+    if( tail == NULL ) head = task; else tail->next = task;
+    tail = task;
+    LeaveCriticalSection( &lock );
+    ReleaseSemaphore( queued, 1, NULL );
+  }
+}
+
+unsigned __stdcall pkgWorkerPool::Worker( void *ref )
+{
+  /* The thread procedure, which is executed by each worker thread;
+   * it repeatedly waits for the semaphore to indicate that the queue
+   * may contain a task, then removes the first task from the queue...
+   */
+  pkgWorkerPool *pool = (pkgWorkerPool *)(ref);
+  while( WaitForSingleObject( pool->queued, INFINITE ) == WAIT_OBJECT_0 )
+  {
+    EnterCriticalSection( &pool->lock );
+    pkgWorkerTask *task = pool->head;
+    if( (task != NULL) && ((pool->head = task->next) == NULL) )
+      pool->tail = NULL;
+    LeaveCriticalSection( &pool->lock );
+
+    if( task == NULL )
+      /*
+       * ...but, when the queue is empty, the semaphore count can have
+       * been posted only by the destructor, to request termination...
+       */
+      break;
+
+    /* ...otherwise, we execute the task, then signal completion.
+     */
+    task->Execute();
+    SetEvent( task->completed );
+  }
+  return 0;
+}
+
+unsigned pkgWorkerPool::ThreadCount( int option )
+{
+  /* Interpret the thread count preference, as specified by the
+   * indexed entry in the global options table...
+   */
+  unsigned threads = pkgOptions()->GetValue( option );
+  if( threads == 0 )
+  {
+    /* ...substituting the number of processors, if it has been
+     * left unspecified, (or is explicitly specified as zero).
+     */
+    SYSTEM_INFO info;
+    GetSystemInfo( &info );
+    threads = info.dwNumberOfProcessors;
+  }
+  return threads;
+}
+
+/* $RCSfile$: end of file */
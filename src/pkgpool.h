@@ -0,0 +1,90 @@
+#ifndef PKGPOOL_H
+/*
+ * pkgpool.h
+ *
+ * $Id$
+ *
+ * Copyright (C) 2026, MinGW.org Project
+ *
+ *
+ * Public interface for a simple pool of worker threads, which may be
+ * used to perform independent units of work, (e.g. decompression of the
+ * individual blocks of a package archive), concurrently.
+ *
+ *
+ * This is free software.  Permission is granted to copy, modify and
+ * redistribute this software, under the provisions of the GNU General
+ * Public License, Version 3, (or, at your option, any later version),
+ * as published by the Free Software Foundation; see the file COPYING
+ * for licensing details.
+ *
+ * Note, in particular, that this software is provided "as is", in the
+ * hope that it may prove useful, but WITHOUT WARRANTY OF ANY KIND; not
+ * even an implied WARRANTY OF MERCHANTABILITY, nor of FITNESS FOR ANY
+ * PARTICULAR PURPOSE.  Under no circumstances will the author, or the
+ * MinGW Project, accept liability for any damages, however caused,
+ * arising from the use of this software.
+ *
+ */
+#define PKGPOOL_H  1
+
+#include <windows.h>
+
+class pkgWorkerTask
+{
+  /* An abstract base class, from which each unit of work to be
+   * submitted to a pkgWorkerPool must be derived; the derived class
+   * must implement the Execute() method, which will be invoked on
+   * some arbitrary worker thread.
+   */
+  public:
+    pkgWorkerTask();
+    virtual ~pkgWorkerTask();
+
+    virtual void Execute() = 0;
+
+    /* The thread which submitted the task may use this, to wait
+     * until the Execute() method has run to completion.
+     */
+    void WaitForCompletion();
+
+  private:
+    friend class pkgWorkerPool;
+    pkgWorkerTask *next;
+    HANDLE completed;
+};
+
+class pkgWorkerPool
+{
+  /* A fixed size pool of worker threads, serving a FIFO queue of
+   * pkgWorkerTask objects; ownership of each task remains with the
+   * submitter, who must not delete it before its completion.
+   */
+  public:
+    pkgWorkerPool( unsigned );
+    ~pkgWorkerPool();
+
+    void Submit( pkgWorkerTask* );
+
+    /* Report the number of worker threads which are actually running;
+     * this may be zero, in which case Submit() will simply execute each
+     * task synchronously, on the submitter's own thread.
+     */
+    inline unsigned Threads(){ return count; }
+
+    /* Helper to interpret any "thread count" option from the global
+     * options table; a value of zero is interpreted as a request for
+     * one thread per processor.
+     */
+    static unsigned ThreadCount( int );
+
+  private:
+    CRITICAL_SECTION lock;
+    HANDLE queued, *thread;
+    pkgWorkerTask *head, *tail;
+    unsigned count;
+
+    static unsigned __stdcall Worker( void* );
+};
+
+#endif /* PKGPOOL_H: $RCSfile$: end of file */
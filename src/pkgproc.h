@@ -5,7 +5,7 @@
  * $Id$
  *
  * Written by Keith Marshall <keithmarshall@users.sourceforge.net>
- * Copyright (C) 2009, 2010, 2011, 2013, MinGW.org Project
+ * Copyright (C) 2009, 2010, 2011, 2013, 2026, MinGW.org Project
  *
  *
  * Specifications for the internal architecture of package archives,
@@ -38,6 +38,40 @@ EXTERN_C void pkgInstall( pkgActionItem* );
 EXTERN_C void pkgRegister( pkgXmlNode*, pkgXmlNode*, const char*, const char* );
 EXTERN_C void pkgRemove( pkgActionItem* );
 
+/* After an in-place upgrade, or reinstallation, delete those files of
+ * the prior installation which the replacement did not reinstate; (this
+ * is implemented in pkgunst.cpp).
+ */
+EXTERN_C void pkgRemoveRetainedFiles( pkgActionItem* );
+
+/* Check whether a file, (specified by its path name relative to its
+ * sysroot), belongs to the prior installation of a package which is
+ * being updated in place; only such files may be replaced.
+ */
+EXTERN_C bool pkgIsRetainedFile( const char* );
+
+/* Open an archive stream, which delivers the content of the package
+ * archive for the specified release, as it is downloaded; (this is
+ * implemented in pkginet.cpp).
+ */
+EXTERN_C pkgArchiveStream *pkgOpenDownloadStream( pkgXmlNode* );
+
+/* Identify package archives which must be processed as zip archives,
+ * rather than as tar archives; (this is implemented in zipproc.cpp).
+ */
+EXTERN_C bool pkgIsZipArchive( const char* );
+
+/* Close the cache of known directories, which is maintained while
+ * installing any archive, (reporting how many file system calls it
+ * saved, when tracing transactions); this is implemented in tarproc.cpp.
+ */
+EXTERN_C void report_mkdir_cache_savings( void );
+
+/* Reserve disk space for an extracted file, of known size, before its
+ * content is written; (also implemented in tarproc.cpp).
+ */
+EXTERN_C void preallocate_output_stream( int, uint64_t );
+
 class pkgManifest
 {
   /* A wrapper around the XML document class, with specialised methods
@@ -48,33 +82,99 @@ class pkgManifest
     ~pkgManifest();
 
     void AddEntry( const char*, const char* );
+    void AddEntry( const char*, const char*, uint64_t, int64_t, const char* = NULL );
     void BindSysRoot( pkgXmlNode*, const char* );
     void DetachSysRoot( const char* );
 
+    /* Delete every file, and any directory which is thereby left empty,
+     * from among those which the manifest records, (so abandoning the
+     * installation which it describes).
+     */
+    void RemoveInstalledEntities( const char* );
+
     inline pkgXmlNode *GetRoot(){ return manifest->GetRoot(); }
     pkgXmlNode *GetSysRootReference( const char* );
 
+    /* A manifest which is only to be inspected, (e.g. to verify the
+     * installation it describes), may be marked as read only; it is
+     * then neither saved, nor deleted, by the destructor.
+     */
+    inline void SetReadOnly(){ read_only = true; }
+
   private:
     pkgXmlDocument *manifest;
     pkgXmlNode     *inventory;
+    bool            read_only;
+};
+
+class pkgTarArchiveIndex
+{
+  /* A sidecar index, stored beside a cached xz compressed tar archive,
+   * which maps the name of each archive member to the location of the
+   * xz block which contains its header, and the offset of that header
+   * within the decompressed content of that block; this allows any
+   * single member to be extracted, without decompressing the entire
+   * archive.  The index is built lazily, by recording the offset of
+   * each member, as it is encountered, during the first complete pass
+   * through the archive.
+   */
+  public:
+    pkgTarArchiveIndex( const char* );
+    ~pkgTarArchiveIndex();
+
+    void Record( const char*, uint64_t );
+    void Commit();
+
+    /* Retrieve a new archive stream, positioned at the header of
+     * the named member, or NULL, if it cannot be located.
+     */
+    pkgArchiveStream *OpenMember( const char* );
+
+  private:
+    char *archive_name, *index_name;
+    uint64_t archive_size, archive_mtime;
+    bool current;
+
+    struct member_offset { char *name; uint64_t offset; } *members;
+    unsigned count, capacity;
 };
 
+/* Factory function, to create a sidecar index object for a named
+ * archive; this returns NULL, unless the archive is xz compressed,
+ * (since the index is of no use for any other archive format, and
+ * there is no point in recording its members).
+ */
+extern pkgTarArchiveIndex *pkgOpenArchiveIndex( const char* );
+
+#else
+/* The setup tool has no need for the sidecar index; it suffices
+ * to declare it as an opaque type.
+ */
+class pkgTarArchiveIndex;
+
 #endif /* PACKAGE_BASE_COMPONENT */
 
+/* Opaque type, used by all archive processors, to record links, the
+ * creation of which must be deferred.
+ */
+struct tar_deferred_link;
+
 class pkgArchiveProcessor
 {
   /* A minimal generic abstract base class, from which we derive
    * processing tools for handling arbitrary package architectures.
    */
   public:
-    pkgArchiveProcessor():save_on_extract(true){}
-    virtual ~pkgArchiveProcessor(){}
+    pkgArchiveProcessor():
+      entry_path(NULL), entry_path_size(0), deferred_links(NULL),
+      save_on_extract(true){}
+    virtual ~pkgArchiveProcessor();
 
     virtual bool IsOk() = 0;
     virtual int Process() = 0;
 
     inline void SaveExtractedFiles( bool mode ){ save_on_extract = mode; }
-    inline int SetOutputStream( const char *, int );
+    int SetOutputStream( const char *, int );
 
   protected:
     int sysroot_len;
@@ -92,9 +192,34 @@ class pkgArchiveProcessor
     const char  *tarname;
     const char  *pkgfile;
 
+    /* Buffer in which the full path name of each archive entry is
+     * composed; the sysroot prefix is expanded into it once only, and
+     * is retained, so that only the entry name need be appended.
+     */
+    char *entry_path;
+    size_t entry_path_size;
+    const char *EntryPathName( const char*, const char* );
+
     virtual int CreateExtractionDirectory( const char* );
     virtual int ExtractFile( int, const char*, int );
 
+    /* Create a hard link, or a symbolic link, to an entity named as it
+     * is recorded in the archive; symbolic links which refer to entities
+     * not yet extracted are deferred, to be created by CreateDeferredLinks(),
+     * when extraction of all other archive content has been completed.
+     * Derived classes may override CreateLinkedEntity(), to defer others.
+     */
+    tar_deferred_link *deferred_links;
+    int CreateLink( const char*, const char*, bool );
+    virtual int CreateLinkedEntity( const char*, const char*, const char* );
+    int DeferLink( const char*, const char*, const char* );
+    void CreateDeferredLinks();
+
+    /* Helper to set the modification time of an extracted file, to
+     * match that recorded in the archive.
+     */
+    static int CommitSavedEntity( const char*, int64_t );
+
     bool save_on_extract;
 };
 
@@ -142,17 +267,50 @@ union tar_archive_header
 #define TAR_ENTITY_TYPE_BLKDEV		'4'
 #define TAR_ENTITY_TYPE_DIRECTORY	'5'
 #define TAR_ENTITY_TYPE_GNU_LONGNAME	'L'
+#define TAR_ENTITY_TYPE_GNU_LONGLINK	'K'
+#define TAR_ENTITY_TYPE_PAX_HEADER	'x'
+#define TAR_ENTITY_TYPE_PAX_GLOBAL	'g'
 
 /* Some older style tar archives may use '\0' as an alternative to '0',
  * to identify an archive entry representing a regular file.
  */
 #define TAR_ENTITY_TYPE_ALTFILE 	'\0'
 
+/* Attributes which may be specified, in GNU long name, or long link
+ * name entries, or in pax extended headers, to override the content of
+ * the header for the archive entry which follows; the numeric values
+ * are valid only when the corresponding flag is set.
+ */
+struct tar_extended_attributes
+{
+  char *path;
+  char *linkpath;
+  uint64_t size;
+  int64_t mtime;
+  unsigned flags;
+};
+
+#define TAR_EXTENDED_SIZE		0x0001
+#define TAR_EXTENDED_MTIME		0x0002
+
 /* Specify classification codes for tar archive processing errors.
  */
 #define TAR_ARCHIVE_DATA_READ_ERROR	-1
 #define TAR_ARCHIVE_DATA_WRITE_ERROR	-2
 #define TAR_ARCHIVE_FORMAT_ERROR	-3
+#define TAR_ARCHIVE_MEMBER_NOT_FOUND	-4
+#define TAR_ARCHIVE_DIGEST_MISMATCH	-5
+
+/* Additional error classification codes, which are specific to the
+ * processing of zip archives.
+ */
+#define ZIP_ARCHIVE_CHECKSUM_ERROR	-6
+#define ZIP_ARCHIVE_METHOD_ERROR	-7
+
+/* Opaque type, used by pkgTarArchiveProcessor, to accumulate a hash
+ * of file content, as it is extracted.
+ */
+struct xxh64_context;
 
 class pkgTarArchiveProcessor : public pkgArchiveProcessor
 {
@@ -164,26 +322,74 @@ class pkgTarArchiveProcessor : public pkgArchiveProcessor
   public:
     /* Constructors and destructor...
      */
-    pkgTarArchiveProcessor(){}
-    pkgTarArchiveProcessor( pkgXmlNode* );
+    pkgTarArchiveProcessor():
+    index( NULL ), archive_offset( 0 ), selected_member( NULL ),
+    transfer_buffer( NULL ), long_linkname( NULL ),
+    compare_on_extract( false ), content_hash( NULL ){}
+    pkgTarArchiveProcessor( pkgXmlNode*, pkgArchiveStream* = NULL );
     virtual ~pkgTarArchiveProcessor();
 
     inline bool IsOk(){ return stream->IsReady(); }
     virtual int Process();
 
+    /* Process only the named archive member; this will use the
+     * sidecar index, if available, to locate it directly, otherwise
+     * it will scan the archive sequentially, (in which case, if more
+     * than one member is to be processed, they must be requested in
+     * the order in which they appear within the archive).
+     */
+    int ProcessMember( const char* );
+
   protected:
     /* Class data...
      */
     pkgArchiveStream *stream;
     union tar_archive_header header;
 
+    /* The sidecar index, if any, together with the offset, within
+     * the decompressed archive stream, of the data which we have
+     * consumed, so far.
+     */
+    pkgTarArchiveIndex *index;
+    uint64_t archive_offset;
+    const char *selected_member;
+
+    /* A buffer, allocated on first use, and retained for the life of
+     * the processor, in which ProcessEntityData() coalesces data from
+     * successive stream views, to be written in large blocks.
+     */
+    static const size_t TransferBufferSize = 1 << 20;
+    char *transfer_buffer;
+
+    /* The name of the entity to which a link entry refers, when this
+     * has been specified by a GNU long link name entry, or by a pax
+     * extended header, in place of the header's own linkname field.
+     */
+    const char *long_linkname;
+
+    /* When extracting into an existing file, (as an in-place update
+     * does), ProcessEntityData() compares each block of data with the
+     * existing content, for as long as they match, and writes only from
+     * the first difference; this remains set while the content matches.
+     */
+    bool compare_on_extract;
+
+    /* When set, (as the installer does, for each regular file), this
+     * accumulates the hash of all data which ProcessEntityData() writes
+     * to the output stream, while it is still cached in memory.
+     */
+    xxh64_context *content_hash;
+
     /* Internal archive processing methods...
      * These are divided into two categories: those for which the
      * abstract base class furnishes a generic implementation...
      */
     virtual int GetArchiveEntry();
+    bool SelectArchiveEntry( uint64_t, const char*, const char* );
+    virtual bool ExcludeArchiveEntry( const char* ){ return false; }
     virtual int ProcessEntityData( int );
     virtual char *EntityDataAsString();
+    int ProcessExtendedHeader( tar_extended_attributes* );
 
     /* ...those for which each specialisation is expected to
      * furnish its own task specific implementation...
@@ -191,8 +397,8 @@ class pkgTarArchiveProcessor : public pkgArchiveProcessor
     virtual int ProcessDirectory( const char* ) = 0;
     virtual int ProcessDataStream( const char* ) = 0;
 
-    /* ...and those which would normally be specialised, but
-     * for which we currently provide a generic stub...
+    /* ...and those for which the generic implementation may be
+     * specialised, as required...
      */
     virtual int ProcessLinkedEntity( const char* );
 };
@@ -203,7 +409,7 @@ class pkgTarArchiveExtractor : public pkgTarArchiveProcessor
    * arbitrary directory, without performing an installation.
    */
   public:
-    pkgTarArchiveExtractor( const char*, const char* );
+    pkgTarArchiveExtractor( const char*, const char*, const char* = NULL );
 
   private:
     /* Specialised implementations of the archive processing methods...
@@ -214,6 +420,14 @@ class pkgTarArchiveExtractor : public pkgTarArchiveProcessor
 
 #if IMPLEMENTATION_LEVEL == PACKAGE_BASE_COMPONENT
 
+/* Opaque types, used by pkgTarArchiveInstaller, to hand off the writing
+ * of extracted files to a pool of worker threads.
+ */
+class pkgWorkerPool;
+class pkgTarWriterTask;
+class pkgTarStagingArea;
+struct tar_pending_entry;
+
 class pkgTarArchiveInstaller : public pkgTarArchiveProcessor
 {
   /* Worker class for extraction of package tar archive content
@@ -223,16 +437,57 @@ class pkgTarArchiveInstaller : public pkgTarArchiveProcessor
   public:
     /* Constructor and destructor...
      */
-    pkgTarArchiveInstaller( pkgXmlNode* );
-    virtual ~pkgTarArchiveInstaller(){}
+    pkgTarArchiveInstaller( pkgXmlNode*, pkgArchiveStream* = NULL );
+    virtual ~pkgTarArchiveInstaller();
 
     virtual int Process();
 
+    /* Select whether files which already exist, (e.g. those of a prior
+     * installation of the package), are to be updated in place, rather
+     * than rewritten in their entirety.
+     */
+    inline void UpdateInPlace( bool mode ){ update_in_place = mode; }
+
   private:
     /* Specialised implementations of the archive processing methods...
      */
     virtual int ProcessDirectory( const char* );
     virtual int ProcessDataStream( const char* );
+    virtual int ProcessLinkedEntity( const char* );
+    virtual int CreateLinkedEntity( const char*, const char*, const char* );
+
+    /* Archive members which match the user's "exclude" preferences, (and
+     * no "include" preference), are skipped, but they are recorded in the
+     * manifest, as such.
+     */
+    virtual bool ExcludeArchiveEntry( const char* );
+
+    /* When updating in place, we count the existing files which we
+     * reuse, and how many of these are left unchanged.
+     */
+    bool update_in_place;
+    unsigned long files_reused, files_unchanged;
+
+    /* When a pool of writer threads is available, small files are
+     * handed off to it, to be created, written, and time stamped, while
+     * we continue to decode the archive; the manifest entries for these
+     * files, and for any directories, are queued in a ring of pending
+     * entries, to be recorded in archive order, as each is retired.
+     */
+    pkgWorkerPool *writers;
+    tar_pending_entry *pending;
+    unsigned pending_head, pending_count, pending_limit;
+
+    void QueueManifestEntry( const char*, const char*, pkgTarWriterTask* = NULL );
+    void RetirePendingEntries( unsigned = 0 );
+    void RetirePendingEntry( const char* );
+
+    /* When the user requests durable installation, regular files are
+     * written to a staging directory, within the sysroot, rather than
+     * to their ultimate locations; they are flushed to disk, and moved
+     * into place, only when the entire archive has been processed.
+     */
+    pkgTarStagingArea *staging;
 };
 
 class pkgTarArchiveUninstaller : public pkgTarArchiveProcessor
@@ -253,5 +508,71 @@ class pkgTarArchiveUninstaller : public pkgTarArchiveProcessor
     virtual int ProcessDataStream( const char* );
 };
 
+/* As an alternative to our standard tar archive format, packages may
+ * also be distributed as zip archives; since each member of such an
+ * archive is compressed independently of all others, and is located
+ * by way of the archive's central directory, we may extract members
+ * concurrently, on a pool of worker threads.
+ */
+class pkgZipArchiveReader;
+struct zip_archive_member;
+
+class pkgZipArchiveProcessor : public pkgArchiveProcessor
+{
+  /* An abstract base class, from which zip archive processing tools
+   * are derived; this class reads the central directory, dispatches
+   * extraction of file members to a pool of worker threads, and then
+   * completes the processing of each member, on the calling thread,
+   * in the order in which the members appear in the central directory.
+   */
+  public:
+    pkgZipArchiveProcessor( pkgXmlNode* );
+    virtual ~pkgZipArchiveProcessor();
+
+    virtual bool IsOk();
+    virtual int Process();
+
+    /* The published digest of the archive may be computed, while the
+     * archive is processed, on a worker thread of its own.
+     */
+    inline void EnableDigest(){ digest_requested = true; }
+    bool DigestMatches( const char* );
+
+  protected:
+    pkgZipArchiveReader *archive;
+    bool digest_requested;
+
+    /* Each specialisation must furnish its own implementation of each
+     * of these methods; the first is invoked for each directory member,
+     * the second to open the output stream for each regular file member,
+     * (returning its file descriptor, as SetOutputStream() does), and the
+     * third after completion of extraction of each file, together with
+     * the resultant status, (and, for a regular file, its central directory
+     * entry, and the hash of its extracted content, if any).
+     */
+    virtual int ProcessDirectory( const char* ) = 0;
+    virtual int OpenDataStream( const char*, int ) = 0;
+    virtual void CommitDataStream( const char*, int, zip_archive_member*, const char* ) = 0;
+};
+
+class pkgZipArchiveInstaller : public pkgZipArchiveProcessor
+{
+  /* Worker class for extraction of package zip archive content to
+   * the sysroot directory nominated in the package manifest, for the
+   * purpose of performing an installation or upgrade; the installation
+   * is recorded in exactly the same manner as for a tar archive.
+   */
+  public:
+    pkgZipArchiveInstaller( pkgXmlNode* );
+    virtual ~pkgZipArchiveInstaller(){}
+
+    virtual int Process();
+
+  private:
+    virtual int ProcessDirectory( const char* );
+    virtual int OpenDataStream( const char*, int );
+    virtual void CommitDataStream( const char*, int, zip_archive_member*, const char* );
+};
+
 #endif /* PACKAGE_BASE_COMPONENT */
 #endif /* PKGPROC_H: $RCSfile$: end of file */
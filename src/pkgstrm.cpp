@@ -4,7 +4,7 @@
  * $Id$
  *
  * Written by Keith Marshall <keithmarshall@users.sourceforge.net>
- * Copyright (C) 2009, 2010, 2013, MinGW.org Project
+ * Copyright (C) 2009, 2010, 2013, 2026, MinGW.org Project
  *
  *
  * Implementation of the streaming data filters, which will be used
@@ -16,6 +16,11 @@
  *   bzip2  (compressed)
  *   lzma   (compressed)
  *   xz     (compressed)
+ *   zstd   (compressed)
+ *
+ * The appropriate filter is selected, by pkgOpenArchiveStream(), on
+ * the basis of magic patterns identified within the leading content
+ * of each archive, rather than by archive file name extension.
  *
  *
  * This is free software.  Permission is granted to copy, modify and
@@ -34,6 +39,9 @@
  */
 #include "pkgimpl.h"
 
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include <fcntl.h>
 
@@ -57,29 +65,483 @@
  */
 #define  PKGSTRM_H_SPECIAL  1
 #include "pkgstrm.h"
+#include "pkgopts.h"
+#include "dmh.h"
 
 /*****
  *
  * Class Implementation: pkgArchiveStream
  *
- * This class uses a default constructor and default virtual destructor.
- * We never instantiate objects of this class directly; all derived classes
- * provide their own specialised constructors and destructors, together with
- * a mandatory specialised "Read" method.
+ * This class uses a default constructor, and a virtual destructor whose
+ * only responsibility is to release any residual primed input data, and
+ * any read-ahead buffers.  We never instantiate objects of this class
+ * directly; all derived classes provide their own specialised constructors
+ * and destructors, together with a mandatory specialised "Decode" method.
  *
  * We do, however, provide one generic "GetRawData" method, which derived
- * classes may adopt, or may override, as necessary...
+ * classes should adopt, and a "ReadRawData" method, which they may adopt,
+ * or may override, as necessary; similarly, we provide generic "GetView"
+ * and "ReleaseView" methods, which lend access to data decoded into our
+ * own output buffer, and which derived classes may override, if they can
+ * lend access to decoded data which they already hold, together with a
+ * "Read" method, built on these, for clients which require a copy...
  *
  */
+#if IMPLEMENTATION_LEVEL == PACKAGE_BASE_COMPONENT
+/*
+ * The read-ahead facility is provided only in the package base component;
+ * it is unnecessary in the setup tool, which must remain compact.
+ */
+#include <windows.h>
+#include <process.h>
+
+class pkgReadAheadStage
+{
+  /* A locally implemented class, representing the read-ahead pipeline
+   * stage; a "reader" thread fills a ring of buffers, by invoking the
+   * stream's ReadRawData() method, while the decoder thread consumes
+   * their content, via the stream's GetRawData() method.
+   */
+  public:
+    pkgReadAheadStage( pkgArchiveStream*, int, unsigned, size_t );
+    ~pkgReadAheadStage();
+
+    inline bool IsRunning(){ return thread != NULL; }
+    int Read( uint8_t*, size_t );
+
+    unsigned long decoder_stalls, reader_stalls;
+
+  private:
+    pkgArchiveStream *stream;
+    int fd;
+
+    /* The ring of buffers; each has an associated data count, which
+     * is set to zero, (or a negative error code), at end of stream.
+     */
+    struct buffer { uint8_t *data; int len; } *ring;
+    unsigned count, head, tail;
+    size_t size, offset;
+    bool have_buffer;
+
+    /* Semaphores, counting buffers which are filled, (and thus may be
+     * consumed), and those which are free, (for the reader to fill).
+     */
+    HANDLE filled, empty, thread;
+    volatile bool cancelled;
+
+    static unsigned __stdcall Reader( void* );
+};
+
+pkgReadAheadStage::pkgReadAheadStage
+( pkgArchiveStream *source, int fileno, unsigned buffers, size_t len ):
+decoder_stalls( 0 ), reader_stalls( 0 ), stream( source ), fd( fileno ),
+count( 0 ), head( 0 ), tail( 0 ), size( len ), offset( 0 ),
+have_buffer( false ), filled( NULL ), empty( NULL ), thread( NULL ),
+cancelled( false )
+{
+  /* Allocate the ring of buffers, then create the semaphores, and
+   * start the reader thread; if any of these steps fails, the stage
+   * will not be running, and the caller should discard it.
+   */
+  if( (ring = (struct buffer *)(calloc( buffers, sizeof( struct buffer )))) != NULL )
+  {
+    while( (count < buffers) && ((ring[count].data = (uint8_t *)(malloc( len ))) != NULL) )
+      ++count;
+    if( (count > 1)
+    &&  ((filled = CreateSemaphore( NULL, 0, count, NULL )) != NULL)
+    &&  ((empty = CreateSemaphore( NULL, count, count, NULL )) != NULL)  )
+      thread = (HANDLE)(_beginthreadex( NULL, 0, Reader, this, 0, NULL ));
+  }
+}
+
+pkgReadAheadStage::~pkgReadAheadStage()
+{
+  /* Stop the reader thread, (waking it, if it is waiting for a free
+   * buffer), and wait for it to terminate, before releasing resources.
+   */
+  if( thread != NULL )
+  {
+    cancelled = true;
+    ReleaseSemaphore( empty, 1, NULL );
+    WaitForSingleObject( thread, INFINITE );
+    CloseHandle( thread );
+  }
+  if( empty != NULL ) CloseHandle( empty );
+  if( filled != NULL ) CloseHandle( filled );
+  if( ring != NULL )
+  {
+    while( count > 0 ) free( ring[--count].data );
+    free( ring );
+  }
+}
+
+unsigned __stdcall pkgReadAheadStage::Reader( void *ref )
+{
+  /* The reader thread procedure; it fills each free buffer in turn,
+   * until it reaches end of stream, or is cancelled.
+   */
+  pkgReadAheadStage *stage = (pkgReadAheadStage *)(ref);
+  while( true )
+  {
+    if( WaitForSingleObject( stage->empty, 0 ) == WAIT_TIMEOUT )
+    {
+      /* All buffers are full; the decoder is the bottleneck, so
+       * note the stall, and wait for it to release a buffer.
+       */
+      ++stage->reader_stalls;
+      WaitForSingleObject( stage->empty, INFINITE );
+    }
+    if( stage->cancelled ) break;
+
+    struct buffer *next = stage->ring + stage->tail;
+    next->len = stage->stream->ReadRawData( stage->fd, next->data, stage->size );
+    stage->tail = (stage->tail + 1) % stage->count;
+    ReleaseSemaphore( stage->filled, 1, NULL );
+
+    /* We stop reading, after we have passed on the end of stream,
+     * (or error), indication to the decoder.
+     */
+    if( next->len <= 0 ) break;
+  }
+  return 0;
+}
+
+int pkgReadAheadStage::Read( uint8_t *buf, size_t max )
+{
+  /* Return up to "max" bytes of data, from the buffers filled by the
+   * reader thread; note that we continue to consume further buffers,
+   * until we have satisfied the request, (or we reach end of stream),
+   * because some decoders interpret any short read as end of stream.
+   */
+  size_t retval = 0;
+  while( retval < max )
+  {
+    if( ! have_buffer )
+    {
+      /* We need another filled buffer; if none is available, then
+       * the reader is the bottleneck; note the stall, and wait.
+       */
+      if( WaitForSingleObject( filled, 0 ) == WAIT_TIMEOUT )
+      {
+	++decoder_stalls;
+	WaitForSingleObject( filled, INFINITE );
+      }
+      have_buffer = true;
+      offset = 0;
+    }
+    struct buffer *current = ring + head;
+    if( current->len <= 0 )
+    {
+      /* This is the end of stream marker; we retain it, so that any
+       * subsequent request will see it again.
+       */
+      if( retval == 0 ) return current->len;
+      break;
+    }
+    size_t avail = current->len - offset;
+    if( avail > (max - retval) ) avail = max - retval;
+    memcpy( buf + retval, current->data + offset, avail );
+    retval += avail;
+    if( (offset += avail) == (size_t)(current->len) )
+    {
+      /* This buffer is now empty; return it to the reader.
+       */
+      head = (head + 1) % count;
+      have_buffer = false;
+      ReleaseSemaphore( empty, 1, NULL );
+    }
+  }
+  return retval;
+}
+
+void pkgArchiveStream::EnableReadAhead( int fd )
+{
+  /* Establish the read-ahead stage; by default, we use four buffers,
+   * each of 1 MiB, but the user may specify alternative preferences;
+   * (specifying fewer than two buffers disables read-ahead).
+   */
+  pkgOpts *options = pkgOptions();
+  unsigned buffers = options->IsSet( OPTION_READ_AHEAD_BUFFERS )
+    ? options->GetValue( OPTION_READ_AHEAD_BUFFERS ) : 4;
+  size_t size = options->IsSet( OPTION_READ_AHEAD_SIZE )
+    ? options->GetValue( OPTION_READ_AHEAD_SIZE ) << 10 : 1 << 20;
+
+  if( (readahead == NULL) && (buffers > 1) && (size > 0) )
+  {
+    /* Read-ahead is required, and is not already active; start it,
+     * provided it can be successfully initialised.
+     */
+    readahead = new pkgReadAheadStage( this, fd, buffers, size );
+    if( ! readahead->IsRunning() ) DisableReadAhead();
+  }
+}
+
+void pkgArchiveStream::DisableReadAhead()
+{
+  /* Stop the read-ahead stage; any data remaining in its buffers is
+   * discarded, so this is appropriate only before any data has been
+   * read, or when the stream is to be repositioned.
+   */
+  delete readahead;
+  readahead = NULL;
+}
+
+unsigned long pkgArchiveStream::DecoderStalls()
+{
+  return (readahead != NULL) ? readahead->decoder_stalls : 0;
+}
+
+unsigned long pkgArchiveStream::ReaderStalls()
+{
+  return (readahead != NULL) ? readahead->reader_stalls : 0;
+}
+
+/* Similarly, the archive digest facility is provided only in the
+ * package base component.
+ */
+#include "sha256.h"
+#include <ctype.h>
+
+class pkgArchiveDigest
+{
+  /* Another locally implemented class, representing the state of
+   * the digest computation, (to which GetRawData() contributes each
+   * block of raw data, as it passes through), together with the file
+   * descriptor of the raw data stream, (as it was last presented to
+   * GetRawData()), so that we may subsequently consume any residual
+   * data which the decoder leaves unread.
+   */
+  public:
+    pkgArchiveDigest():fd( -1 ){ sha256_init( &context ); }
+    inline void Update( int fileno, const void *data, size_t len )
+    { fd = fileno; sha256_update( &context, data, len ); }
+
+    int fd;
+    sha256_context context;
+};
+
+void pkgArchiveStream::EnableDigest()
+{
+  /* Begin computing the digest; this is effective only when it has
+   * not already been enabled.
+   */
+  if( digest == NULL ) digest = new pkgArchiveDigest();
+}
+
+void pkgArchiveStream::DrainRawData()
+{
+  /* Consume, (and thus incorporate into the digest), any raw data
+   * which the decoder has left unread; when the decoder has already
+   * reached the end of the raw data stream, there will be none, and
+   * GetRawData() simply returns zero.
+   */
+  if( digest->fd != -1 )
+  {
+    uint8_t scratch[BUFSIZ];
+    while( GetRawData( digest->fd, scratch, sizeof( scratch ) ) > 0 )
+      ;
+  }
+}
+
+bool pkgArchiveStream::DigestMatches( const char *expected )
+{
+  /* Complete the digest computation, if it is active, and compare
+   * the result with the expected value, (ignoring case distinctions,
+   * since hexadecimal notation may use either); the digest cannot be
+   * resumed after this, so we discard it.
+   */
+  if( (digest == NULL) || (expected == NULL) )
+    return false;
+
+  char computed[SHA256_HEXDIGEST_SIZE];
+  DrainRawData(); sha256_hexdigest( &digest->context, computed );
+  delete digest; digest = NULL;
+
+  const char *p = computed;
+  while( (*p != '\0') && (*p == tolower( *expected )) )
+    ++p, ++expected;
+  return (*p == '\0') && (*expected == '\0');
+}
+
+#else /* SETUP_TOOL_COMPONENT */
+/*
+ * The setup tool never requests read-ahead, but since EnableReadAhead()
+ * is a virtual method, it must still be defined; a no-op will suffice.
+ */
+void pkgArchiveStream::EnableReadAhead( int ){}
+
+/* Likewise, the setup tool never requests an archive digest; we need
+ * only a minimal definition of the digest class, to satisfy references
+ * in GetRawData(), where the digest is never active, and trivial
+ * definitions of the associated virtual methods.
+ */
+class pkgArchiveDigest
+{
+  public:
+    inline void Update( int, const void*, size_t ){}
+};
+
+void pkgArchiveStream::EnableDigest(){}
+void pkgArchiveStream::DrainRawData(){}
+bool pkgArchiveStream::DigestMatches( const char* ){ return false; }
+
+#endif /* PACKAGE_BASE_COMPONENT */
+
+pkgArchiveStream::~pkgArchiveStream()
+{
+  /* Any primed input data, or decoded output, which has not been
+   * consumed, is simply discarded; we need only release the memory
+   * which holds it, together with any incomplete digest, and shut
+   * down any active read-ahead stage.
+   */
+  free( primed_data );
+  free( view_data );
+  delete digest;
+#if IMPLEMENTATION_LEVEL == PACKAGE_BASE_COMPONENT
+  delete readahead;
+#endif
+}
+
+void pkgArchiveStream::PrimeInput( const uint8_t *data, size_t len )
+{
+  /* Save a private copy of data which has already been read from the
+   * raw input stream, (typically by pkgOpenArchiveStream(), to identify
+   * the stream format), so that we may hand it back to the decoder, via
+   * GetRawData(), without any need to rewind the stream.
+   */
+  free( primed_data ); primed_data = NULL; primed_offset = 0;
+  if( ((primed_bytes = len) > 0) && ((primed_data = (uint8_t *)(malloc( len ))) != NULL) )
+    memcpy( primed_data, data, len );
+
+  else
+    /* Either there was no data to save, or we were unable to allocate
+     * the storage we need to save it; in either case, we must ensure
+     * that GetRawData() will not attempt to return it.
+     */
+    primed_bytes = 0;
+}
+
+int pkgArchiveStream::ReadRawData( int fd, uint8_t *buf, size_t max )
+{
+  /* The default source of raw data is a file stream, from which
+   * we simply invoke read() requests; however, we segregate this
+   * function, to facilitate an override to handle other input
+   * streaming capabilities.  Since some decoders interpret any short
+   * read as end of stream, we must continue reading until we have
+   * filled the buffer, or we reach the end of stream; (a regular file
+   * will usually satisfy the first request, but a pipe, such as that
+   * which delivers an archive as it is downloaded, will not).
+   */
+  int count = 0, retval = 0;
+  while( (retval < (int)(max))
+  &&    ((count = read( fd, buf + retval, max - retval )) > 0)  )
+    retval += count;
+  return ((retval == 0) && (count < 0)) ? count : retval;
+}
+
 int pkgArchiveStream::GetRawData( int fd, uint8_t *buf, size_t max )
 {
   /* Generic helper function for reading a compressed data stream into
-   * its decompressing filter's input buffer.  The default implementation
-   * assumes a file stream, and simply invokes a read() request; however,
-   * we segregate this function, to facilitate an override to handle
-   * other input streaming capabilities.
+   * its decompressing filter's input buffer.
+   */
+  if( primed_bytes > 0 )
+  {
+    /* Before reading anything from the file stream itself, we must
+     * return any data with which the stream has been primed...
+     */
+    size_t count = (max > primed_bytes) ? primed_bytes : max;
+    memcpy( buf, primed_data + primed_offset, count );
+    if( digest != NULL ) digest->Update( fd, buf, count );
+    primed_offset += count;
+    if( (primed_bytes -= count) == 0 )
+    {
+      /* ...releasing the storage which it occupied, as soon as it
+       * has been completely consumed; note that, since some decoders
+       * interpret a short read as an end of stream indication, we
+       * must then attempt to fill any residual space in "buf", from
+       * the file stream.
+       */
+      int residual = 0;
+      free( primed_data ); primed_data = NULL;
+      if( (count < max) && ((residual = GetRawData( fd, buf + count, max - count )) > 0) )
+	count += residual;
+    }
+    return count;
+  }
+  int count;
+#if IMPLEMENTATION_LEVEL == PACKAGE_BASE_COMPONENT
+  /* When read-ahead is active, we retrieve data which has already
+   * been read by the reader thread...
+   */
+  if( readahead != NULL )
+    count = readahead->Read( buf, max );
+  else
+#endif
+  /* ...otherwise, we read it directly from the raw data source.
    */
-  return read( fd, buf, max );
+  count = ReadRawData( fd, buf, max );
+
+  /* In either case, when a digest is being computed, we must update
+   * it to incorporate whatever data we have retrieved.
+   */
+  if( (digest != NULL) && (count > 0) ) digest->Update( fd, buf, count );
+  return count;
+}
+
+int pkgArchiveStream::GetView( const char **ref )
+{
+  /* Generic method for lending access to decoded data; when all data
+   * within the current view has been consumed, we first refill our own
+   * output buffer, (allocating it on first use), from the decoder...
+   */
+  if( view_offset == view_bytes )
+  {
+    int count;
+    if( (view_data == NULL)
+    &&  ((view_data = (char *)(malloc( ViewBufferSize ))) == NULL)  )
+      return -1;
+
+    view_offset = view_bytes = 0;
+    if( (count = Decode( view_data, ViewBufferSize )) <= 0 )
+      /*
+       * ...passing back any end of stream, or error, indication...
+       */
+      return count;
+    view_bytes = count;
+  }
+  /* ...otherwise, we lend access to whatever remains unconsumed.
+   */
+  *ref = view_data + view_offset;
+  return view_bytes - view_offset;
+}
+
+void pkgArchiveStream::ReleaseView( size_t count )
+{
+  /* Mark data within the current view as consumed, taking care
+   * that we never advance beyond the extent of the view.
+   */
+  if( (view_offset += count) > view_bytes ) view_offset = view_bytes;
+}
+
+int pkgArchiveStream::Read( char *buf, size_t max )
+{
+  /* Compatibility method, to copy up to "max" bytes of decoded data
+   * into "buf"; we continue to consume successive views, until either
+   * the request has been satisfied, or no further data is available.
+   */
+  size_t count = 0;
+  while( count < max )
+  {
+    const char *data; int avail;
+    if( (avail = GetView( &data )) <= 0 )
+      return (count > 0) ? count : avail;
+
+    if( (size_t)(avail) > (max - count) ) avail = max - count;
+    memcpy( buf + count, data, avail );
+    ReleaseView( avail );
+    count += avail;
+  }
+  return count;
 }
 
 #if IMPLEMENTATION_LEVEL == PACKAGE_BASE_COMPONENT
@@ -94,99 +556,972 @@ int pkgArchiveStream::GetRawData( int fd, uint8_t *buf, size_t max )
  */
 pkgRawArchiveStream::pkgRawArchiveStream( const char *filename )
 {
-  /* The constructor has little to to, but to open the archive file
-   * and associate a file descriptor with the resultant data stream.
+  /* The constructor has little to to, but to open the archive file
+   * and associate a file descriptor with the resultant data stream.
+   */
+  fd = open( filename, O_RDONLY | O_BINARY );
+}
+
+pkgRawArchiveStream::pkgRawArchiveStream( int fileno ):fd( fileno )
+{
+  /* Alternatively, when the archive file has already been opened,
+   * we simply adopt the file descriptor which represents it.
+   */
+}
+
+pkgRawArchiveStream::~pkgRawArchiveStream()
+{
+  /* The destructor needs only to close the data stream.
+   */
+  if( fd != -1 ) close( fd );
+}
+
+int pkgRawArchiveStream::Decode( char *buf, size_t max )
+{
+  /* While the stream reader simply transfers the requested number
+   * of bytes from the stream, to the caller's buffer; (note that we
+   * delegate this to GetRawData(), so that any primed input data is
+   * returned ahead of further data read from the stream).
+   */
+  return (fd == -1) ? fd : GetRawData( fd, (uint8_t *)(buf), max );
+}
+
+/*****
+ *
+ * Class Implementation: pkgMappedArchiveStream
+ *
+ * This is an alternative to pkgRawArchiveStream, for uncompressed archives
+ * which are stored in regular files; rather than reading the data, we map
+ * it into memory, a window at a time, and lend views directly into those
+ * mapped pages, so that extracted data is copied only once, from the
+ * system's cache to the destination file.  Successive windows are mapped
+ * on demand, so that archives larger than the available address space,
+ * (e.g. exceeding 4 GiB, for a 32-bit process), may be accommodated.
+ *
+ */
+#include <io.h>
+
+/* Where the host supports it, (i.e. on Windows-8 and later), we hint
+ * to the memory manager that each mapped window will be read, in full;
+ * this is the nearest equivalent to madvise( MADV_WILLNEED ), but since
+ * older hosts lack the API, we must resolve it at run time.
+ */
+typedef struct { void *address; size_t length; } prefetch_range;
+typedef BOOL (WINAPI *prefetch_api)( HANDLE, ULONG_PTR, prefetch_range*, ULONG );
+
+static void prefetch_window( const void *address, size_t length )
+{
+  static prefetch_api prefetch = NULL;
+  static bool initialised = false;
+  if( ! initialised )
+  {
+    /* On first call, attempt to resolve the API entry point; we do
+     * this only once, irrespective of the outcome.
+     */
+    HMODULE kernel = GetModuleHandle( "kernel32.dll" );
+    if( kernel != NULL ) prefetch = (prefetch_api)(GetProcAddress( kernel,
+	  "PrefetchVirtualMemory"
+	));
+    initialised = true;
+  }
+  if( prefetch != NULL )
+  {
+    /* The API is available; issue the hint, (ignoring any failure,
+     * since it does not affect the validity of the mapped data).
+     */
+    prefetch_range range = { (void *)(address), length };
+    prefetch( GetCurrentProcess(), 1, &range, 0 );
+  }
+}
+
+pkgMappedArchiveStream::pkgMappedArchiveStream( int fileno ):
+pkgRawArchiveStream( fileno ), mapping( NULL ), window( NULL ),
+file_size( 0 ), window_base( 0 ), window_end( 0 ), position( 0 )
+{
+  /* The constructor establishes a read-only mapping object, for the
+   * entire file, noting its size, and the current stream position;
+   * if the file is empty, or cannot be mapped, (e.g. if it is not a
+   * regular file), then we simply leave the mapping handle as NULL,
+   * and the stream will then behave as a regular raw stream.
+   */
+  __int64 size;
+  if( (fd != -1) && ((size = _filelengthi64( fd )) > 0) )
+  {
+    HANDLE file = (HANDLE)(_get_osfhandle( fd ));
+    if( (file != INVALID_HANDLE_VALUE)
+    &&  ((mapping = CreateFileMapping( file, NULL, PAGE_READONLY, 0, 0, NULL )) != NULL)  )
+    {
+      file_size = size;
+      position = _telli64( fd );
+    }
+  }
+}
+
+pkgMappedArchiveStream::~pkgMappedArchiveStream()
+{
+  /* The destructor must release any mapped window, and the mapping
+   * object, before the base class destructor closes the file.
+   */
+  UnmapFile();
+}
+
+void pkgMappedArchiveStream::UnmapFile()
+{
+  /* Helper method, to release the current window, (if any), and the
+   * mapping object itself; this may be called by the destructor, or
+   * when we must revert to reading the file in the regular manner.
+   */
+  if( window != NULL ) UnmapViewOfFile( (void *)(window) );
+  if( mapping != NULL ) CloseHandle( (HANDLE)(mapping) );
+  window = NULL; mapping = NULL;
+}
+
+bool pkgMappedArchiveStream::MapWindow()
+{
+  /* Helper method, to replace the current window, (if any), with a
+   * new one, beginning at (or just before) the current position; the
+   * window offset must be a multiple of the allocation granularity, so
+   * we align it downwards, (but since WindowSize is also a multiple of
+   * this granularity, this is necessary only for the first window).
+   */
+  SYSTEM_INFO info;
+  GetSystemInfo( &info );
+  uint64_t base = position - (position % info.dwAllocationGranularity);
+  uint64_t span = file_size - base;
+  if( span > WindowSize ) span = WindowSize;
+
+  if( window != NULL ) UnmapViewOfFile( (void *)(window) );
+  window = (const char *)(MapViewOfFile( (HANDLE)(mapping), FILE_MAP_READ,
+	(DWORD)(base >> 32), (DWORD)(base), (size_t)(span)
+      ));
+  if( window == NULL )
+    return false;
+
+  /* We have a new window; note its extent, and hint that we will
+   * soon need its content.
+   */
+  window_base = base; window_end = base + span;
+  prefetch_window( window + (position - base), window_end - position );
+  return true;
+}
+
+int pkgMappedArchiveStream::GetView( const char **ref )
+{
+  /* Lend a view into the mapped file, extending from the current
+   * position to the end of the current window.
+   */
+  if( mapping != NULL )
+  {
+    if( primed_data != NULL )
+    {
+      /* The sample data with which pkgOpenArchiveStream() primed the
+       * stream remains within the file, so we may simply discard the
+       * primed copy, and step back to the position whence it came.
+       */
+      position -= primed_bytes;
+      free( primed_data ); primed_data = NULL; primed_bytes = 0;
+    }
+    if( position >= file_size )
+      /*
+       * There is no more data; this is a normal end of stream.
+       */
+      return 0;
+
+    if( ((window != NULL) && (position < window_end)) || MapWindow() )
+    {
+      /* The current position lies within a mapped window; lend a view
+       * of whatever remains within it.
+       */
+      *ref = window + (position - window_base);
+      return window_end - position;
+    }
+    /* If we get to here, we failed to map the next window, (perhaps
+     * because the address space is exhausted); fall back to reading
+     * the remainder of the file in the regular manner.
+     */
+    UnmapFile();
+    if( _lseeki64( fd, position, SEEK_SET ) < 0 )
+      return -1;
+  }
+  return pkgRawArchiveStream::GetView( ref );
+}
+
+void pkgMappedArchiveStream::ReleaseView( size_t count )
+{
+  /* Mark data within the current view as consumed; when the file is
+   * mapped, this simply advances the position within the window.
+   */
+  if( mapping == NULL )
+    pkgRawArchiveStream::ReleaseView( count );
+
+  else
+  { /* Since the mapped data never passes through GetRawData(), it is
+     * here that we must incorporate it into any active digest.
+     */
+    if( count > (window_end - position) ) count = window_end - position;
+    if( digest != NULL ) digest->Update( fd, window + (position - window_base), count );
+    position += count;
+  }
+}
+
+void pkgMappedArchiveStream::DrainRawData()
+{
+  /* Since data in the mapped file is lent directly, we may consume
+   * any residue simply by releasing successive views, until the end
+   * of the file; (this remains appropriate, even if we have reverted
+   * to reading the file in the regular manner).
+   */
+  const char *data; int count;
+  while( (count = GetView( &data )) > 0 )
+    ReleaseView( count );
+}
+
+void pkgMappedArchiveStream::EnableReadAhead( int fd )
+{
+  /* Read-ahead would serve no useful purpose, (and would interfere
+   * with the file position), while the file is mapped; we permit it
+   * only when we have been unable to map the file.
+   */
+  if( mapping == NULL ) pkgRawArchiveStream::EnableReadAhead( fd );
+}
+
+/*****
+ *
+ * Class Implementation: pkgGzipArchiveStream
+ *
+ * This class creates an input streaming interface, suitable for
+ * reading archives which have been stored with gzip compression.
+ * The implementation is based on the use of libz.a; rather than
+ * delegating file access to gzopen() and gzread(), we drive the
+ * inflate() API directly, and obtain its input via GetRawData(),
+ * in the same manner as the lzma and xz decoders do.
+ *
+ */
+static
+int gzip_stream_initialise( z_stream *stream )
+{
+  /* This helper establishes initial state for the decoder; we use
+   * the default memory allocator, and configure inflate() to expect
+   * a gzip wrapper, (or a zlib wrapper, which is detected implicitly).
+   */
+  memset( stream, 0, sizeof( z_stream ) );
+  return inflateInit2( stream, 32 + MAX_WBITS );
+}
+
+pkgGzipArchiveStream::pkgGzipArchiveStream( const char *filename )
+{
+  /* The constructor must first open a file stream...
+   */
+  if( (fd = open( filename, O_RDONLY | O_BINARY )) >= 0 )
+    /*
+     * ...then set up the inflate decoder, in appropriately
+     * initialised state.
+     */
+    status = gzip_stream_initialise( &stream );
+}
+
+pkgGzipArchiveStream::pkgGzipArchiveStream( int fileno ):fd( fileno )
+{
+  /* Alternatively, given an already opened file stream, we need only
+   * set up the inflate decoder.
+   */
+  if( fd != -1 ) status = gzip_stream_initialise( &stream );
+}
+
+pkgGzipArchiveStream::~pkgGzipArchiveStream()
+{
+  /* The destructor releases the decoder resources, and closes
+   * the input stream file descriptor.
+   */
+  if( fd != -1 )
+  {
+    inflateEnd( &stream );
+    close( fd );
+  }
+}
+
+int pkgGzipArchiveStream::Decode( char *buf, size_t max )
+{
+  /* Read a gzip compressed data stream; store up to "max" bytes of
+   * decompressed data into "buf".
+   */
+  if( fd == -1 )
+    /*
+     * We cannot read from a stream with an invalid descriptor;
+     * in this circumstance, just say "nothing was read"...
+     */
+    return fd;
+
+  /* Similarly, once the decoder has reported an error, (which we will
+   * already have diagnosed), there is nothing more which we may read.
+   */
+  if( (status != Z_OK) && (status != Z_STREAM_END) )
+    return -1;
+
+  /* Otherwise the stream is ready to read...
+   * Start by directing the decoder to use "buf", initially marking it
+   * as "empty".
+   */
+  stream.next_out = (Bytef *)(buf);
+  stream.avail_out = max;
+
+  while( (stream.avail_out > 0) && (status == Z_OK) )
+  {
+    /* "buf" hasn't been filled yet, and the decoder continues to say
+     * that more data may be available.
+     */
+    if( stream.avail_in == 0 )
+    {
+      /* We exhausted the current content of the raw input buffer;
+       * top it up again, (noting that a failure to do so, while the
+       * decoder still expects more data, is an unexpected end of
+       * the input stream).
+       */
+      int count;
+      stream.next_in = streambuf;
+      if( (count = GetRawData( fd, streambuf, BUFSIZ )) <= 0 )
+      {
+	stream.avail_in = 0;
+	status = Z_BUF_ERROR;
+	break;
+      }
+      stream.avail_in = count;
+    }
+
+    /* Run the decoder, to decompress as much as possible of the data
+     * currently in the raw input buffer, filling available space in
+     * "buf"...
+     */
+    if( (status = inflate( &stream, Z_NO_FLUSH )) == Z_STREAM_END )
+    {
+      /* ...but, on reaching the end of a gzip member, the input may
+       * comprise the concatenation of further members, (as gzread()
+       * would have accepted); check for the signature of another...
+       */
+      if( stream.avail_in == 0 )
+      {
+	int count;
+	stream.next_in = streambuf;
+	stream.avail_in = ((count = GetRawData( fd, streambuf, BUFSIZ )) > 0)
+	  ? count : 0;
+      }
+      if( (stream.avail_in > 0) && (*stream.next_in == 0x1F) )
+	/*
+	 * ...and, when one is present, reset the decoder to continue
+	 * processing it; (any other trailing data is ignored).
+	 */
+	status = inflateReset( &stream );
+    }
+  }
+
+  /* When we get to here, we either filled "buf" completely, or we
+   * completely exhausted the raw input stream, or the decoder found
+   * the stream to be corrupt, or truncated; in the last case, we must
+   * diagnose the fault, and return -1, as gzread() would have done,
+   * rather than allow the caller to mistake it for the end of the
+   * stream...
+   */
+  if( (status != Z_OK) && (status != Z_STREAM_END) )
+  {
+    dmh_notify( DMH_ERROR, "gzip decoder: %s\n", (status == Z_BUF_ERROR)
+	? "unexpected end of compressed data" : (stream.msg != NULL)
+	? stream.msg : "corrupt compressed data"
+      );
+    return -1;
+  }
+  /* ...otherwise, we return the actual number of bytes stored in "buf",
+   * (i.e. its total size, less any residual free space).
+   */
+  return max - stream.avail_out;
+}
+
+/*****
+ *
+ * Class Implementation: pkgBzipArchiveStream
+ *
+ * This class creates an input streaming interface, suitable for
+ * reading archives which have been stored with bzip2 compression.
+ * The implementation is based on the use of libbz2.a; as in the
+ * case of gzip, we drive the low-level BZ2_bzDecompress() API, in
+ * preference to the stdio based BZ2_bzRead(), so that input may
+ * be obtained via GetRawData().
+ *
+ */
+static
+int bzip_stream_initialise( bz_stream *stream )
+{
+  /* Establish initial state for the bzip2 decoder, using default
+   * memory allocation, and the normal (faster) decoding algorithm.
+   */
+  memset( stream, 0, sizeof( bz_stream ) );
+  return BZ2_bzDecompressInit( stream, 0, 0 );
+}
+
+pkgBzipArchiveStream::pkgBzipArchiveStream( const char *filename )
+{
+  /* The constructor must first open a file stream...
+   */
+  if( (fd = open( filename, O_RDONLY | O_BINARY )) >= 0 )
+    /*
+     * ...then set up the bzip2 decoder, in appropriately
+     * initialised state.
+     */
+    status = bzip_stream_initialise( &stream );
+}
+
+pkgBzipArchiveStream::pkgBzipArchiveStream( int fileno ):fd( fileno )
+{
+  /* Alternatively, given an already opened file stream, we need only
+   * set up the bzip2 decoder.
+   */
+  if( fd != -1 ) status = bzip_stream_initialise( &stream );
+}
+
+pkgBzipArchiveStream::~pkgBzipArchiveStream()
+{
+  /* The destructor releases the decoder resources, and closes
+   * the input stream file descriptor.
+   */
+  if( fd != -1 )
+  {
+    BZ2_bzDecompressEnd( &stream );
+    close( fd );
+  }
+}
+
+int pkgBzipArchiveStream::Decode( char *buf, size_t max )
+{
+  /* Read a bzip2 compressed data stream; store up to "max" bytes of
+   * decompressed data into "buf".
+   */
+  if( fd == -1 )
+    /*
+     * We cannot read from a stream with an invalid descriptor;
+     * in this circumstance, just say "nothing was read"...
+     */
+    return fd;
+
+  /* Similarly, once the decoder has reported an error, (which we will
+   * already have diagnosed), there is nothing more which we may read.
+   */
+  if( (status != BZ_OK) && (status != BZ_STREAM_END) )
+    return -1;
+
+  /* Otherwise the stream is ready to read...
+   * Start by directing the decoder to use "buf", initially marking it
+   * as "empty".
+   */
+  stream.next_out = buf;
+  stream.avail_out = max;
+
+  while( (stream.avail_out > 0) && (status == BZ_OK) )
+  {
+    /* "buf" hasn't been filled yet, and the decoder continues to say
+     * that more data may be available.
+     */
+    if( stream.avail_in == 0 )
+    {
+      /* We exhausted the current content of the raw input buffer;
+       * top it up again, or bail out if that isn't possible.
+       */
+      int count;
+      stream.next_in = streambuf;
+      if( (count = GetRawData( fd, (uint8_t *)(streambuf), BUFSIZ )) <= 0 )
+      {
+	stream.avail_in = 0;
+	status = BZ_UNEXPECTED_EOF;
+	break;
+      }
+      stream.avail_in = count;
+    }
+
+    /* Run the decoder, to decompress as much as possible of the data
+     * currently in the raw input buffer, filling available space in
+     * "buf"...
+     */
+    if( (status = BZ2_bzDecompress( &stream )) == BZ_STREAM_END )
+    {
+      /* ...but, as in the gzip case, the input may comprise several
+       * concatenated bzip2 streams, (as produced by pbzip2, say); when
+       * another follows, we must restart the decoder to process it.
+       */
+      if( stream.avail_in == 0 )
+      {
+	int count;
+	stream.next_in = streambuf;
+	stream.avail_in = ((count = GetRawData( fd, (uint8_t *)(streambuf), BUFSIZ )) > 0)
+	  ? count : 0;
+      }
+      if( (stream.avail_in > 0) && (*stream.next_in == 'B') )
+      {
+	/* The decoder must be reinitialised, but this would discard
+	 * our references to the residual input, and to the output
+	 * buffer; preserve them, across the reset.
+	 */
+	char *next_in = stream.next_in, *next_out = stream.next_out;
+	unsigned int avail_in = stream.avail_in, avail_out = stream.avail_out;
+	BZ2_bzDecompressEnd( &stream );
+	if( (status = bzip_stream_initialise( &stream )) == BZ_OK )
+	{
+	  stream.next_in = next_in; stream.avail_in = avail_in;
+	  stream.next_out = next_out; stream.avail_out = avail_out;
+	}
+      }
+    }
+  }
+
+  /* When we get to here, we either filled "buf" completely, or we
+   * completely exhausted the raw input stream, or the decoder found
+   * the stream to be corrupt, or truncated; in the last case, we must
+   * diagnose the fault, and return -1, as BZ2_bzRead() would have done,
+   * rather than allow the caller to mistake it for the end of the
+   * stream...
+   */
+  if( (status != BZ_OK) && (status != BZ_STREAM_END) )
+  {
+    dmh_notify( DMH_ERROR, "bzip2 decoder: %s\n",
+	(status == BZ_UNEXPECTED_EOF) ? "unexpected end of compressed data"
+	: (status == BZ_DATA_ERROR_MAGIC) ? "not a bzip2 stream"
+	: (status == BZ_MEM_ERROR) ? "insufficient memory"
+	: "corrupt compressed data"
+      );
+    return -1;
+  }
+  /* ...otherwise, we return the actual number of bytes stored in "buf",
+   * (i.e. its total size, less any residual free space).
+   */
+  return max - stream.avail_out;
+}
+
+/*****
+ *
+ * Class Implementation: pkgBzipParallelArchiveStream
+ *
+ * This class provides an alternative input streaming interface, for
+ * archives which have been stored with bzip2 compression.  A bzip2
+ * stream comprises a sequence of independently compressed blocks, each
+ * introduced by a 48-bit magic signature, (which is NOT byte aligned),
+ * and the stream is terminated by a similar end of stream signature,
+ * followed by a combined CRC.  We scan the raw stream for these magic
+ * signatures; each block thus identified is copied, (realigned to a
+ * byte boundary), into a synthetic single block stream, which may be
+ * decoded by a worker thread, independently of all other blocks.  The
+ * decoded blocks are then returned to the caller, in their original
+ * order, by lending views of each block's decoded data buffer.
+ *
+ */
+#include "pkgpool.h"
+
+#define BZIP2_BLOCK_MAGIC	0x314159265359ULL
+#define BZIP2_FINAL_MAGIC	0x177245385090ULL
+#define BZIP2_MAGIC_MASK	0xFFFFFFFFFFFFULL
+#define BZIP2_NO_BLOCK  	(~0ULL)
+
+class pkgBzipBlockDecoder : public pkgWorkerTask
+{
+  /* A locally defined worker task class, representing one bzip2
+   * block, to be decoded on a worker thread.
+   */
+  public:
+    pkgBzipBlockDecoder( const uint8_t*, unsigned, uint64_t );
+    virtual ~pkgBzipBlockDecoder(){ free( raw ); free( data ); }
+    virtual void Execute();
+
+    /* Decoded data, and its disposition; these are not accessed by
+     * the consumer, until after Execute() has completed.
+     */
+    pkgBzipBlockDecoder *successor;
+    char *data; size_t len, offset;
+    bool ok;
+
+  private:
+    uint8_t *raw;
+    unsigned shift;
+    uint64_t bits;
+};
+
+pkgBzipBlockDecoder::pkgBzipBlockDecoder
+( const uint8_t *src, unsigned first_bit, uint64_t count ):
+successor( NULL ), data( NULL ), len( 0 ), offset( 0 ), ok( false ),
+shift( first_bit ), bits( count )
+{
+  /* The constructor, which runs on the scanner's thread, simply takes
+   * a copy of the raw data which spans the block; this is allocated
+   * with one extra (zero) byte, to simplify realignment.
+   */
+  size_t span = (shift + bits + 7) >> 3;
+  if( (raw = (uint8_t *)(calloc( span + 1, 1 ))) != NULL )
+    memcpy( raw, src, span );
+}
+
+static inline
+void bzip2_put_bits( uint8_t *buf, uint64_t &pos, uint64_t value, int count )
+{
+  /* Helper, to append the "count" least significant bits of "value",
+   * at bit offset "pos" within a (zero filled) buffer.
+   */
+  while( count-- > 0 )
+  { if( (value >> count) & 1 ) buf[pos >> 3] |= 0x80 >> (pos & 7);
+    ++pos;
+  }
+}
+
+void pkgBzipBlockDecoder::Execute()
+{
+  /* Method invoked on the worker thread, to construct and decode the
+   * synthetic stream; this must comprise a stream header, the block
+   * itself, (which must at least be long enough to include its own
+   * magic signature and CRC), and the end of stream trailer.
+   */
+  size_t body = (bits + 7) >> 3, total = 4 + ((bits + 80 + 7) >> 3);
+  uint8_t *stream_data;
+  if( (raw == NULL) || (bits < 80)
+  ||  ((stream_data = (uint8_t *)(calloc( total, 1 ))) == NULL)  )
+    return;
+
+  /* The stream header specifies the maximum block size; since this
+   * serves only to limit the decoder's memory allocation, we need not
+   * match the original, so we always specify the maximum.
+   */
+  uint8_t *out = stream_data + 4;
+  memcpy( stream_data, "BZh9", 4 );
+  for( size_t i = 0; i < body; i++ )
+    out[i] = shift ? (raw[i] << shift) | (raw[i + 1] >> (8 - shift)) : raw[i];
+  if( (bits & 7) != 0 ) out[body - 1] &= 0xFF << (8 - (bits & 7));
+
+  /* The trailer comprises the end of stream signature, followed by the
+   * combined CRC which, for a single block stream, is simply a copy of
+   * the block CRC, (which immediately follows the block's signature).
+   */
+  uint64_t pos = bits;
+  uint32_t crc = (out[6] << 24) | (out[7] << 16) | (out[8] << 8) | out[9];
+  bzip2_put_bits( out, pos, BZIP2_FINAL_MAGIC, 48 );
+  bzip2_put_bits( out, pos, crc, 32 );
+
+  /* Decode the synthetic stream, into a buffer which we allow to grow
+   * as required; (note that the bzip2 initial run length encoding may
+   * result in decoded data which is much larger than the block size).
+   */
+  bz_stream stream;
+  memset( &stream, 0, sizeof( stream ) );
+  if( BZ2_bzDecompressInit( &stream, 0, 0 ) == BZ_OK )
+  {
+    int status = BZ_OK;
+    size_t capacity = 0;
+    stream.next_in = (char *)(stream_data);
+    stream.avail_in = total;
+    while( status == BZ_OK )
+    {
+      if( len == capacity )
+      {
+	/* We've filled the output buffer; double its capacity.
+	 */
+	char *tmp = (char *)(realloc( data, capacity = capacity ? capacity << 1 : 1 << 20 ));
+	if( tmp == NULL ) break;
+	data = tmp;
+      }
+      stream.next_out = data + len;
+      stream.avail_out = capacity - len;
+      status = BZ2_bzDecompress( &stream );
+      len = stream.next_out - data;
+
+      /* If the decoder has consumed all input, yet has still not
+       * filled the output buffer, then the block must be incomplete.
+       */
+      if( (status == BZ_OK) && (stream.avail_in == 0) && (len < capacity) )
+	break;
+    }
+    ok = (status == BZ_STREAM_END);
+    BZ2_bzDecompressEnd( &stream );
+  }
+  free( stream_data );
+}
+
+pkgBzipParallelArchiveStream::pkgBzipParallelArchiveStream
+( int fileno, unsigned threads ):fd( fileno ), pool( NULL ),
+max_pending( threads << 1 ), pending_count( 0 ), pending( NULL ),
+last_pending( NULL ), inbuf( NULL ), inbuf_size( 0 ), inbuf_len( 0 ),
+inbuf_base( 0 ), bitpos( 0 ), window( 0 ), block_start( BZIP2_NO_BLOCK ),
+truncated( false ), delivered( 0 ), serial( NULL )
+{
+  /* The constructor need only start the worker thread pool; we keep
+   * up to two blocks per thread in the pipeline, so that the workers
+   * need not stall while the consumer drains completed blocks.
+   */
+  if( fd != -1 ) pool = new pkgWorkerPool( threads );
+}
+
+pkgBzipParallelArchiveStream::~pkgBzipParallelArchiveStream()
+{
+  /* The destructor must shut down the worker thread pool, (which
+   * will complete any blocks which are still pending), before we may
+   * release the blocks, and any other resources we hold.
    */
-  fd = open( filename, O_RDONLY | O_BINARY );
+  delete pool;
+  while( pending != NULL )
+  {
+    pkgBzipBlockDecoder *block = pending;
+    pending = block->successor;
+    delete block;
+  }
+  free( inbuf );
+
+  /* If we reverted to the serial decoder, then it has adopted the file
+   * descriptor, and will close it; otherwise, we must close it.
+   */
+  if( serial != NULL ) delete serial;
+  else if( fd != -1 ) close( fd );
 }
 
-pkgRawArchiveStream::~pkgRawArchiveStream()
+bool pkgBzipParallelArchiveStream::FillBuffer()
 {
-  /* The destructor needs only to close the data stream.
+  /* Helper method, to read more raw data into the input buffer; first,
+   * we discard any data which precedes the start of the block which we
+   * are currently scanning, (or the scanning position, if none)...
    */
-  close( fd );
+  uint64_t keep = ((block_start == BZIP2_NO_BLOCK) ? bitpos : block_start) >> 3;
+  if( keep > inbuf_base )
+  {
+    size_t discard = keep - inbuf_base;
+    memmove( inbuf, inbuf + discard, inbuf_len -= discard );
+    inbuf_base = keep;
+  }
+  if( inbuf_len == inbuf_size )
+  {
+    /* ...then, if there is still no free space, we extend the buffer
+     * to accommodate at least one more full sized bzip2 block...
+     */
+    uint8_t *tmp = (uint8_t *)(realloc( inbuf, inbuf_size + (1 << 20) ));
+    if( tmp == NULL ) return false;
+    inbuf = tmp; inbuf_size += 1 << 20;
+  }
+  /* ...before we finally top it up.
+   */
+  int count = GetRawData( fd, inbuf + inbuf_len, inbuf_size - inbuf_len );
+  if( count <= 0 ) return false;
+  inbuf_len += count;
+  return true;
 }
 
-int pkgRawArchiveStream::Read( char *buf, size_t max )
+bool pkgBzipParallelArchiveStream::ScanNextBlock()
 {
-  /* While the stream reader simply transfers the requested number
-   * of bytes from the stream, to the caller's buffer.
+  /* Helper method to scan the raw data stream, until we have found
+   * one complete block; submit it for decoding, and return true, or
+   * return false when no further block is found.
    */
-  return read( fd, buf, max );
+  while( true )
+  {
+    size_t index = (bitpos >> 3) - inbuf_base;
+    if( index >= inbuf_len )
+    {
+      /* We've exhausted the buffered data; read some more, or, if
+       * that isn't possible, note if we have an incomplete block.
+       */
+      if( FillBuffer() ) continue;
+      truncated = (block_start != BZIP2_NO_BLOCK);
+      return false;
+    }
+    /* Shift the next byte into the scanning window; then, since the
+     * magic signatures may begin at any bit offset, check each of the
+     * eight possible alignments, (earliest first), for a match with
+     * either signature; (note that no more than one match is possible,
+     * within any one byte).
+     */
+    window = (window << 8) | inbuf[index];
+    bitpos += 8;
+    for( int align = 7; align >= 0; align-- )
+    {
+      uint64_t tag = (window >> align) & BZIP2_MAGIC_MASK;
+      if( (tag == BZIP2_BLOCK_MAGIC) || (tag == BZIP2_FINAL_MAGIC) )
+      {
+	/* A signature match marks the end of any preceding block,
+	 * (and possibly the start of another).
+	 */
+	uint64_t here = bitpos - align - 48, start = block_start;
+	block_start = (tag == BZIP2_BLOCK_MAGIC) ? here : BZIP2_NO_BLOCK;
+	if( start != BZIP2_NO_BLOCK )
+	{
+	  /* There is a preceding block; submit it for decoding, and
+	   * add it to the in-order queue of pending blocks.
+	   */
+	  pkgBzipBlockDecoder *block = new pkgBzipBlockDecoder(
+	      inbuf + ((start >> 3) - inbuf_base), start & 7, here - start
+	    );
+	  if( last_pending == NULL ) pending = block;
+	  else last_pending->successor = block;
+	  last_pending = block; ++pending_count;
+	  pool->Submit( block );
+	  return true;
+	}
+	break;
+      }
+    }
+  }
 }
 
-/*****
- *
- * Class Implementation: pkgGzipArchiveStream
- *
- * This class creates an input streaming interface, suitable for
- * reading archives which have been stored with gzip compression.
- * The implementation is based on the use of libz.a, which allows
- * for a similar implementation to that of pkgRawArchiveStream.
- *
- */
-pkgGzipArchiveStream::pkgGzipArchiveStream( const char *filename )
+bool pkgBzipParallelArchiveStream::RevertToSerialDecoder()
 {
-  /* Once more, the constructor has little to do but open the stream;
-   * in this case, the method is analogous to C's fopen().
+  /* Helper method, invoked when a block fails to decode; we must assume
+   * that our block identification is flawed, so we abandon the parallel
+   * decoding process, and restart from the beginning of the file, with
+   * the serial decoder.  This is possible only when the input stream is
+   * a seekable file, and we have reached neither truncation, nor any
+   * genuine data error, (in which case, the serial decoder will also
+   * fail, and we simply diagnose the failure at that point).
+   */
+  DisableReadAhead();
+  if( lseek( fd, 0, SEEK_SET ) != 0 ) return false;
+
+  /* Shut down the pipeline, and discard all pending blocks.
    */
-  stream = gzopen( filename, "rb" );
+  delete pool; pool = NULL;
+  while( pending != NULL )
+  {
+    pkgBzipBlockDecoder *block = pending;
+    pending = block->successor;
+    delete block;
+  }
+  last_pending = NULL; pending_count = 0;
+
+  /* Hand over the file descriptor to the serial decoder, then discard
+   * as much decoded data as we have already delivered to our caller.
+   */
+  serial = new pkgBzipArchiveStream( fd );
+  if( digest != NULL )
+  {
+    /* The serial decoder will read the entire file afresh, so any
+     * digest must also be computed afresh, as it does so.
+     */
+    delete digest; digest = NULL;
+    serial->EnableDigest();
+  }
+  for( uint64_t skip = delivered; skip > 0; )
+  {
+    char scratch[BUFSIZ];
+    int count = serial->Read( scratch, (skip < BUFSIZ) ? skip : BUFSIZ );
+    if( count <= 0 ) return false;
+    skip -= count;
+  }
+  return true;
 }
 
-pkgGzipArchiveStream::~pkgGzipArchiveStream()
+int pkgBzipParallelArchiveStream::GetView( const char **ref )
 {
-  /* Another destructor, with little to do but close the stream; the
-   * gzclose() call suffices for the purpose.
+  /* Lend access to decoded bzip2 data, directly from the buffer of
+   * the oldest pending block in the parallel decoding pipeline.
+   */
+  if( serial != NULL )
+    /*
+     * We've already reverted to serial decoding; delegate.
+     */
+    return serial->GetView( ref );
+
+  if( fd == -1 )
+    /*
+     * We cannot read from a stream with an invalid descriptor;
+     * in this circumstance, just say "nothing was read"...
+     */
+    return fd;
+
+  while( true )
+  {
+    /* Keep the pipeline filled...
+     */
+    while( (pending_count < max_pending) && ScanNextBlock() )
+      ;
+
+    /* ...then wait for the oldest pending block to be decoded; if it
+     * decoded successfully, lend access to its unconsumed content.
+     */
+    pkgBzipBlockDecoder *block;
+    if( (block = pending) == NULL )
+    {
+      /* There are no more blocks; this is a normal end of stream,
+       * unless the final block was incomplete.
+       */
+      if( truncated ) break;
+      return 0;
+    }
+    block->WaitForCompletion();
+    if( ! block->ok )
+      break;
+
+    if( block->offset < block->len )
+    {
+      *ref = block->data + block->offset;
+      return block->len - block->offset;
+    }
+    /* We should never see a successfully decoded block which yields
+     * no data, but if we do, we simply discard it, and move on.
+     */
+    ReleaseView( 0 );
+  }
+  /* When we get to here, we had to abandon parallel decoding; continue
+   * using the serial decoder instead, if possible.
    */
-  gzclose( stream );
+  return RevertToSerialDecoder() ? serial->GetView( ref ) : -1;
 }
 
-int pkgGzipArchiveStream::Read( char *buf, size_t max )
+void pkgBzipParallelArchiveStream::ReleaseView( size_t count )
 {
-  /* The reader is again served by a single function call, to transfer
-   * the requested volume of decompressed data from the raw input file
-   * to the caller's buffer.
+  /* Mark data within the current view as consumed, discarding the
+   * block which holds it, when none remains.
    */
-  return gzread( stream, buf, max );
+  if( serial != NULL )
+    serial->ReleaseView( count );
+
+  else if( pending != NULL )
+  {
+    pkgBzipBlockDecoder *block = pending;
+    if( count > (block->len - block->offset) )
+      count = block->len - block->offset;
+    block->offset += count; delivered += count;
+
+    if( block->offset == block->len )
+    {
+      /* This block has been completely consumed; discard it.
+       */
+      if( (pending = block->successor) == NULL ) last_pending = NULL;
+      --pending_count;
+      delete block;
+    }
+  }
 }
 
-/*****
- *
- * Class Implementation: pkgBzipArchiveStream
- *
- * This class creates an input streaming interface, suitable for
- * reading archives which have been stored with bzip2 compression.
- * The implementation is based on the use of libbz2.a, which again
- * allows for a fairly simple implementation, which is also quite
- * analogous to that of pkgRawArchiveStream.
- *
- */
-pkgBzipArchiveStream::pkgBzipArchiveStream( const char *filename )
+int pkgBzipParallelArchiveStream::Decode( char *buf, size_t max )
 {
-  /* The constructor carries a marginal additional overhead, in
-   * that it must first open a regular file, before associating
-   * a bzip2 control structure with it; subsequent stream access
-   * is directed exclusively through that control structure.
+  /* Since we override the generic view API, the only requirement for
+   * this method is to satisfy direct calls; the generic Read() method,
+   * (which uses our own view API), will serve.
    */
-  FILE *streamfile = fopen( filename, "rb" );
-  stream = BZ2_bzReadOpen( &bzerror, streamfile, 0, 0, 0, 0 );
+  return Read( buf, max );
 }
 
-pkgBzipArchiveStream::~pkgBzipArchiveStream()
+bool pkgBzipParallelArchiveStream::DigestMatches( const char *expected )
 {
-  /* For the destructor, it is again just a matter of closing
-   * the bzip2 stream; (this also takes care of closing the
-   * associated file stream).
+  /* When we have reverted to the serial decoder, it is that decoder
+   * which has computed the digest, so it must also check it.
    */
-  BZ2_bzReadClose( &bzerror, stream );
+  if( serial != NULL ) return serial->DigestMatches( expected );
+  return pkgArchiveStream::DigestMatches( expected );
 }
 
-int pkgBzipArchiveStream::Read( char *buf, size_t max )
+static
+pkgArchiveStream *bzip2_stream_factory( int fd )
 {
-  /* Once again, reading is a simple matter of transferring
-   * the requisite number of bytes to the caller's buffer.
+  /* Factory function, registered for bzip2 archives; it chooses the
+   * parallel decoder, when the "decoder-threads" preference, (or the
+   * number of processors, by default), offers more than one thread,
+   * otherwise the serial decoder.  Note that the parallel decoder may
+   * need to revert to the serial decoder, by rewinding its input; we
+   * cannot do that when the input is not seekable, (e.g. when it is
+   * a pipe, delivering an archive as it is downloaded), so we must
+   * choose the serial decoder, in that case.
    */
-  return BZ2_bzRead( &bzerror, stream, buf, max );
+  unsigned threads = pkgWorkerPool::ThreadCount( OPTION_DECODER_THREADS );
+  if( (threads > 1) && (lseek( fd, 0, SEEK_CUR ) >= 0) )
+    return new pkgBzipParallelArchiveStream( fd, threads );
+  return new pkgBzipArchiveStream( fd );
 }
 
 #endif /* PACKAGE_BASE_COMPONENT */
@@ -273,7 +1608,7 @@ pkgLzmaArchiveStream::~pkgLzmaArchiveStream()
   }
 }
 
-int pkgLzmaArchiveStream::Read( char *buf, size_t max )
+int pkgLzmaArchiveStream::Decode( char *buf, size_t max )
 {
   /* Read an lzma compressed data stream; store up to "max" bytes of
    * decompressed data into "buf".
@@ -339,6 +1674,52 @@ int pkgLzmaArchiveStream::Read( char *buf, size_t max )
  * use as an xz decompressor.
  *
  */
+static
+int xz_stream_initialise( lzma_stream *stream )
+{
+  /* Helper to set up the xz decoder, for use by either constructor;
+   * the decoder state is initialised, as for lzma...
+   */
+  lzma_stream_initialise( stream );
+
+#if (IMPLEMENTATION_LEVEL == PACKAGE_BASE_COMPONENT) \
+ && defined LZMA_VERSION && (LZMA_VERSION >= 50040002)
+  /* ...then, when liblzma is sufficiently recent to offer it, (i.e. at
+   * least version 5.4.0), we prefer the multi-threaded decoder; this will
+   * decode independent blocks concurrently, in archives created by "xz -T"
+   * (or any other encoder which records block sizes in block headers),
+   * while quietly reverting to single threaded decoding for any stream
+   * which comprises only one block, or which does not record sizes.  The
+   * number of threads is specified by the "decoder-threads" preference;
+   * if unspecified, (or zero), we use one thread per processor core...
+   */
+  unsigned threads = pkgOptions()->GetValue( OPTION_DECODER_THREADS );
+  if( (threads == 0) && ((threads = lzma_cputhreads()) == 0) ) threads = 1;
+  if( threads > 1 )
+  {
+    /* ...but, when only one thread is specified, (or the processor
+     * count cannot be determined), we simply fall through to use the
+     * single threaded decoder.  Otherwise, we set up the threaded
+     * decoder; allow it to use up to a quarter of physical memory
+     * for threaded decoding, before it reverts to single threading,
+     * but stop only when our usual memory limit would be exceeded.
+     */
+    lzma_mt mt;
+    memset( &mt, 0, sizeof( mt ) );
+    mt.flags = LZMA_CONCATENATED;
+    mt.threads = threads;
+    mt.memlimit_threading = lzma_physmem() / 4;
+    mt.memlimit_stop = memlimit();
+    if( lzma_stream_decoder_mt( stream, &mt ) == LZMA_OK )
+      return LZMA_OK;
+  }
+#endif
+  /* When the multi-threaded decoder isn't available, or isn't wanted,
+   * (or it couldn't be initialised), use the single threaded decoder.
+   */
+  return lzma_stream_decoder( stream, memlimit(), LZMA_CONCATENATED );
+}
+
 pkgXzArchiveStream::pkgXzArchiveStream( const char *filename )
 {
   /* The constructor must first open a file stream...
@@ -348,8 +1729,7 @@ pkgXzArchiveStream::pkgXzArchiveStream( const char *filename )
     /* ...then set up the lzma decoder, in appropriately
      * initialised state...
      */
-    lzma_stream_initialise( &stream );
-    status = lzma_stream_decoder( &stream, memlimit(), LZMA_CONCATENATED );
+    status = xz_stream_initialise( &stream );
 
     /* Finally, recognising that with LZMA_CONCATENATED data,
      * we will eventually need to switch the decoder from its
@@ -361,6 +1741,18 @@ pkgXzArchiveStream::pkgXzArchiveStream( const char *filename )
   }
 }
 
+pkgXzArchiveStream::pkgXzArchiveStream( int fileno ):fd( fileno )
+{
+  /* Alternatively, given an already opened file stream, we need
+   * only set up the decoder, as above.
+   */
+  if( fd != -1 )
+  {
+    status = xz_stream_initialise( &stream );
+    opmode = LZMA_RUN;
+  }
+}
+
 pkgXzArchiveStream::~pkgXzArchiveStream()
 {
   /* This destructor frees memory resources allocated to the decoder,
@@ -375,7 +1767,7 @@ pkgXzArchiveStream::~pkgXzArchiveStream()
   }
 }
 
-int pkgXzArchiveStream::Read( char *buf, size_t max )
+int pkgXzArchiveStream::Decode( char *buf, size_t max )
 {
   /* Read an xz compressed data stream; store up to "max" bytes of
    * decompressed data into "buf".
@@ -455,64 +1847,395 @@ int pkgXzArchiveStream::Read( char *buf, size_t max )
 
 /*****
  *
- * Auxiliary function: pkgOpenArchiveStream()
+ * Class Implementation: pkgZstdArchiveStream
  *
- * NOTE: Keep this AFTER the class specialisations, so that their derived
- * class declarations are visible for object instantiation here!
+ * This class creates an input streaming interface, suitable for
+ * reading archives which have been stored with zstd compression;
+ * it is based on the streaming decompression API of libzstd.a, with
+ * raw input obtained via GetRawData(), in the same manner as for
+ * each of the other compressed stream classes.  Concatenated zstd
+ * frames are handled implicitly, by the library decoder.
  *
  */
-#include <string.h>
-#include <strings.h>
+void pkgZstdArchiveStream::InitialiseDecoder()
+{
+  /* Helper, invoked by each of the constructors, to set up the zstd
+   * decoder, and its raw input buffer; we size this buffer according
+   * to the library's recommendation, (which is typically rather larger
+   * than BUFSIZ), to minimise the number of raw read requests...
+   */
+  streambuf_size = ZSTD_DStreamInSize();
+  if( (streambuf = (uint8_t *)(malloc( streambuf_size ))) != NULL )
+  {
+    /* ...and, provided we successfully allocated it, we may then
+     * create the decoder, initially marking the input buffer as empty.
+     */
+    input.src = streambuf; input.size = input.pos = 0;
+    if( (stream = ZSTD_createDStream()) != NULL )
+      status = ZSTD_isError( hint = ZSTD_initDStream( stream ) ) ? -1 : 0;
+  }
+}
 
-extern "C" pkgArchiveStream* pkgOpenArchiveStream( const char* filename )
+pkgZstdArchiveStream::pkgZstdArchiveStream( const char *filename ):
+stream( NULL ), streambuf( NULL ), status( -1 )
 {
-  /* Naive decompression filter selection, based on file name extension.
-   *
-   * FIXME: adopt more proactive selection method, (similar to that used
-   * by libarchive, perhaps), based on magic patterns within the file.
-   *
-   * NOTE: MS-Windows may use UNICODE file names, but distributed package
-   * archives almost certainly do not.  For our purposes, use of the POSIX
-   * Portable Character Set should suffice; we offer no concessions for
-   * any usage beyond this.
+  /* The constructor must first open a file stream...
+   */
+  if( (fd = open( filename, O_RDONLY | O_BINARY )) >= 0 )
+    /*
+     * ...then set up the zstd decoder.
+     */
+    InitialiseDecoder();
+}
+
+pkgZstdArchiveStream::pkgZstdArchiveStream( int fileno ):
+fd( fileno ), stream( NULL ), streambuf( NULL ), status( -1 )
+{
+  /* Alternatively, given an already opened file stream, we need
+   * only set up the zstd decoder.
+   */
+  if( fd != -1 ) InitialiseDecoder();
+}
+
+pkgZstdArchiveStream::~pkgZstdArchiveStream()
+{
+  /* The destructor releases the decoder, and its input buffer, then
+   * closes the input stream file descriptor.
+   */
+  ZSTD_freeDStream( stream );
+  free( streambuf );
+  if( fd != -1 ) close( fd );
+}
+
+int pkgZstdArchiveStream::Decode( char *buf, size_t max )
+{
+  /* Read a zstd compressed data stream; store up to "max" bytes of
+   * decompressed data into "buf".
+   */
+  if( ! IsReady() )
+    /*
+     * We cannot read from a stream which is not ready; in this
+     * circumstance, just say "nothing was read"...
+     */
+    return -1;
+
+  /* Otherwise the stream is ready to read...
+   * Start by directing the decoder to use "buf", initially marking it
+   * as "empty".
    */
-  char *ext = strrchr( filename, '.' );
-  if( ext != NULL )
+  ZSTD_outBuffer output = { buf, max, 0 };
+  while( (output.pos < output.size) && (status >= 0) )
   {
-    if( strcasecmp( ext, ".gz" ) == 0 )
-      /*
-       * We expect this input stream to be "gzip" compressed,
-       * so we return the appropriate decompressor.
+    /* "buf" hasn't been filled yet, and no decoding error has yet
+     * been detected.
+     */
+    if( (input.pos == input.size) && (status == 0) )
+    {
+      /* We exhausted the current content of the raw input buffer;
+       * top it up again, or mark the raw input as finished, if there
+       * is no more available.
        */
-      return new pkgGzipArchiveStream( filename );
+      int count;
+      if( (count = GetRawData( fd, streambuf, streambuf_size )) > 0 )
+      { input.size = count; input.pos = 0; }
+      else status = (count == 0) ? 1 : -1;
+    }
 
-    else if( strcasecmp( ext, ".bz2" ) == 0 )
-      /*
-       * We expect this input stream to be "bzip2" compressed,
-       * so again, we return the appropriate decompressor.
-       */
-      return new pkgBzipArchiveStream( filename );
+    /* The end of the raw input is the proper end of the stream, only
+     * if the decoder's most recent hint indicated that it had completed,
+     * and fully flushed, its last frame; otherwise, we must give the
+     * decoder one more opportunity to flush any data which it holds,
+     * (which it may not have been able to deliver, if "buf" was filled
+     * by its previous invocation).
+     */
+    size_t pos = output.pos;
+    if( (status == 1) && (hint == 0) ) break;
+    if( status >= 0 ) hint = ZSTD_decompressStream( stream, &output, &input );
 
-    else if( strcasecmp( ext, ".lzma" ) == 0 )
-      /*
-       * We expect this input stream to be "lzma" compressed,
-       * so again, we return the appropriate decompressor.
+    if( (status < 0) || ((status == 1) && (output.pos == pos)) )
+    {
+      /* We couldn't read the raw input, or it ended before the decoder
+       * could complete its last frame; the stream has been truncated.
        */
-      return new pkgLzmaArchiveStream( filename );
-
-    else if( strcasecmp( ext, ".xz" ) == 0 )
-      /*
-       * We expect this input stream to be "xz" compressed,
-       * so again, we return the appropriate decompressor.
+      dmh_notify( DMH_ERROR, "zstd decoder: %s\n",
+	  "unexpected end of compressed data"
+	);
+      status = -1;
+    }
+    else if( ZSTD_isError( hint ) )
+    {
+      /* The decoder reported corruption of the input stream; we
+       * diagnose it, and decline to read any further.
        */
-      return new pkgXzArchiveStream( filename );
+      dmh_notify( DMH_ERROR, "zstd decoder: %s\n", ZSTD_getErrorName( hint ) );
+      status = -1;
+    }
+  }
+
+  /* When we get to here, we either filled "buf" completely, or we
+   * reached the proper end of the stream, or the decoder found it to be
+   * corrupt, or truncated; in the last case, we must return -1, rather
+   * than allow the caller to mistake it for the end of the stream...
+   */
+  if( status < 0 ) return -1;
+
+  /* ...otherwise, we return the actual number of bytes stored in "buf".
+   */
+  return output.pos;
+}
+
+/*****
+ *
+ * Class Implementation: pkgArchiveSignature
+ *
+ * This provides the registry of magic patterns, which is used by
+ * pkgOpenArchiveStream() to identify the format of any archive, and
+ * thus, to select the appropriate stream class to decode it.
+ *
+ */
+pkgArchiveSignature *pkgArchiveSignature::registry = NULL;
+
+pkgArchiveSignature::pkgArchiveSignature
+( const char *format, pkgArchiveMatcher *matcher, pkgArchiveFactory *creator ):
+next( registry ), name( format ), matches( matcher ), factory( creator )
+{
+  /* Each registry entry is simply pushed on to the head of a linked
+   * list; (note that "registry" is a statically initialised pointer,
+   * so this is safe, regardless of static construction order).
+   */
+  registry = this;
+}
+
+const pkgArchiveSignature *pkgArchiveSignature::Identify
+( const uint8_t *sample, size_t len )
+{
+  /* Walk the registry, offering the sample data to each registered
+   * pattern matcher in turn, and return a reference to the first entry
+   * whose matcher accepts it, or NULL if none does.
+   */
+  for( pkgArchiveSignature *ref = registry; ref != NULL; ref = ref->next )
+    if( ref->matches( sample, len ) ) return ref;
+  return NULL;
+}
+
+/* Pattern matchers for each of the built-in archive stream formats...
+ * Each is passed a sample comprising the first 512 bytes of the archive,
+ * (or fewer, if the archive is shorter), and must return true if, and
+ * only if, it is satisfied that the sample represents its own format.
+ */
+static
+bool is_ustar_archive( const uint8_t *sample, size_t len )
+{
+  /* An uncompressed tar archive; the first header block of a POSIX,
+   * or GNU, archive will carry the "ustar" magic signature...
+   */
+  const char *magic = (const char *)(sample) + 257;
+  if( (len >= 512) && (strncmp( magic, "ustar", 5 ) == 0) )
+    return true;
+
+  /* ...whereas an old style (v7) archive will not; in this case, we
+   * accept the sample if it looks like a header block, which carries
+   * a valid checksum, (while counting the checksum field as if it was
+   * filled with spaces).
+   */
+  if( (len >= 512) && (*sample != '\0') )
+  {
+    unsigned long sum = 0, chksum = 0;
+    const uint8_t *field = sample + 148, *end = field + 8;
+    for( size_t offset = 0; offset < 512; offset++ )
+      sum += ((offset >= 148) && (offset < 156)) ? ' ' : sample[offset];
+    while( (field < end) && (*field == ' ') ) ++field;
+    while( (field < end) && (*field >= '0') && (*field <= '7') )
+      chksum = (chksum << 3) + *field++ - '0';
+    return (field > sample + 148) && (sum == chksum);
   }
+  return false;
+}
+
+static
+bool is_gzip_archive( const uint8_t *sample, size_t len )
+{
+  /* A gzip stream starts with the two byte ID sequence, 0x1F 0x8B,
+   * which is always followed by compression method 8, (deflate).
+   */
+  return (len >= 3) && (sample[0] == 0x1F) && (sample[1] == 0x8B)
+    && (sample[2] == 8);
+}
+
+static
+bool is_bzip2_archive( const uint8_t *sample, size_t len )
+{
+  /* A bzip2 stream starts with "BZh", followed by a block size digit
+   * in the range '1'..'9', and then the magic signature of either the
+   * first compressed block, or of the end of stream marker.
+   */
+  static const uint8_t block_magic[] = { 0x31, 0x41, 0x59, 0x26, 0x53, 0x59 };
+  static const uint8_t final_magic[] = { 0x17, 0x72, 0x45, 0x38, 0x50, 0x90 };
+  return (len >= 10) && (memcmp( sample, "BZh", 3 ) == 0)
+    && (sample[3] >= '1') && (sample[3] <= '9')
+    && (  (memcmp( sample + 4, block_magic, 6 ) == 0)
+       || (memcmp( sample + 4, final_magic, 6 ) == 0)  );
+}
+
+static
+bool is_xz_archive( const uint8_t *sample, size_t len )
+{
+  /* An xz stream starts with the six byte header magic sequence.
+   */
+  static const uint8_t magic[] = { 0xFD, '7', 'z', 'X', 'Z', 0x00 };
+  return (len >= 6) && (memcmp( sample, magic, 6 ) == 0);
+}
+
+static
+bool is_lzma_archive( const uint8_t *sample, size_t len )
+{
+  /* The legacy lzma_alone format has no magic signature, as such; we
+   * must rely on a heuristic evaluation of its 13 byte header, (in the
+   * same manner as xz-utils does).  The first byte encodes the lc, lp
+   * and pb properties, and must not exceed (4 * 5 + 4) * 9 + 8...
+   */
+  if( (len < 13) || (sample[0] > (4 * 5 + 4) * 9 + 8) )
+    return false;
+
+  /* ...the following four bytes specify the dictionary size, (little
+   * endian), which must be either 2^n or 2^n + 2^(n-1), or 2^32 - 1...
+   */
+  uint32_t dict = sample[1] | (sample[2] << 8) | (sample[3] << 16)
+    | ((uint32_t)(sample[4]) << 24);
+  if( dict != 0xFFFFFFFFUL )
+  {
+    uint32_t d = dict - 1;
+    d |= d >> 2; d |= d >> 3; d |= d >> 4; d |= d >> 8; d |= d >> 16;
+    if( dict != ++d ) return false;
+  }
+  /* ...and the final eight bytes specify the uncompressed size, (again
+   * little endian), which is either unknown, (all bits set), or which
+   * we may reasonably assume will be less than 1 TiB.
+   */
+  for( int offset = 5; offset < 13; offset++ )
+    if( sample[offset] != 0xFF )
+      return (sample[10] | sample[11] | sample[12]) == 0;
+  return true;
+}
+
+static
+bool is_zstd_archive( const uint8_t *sample, size_t len )
+{
+  /* A zstd frame starts with the magic number 0xFD2FB528, stored
+   * in little endian byte order.
+   */
+  static const uint8_t magic[] = { 0x28, 0xB5, 0x2F, 0xFD };
+  return (len >= 4) && (memcmp( sample, magic, 4 ) == 0);
+}
+
+/* The built-in registry entries; note that these are listed in order
+ * of increasing precedence, so the speculative lzma match is last to be
+ * checked, while the uncompressed tar match is deliberately given the
+ * highest precedence, to avoid misinterpretation of any tar archive in
+ * which the first member name happens to resemble a lzma header.
+ */
+static pkgArchiveSignature lzma_signature( "lzma", is_lzma_archive,
+    pkgArchiveStreamFactory<pkgLzmaArchiveStream>
+  );
+static pkgArchiveSignature zstd_signature( "zstd", is_zstd_archive,
+    pkgArchiveStreamFactory<pkgZstdArchiveStream>
+  );
+static pkgArchiveSignature xz_signature( "xz", is_xz_archive,
+    pkgArchiveStreamFactory<pkgXzArchiveStream>
+  );
+static pkgArchiveSignature bzip2_signature( "bzip2", is_bzip2_archive,
+    bzip2_stream_factory
+  );
+static pkgArchiveSignature gzip_signature( "gzip", is_gzip_archive,
+    pkgArchiveStreamFactory<pkgGzipArchiveStream>
+  );
+static pkgArchiveSignature ustar_signature( "tar", is_ustar_archive,
+    pkgArchiveStreamFactory<pkgMappedArchiveStream>
+  );
+
+/*****
+ *
+ * Auxiliary functions: pkgAttachArchiveStream() and pkgOpenArchiveStream()
+ *
+ * NOTE: Keep these AFTER the class specialisations, so that their derived
+ * class declarations are visible for object instantiation here!
+ *
+ */
+extern "C" pkgArchiveStream* pkgAttachArchiveStream( int fd, const char* name )
+{
+  /* Decompression filter selection, based on magic patterns found
+   * within the leading content of the archive data stream, which has
+   * already been opened, as "fd"; we read a sample of its content, just
+   * once, allowing for the possibility that read() may return less than
+   * we request, without necessarily reaching end of file.
+   */
+  int residual, count = 0;
+  uint8_t sample[pkgArchiveSignature::SampleSize];
+  while( (count < (int)(sizeof( sample )))
+  &&    ((residual = read( fd, sample + count, sizeof( sample ) - count )) > 0) )
+    count += residual;
+
+  const pkgArchiveSignature *format;
+  if( (format = pkgArchiveSignature::Identify( sample, count )) == NULL )
+    /*
+     * The sample doesn't match any registered pattern; we can't
+     * process this archive.
+     */
+    dmh_notify( DMH_ERROR, "%s: unrecognised archive format\n", name );
+
+  else if( format->Factory() == NULL )
+    /*
+     * We recognise the format, but we have no decoder for it.
+     */
+    dmh_notify( DMH_ERROR, "%s: %s compressed archives are not supported\n",
+	name, format->FormatName()
+      );
 
-  /* If we get to here, then we didn't recognise any of the standard
-   * compression indicating file name extensions; fall through, to
-   * process the stream as raw (uncompressed) data.
+  else
+  { /* We identified the format, and we have a decoder; create the
+     * stream object, and hand back the sample data, so the decoder
+     * may begin with it, without any need to rewind the stream.
+     */
+    pkgArchiveStream *stream = format->Factory()( fd );
+    stream->PrimeInput( sample, count );
+    return stream;
+  }
+  /* If we get to here, we have already diagnosed the problem; we
+   * no longer need the file descriptor, and we return an unready raw
+   * stream, so that the caller's IsReady() check will decline to
+   * process it.
+   */
+  close( fd );
+  return new pkgRawArchiveStream( -1 );
+}
+
+extern "C" pkgArchiveStream* pkgOpenArchiveStream( const char* filename )
+{
+  /* Open the named archive file, and attach the appropriate archive
+   * stream to it...
+   */
+  int fd;
+  pkgArchiveStream *stream;
+  if( (stream = pkgOpenTranscodedArchive( filename )) != NULL )
+    /*
+     * ...unless the cache transcoder offers a faster alternative...
+     */
+    return stream;
+
+  if( (fd = open( filename, O_RDONLY | O_BINARY )) >= 0 )
+  {
+    /* ...then start reading ahead of the decoder, (if the user
+     * permits, and provided the format was identified).
+     */
+    stream = pkgAttachArchiveStream( fd, filename );
+    if( stream->IsReady() ) stream->EnableReadAhead( fd );
+    return stream;
+  }
+  /* If we couldn't open the archive file, then we return an unready
+   * raw stream, so that the caller's IsReady() check will decline to
+   * process it.
    */
-  return new pkgRawArchiveStream( filename );
+  return new pkgRawArchiveStream( -1 );
 }
 
 #endif /* PACKAGE_BASE_COMPONENT */
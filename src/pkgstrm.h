@@ -5,7 +5,7 @@
  * $Id$
  *
  * Written by Keith Marshall <keithmarshall@users.sourceforge.net>
- * Copyright (C) 2009, 2010, MinGW Project
+ * Copyright (C) 2009, 2010, 2026, MinGW Project
  *
  *
  * Declaration of the streaming API, for reading package archives.
@@ -28,6 +28,10 @@
 #define PKGSTRM_H  1
 
 #include <stdint.h>
+#include <stddef.h>
+
+class pkgReadAheadStage;
+class pkgArchiveDigest;
 
 class pkgArchiveStream
 {
@@ -35,13 +39,98 @@ class pkgArchiveStream
    * All archive streaming classes are be derived from this.
    */
   public:
-    pkgArchiveStream(){}
+    pkgArchiveStream(): primed_data( NULL ), primed_bytes( 0 ), readahead( NULL ),
+    digest( NULL ), view_data( NULL ), view_offset( 0 ), view_bytes( 0 ){}
     virtual bool IsReady() = 0;
-    virtual int Read( char*, size_t ) = 0;
-    virtual ~pkgArchiveStream(){}
+    virtual ~pkgArchiveStream();
+
+    /* Clients may retrieve decoded data without copying it, by asking
+     * the stream to lend them a view into its own output buffer; this
+     * returns the number of bytes which may be accessed via the pointer
+     * which is stored into the referenced location, (or zero, at end of
+     * stream, or a negative value on error).  The view remains valid
+     * until ReleaseView() is called, to mark the specified number of
+     * bytes as consumed; the next GetView() then returns any residue,
+     * or a view of the next block of decoded data.
+     */
+    virtual int GetView( const char** );
+    virtual void ReleaseView( size_t );
+
+    /* Alternatively, for compatibility with clients which require it,
+     * a conventional Read() method will copy decoded data, (obtained by
+     * way of the preceding view API), into a caller supplied buffer.
+     */
+    int Read( char*, size_t );
+
+    /* When the leading bytes of the raw data stream have already
+     * been consumed, (e.g. to identify the compression format), they
+     * may be handed back, to be returned by the first GetRawData()
+     * request(s), ahead of any further data read from the stream.
+     */
+    void PrimeInput( const uint8_t*, size_t );
+
+    /* Optionally, raw data may be read ahead of the decoder's demand,
+     * by a separate thread, and buffered for subsequent retrieval by
+     * GetRawData(); this must be enabled explicitly, (and may also be
+     * disabled again), with the number and size of the buffers being
+     * as specified by user preference.  While it is enabled, we count
+     * the number of occasions on which either the decoder has had to
+     * wait for data, or the reader has had to wait for a free buffer;
+     * (derived classes for which read-ahead is inappropriate may
+     * override EnableReadAhead(), to decline the request).
+     */
+    virtual void EnableReadAhead( int );
+    void DisableReadAhead();
+    unsigned long DecoderStalls();
+    unsigned long ReaderStalls();
+
+    /* Also optionally, a SHA-256 digest may be computed over the raw,
+     * (i.e. still compressed), content of the archive file, as it is
+     * consumed by the decoder, so that the archive may be verified
+     * without reading it a second time; this must be enabled before
+     * any data has been read.  When the client has read all the data
+     * it requires, DigestMatches() will consume any raw data which the
+     * decoder has left unread, (e.g. trailing padding), then compare
+     * the resultant digest with the expected value, as specified in
+     * hexadecimal notation; it returns false, if they differ, or if
+     * the digest was never enabled.
+     */
+    virtual void EnableDigest();
+    virtual bool DigestMatches( const char* );
 
   protected:
-    virtual int GetRawData( int, uint8_t*, size_t );
+    uint8_t *primed_data;
+    size_t primed_bytes, primed_offset;
+    pkgReadAheadStage *readahead;
+    friend class pkgReadAheadStage;
+
+    /* The digest accumulates the effect of all raw data which passes
+     * through GetRawData(); derived classes which retrieve raw data by
+     * other means must update it themselves, and must also override
+     * DrainRawData(), if the default implementation, which consumes
+     * residual data via GetRawData(), is not appropriate.
+     */
+    pkgArchiveDigest *digest;
+    virtual void DrainRawData();
+
+    /* Decoders obtain their raw input via GetRawData(); this returns
+     * any primed data first, then data from the read-ahead buffers, (if
+     * enabled), or directly from ReadRawData(); the latter represents
+     * the ultimate raw data source, which may be overridden to handle
+     * input streams other than regular files.
+     */
+    int GetRawData( int, uint8_t*, size_t );
+    virtual int ReadRawData( int, uint8_t*, size_t );
+
+    /* Each derived class must provide a Decode() method, to store up
+     * to the specified number of bytes of decoded data into the given
+     * buffer; the generic view API invokes it, to fill an output buffer
+     * which is allocated on demand, and owned by the stream object.
+     */
+    virtual int Decode( char*, size_t ) = 0;
+    static const size_t ViewBufferSize = 1 << 16;
+    char *view_data;
+    size_t view_offset, view_bytes;
 };
 
 #ifdef PKGSTRM_H_SPECIAL
@@ -52,11 +141,70 @@ class pkgArchiveStream
  * #include pkgstrm.h
  *
  */
+class pkgArchiveSignature
+{
+  /* A registry of magic patterns, which pkgOpenArchiveStream() uses
+   * to select an appropriate decompression filter, (or raw stream),
+   * according to the leading content of each archive file.  Each
+   * pkgArchiveStream specialisation which is to participate in this
+   * selection process must add itself to the registry, by declaring
+   * a static pkgArchiveSignature object; its constructor requires a
+   * descriptive format name, a predicate function which will return
+   * true, if the initial content of an archive, (of which at least
+   * the first 512 bytes, or as many as are available in the case
+   * of a shorter file), is recognised, and a factory function which
+   * will construct the stream object, given an open file descriptor.
+   */
+  public:
+    typedef bool pkgArchiveMatcher( const uint8_t*, size_t );
+    typedef pkgArchiveStream *pkgArchiveFactory( int );
+
+    pkgArchiveSignature( const char*, pkgArchiveMatcher*, pkgArchiveFactory* );
+    static const pkgArchiveSignature *Identify( const uint8_t*, size_t );
+
+    /* The factory reference may be NULL, to indicate a format which
+     * we recognise, but for which we have no decoder; a registry entry
+     * may also be disabled, (without removing it), by assigning NULL.
+     */
+    inline const char *FormatName()const{ return name; }
+    inline pkgArchiveFactory *Factory()const{ return factory; }
+    inline void SetFactory( pkgArchiveFactory *fn ){ factory = fn; }
+
+    /* The number of leading bytes, read from the archive, which are
+     * offered to each pattern matcher; (this is sufficient to capture
+     * the "ustar" magic signature within the first tar header).
+     */
+    static const size_t SampleSize = 512;
+
+  private:
+    /* The registry will be interrogated in the reverse of the order
+     * in which entries are registered, so any more generic, (or more
+     * speculative), pattern matchers should be registered first.
+     */
+    static pkgArchiveSignature *registry;
+    pkgArchiveSignature *next;
+
+    const char *name;
+    pkgArchiveMatcher *matches;
+    pkgArchiveFactory *factory;
+};
+
+template <class STREAM>
+pkgArchiveStream *pkgArchiveStreamFactory( int fd )
+{
+  /* A generic factory function template, suitable for registration
+   * with any pkgArchiveStream specialisation which provides a public
+   * constructor, accepting an open file descriptor as its argument.
+   */
+  return new STREAM( fd );
+}
+
 class pkgRawArchiveStream : public pkgArchiveStream
 {
   /* A regular (uncompressed) data stream...
    */
   protected:
+    virtual int Decode( char*, size_t );
     int fd;
 
   public:
@@ -65,7 +213,35 @@ class pkgRawArchiveStream : public pkgArchiveStream
     virtual ~pkgRawArchiveStream();
 
     inline bool IsReady(){ return fd != -1; }
-    virtual int Read( char*, size_t );
+};
+
+class pkgMappedArchiveStream : public pkgRawArchiveStream
+{
+  /* A regular (uncompressed) data stream, which is accessed by mapping
+   * successive windows of the underlying file into memory, and lending
+   * views directly into the mapped pages, rather than copying them; if
+   * the file cannot be mapped, it degrades to a regular raw stream.
+   */
+  protected:
+    void *mapping;
+    const char *window;
+    uint64_t file_size, window_base, window_end, position;
+    bool MapWindow();
+    void UnmapFile();
+    virtual void DrainRawData();
+
+  public:
+    pkgMappedArchiveStream( int );
+    virtual ~pkgMappedArchiveStream();
+
+    virtual int GetView( const char** );
+    virtual void ReleaseView( size_t );
+    virtual void EnableReadAhead( int );
+
+    /* The size of each mapped window; this must be a multiple of the
+     * system's allocation granularity, (which is normally 64 kB).
+     */
+    static const size_t WindowSize = 1 << 26;
 };
 
 /* Compressed data stream classes...
@@ -73,21 +249,25 @@ class pkgRawArchiveStream : public pkgArchiveStream
 #include <zlib.h>
 #include <bzlib.h>
 #include <lzma.h>
+#include <zstd.h>
 
 class pkgGzipArchiveStream : public pkgArchiveStream
 {
   /* A stream compressed using the "gzip" algorithm...
    */
   protected:
-    gzFile stream;
+    virtual int Decode( char*, size_t );
+    int fd;
+    z_stream stream;
+    uint8_t streambuf[BUFSIZ];
+    int status;
 
   public:
     pkgGzipArchiveStream( int );
     pkgGzipArchiveStream( const char* );
     virtual ~pkgGzipArchiveStream();
 
-    inline bool IsReady(){ return stream != NULL; }
-    virtual int Read( char*, size_t );
+    inline bool IsReady(){ return fd != -1; }
 };
 
 class pkgBzipArchiveStream : public pkgArchiveStream
@@ -95,16 +275,73 @@ class pkgBzipArchiveStream : public pkgArchiveStream
   /* A stream compressed using the "bzip2" algorithm...
    */
   protected:
-    BZFILE *stream;
-    int bzerror;
+    virtual int Decode( char*, size_t );
+    int fd;
+    bz_stream stream;
+    char streambuf[BUFSIZ];
+    int status;
 
   public:
     pkgBzipArchiveStream( int );
     pkgBzipArchiveStream( const char* );
     virtual ~pkgBzipArchiveStream();
 
-    inline bool IsReady(){ return stream != NULL; }
-    virtual int Read( char*, size_t );
+    inline bool IsReady(){ return fd != -1; }
+};
+
+class pkgWorkerPool;
+class pkgBzipBlockDecoder;
+
+class pkgBzipParallelArchiveStream : public pkgArchiveStream
+{
+  /* A stream compressed using the "bzip2" algorithm, for which the
+   * individual compressed blocks are located by scanning for their
+   * (bit aligned) magic signatures, and then decoded concurrently,
+   * by a pool of worker threads...
+   */
+  protected:
+    virtual int Decode( char*, size_t );
+    int fd;
+    pkgWorkerPool *pool;
+    unsigned max_pending, pending_count;
+    pkgBzipBlockDecoder *pending, *last_pending;
+
+    /* ...with the raw input data being accumulated in a buffer, from
+     * which the scanner extracts each block, as it is identified...
+     */
+    uint8_t *inbuf;
+    size_t inbuf_size, inbuf_len;
+    uint64_t inbuf_base, bitpos, window, block_start;
+    bool truncated;
+
+    /* ...and, should this process fail, (e.g. because a magic pattern
+     * is matched by chance, within compressed data), we revert to the
+     * serial decoder, skipping data which has already been delivered.
+     */
+    uint64_t delivered;
+    pkgBzipArchiveStream *serial;
+
+    bool ScanNextBlock();
+    bool FillBuffer();
+    bool RevertToSerialDecoder();
+
+  public:
+    pkgBzipParallelArchiveStream( int, unsigned );
+    virtual ~pkgBzipParallelArchiveStream();
+
+    inline bool IsReady(){ return fd != -1; }
+
+    /* Decoded blocks are already held in their own buffers, so we may
+     * lend views of them directly, rather than copying them.
+     */
+    virtual int GetView( const char** );
+    virtual void ReleaseView( size_t );
+
+    /* After reverting to the serial decoder, the digest must also be
+     * computed afresh, by that decoder; we must then defer to it, to
+     * check the result.
+     */
+    virtual bool DigestMatches( const char* );
 };
 
 class pkgLzmaArchiveStream : public pkgArchiveStream
@@ -112,6 +349,7 @@ class pkgLzmaArchiveStream : public pkgArchiveStream
   /* A stream compressed using the "lzma" algorithm...
    */
   protected:
+    virtual int Decode( char*, size_t );
     int fd;
     lzma_stream stream;
     uint8_t streambuf[BUFSIZ];
@@ -123,7 +361,6 @@ class pkgLzmaArchiveStream : public pkgArchiveStream
     virtual ~pkgLzmaArchiveStream();
 
     inline bool IsReady(){ return fd != -1; }
-    virtual int Read( char*, size_t );
 };
 
 class pkgXzArchiveStream : public pkgArchiveStream
@@ -131,6 +368,7 @@ class pkgXzArchiveStream : public pkgArchiveStream
   /* A stream compressed using the "xz" algorithm...
    */
   protected:
+    virtual int Decode( char*, size_t );
     int fd;
     lzma_stream stream;
     uint8_t streambuf[BUFSIZ];
@@ -143,7 +381,31 @@ class pkgXzArchiveStream : public pkgArchiveStream
     virtual ~pkgXzArchiveStream();
 
     inline bool IsReady(){ return fd != -1; }
-    virtual int Read( char*, size_t );
+};
+
+class pkgZstdArchiveStream : public pkgArchiveStream
+{
+  /* A stream compressed using the "zstd" algorithm...
+   */
+  protected:
+    virtual int Decode( char*, size_t );
+    int fd;
+    ZSTD_DStream *stream;
+    ZSTD_inBuffer input;
+    uint8_t *streambuf;
+    size_t streambuf_size;
+    size_t hint;
+    int status;
+
+  public:
+    pkgZstdArchiveStream( int );
+    pkgZstdArchiveStream( const char* );
+    virtual ~pkgZstdArchiveStream();
+
+    inline bool IsReady(){ return (fd != -1) && (stream != NULL); }
+
+  private:
+    void InitialiseDecoder();
 };
 
 #endif /* PKGSTRM_H_SPECIAL */
@@ -153,4 +415,19 @@ class pkgXzArchiveStream : public pkgArchiveStream
  */
 extern "C" pkgArchiveStream *pkgOpenArchiveStream( const char* );
 
+/* ...or, to attach such a stream to a data source which has already
+ * been opened, (e.g. a pipe), given its file descriptor, and a name by
+ * which to identify it in diagnostic messages; (note that, unlike the
+ * preceding function, this does not enable read-ahead).
+ */
+extern "C" pkgArchiveStream *pkgAttachArchiveStream( int, const char* );
+
+/* Functions providing access to transcoded copies of cached archives,
+ * (when the user has enabled the cache transcoder); the first returns
+ * NULL, if no such copy is available, and the second reports the time
+ * saved, by using such copies.
+ */
+extern "C" pkgArchiveStream *pkgOpenTranscodedArchive( const char* );
+extern "C" void pkgTranscodedArchiveReport( void );
+
 #endif /* PKGSTRM_H: $RCSfile$: end of file */
@@ -5,7 +5,7 @@
  * $Id$
  *
  * Written by Keith Marshall <keithmarshall@users.sourceforge.net>
- * Copyright (C) 2009, 2010, 2011, 2012, MinGW Project
+ * Copyright (C) 2009, 2010, 2011, 2012, 2026, MinGW Project
  *
  *
  * This header provides manifest definitions for the action codes,
@@ -43,6 +43,8 @@ enum
   action_licence,
   action_source,
 
+  action_verify,
+
   end_of_actions
 };
 
@@ -57,6 +59,7 @@ enum
 #define ACTION_UPDATE   	(unsigned long)(action_update)
 #define ACTION_LICENCE  	(unsigned long)(action_licence)
 #define ACTION_SOURCE   	(unsigned long)(action_source)
+#define ACTION_VERIFY   	(unsigned long)(action_verify)
 
 #define STRICTLY_GT		(ACTION_MASK + 1)
 #define STRICTLY_LT		(STRICTLY_GT << 1)
@@ -89,6 +92,27 @@ enum
 #define ACTION_INSTALL_FAILED	(ACTION_PRIMARY << 6)
 #define ACTION_REMOVE_FAILED	(ACTION_PRIMARY << 7)
 
+/* Flag set by pkgActionItem::Execute(), to indicate that the archive
+ * for a package which is to be installed should not be downloaded in
+ * advance, but rather, streamed directly into the installer.
+ */
+#define ACTION_STREAM		(ACTION_PRIMARY << 8)
+
+/* Flag set by pkgActionItem::Execute(), to indicate that a package
+ * which is to be upgraded, or reinstalled, should be updated in place;
+ * files of the prior installation are then deleted only after the
+ * replacement has been installed, and only if it has not reinstated
+ * them, while those which are unchanged are not rewritten.
+ */
+#define ACTION_IN_PLACE 	(ACTION_PRIMARY << 9)
+
+/* Flag set by pkgActionItem::Execute(), together with ACTION_IN_PLACE,
+ * when durable installation is in effect; removal of the prior package
+ * then merely records what is to be removed, while its deregistration
+ * is deferred until its replacement has been successfully installed.
+ */
+#define ACTION_DURABLE  	(ACTION_PRIMARY << 10)
+
 #define ACTION_APPLY_FAILED	(ACTION_INSTALL_FAILED | ACTION_REMOVE_FAILED)
 #define ACTION_UNSUCCESSFUL	(ACTION_DOWNLOAD_FAILED | ACTION_APPLY_FAILED)
 
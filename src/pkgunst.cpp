@@ -4,7 +4,7 @@
  * $Id$
  *
  * Written by Keith Marshall <keithmarshall@users.sourceforge.net>
- * Copyright (C) 2011-2013, MinGW.org Project
+ * Copyright (C) 2011-2013, 2026, MinGW.org Project
  *
  *
  * Implementation of the primary package removal methods.
@@ -259,7 +259,11 @@ int pkg_rmdir( const char *sysroot, const char *pathname )
 	dmh_printf( "  %s: rmdir\n", fullpath )
       );
 
-    retval = rmdir( fullpath ) == 0;
+    /* Any directory which we do remove must also be forgotten, by
+     * the cache of directories which are known to exist.
+     */
+    if( (retval = rmdir( fullpath ) == 0) )
+      mkdir_cache_flush();
   }
   return retval;
 }
@@ -293,18 +297,165 @@ int pkg_unlink( const char *sysroot, const char *pathname )
       );
 
     chmod( filepath, S_IWRITE );
-    if( ((retval = unlink( filepath )) != 0) && (errno != ENOENT) )
+    if( ((retval = unlink( filepath )) != 0) && (errno == EACCES) )
+    {
+      /* A symbolic link to a directory, (as may be installed from a
+       * tar archive), is recorded as a file, but Windows will remove
+       * it only as if it were itself a directory.
+       */
+      struct stat info;
+      if( (stat( filepath, &info ) == 0) && S_ISDIR( info.st_mode ) )
+	retval = rmdir( filepath );
+      else
+	errno = EACCES;
+    }
+    if( (retval != 0) && (errno != ENOENT) )
       dmh_notify( DMH_WARNING, "%s:unlink failed; %s\n", filepath, strerror( errno ) );
   }
   return retval;
 }
 
+void pkgManifest::RemoveInstalledEntities( const char *syspath )
+{
+  /* Method to undo an installation which has been abandoned, after
+   * its content has been written into the sysroot, (e.g. because the
+   * archive proved not to match its published digest); we delete every
+   * file which the manifest records, then prune any of its recorded
+   * directories which are thus left empty, (iterating, as pkgRemove()
+   * does, until no more can be removed).  The "syspath" is the template
+   * which the installer used to construct the absolute path name for
+   * each of the recorded entities.
+   */
+  if( inventory != NULL )
+  {
+    pkgXmlNode *files = inventory->FindFirstAssociate( filename_key );
+    while( files != NULL )
+    {
+      pkg_unlink( syspath, pathname_lookup( files, NULL ) );
+      files = files->FindNextAssociate( filename_key );
+    }
+    bool restart;
+    do { pkgXmlNode *dir = inventory->FindFirstAssociate( dirname_key );
+	 restart = false;
+	 while( dir != NULL )
+	 {
+	   restart |= pkg_rmdir( syspath, pathname_lookup( dir, NULL ) );
+	   dir = dir->FindNextAssociate( dirname_key );
+	 }
+       } while( restart );
+  }
+}
+
+/* When a package is to be updated in place, the files and directories
+ * of its prior installation are not removed by pkgRemove(); rather, we
+ * retain a record of their path names, so that pkgRemoveRetainedFiles()
+ * may remove those which the replacement does not reinstate.  Packages
+ * are processed sequentially, so we need retain no more than one such
+ * record at any time.  When installing durably, we similarly retain the
+ * identity of the prior installation, so that it may be deregistered
+ * only when its replacement has been successfully installed.
+ */
+static struct
+{
+  char *syspath;
+  char **pathname;
+  unsigned files, count, limit;
+  pkgXmlNode *pkg, *sysroot;
+  char *tarname, *sysname;
+} retained = { NULL, NULL, 0, 0, 0, NULL, NULL, NULL, NULL };
+
+static void discard_retained_entries( void )
+{
+  /* Helper to release the record of retained path names.
+   */
+  while( retained.count > 0 )
+    free( retained.pathname[--retained.count] );
+  free( retained.pathname );
+  free( retained.syspath );
+  free( retained.tarname );
+  free( retained.sysname );
+  retained.syspath = retained.tarname = retained.sysname = NULL;
+  retained.pathname = NULL;
+  retained.files = retained.limit = 0;
+  retained.pkg = retained.sysroot = NULL;
+}
+
+static void retain_entries( pkgXmlNode *manifest, const char *key )
+{
+  /* Helper to append the path names of all manifest entries which
+   * match "key", (i.e. files, or directories), to the record of those
+   * which have been retained.
+   */
+  while( manifest != NULL )
+  {
+    pkgXmlNode *ref = manifest->FindFirstAssociate( key );
+    while( ref != NULL )
+    {
+      const char *pathname = pathname_lookup( ref, NULL );
+      if( (pathname != NULL) && (retained.count == retained.limit) )
+      {
+	char **grow = (char **)(realloc( retained.pathname,
+	      (retained.limit + 256) * sizeof( char * )
+	    ));
+	if( grow != NULL )
+	{
+	  retained.pathname = grow;
+	  retained.limit += 256;
+	}
+      }
+      if( (pathname != NULL) && (retained.count < retained.limit)
+      &&  ((retained.pathname[retained.count] = strdup( pathname )) != NULL)  )
+	++retained.count;
+
+      ref = ref->FindNextAssociate( key );
+    }
+    manifest = manifest->FindNextAssociate( manifest_key );
+  }
+}
+
+static void expunge_installation_record( pkgXmlNode *sysroot, const char *tarname )
+{
+  /* Helper to expunge the installation record for the package identified
+   * by "tarname", from the associated sysroot element within the system
+   * map; (that is, any record of type "installed" contained within the
+   * sysroot element, with a tarname attribute which matches "tarname").
+   */
+  pkgXmlNode *expunge, *instrec = sysroot->FindFirstAssociate( installed_key );
+  while( (expunge = instrec) != NULL )
+  {
+    /* Consider each installation record in turn, as a possible candidate for
+     * deletion; in any case, always locate the NEXT candidate, BEFORE deleting
+     * a matched record, so we don't destroy our point of reference, whence we
+     * must continue the search.
+     */
+    instrec = instrec->FindNextAssociate( installed_key );
+    if( strcmp( tarname, expunge->GetPropVal( tarname_key, value_unknown )) == 0 )
+    {
+      /* The CURRENT candidate matches the "tarname" criterion for deletion;
+       * we may delete it, also marking the sysroot record as "modified", so
+       * that the change will be committed to disk.
+       */
+      sysroot->DeleteChild( expunge );
+      sysroot->SetAttribute( modified_key, value_yes );
+    }
+  }
+}
+
+static int compare_pathnames( const void *a, const void *b )
+{
+  /* Helper for sorting, and searching, a table of path names; (file
+   * names are not case sensitive, on Windows).
+   */
+  return strcasecmp( *(const char **)(a), *(const char **)(b) );
+}
+
 EXTERN_C void pkgRemove( pkgActionItem *current )
 {
   /* Common handler for all package removal tasks; note that we
    * initially assert failure, pending reversion on success...
    */
   pkgXmlNode *pkg;
+  bool deferred = false;
   current->Assert( ACTION_REMOVE_FAILED );
   if( ((pkg = current->Selection( to_remove )) != NULL)
   &&  (current->HasAttribute( ACTION_DOWNLOAD_OK ) == ACTION_REMOVE_OK)  )
@@ -430,9 +581,39 @@ EXTERN_C void pkgRemove( pkgActionItem *current )
 	  const char *refpath = pathname_lookup( sysroot, value_unknown );
 	  char syspath[4 + strlen( refpath )]; sprintf( syspath, "%s%%/F", refpath );
 
-	  /* Read the package manifest...
+	  /* When the package is to be updated in place, we simply retain
+	   * the path names of its files and directories, for processing
+	   * by pkgRemoveRetainedFiles(), after its replacement has been
+	   * installed.
+	   */
+	  bool retain = (current->HasAttribute( ACTION_IN_PLACE ) != 0);
+	  if( retain )
+	  {
+	    discard_retained_entries();
+	    retained.syspath = strdup( syspath );
+	    retain_entries( manifest, filename_key );
+	    retained.files = retained.count;
+	    qsort( retained.pathname, retained.files, sizeof( char * ), compare_pathnames );
+	    retain_entries( manifest, dirname_key );
+
+	    /* When installing durably, we also retain the identity of
+	     * the package, deferring its deregistration until after its
+	     * replacement has been successfully installed; until then,
+	     * its installation records must remain intact.
+	     */
+	    if( (current->HasAttribute( ACTION_DURABLE ) != 0) && (sysname != NULL)
+	    &&  ((retained.tarname = strdup( tarname )) != NULL)
+	    &&  ((retained.sysname = strdup( sysname )) != NULL)  )
+	    {
+	      retained.pkg = pkg;
+	      retained.sysroot = sysroot;
+	      deferred = true;
+	    }
+	  }
+
+	  /* Otherwise, read the package manifest...
 	   */
-	  ref = manifest;
+	  ref = retain ? NULL : manifest;
 	  while( ref != NULL )
 	  {
 	    /* ...selecting records identifying installed files...
@@ -477,7 +658,7 @@ EXTERN_C void pkgRemove( pkgActionItem *current )
 	       /* Process the entire manifest on each iteration;
 		* initially assume that no restart will be required.
 		*/
-	       ref = manifest; restart = false;
+	       ref = retain ? NULL : manifest; restart = false;
 	       while( ref != NULL )
 	       {
 		 /* Select manifest records which specify directories...
@@ -505,47 +686,32 @@ EXTERN_C void pkgRemove( pkgActionItem *current )
 		*/
 	     } while( restart );
 
-	  /* Finally, disassociate the package manifest from the active sysroot;
-	   * this will automatically delete the manifest itself, unless it has a
-	   * further association with any other sysroot, (e.g. in an alternative
-	   * system map).
+	  /* Finally, (unless deferred), disassociate the package manifest from
+	   * the active sysroot; this will automatically delete the manifest itself,
+	   * unless it has a further association with any other sysroot, (e.g. in
+	   * an alternative system map).
 	   */
-	  inventory.DetachSysRoot( sysname );
+	  if( ! deferred )
+	    inventory.DetachSysRoot( sysname );
 	}
       }
     }
     /* In the case of both real and virtual packages, the final phase of removal
      * is to expunge the installation record from the associated sysroot element
-     * within the system map; (that is, any record of type "installed" contained
-     * within the sysroot element referenced by the "sysroot" pointer identified
-     * above, with a tarname attribute which matches "tarname").
+     * within the system map, (again, unless deferred)...
      */
-    pkgXmlNode *expunge, *instrec = sysroot->FindFirstAssociate( installed_key );
-    while( (expunge = instrec) != NULL )
+    if( ! deferred )
     {
-      /* Consider each installation record in turn, as a possible candidate for
-       * deletion; in any case, always locate the NEXT candidate, BEFORE deleting
-       * a matched record, so we don't destroy our point of reference, whence we
-       * must continue the search.
+      expunge_installation_record( sysroot, tarname );
+
+      /* ...and to update the internal record of installed state; although
+       * no running CLI instance will return to any point where it needs
+       * this, we may have been called from the GUI, and it requires
+       * consistency here, if the user revisits this package within
+       * any single active session.
        */
-      instrec = instrec->FindNextAssociate( installed_key );
-      if( strcmp( tarname, expunge->GetPropVal( tarname_key, value_unknown )) == 0 )
-      {
-	/* The CURRENT candidate matches the "tarname" criterion for deletion;
-	 * we may delete it, also marking the sysroot record as "modified", so
-	 * that the change will be committed to disk.
-	 */
-	sysroot->DeleteChild( expunge );
-	sysroot->SetAttribute( modified_key, value_yes );
-      }
+      pkg->SetAttribute( installed_key, value_no );
     }
-    /* Update the internal record of installed state; although no
-     * running CLI instance will return to any point where it needs
-     * this, we may have been called from the GUI, and it requires
-     * consistency here, if the user revisits this package within
-     * any single active session.
-     */
-    pkg->SetAttribute( installed_key, value_no );
 
     /* After package removal has been completed, we invoke any
      * post-remove script which may be associated with the package.
@@ -566,4 +732,123 @@ EXTERN_C void pkgRemove( pkgActionItem *current )
   }
 }
 
+EXTERN_C bool pkgIsRetainedFile( const char *pathname )
+{
+  /* Identify any file which belongs to the prior installation of the
+   * package which is currently being updated in place; the table of
+   * retained file names is sorted, so we may simply search it.
+   */
+  return (retained.files > 0) && (bsearch( &pathname, retained.pathname,
+	retained.files, sizeof( char * ), compare_pathnames ) != NULL
+      );
+}
+
+EXTERN_C void pkgRemoveRetainedFiles( pkgActionItem *current )
+{
+  /* Complete an in-place update, by removing those files, of the prior
+   * installation, which have not been reinstated by the replacement, as
+   * recorded in its installation manifest, (if any; in the event that
+   * the installation failed, every retained file is removed), then
+   * pruning any directories which have thereby become empty.
+   */
+  pkgXmlNode *pkg;
+  if( (retained.tarname != NULL) && current->HasAttribute( ACTION_INSTALL_FAILED ) )
+  {
+    /* When installing durably, however, a failed installation has left
+     * the prior installation intact, and we have not yet deregistered it;
+     * it must remain installed, so we simply abandon its removal.
+     */
+    dmh_notify( DMH_WARNING, "%s is still installed\n", retained.tarname );
+  }
+  else if( (retained.syspath != NULL) && ((pkg = current->Selection()) != NULL) )
+  {
+    /* Collect the path names of all files installed by the replacement,
+     * in a sorted table, so that we may efficiently check each retained
+     * path name against it.
+     */
+    const char *tarname = pkg->GetPropVal( tarname_key, NULL );
+    pkgManifest inventory( package_key, tarname );
+    pkgXmlNode *ref, *manifest = inventory.GetRoot();
+    if( manifest != NULL )
+      manifest = manifest->FindFirstAssociate( manifest_key );
+
+    unsigned count = 0;
+    for( ref = manifest; ref != NULL; ref = ref->FindNextAssociate( manifest_key ) )
+      for( pkgXmlNode *file = ref->FindFirstAssociate( filename_key );
+	  file != NULL; file = file->FindNextAssociate( filename_key )  )
+	++count;
+
+    /* The table may be large, (since a package may install many
+     * thousands of files), so we allocate it on the heap, rather than
+     * on the stack...
+     */
+    const char **installed = (const char **)(malloc(
+	  (count + 1) * sizeof( const char * )
+	));
+    unsigned index, reinstated = 0;
+    if( installed == NULL )
+      /*
+       * ...and, if that fails, we cannot identify which retained files
+       * have been reinstated; we must then leave all of them in place,
+       * (which is untidy, but harmless), rather than risk removing any
+       * which the replacement requires.
+       */
+      dmh_notify( DMH_WARNING, "%s: cannot identify obsolete files; "
+	  "none have been removed\n", (tarname != NULL) ? tarname : "update"
+	);
+
+    else
+    { count = 0;
+      for( ref = manifest; ref != NULL; ref = ref->FindNextAssociate( manifest_key ) )
+	for( pkgXmlNode *file = ref->FindFirstAssociate( filename_key );
+	    file != NULL; file = file->FindNextAssociate( filename_key )  )
+	  if( (installed[count] = pathname_lookup( file, NULL )) != NULL )
+	    ++count;
+      qsort( installed, count, sizeof( const char * ), compare_pathnames );
+
+      /* Remove each retained file which has not been reinstated.
+       */
+      for( index = 0; index < retained.files; index++ )
+	if( bsearch( retained.pathname + index, installed, count,
+	      sizeof( const char * ), compare_pathnames ) == NULL  )
+	  pkg_unlink( retained.syspath, retained.pathname[index] );
+	else
+	  ++reinstated;
+      free( installed );
+    }
+
+    DEBUG_INVOKE_IF( DEBUG_REQUEST( DEBUG_TRACE_TRANSACTIONS ),
+	dmh_printf( "  in-place update: %u of %u files reinstated\n",
+	    reinstated, retained.files
+	  )
+      );
+
+    /* Prune any retained directories which have become empty,
+     * iterating as pkgRemove() does, since removal of any leaf directory
+     * may expose its parent as a new leaf.
+     */
+    bool restart;
+    do { restart = false;
+	 for( index = retained.files; index < retained.count; index++ )
+	   restart |= pkg_rmdir( retained.syspath, retained.pathname[index] );
+       } while( restart );
+
+    /* When installing durably, we may now complete the deregistration
+     * of the prior installation, which pkgRemove() deferred; (but not on
+     * reinstallation, when its records now represent its replacement).
+     */
+    if( (retained.tarname != NULL)
+    &&  ((tarname == NULL) || (strcmp( tarname, retained.tarname ) != 0))  )
+    {
+      pkgManifest prior( package_key, retained.tarname );
+      prior.DetachSysRoot( retained.sysname );
+      expunge_installation_record( retained.sysroot, retained.tarname );
+      retained.pkg->SetAttribute( installed_key, value_no );
+    }
+  }
+  /* In any case, the retained path names are no longer required.
+   */
+  discard_retained_entries();
+}
+
 /* $RCSfile$: end of file */
@@ -0,0 +1,539 @@
+/*
+ * pkgvrfy.cpp
+ *
+ * $Id$
+ *
+ * Copyright (C) 2026, MinGW.org Project
+ *
+ *
+ * Implementation of the "verify" action; this checks the files which
+ * have been installed within each sysroot, against the manifests of
+ * the packages which installed them, reporting any which are missing,
+ * or have been modified since installation, together with any files
+ * within the package directories, which no package claims to own.
+ *
+ *
+ * This is free software.  Permission is granted to copy, modify and
+ * redistribute this software, under the provisions of the GNU General
+ * Public License, Version 3, (or, at your option, any later version),
+ * as published by the Free Software Foundation; see the file COPYING
+ * for licensing details.
+ *
+ * Note, in particular, that this software is provided "as is", in the
+ * hope that it may prove useful, but WITHOUT WARRANTY OF ANY KIND; not
+ * even an implied WARRANTY OF MERCHANTABILITY, nor of FITNESS FOR ANY
+ * PARTICULAR PURPOSE.  Under no circumstances will the author, or the
+ * MinGW Project, accept liability for any damages, however caused,
+ * arising from the use of this software.
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include "dmh.h"
+#include "mkpath.h"
+
+#include "pkgbase.h"
+#include "pkgkeys.h"
+#include "pkgproc.h"
+#include "pkgopts.h"
+#include "pkgstat.h"
+#include "pkgpool.h"
+#include "xxh64.h"
+
+#include <io.h>
+
+/* The possible outcomes of checking any one installed file.
+ */
+enum
+{
+  VERIFY_PENDING = 0,
+  VERIFY_OK,
+  VERIFY_MISSING,
+  VERIFY_MODIFIED,
+  VERIFY_UNREADABLE
+};
+
+struct verify_entry
+{
+  /* Record of one file, as listed in a package manifest, together
+   * with the outcome of checking it; "pathname" is the absolute path
+   * name of the file, while "relpath" refers to the sysroot relative
+   * part of it, (as recorded in the manifest, but without any leading
+   * "./" qualification).  The size, and the content hash, are known
+   * only when the manifest records them.
+   */
+  char *pathname;
+  const char *relpath;
+  const char *tarname;
+  char *digest;
+  uint64_t size;
+  bool has_size;
+  int status;
+};
+
+/* Files are checked in batches; each batch is a single unit of work,
+ * for the pool of worker threads.  Successive batches cover successive
+ * ranges of the table of files, which is sorted by path name, so that
+ * the disk is read in an orderly sequence, even when several threads
+ * are active.
+ */
+#define VERIFY_BATCH_SIZE	64
+#define VERIFY_BUFFER_SIZE	(256 << 10)
+
+static __inline__ __attribute__((__always_inline__))
+const char *canonical_relpath( const char *pathname )
+{
+  /* Helper to discard any leading "./" qualification from a sysroot
+   * relative path name, (as an archive may record it); the sysroot
+   * directory itself, (i.e. "."), is represented as an empty string.
+   */
+  while( (pathname[0] == '.') && (pathname[1] == '/') )
+    while( *++pathname == '/' )
+      ;
+  return ((pathname[0] == '.') && (pathname[1] == '\0')) ? "" : pathname;
+}
+
+static int compare_entries( const void *a, const void *b )
+{
+  /* Helper for sorting, and searching, the table of files; (file
+   * names are not case sensitive, on Windows).
+   */
+  return strcasecmp( ((const verify_entry *)(a))->relpath,
+      ((const verify_entry *)(b))->relpath
+    );
+}
+
+static int compare_pathnames( const void *a, const void *b )
+{
+  /* Helper for sorting the table of directory names.
+   */
+  return strcasecmp( *(const char **)(a), *(const char **)(b) );
+}
+
+static int verify_file( verify_entry *entry, char **buf )
+{
+  /* Check one installed file; this runs on a worker thread, and must
+   * not use any global state.  Every file must exist, but we can check
+   * its size, or its content, only when the manifest records them; (a
+   * link may also be recorded as a file, but without either).
+   */
+  struct stat info;
+  if( stat( entry->pathname, &info ) != 0 )
+    return VERIFY_MISSING;
+
+  if( ! entry->has_size )
+    return VERIFY_OK;
+
+  if( ! S_ISREG( info.st_mode ) || ((uint64_t)(info.st_size) != entry->size) )
+    return VERIFY_MODIFIED;
+
+  if( entry->digest == NULL )
+    return VERIFY_OK;
+
+  /* The size matches; we must read the file, to compare its content
+   * hash with that recorded when it was installed.
+   */
+  int fd;
+  if( ((*buf == NULL) && ((*buf = (char *)(malloc( VERIFY_BUFFER_SIZE ))) == NULL))
+  ||  ((fd = open( entry->pathname, O_RDONLY | O_BINARY )) < 0)  )
+    return VERIFY_UNREADABLE;
+
+  int count;
+  uint64_t total = 0;
+  xxh64_context content;
+  xxh64_init( &content, 0 );
+  while( (count = read( fd, *buf, VERIFY_BUFFER_SIZE )) > 0 )
+  {
+    xxh64_update( &content, *buf, count );
+    total += count;
+  }
+  close( fd );
+  if( count < 0 )
+    return VERIFY_UNREADABLE;
+
+  char digest[XXH64_HEXDIGEST_SIZE];
+  return ((total == entry->size)
+      && (strcasecmp( xxh64_hexdigest( &content, digest ), entry->digest ) == 0)
+    ) ? VERIFY_OK : VERIFY_MODIFIED;
+}
+
+/*******************
+ *
+ * Class Implementation: pkgVerifyTask
+ *
+ */
+class pkgVerifyTask : public pkgWorkerTask
+{
+  /* A locally implemented class, representing one batch of files to
+   * be checked by a worker thread; the outcome for each is recorded
+   * in its table entry, to be reported on the main thread.
+   */
+  public:
+    pkgVerifyTask( verify_entry *first, unsigned n ): entry( first ), count( n ){}
+    virtual void Execute();
+
+  private:
+    verify_entry *entry;
+    unsigned count;
+};
+
+void pkgVerifyTask::Execute()
+{
+  /* Check each file in the batch, in turn, sharing a single buffer
+   * for reading the content of any which must be hashed.
+   */
+  char *buf = NULL;
+  for( unsigned i = 0; i < count; i++ )
+    entry[i].status = verify_file( entry + i, &buf );
+  free( buf );
+}
+
+/*******************
+ *
+ * Class Implementation: pkgSysRootVerifier
+ *
+ */
+class pkgSysRootVerifier
+{
+  /* A locally implemented class, which collects the file and directory
+   * entries from the manifests of all packages installed in one sysroot,
+   * then checks them, and reports its findings.
+   */
+  public:
+    pkgSysRootVerifier( const char* );
+    ~pkgSysRootVerifier();
+
+    unsigned long CollectManifest( const char*, const char* );
+    unsigned long Check( pkgWorkerPool* );
+
+  private:
+    const char *syspath;
+    size_t syspath_len;
+    unsigned long checked, missing, modified, unowned;
+
+    verify_entry *file;
+    unsigned files, file_limit;
+    char **dir;
+    unsigned dirs, dir_limit;
+
+    void AddFile( pkgXmlNode*, const char* );
+    void AddDirectory( const char* );
+    void Retire( pkgVerifyTask*, unsigned );
+    void Report( verify_entry* );
+    void FindUnownedFiles();
+};
+
+pkgSysRootVerifier::
+pkgSysRootVerifier( const char *refpath ):
+checked( 0 ), missing( 0 ), modified( 0 ), unowned( 0 ),
+file( NULL ), files( 0 ), file_limit( 0 ), dir( NULL ), dirs( 0 ), dir_limit( 0 )
+{
+  /* Constructor: the sysroot path name may include macros, (notably
+   * "%R"), so we expand it once, to form the prefix for all absolute
+   * path names within the sysroot.
+   */
+  char *path = (char *)(malloc( mkpath( NULL, refpath, NULL, NULL ) ));
+  mkpath( path, refpath, NULL, NULL );
+  syspath_len = strlen( syspath = path );
+}
+
+pkgSysRootVerifier::~pkgSysRootVerifier()
+{
+  /* Destructor must release all memory allocated to the tables of
+   * files and directories.
+   */
+  while( files > 0 )
+  {
+    free( file[--files].pathname );
+    free( file[files].digest );
+  }
+  while( dirs > 0 )
+    free( dir[--dirs] );
+  free( file );
+  free( dir );
+  free( (void *)(syspath) );
+}
+
+void pkgSysRootVerifier::AddFile( pkgXmlNode *ref, const char *tarname )
+{
+  /* Append one manifest "file" entry to the table of files which are
+   * to be checked.
+   */
+  const char *relpath = ref->GetPropVal( pathname_key, NULL );
+  if( relpath == NULL )
+    return;
+
+  if( files == file_limit )
+  {
+    verify_entry *grow = (verify_entry *)(realloc( file,
+	  (file_limit + 1024) * sizeof( verify_entry )
+	));
+    if( grow == NULL )
+      return;
+    file = grow;
+    file_limit += 1024;
+  }
+  relpath = canonical_relpath( relpath );
+  verify_entry *entry = file + files;
+  if( (entry->pathname = (char *)(malloc( syspath_len + strlen( relpath ) + 2 ))) != NULL )
+  {
+    sprintf( entry->pathname, "%s/%s", syspath, relpath );
+    entry->relpath = entry->pathname + syspath_len + 1;
+    entry->tarname = tarname;
+
+    const char *value;
+    if( (entry->has_size = ((value = ref->GetPropVal( size_key, NULL )) != NULL)) )
+      entry->size = strtoull( value, NULL, 10 );
+    entry->digest = ((value = ref->GetPropVal( xxh64_key, NULL )) != NULL)
+      ? strdup( value ) : NULL;
+    entry->status = VERIFY_PENDING;
+    ++files;
+  }
+}
+
+void pkgSysRootVerifier::AddDirectory( const char *relpath )
+{
+  /* Append one manifest "dir" entry to the table of directories,
+   * which are to be searched for files which no package owns.
+   */
+  if( dirs == dir_limit )
+  {
+    char **grow = (char **)(realloc( dir, (dir_limit + 256) * sizeof( char * ) ));
+    if( grow == NULL )
+      return;
+    dir = grow;
+    dir_limit += 256;
+  }
+  if( (dir[dirs] = strdup( canonical_relpath( relpath ) )) != NULL )
+    ++dirs;
+}
+
+unsigned long pkgSysRootVerifier::
+CollectManifest( const char *sysname, const char *tarname )
+{
+  /* Collect the file and directory entries from the manifest of one
+   * installed package; returns one, if the manifest is missing, (or
+   * it does not refer to the sysroot), or zero otherwise.  Note that
+   * the manifest is consulted only; it must not be rewritten.
+   */
+  pkgManifest inventory( package_key, tarname );
+  inventory.SetReadOnly();
+  if( inventory.GetSysRootReference( sysname ) == NULL )
+  {
+    dmh_notify( DMH_WARNING, "%s: no installation manifest for sysroot %s\n",
+	tarname, sysname
+      );
+    return 1;
+  }
+
+  pkgXmlNode *manifest = inventory.GetRoot()->FindFirstAssociate( manifest_key );
+  while( manifest != NULL )
+  {
+    /* As pkgRemove() does, we allow for the possibility that the
+     * manifest may be subdivided into multiple sections.
+     */
+    pkgXmlNode *ref = manifest->FindFirstAssociate( filename_key );
+    while( ref != NULL )
+    {
+      AddFile( ref, tarname );
+      ref = ref->FindNextAssociate( filename_key );
+    }
+    ref = manifest->FindFirstAssociate( dirname_key );
+    while( ref != NULL )
+    {
+      const char *relpath = ref->GetPropVal( pathname_key, NULL );
+      if( relpath != NULL )
+	AddDirectory( relpath );
+      ref = ref->FindNextAssociate( dirname_key );
+    }
+    manifest = manifest->FindNextAssociate( manifest_key );
+  }
+  return 0;
+}
+
+void pkgSysRootVerifier::Retire( pkgVerifyTask *batch, unsigned index )
+{
+  /* Wait for completion of one batch of files, then report the outcome
+   * for each file within it, in path name order.
+   */
+  batch->WaitForCompletion();
+  delete batch;
+
+  unsigned limit = (index + 1) * VERIFY_BATCH_SIZE;
+  if( limit > files ) limit = files;
+  for( index *= VERIFY_BATCH_SIZE; index < limit; index++ )
+    Report( file + index );
+}
+
+void pkgSysRootVerifier::Report( verify_entry *entry )
+{
+  /* Report the outcome of checking one file, (on the main thread),
+   * if it is anything other than a successful match.
+   */
+  ++checked;
+  switch( entry->status )
+  {
+    case VERIFY_MISSING:
+      dmh_printf( "missing:    %s  (%s)\n", entry->pathname, entry->tarname );
+      ++missing;
+      break;
+
+    case VERIFY_MODIFIED:
+      dmh_printf( "modified:   %s  (%s)\n", entry->pathname, entry->tarname );
+      ++modified;
+      break;
+
+    case VERIFY_UNREADABLE:
+      dmh_printf( "unreadable: %s  (%s)\n", entry->pathname, entry->tarname );
+      ++modified;
+  }
+}
+
+void pkgSysRootVerifier::FindUnownedFiles()
+{
+  /* Search each directory which any package has installed, (but not
+   * the rest of the sysroot, which may hold other content), for files
+   * which are not listed in any package manifest; many packages share
+   * directories, so we visit each only once.
+   */
+  qsort( dir, dirs, sizeof( char * ), compare_pathnames );
+  for( unsigned i = 0; i < dirs; i++ )
+  {
+    if( (i > 0) && (strcasecmp( dir[i], dir[i - 1] ) == 0) )
+      continue;
+
+    DIR *listing;
+    size_t len = strlen( dir[i] );
+    char dirpath[syspath_len + len + 2];
+    sprintf( dirpath, (len > 0) ? "%s/%s" : "%s", syspath, dir[i] );
+    if( (listing = opendir( dirpath )) == NULL )
+      continue;
+
+    struct dirent *entry;
+    while( (entry = readdir( listing )) != NULL )
+    {
+      if( (strcmp( entry->d_name, "." ) == 0) || (strcmp( entry->d_name, ".." ) == 0) )
+	continue;
+
+      /* Form the sysroot relative path name for each directory entry,
+       * and look it up in the table of files, (which is now sorted);
+       * any regular file which is not found is unowned.
+       */
+      struct stat info;
+      char pathname[syspath_len + len + strlen( entry->d_name ) + 3];
+      char *relpath = pathname + sprintf( pathname, "%s/", syspath );
+      sprintf( relpath, (len > 0) ? "%s/%s" : "%s%s", dir[i], entry->d_name );
+
+      verify_entry key; key.relpath = relpath;
+      if( (bsearch( &key, file, files, sizeof( verify_entry ), compare_entries ) == NULL)
+      &&  (stat( pathname, &info ) == 0) && S_ISREG( info.st_mode )  )
+      {
+	dmh_printf( "unowned:    %s\n", pathname );
+	++unowned;
+      }
+    }
+    closedir( listing );
+  }
+}
+
+unsigned long pkgSysRootVerifier::Check( pkgWorkerPool *workers )
+{
+  /* Check all files in the table, handing off each batch to the pool
+   * of worker threads, while we report the outcome of earlier batches;
+   * as in the case of the installer's writer threads, we allow up to
+   * four batches to be outstanding, for each worker thread.
+   */
+  qsort( file, files, sizeof( verify_entry ), compare_entries );
+
+  unsigned batches = (files + VERIFY_BATCH_SIZE - 1) / VERIFY_BATCH_SIZE;
+  unsigned window = (workers->Threads() > 0) ? workers->Threads() << 2 : 1;
+  pkgVerifyTask **task = (pkgVerifyTask **)(malloc( window * sizeof( pkgVerifyTask * ) ));
+
+  unsigned next, retired = 0;
+  for( next = 0; (task != NULL) && (next < batches); next++ )
+  {
+    if( (next - retired) == window )
+    {
+      /* The window of outstanding batches is full; we must wait for
+       * the oldest to be completed, and report it, before we may hand
+       * off another.
+       */
+      Retire( task[retired % window], retired );
+      ++retired;
+    }
+    unsigned first = next * VERIFY_BATCH_SIZE;
+    pkgSpinWait::Report( "Verifying %s", file[first].relpath );
+    unsigned count = ((files - first) < VERIFY_BATCH_SIZE)
+      ? files - first : VERIFY_BATCH_SIZE;
+    workers->Submit( task[next % window] = new pkgVerifyTask( file + first, count ) );
+  }
+
+  /* Wait for, and report, any batches which remain outstanding.
+   */
+  for( ; retired < next; retired++ )
+    Retire( task[retired % window], retired );
+  free( task );
+
+  /* Having checked the files which the packages do own, we may now
+   * look for any which they don't.
+   */
+  FindUnownedFiles();
+  dmh_printf( "%s: %lu files checked; %lu missing, %lu modified, %lu unowned\n",
+      syspath, checked, missing, modified, unowned
+    );
+  return missing + modified + unowned;
+}
+
+/*******************
+ *
+ * Class Implementation: pkgXmlDocument (verify action)
+ *
+ */
+unsigned long pkgXmlDocument::VerifyInstallation()
+{
+  /* Method to check every sysroot, which is specified by the active
+   * system map, against the manifests of all packages which have been
+   * installed within it; returns the total number of discrepancies.
+   */
+  unsigned long discrepancies = 0;
+  pkgWorkerPool workers( pkgWorkerPool::ThreadCount( OPTION_VERIFY_THREADS ) );
+  pkgXmlNode *sysroot = GetRoot()->FindFirstAssociate( sysroot_key );
+  while( sysroot != NULL )
+  {
+    const char *refpath = sysroot->GetPropVal( pathname_key, NULL );
+    const char *sysname = sysroot->GetPropVal( id_key, NULL );
+    if( (refpath != NULL) && (sysname != NULL) )
+    {
+      /* Collect the manifests of all packages installed in this
+       * sysroot, excluding any virtual packages, (which have no
+       * manifest, because they have no archive)...
+       */
+      pkgSysRootVerifier verify( refpath );
+      pkgXmlNode *pkg = sysroot->FindFirstAssociate( installed_key );
+      while( pkg != NULL )
+      {
+	const char *tarname = pkg->GetPropVal( tarname_key, NULL );
+	pkgXmlNode *dl = pkg->FindFirstAssociate( download_key );
+	const char *archive = (dl != NULL) ? dl->GetPropVal( tarname_key, NULL ) : NULL;
+	if( (tarname != NULL)
+	&&  ((archive == NULL) || (strcmp( archive, value_none ) != 0))  )
+	  discrepancies += verify.CollectManifest( sysname, tarname );
+
+	pkg = pkg->FindNextAssociate( installed_key );
+      }
+      /* ...then check all of their files together.
+       */
+      discrepancies += verify.Check( &workers );
+    }
+    sysroot = sysroot->FindNextAssociate( sysroot_key );
+  }
+  return discrepancies;
+}
+
+/* $RCSfile$: end of file */
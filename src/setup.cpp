@@ -4,7 +4,7 @@
  * $Id$
  *
  * Written by Keith Marshall <keith@users.osdn.me>
- * Copyright (C) 2013, 2020, MinGW.org Project
+ * Copyright (C) 2013, 2020, 2026, MinGW.org Project
  *
  *
  * Implementation of the mingw-get setup tool's dialogue controller.
@@ -545,7 +545,7 @@ class pkgManifest;
  * has been excluded; (it implements a level of complexity, not required
  * here); hence, we provide a minimal, do nothing, substitute.
  */
-pkgTarArchiveProcessor::pkgTarArchiveProcessor( pkgXmlNode * ){}
+pkgTarArchiveProcessor::pkgTarArchiveProcessor( pkgXmlNode *, pkgArchiveStream * ){}
 
 /* Similarly, we need a simplified implementation of the destructor
  * for this same class...
@@ -556,6 +556,7 @@ pkgTarArchiveProcessor::~pkgTarArchiveProcessor()
    * allocated by the pkgTarArchiveExtractor class constructor.
    */
   free( (void *)(sysroot_path) );
+  free( transfer_buffer );
   delete stream;
 }
 
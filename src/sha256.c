@@ -0,0 +1,208 @@
+/*
+ * sha256.c
+ *
+ * $Id$
+ *
+ * Copyright (C) 2026, MinGW.org Project
+ *
+ *
+ * Implementation of the SHA-256 message digest algorithm, as specified
+ * in FIPS PUB 180-4; this is used to verify the integrity of package
+ * archives, by comparison with the digests which are published in the
+ * package catalogues.  The interface is incremental, so that a digest
+ * may be accumulated while the archive is being read for extraction,
+ * rather than requiring the archive file to be read a second time.
+ *
+ *
+ * This is free software.  Permission is granted to copy, modify and
+ * redistribute this software, under the provisions of the GNU General
+ * Public License, Version 3, (or, at your option, any later version),
+ * as published by the Free Software Foundation; see the file COPYING
+ * for licensing details.
+ *
+ * Note, in particular, that this software is provided "as is", in the
+ * hope that it may prove useful, but WITHOUT WARRANTY OF ANY KIND; not
+ * even an implied WARRANTY OF MERCHANTABILITY, nor of FITNESS FOR ANY
+ * PARTICULAR PURPOSE.  Under no circumstances will the author, or the
+ * MinGW Project, accept liability for any damages, however caused,
+ * arising from the use of this software.
+ *
+ */
+#include "sha256.h"
+
+#include <string.h>
+
+/* The round constants; these are the first 32 bits of the fractional
+ * parts of the cube roots of the first 64 prime numbers.
+ */
+static const uint32_t round_constant[64] =
+{
+  0x428A2F98, 0x71374491, 0xB5C0FBCF, 0xE9B5DBA5,
+  0x3956C25B, 0x59F111F1, 0x923F82A4, 0xAB1C5ED5,
+  0xD807AA98, 0x12835B01, 0x243185BE, 0x550C7DC3,
+  0x72BE5D74, 0x80DEB1FE, 0x9BDC06A7, 0xC19BF174,
+  0xE49B69C1, 0xEFBE4786, 0x0FC19DC6, 0x240CA1CC,
+  0x2DE92C6F, 0x4A7484AA, 0x5CB0A9DC, 0x76F988DA,
+  0x983E5152, 0xA831C66D, 0xB00327C8, 0xBF597FC7,
+  0xC6E00BF3, 0xD5A79147, 0x06CA6351, 0x14292967,
+  0x27B70A85, 0x2E1B2138, 0x4D2C6DFC, 0x53380D13,
+  0x650A7354, 0x766A0ABB, 0x81C2C92E, 0x92722C85,
+  0xA2BFE8A1, 0xA81A664B, 0xC24B8B70, 0xC76C51A3,
+  0xD192E819, 0xD6990624, 0xF40E3585, 0x106AA070,
+  0x19A4C116, 0x1E376C08, 0x2748774C, 0x34B0BCB5,
+  0x391C0CB3, 0x4ED8AA4A, 0x5B9CCA4F, 0x682E6FF3,
+  0x748F82EE, 0x78A5636F, 0x84C87814, 0x8CC70208,
+  0x90BEFFFA, 0xA4506CEB, 0xBEF9A3F7, 0xC67178F2
+};
+
+static __inline__ __attribute__((__always_inline__))
+uint32_t rotr( uint32_t value, unsigned bits )
+{
+  /* Helper to rotate a 32-bit word right, by the specified number
+   * of bit positions.
+   */
+  return (value >> bits) | (value << (32 - bits));
+}
+
+static void sha256_transform( uint32_t *state, const uint8_t *block )
+{
+  /* Incorporate the effect of one 64-byte input block into the
+   * intermediate hash value; first, we expand the block, (which is
+   * interpreted as sixteen big-endian words), into the message
+   * schedule of sixty-four words...
+   */
+  int i;
+  uint32_t w[64], a, b, c, d, e, f, g, h;
+  for( i = 0; i < 16; i++, block += 4 )
+    w[i] = ((uint32_t)(block[0]) << 24) | ((uint32_t)(block[1]) << 16)
+	 | ((uint32_t)(block[2]) << 8) | (uint32_t)(block[3]);
+
+  for( ; i < 64; i++ )
+    w[i] = w[i - 16] + w[i - 7]
+	 + (rotr( w[i - 15], 7 ) ^ rotr( w[i - 15], 18 ) ^ (w[i - 15] >> 3))
+	 + (rotr( w[i - 2], 17 ) ^ rotr( w[i - 2], 19 ) ^ (w[i - 2] >> 10));
+
+  /* ...then we run the sixty-four rounds of the compression function,
+   * on a working copy of the intermediate hash value...
+   */
+  a = state[0]; b = state[1]; c = state[2]; d = state[3];
+  e = state[4]; f = state[5]; g = state[6]; h = state[7];
+  for( i = 0; i < 64; i++ )
+  {
+    uint32_t t1 = h + (rotr( e, 6 ) ^ rotr( e, 11 ) ^ rotr( e, 25 ))
+      + ((e & f) ^ (~e & g)) + round_constant[i] + w[i];
+    uint32_t t2 = (rotr( a, 2 ) ^ rotr( a, 13 ) ^ rotr( a, 22 ))
+      + ((a & b) ^ (a & c) ^ (b & c));
+    h = g; g = f; f = e; e = d + t1;
+    d = c; c = b; b = a; a = t1 + t2;
+  }
+
+  /* ...and finally, we add the result into the intermediate hash.
+   */
+  state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+  state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+}
+
+void sha256_init( sha256_context *ctx )
+{
+  /* Initialise the context for a new digest computation; the initial
+   * hash value comprises the first 32 bits of the fractional parts of
+   * the square roots of the first eight prime numbers.
+   */
+  static const uint32_t initial_state[8] =
+  {
+    0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A,
+    0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19
+  };
+  memcpy( ctx->state, initial_state, sizeof( initial_state ) );
+  ctx->length = 0;
+}
+
+void sha256_update( sha256_context *ctx, const void *data, size_t len )
+{
+  /* Accumulate the effect of an arbitrary length sequence of input
+   * bytes, into the digest computation.
+   */
+  const uint8_t *input = (const uint8_t *)(data);
+  size_t residual = ctx->length & 63;
+  ctx->length += len;
+
+  if( residual > 0 )
+  {
+    /* There is a partial block, carried over from a preceding update;
+     * we must complete this first...
+     */
+    size_t count = 64 - residual;
+    if( count > len ) count = len;
+    memcpy( ctx->block + residual, input, count );
+    input += count; len -= count;
+
+    /* ...but, if it remains incomplete, we cannot yet process it.
+     */
+    if( (residual + count) < 64 )
+      return;
+    sha256_transform( ctx->state, ctx->block );
+  }
+
+  /* Process as many complete blocks as we may, directly from the
+   * input buffer, before we save any residual partial block, for
+   * completion by a subsequent update.
+   */
+  while( len >= 64 )
+  {
+    sha256_transform( ctx->state, input );
+    input += 64; len -= 64;
+  }
+  if( len > 0 ) memcpy( ctx->block, input, len );
+}
+
+void sha256_final( sha256_context *ctx, uint8_t *digest )
+{
+  /* Complete the digest computation, by appending the padding, and
+   * the message length in bits, then store the resultant hash value,
+   * (as a sequence of big-endian words), into the digest buffer.
+   */
+  int i;
+  uint8_t trailer[72];
+  uint64_t bits = ctx->length << 3;
+  size_t count = 64 - ((ctx->length + 8) & 63);
+
+  /* The padding comprises a single 'one' bit, followed by as many
+   * 'zero' bits as are required, such that the message length field
+   * will complete the final block.
+   */
+  memset( trailer, 0, count );
+  trailer[0] = 0x80;
+  for( i = 0; i < 8; i++ )
+    trailer[count + i] = (uint8_t)(bits >> (56 - 8 * i));
+  sha256_update( ctx, trailer, count + 8 );
+
+  for( i = 0; i < 8; i++ )
+  {
+    digest[4 * i] = (uint8_t)(ctx->state[i] >> 24);
+    digest[4 * i + 1] = (uint8_t)(ctx->state[i] >> 16);
+    digest[4 * i + 2] = (uint8_t)(ctx->state[i] >> 8);
+    digest[4 * i + 3] = (uint8_t)(ctx->state[i]);
+  }
+}
+
+char *sha256_hexdigest( sha256_context *ctx, char *buf )
+{
+  /* Complete the digest computation, and format the result as the
+   * conventional string of (lower case) hexadecimal digits.
+   */
+  int i;
+  uint8_t digest[SHA256_DIGEST_SIZE];
+  static const char hexdigit[] = "0123456789abcdef";
+
+  sha256_final( ctx, digest );
+  for( i = 0; i < SHA256_DIGEST_SIZE; i++ )
+  {
+    buf[2 * i] = hexdigit[digest[i] >> 4];
+    buf[2 * i + 1] = hexdigit[digest[i] & 0x0F];
+  }
+  buf[2 * SHA256_DIGEST_SIZE] = '\0';
+  return buf;
+}
+
+/* $RCSfile$: end of file */
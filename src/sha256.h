@@ -0,0 +1,73 @@
+#ifndef SHA256_H
+/*
+ * sha256.h
+ *
+ * $Id$
+ *
+ * Copyright (C) 2026, MinGW.org Project
+ *
+ *
+ * Prototype declarations, and the context data structure, for the
+ * incremental SHA-256 message digest functions, which are implemented
+ * in sha256.c
+ *
+ *
+ * This is free software.  Permission is granted to copy, modify and
+ * redistribute this software, under the provisions of the GNU General
+ * Public License, Version 3, (or, at your option, any later version),
+ * as published by the Free Software Foundation; see the file COPYING
+ * for licensing details.
+ *
+ * Note, in particular, that this software is provided "as is", in the
+ * hope that it may prove useful, but WITHOUT WARRANTY OF ANY KIND; not
+ * even an implied WARRANTY OF MERCHANTABILITY, nor of FITNESS FOR ANY
+ * PARTICULAR PURPOSE.  Under no circumstances will the author, or the
+ * MinGW Project, accept liability for any damages, however caused,
+ * arising from the use of this software.
+ *
+ */
+#define SHA256_H  1
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifndef EXTERN_C
+# ifdef __cplusplus
+#  define EXTERN_C extern "C"
+# else
+#  define EXTERN_C
+# endif
+#endif
+
+/* The digest is 32 bytes long; its conventional representation, as
+ * a string of hexadecimal digits, requires twice as many characters,
+ * plus one more for the terminating NUL.
+ */
+#define SHA256_DIGEST_SIZE	32
+#define SHA256_HEXDIGEST_SIZE	(2 * SHA256_DIGEST_SIZE + 1)
+
+typedef
+struct sha256_context
+{
+  /* The state of a digest computation which is in progress; this
+   * comprises the eight word intermediate hash value, the total number
+   * of bytes processed so far, and a buffer to accumulate any partial
+   * block of input, pending the arrival of sufficient further input
+   * to complete it.
+   */
+  uint32_t	state[8];
+  uint64_t	length;
+  uint8_t	block[64];
+} sha256_context;
+
+EXTERN_C void sha256_init( sha256_context * );
+EXTERN_C void sha256_update( sha256_context *, const void *, size_t );
+EXTERN_C void sha256_final( sha256_context *, uint8_t * );
+
+/* Convenience function to finalise a digest computation, storing
+ * the result as a NUL terminated hexadecimal string, into a buffer
+ * of at least SHA256_HEXDIGEST_SIZE bytes; returns the buffer.
+ */
+EXTERN_C char *sha256_hexdigest( sha256_context *, char * );
+
+#endif /* SHA256_H: $RCSfile$: end of file */
@@ -4,7 +4,7 @@
  * $Id$
  *
  * Written by Keith Marshall <keithmarshall@users.sourceforge.net>
- * Copyright (C) 2010, 2011, 2012, MinGW.org Project
+ * Copyright (C) 2010, 2011, 2012, 2026, MinGW.org Project
  *
  *
  * Implementation of the system map loader, sysroot management and
@@ -29,6 +29,9 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <unistd.h>
+#include <io.h>
+#include <windows.h>
 
 #ifdef _MAX_PATH
 /*
@@ -44,6 +47,7 @@
 #include "pkgbase.h"
 #include "pkgstat.h"
 #include "pkgkeys.h"
+#include "pkgopts.h"
 
 #include "debug.h"
 
@@ -417,6 +421,47 @@ void pkgXmlDocument::LoadSystemMap()
   }
 }
 
+bool pkgXmlDocument::Save( const char *filename )
+{
+  /* Method to save the database, (or any other XML document, such as
+   * an installation manifest, or a sysroot record); this is normally
+   * equivalent to the tinyxml SaveFile( const char* ) method, but when
+   * the user has requested durable installation, we write a temporary
+   * copy, flush it to disk, and move it into place, so that the saved
+   * file will never be found to be incomplete.
+   */
+  if( pkgOptions()->GetValue( OPTION_DURABLE_INSTALL ) == 0 )
+    return SaveFile( filename );
+
+  FILE *fp;
+  bool saved = false;
+  char tmpname[5 + strlen( filename )];
+  sprintf( tmpname, "%s.new", filename );
+  if( (fp = fopen( tmpname, "w" )) != NULL )
+  {
+    saved = SaveFile( fp ) && (fflush( fp ) == 0) && (_commit( fileno( fp ) ) == 0);
+    fclose( fp );
+
+    /* Any files which were installed in the same transaction will have
+     * been moved into place, and the directories which hold them flushed,
+     * (by pkgTarStagingArea::Commit()), before we save the record of them;
+     * we similarly flush the directory which holds this record, after we
+     * have moved it into place, so that the move is not merely cached.
+     */
+    if( saved && (saved = MoveFileExA( tmpname, filename,
+	    MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH
+	  ))
+    &&  (flush_parent_directory( filename ) != 0)  )
+      dmh_notify( DMH_WARNING, "%s: cannot flush directory to disk\n", filename );
+  }
+  if( ! saved )
+  {
+    dmh_notify( DMH_ERROR, "%s: cannot save file\n", filename );
+    unlink( tmpname );
+  }
+  return saved;
+}
+
 void pkgXmlDocument::UpdateSystemMap()
 {
   /* Inspect all sysroot records in the current system map;
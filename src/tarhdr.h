@@ -0,0 +1,220 @@
+#ifndef TARHDR_H
+/*
+ * tarhdr.h
+ *
+ * $Id$
+ *
+ * Copyright (C) 2026, MinGW.org Project
+ *
+ *
+ * Inline helper functions, used by the tar archive processor in
+ * tarproc.cpp, to validate tar archive headers, and to interpret the
+ * numeric values recorded within their fields; these are segregated
+ * into this header, so that the regression tests may compare them
+ * with straightforward byte-by-byte reference implementations.
+ *
+ *
+ * This is free software.  Permission is granted to copy, modify and
+ * redistribute this software, under the provisions of the GNU General
+ * Public License, Version 3, (or, at your option, any later version),
+ * as published by the Free Software Foundation; see the file COPYING
+ * for licensing details.
+ *
+ * Note, in particular, that this software is provided "as is", in the
+ * hope that it may prove useful, but WITHOUT WARRANTY OF ANY KIND; not
+ * even an implied WARRANTY OF MERCHANTABILITY, nor of FITNESS FOR ANY
+ * PARTICULAR PURPOSE.  Under no circumstances will the author, or the
+ * MinGW Project, accept liability for any damages, however caused,
+ * arising from the use of this software.
+ *
+ */
+#define TARHDR_H  1
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+/* Every tar header occupies one 512-byte block.
+ */
+#define TAR_HEADER_SIZE		512
+
+/* The tar header is examined as a sequence of 64-bit words, rather
+ * than byte by byte; these masks select alternate bytes, (to be summed
+ * in 16-bit lanes), the high order bit of each byte, and the low order
+ * three bits of each byte, (i.e. the value of each octal digit).
+ */
+#define TAR_WORD_BYTE_LANES	0x00FF00FF00FF00FFULL
+#define TAR_WORD_WORD_LANES	0x0000FFFF0000FFFFULL
+#define TAR_WORD_HIGH_BITS	0x8080808080808080ULL
+#define TAR_WORD_DIGIT_MASK	0xF8F8F8F8F8F8F8F8ULL
+#define TAR_WORD_DIGIT_BASE	0x3030303030303030ULL
+#define TAR_WORD_DIGIT_BITS	0x0707070707070707ULL
+
+static inline __attribute__((__always_inline__))
+uint64_t load_header_word( const char *p )
+{
+  /* Helper to load eight bytes from a tar header, as a 64-bit word,
+   * with the first byte in the least significant position; on our
+   * little-endian host, this reduces to a single unaligned load.
+   */
+  uint64_t word;
+  memcpy( &word, p, sizeof( word ) );
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  word = __builtin_bswap64( word );
+#endif
+  return word;
+}
+
+static inline __attribute__((__always_inline__))
+uint64_t load_header_word( const char *p, size_t len )
+{
+  /* Variant of the preceding helper, to load fewer than eight bytes,
+   * (at the end of a header field), without reading beyond them.
+   */
+  uint64_t word = 0;
+  while( len-- > 0 )
+    word |= (uint64_t)((unsigned char)(p[len])) << (len << 3);
+  return word;
+}
+
+static inline __attribute__((__always_inline__))
+uint64_t sum_header_bytes( uint64_t word )
+{
+  /* Helper to sum the bytes of a 64-bit word in pairs, yielding four
+   * 16-bit partial sums; (these may be accumulated over all sixty-four
+   * words of a tar header, without overflow).
+   */
+  return (word & TAR_WORD_BYTE_LANES) + ((word >> 8) & TAR_WORD_BYTE_LANES);
+}
+
+static inline __attribute__((__always_inline__))
+unsigned fold_header_sum( uint64_t lanes )
+{
+  /* Helper to reduce the four 16-bit partial sums, as accumulated by
+   * sum_header_bytes(), to a single total.
+   */
+  lanes = (lanes & TAR_WORD_WORD_LANES) + ((lanes >> 16) & TAR_WORD_WORD_LANES);
+  return (unsigned)((lanes + (lanes >> 32)) & 0xFFFFFFFF);
+}
+
+static inline __attribute__((__always_inline__))
+uint64_t octal_word_value( uint64_t digits, unsigned count )
+{
+  /* Helper to compute the value represented by the leading "count"
+   * octal digits, (1 <= count <= 8), of a word loaded by the preceding
+   * load_header_word() helper; the digits are first aligned with the
+   * most significant end of the word, (so that unused positions are
+   * treated as leading zeros), then combined in pairs, quadruples, and
+   * finally as a group of eight, without branching, or any lookup.
+   */
+  digits = (digits & TAR_WORD_DIGIT_BITS) << ((8 - count) << 3);
+  digits = ((digits & TAR_WORD_BYTE_LANES) << 3) + ((digits >> 8) & TAR_WORD_BYTE_LANES);
+  digits = ((digits & TAR_WORD_WORD_LANES) << 6) + ((digits >> 16) & TAR_WORD_WORD_LANES);
+  return ((digits & 0xFFFFFFFF) << 12) + (digits >> 32);
+}
+
+static inline
+uint64_t compute_octval( const char *p, size_t len )
+{
+  /* Helper to convert the ASCII representation of octal values,
+   * (as recorded within tar archive header fields), to their actual
+   * numeric values, ignoring leading or trailing garbage.
+   */
+  uint64_t value = 0LL;
+  const char *field = p, *end = p + len;
+
+  if( (len > 0) && ((*p & 0x80) != 0) )
+  {
+    /* GNU tar, (and others), represent values which are too large to
+     * be expressed in the octal digits which the field will accommodate,
+     * (e.g. the size of an entry of 8 GiB or more), or which are negative,
+     * (e.g. the mtime of an entry which predates the epoch), in base-256
+     * notation; the high order bit of the first byte flags this, and the
+     * remaining bytes represent a big-endian two's complement value, with
+     * the second highest bit of the first byte acting as its sign.
+     */
+    value = (*p & 0x40) ? (~0ULL << 6) | (*p & 0x3F) : (*p & 0x3F);
+    while( --len > 0 )
+      value = (value << 8) | (unsigned char)(*++p);
+    return value;
+  }
+
+  while( (len > 0) && ((*p < '0') || (*p > '7')) )
+  {
+    /* Step over leading garbage.
+     */
+    ++p; --len;
+  }
+  while( len > 0 )
+  {
+    /* Accumulate octal digits, up to eight at a time, (each represents
+     * exactly three bits in the accumulated value), until we either
+     * exhaust the width of the field, or we encounter trailing junk;
+     * the first non-digit in each word is located by marking every byte
+     * which is not an ASCII digit in the range '0'..'7'.  When fewer
+     * than eight bytes remain, we prefer to load the last eight bytes
+     * of the field, and discard those which we have already consumed.
+     */
+    size_t width = (len < 8) ? len : 8;
+    uint64_t digits = (width == 8) ? load_header_word( p )
+      : ((end - field) >= 8) ? load_header_word( end - 8 ) >> ((8 - width) << 3)
+      : load_header_word( p, width );
+    uint64_t junk = ((digits & TAR_WORD_DIGIT_MASK) ^ TAR_WORD_DIGIT_BASE)
+      | ((width < 8) ? ~0ULL << (width << 3) : 0ULL);
+
+    unsigned count = (junk == 0) ? 8 : __builtin_ctzll( junk ) >> 3;
+    if( count > 0 )
+      value = (value << (3 * count)) + octal_word_value( digits, count );
+    if( count < 8 )
+      break;
+
+    p += 8; len -= 8;
+  }
+  return value;
+}
+
+static inline
+bool sum_tar_header( const char *buf, const char *chksum_field, unsigned *sums )
+{
+  /* Helper to compute the checksum of the tar header in "buf", (within
+   * which "chksum_field" is the eight byte checksum field); it stores
+   * the unsigned form of the checksum in sums[0], and the signed form in
+   * sums[1], and returns true, unless the header is all zero, in which
+   * case it returns false, and "sums" is unchanged.
+   *
+   * We make a single pass over the header, one word at a time, to check
+   * for an all zero header, while also accumulating the sum of all of
+   * its bytes, and the number of bytes with the high order bit set...
+   */
+  uint64_t any = 0, sum = 0, high = 0;
+  for( size_t count = 0; count < TAR_HEADER_SIZE; count += 8 )
+  {
+    uint64_t word = load_header_word( buf + count );
+    sum += sum_header_bytes( word );
+    high += (word & TAR_WORD_HIGH_BITS) >> 7;
+    any |= word;
+  }
+  if( any == 0 )
+    return false;
+
+  /* ...then, for a non-zero header, the checksum is computed by treating
+   * each byte within the checksum field itself as having an effective
+   * value equivalent to ASCII <space>; thus, we mask out the actual
+   * content of this field, from the sum of all bytes.
+   */
+  uint64_t chksum = load_header_word( chksum_field );
+  sums[0] = fold_header_sum( sum ) + 8 * 0x20
+    - fold_header_sum( sum_header_bytes( chksum ) );
+
+  /* Some historic implementations of tar computed the checksum with
+   * each byte interpreted as a signed value; each byte with the high
+   * order bit set then contributes 256 less than its unsigned value.
+   */
+  sums[1] = sums[0] - 256
+    * (fold_header_sum( sum_header_bytes( high ) )
+	- fold_header_sum( sum_header_bytes( (chksum & TAR_WORD_HIGH_BITS) >> 7 ) )
+      );
+  return true;
+}
+
+#endif /* TARHDR_H: $RCSfile$: end of file */
@@ -0,0 +1,466 @@
+/*
+ * tarindex.cpp
+ *
+ * $Id$
+ *
+ * Copyright (C) 2026, MinGW.org Project
+ *
+ *
+ * Implementation of the sidecar index, which may be maintained for any
+ * xz compressed tar archive in the package cache, to support extraction
+ * of individual archive members, without decompressing the archive in
+ * its entirety.
+ *
+ *
+ * This is free software.  Permission is granted to copy, modify and
+ * redistribute this software, under the provisions of the GNU General
+ * Public License, Version 3, (or, at your option, any later version),
+ * as published by the Free Software Foundation; see the file COPYING
+ * for licensing details.
+ *
+ * Note, in particular, that this software is provided "as is", in the
+ * hope that it may prove useful, but WITHOUT WARRANTY OF ANY KIND; not
+ * even an implied WARRANTY OF MERCHANTABILITY, nor of FITNESS FOR ANY
+ * PARTICULAR PURPOSE.  Under no circumstances will the author, or the
+ * MinGW Project, accept liability for any damages, however caused,
+ * arising from the use of this software.
+ *
+ */
+#define  PKGSTRM_H_SPECIAL  1
+
+#include "pkgimpl.h"
+#include "pkgstrm.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <io.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "dmh.h"
+#include "pkgbase.h"
+#include "pkgproc.h"
+
+#ifndef O_BINARY
+/* POSIX hosts don't distinguish binary from text files.
+ */
+# define O_BINARY  0
+#endif
+
+/* The sidecar index file is a simple binary file, with a name formed
+ * by appending the following suffix to the name of the archive; it is
+ * introduced by a signature, and a record of the size and modification
+ * time of the archive which it represents, (so that we may detect when
+ * it has become stale), followed by one record for each archive member.
+ * Each member record comprises the file offset of the xz block which
+ * contains the member's header, the offset of that header within the
+ * decompressed data of the block, the integrity check type for the
+ * stream to which the block belongs, and the member name.
+ */
+#define TAR_INDEX_SUFFIX	".idx"
+#define TAR_INDEX_SIGNATURE	"mingw-get:tar.xz:index:1"
+
+/* A pseudo integrity check type, (which cannot conflict with any which
+ * is defined by the xz format specification), is used to indicate that
+ * a member record is indexed relative to the start of a stream, rather
+ * than a block.
+ */
+#define TAR_INDEX_STREAM_START	0xFF
+
+static bool read_u64( FILE *fp, uint64_t *value )
+{
+  /* Helper, to read one 64-bit value from the index file, in
+   * little endian byte order...
+   */
+  uint8_t buf[8];
+  if( fread( buf, sizeof( buf ), 1, fp ) != 1 ) return false;
+  *value = 0;
+  for( int i = 8; i > 0; --i ) *value = (*value << 8) | buf[i - 1];
+  return true;
+}
+
+static bool write_u64( FILE *fp, uint64_t value )
+{
+  /* ...and its complementary helper, to write such a value.
+   */
+  uint8_t buf[8];
+  for( int i = 0; i < 8; i++ ) { buf[i] = value & 0xFF; value >>= 8; }
+  return fwrite( buf, sizeof( buf ), 1, fp ) == 1;
+}
+
+static bool read_xz_bytes( int fd, uint64_t offset, uint8_t *buf, size_t len )
+{
+  /* Helper, to read a specified number of bytes, from a specified
+   * offset within the archive file.
+   */
+  if( _lseeki64( fd, offset, SEEK_SET ) != (__int64)(offset) ) return false;
+  while( len > 0 )
+  {
+    int count = read( fd, buf, len );
+    if( count <= 0 ) return false;
+    buf += count; len -= count;
+  }
+  return true;
+}
+
+static lzma_index *read_xz_index( int fd )
+{
+  /* Helper, to retrieve the block index which is embedded within each
+   * stream of an xz archive; we begin at the end of the file, working
+   * backwards through each stream, (skipping any stream padding), and
+   * combining the indexes of any concatenated streams, so that the
+   * resultant index represents the entire archive.
+   */
+  lzma_index *combined = NULL;
+  __int64 pos = _lseeki64( fd, 0, SEEK_END );
+  lzma_vli padding = 0;
+
+  while( pos > 0 )
+  {
+    uint8_t buf[LZMA_STREAM_HEADER_SIZE];
+    lzma_stream_flags footer, header;
+    if( (pos < 2 * LZMA_STREAM_HEADER_SIZE)
+    ||  ! read_xz_bytes( fd, pos - LZMA_STREAM_HEADER_SIZE, buf, sizeof( buf ) )  )
+      break;
+
+    if( (buf[8] | buf[9] | buf[10] | buf[11]) == 0 )
+    {
+      /* Stream padding comprises null bytes, in multiples of four;
+       * skip over it, noting how much we skipped.
+       */
+      pos -= 4; padding += 4;
+      continue;
+    }
+    /* Decode the stream footer, to locate the stream index...
+     */
+    if( lzma_stream_footer_decode( &footer, buf ) != LZMA_OK )
+      break;
+
+    lzma_vli index_size = footer.backward_size;
+    __int64 index_pos = pos - LZMA_STREAM_HEADER_SIZE - index_size;
+    uint8_t *index_data;
+    if( (index_pos < LZMA_STREAM_HEADER_SIZE)
+    ||  ((index_data = (uint8_t *)(malloc( index_size ))) == NULL)  )
+      break;
+
+    /* ...then read and decode the index itself.
+     */
+    lzma_index *idx = NULL;
+    uint64_t memlimit = UINT64_MAX; size_t in_pos = 0;
+    bool ok = read_xz_bytes( fd, index_pos, index_data, index_size )
+      && (lzma_index_buffer_decode( &idx, &memlimit, NULL,
+	    index_data, &in_pos, index_size ) == LZMA_OK
+	  );
+    free( index_data );
+    if( ! ok ) break;
+
+    /* The index tells us the total size of the stream, whence we may
+     * locate, and validate, its header...
+     */
+    pos -= lzma_index_stream_size( idx );
+    if( (pos < 0) || ! read_xz_bytes( fd, pos, buf, sizeof( buf ) )
+    ||  (lzma_stream_header_decode( &header, buf ) != LZMA_OK)
+    ||  (lzma_stream_flags_compare( &header, &footer ) != LZMA_OK)
+    ||  (lzma_index_stream_flags( idx, &footer ) != LZMA_OK)
+    ||  (lzma_index_stream_padding( idx, padding ) != LZMA_OK)
+    ||  ((combined != NULL) && (lzma_index_cat( idx, combined, NULL ) != LZMA_OK))  )
+    {
+      lzma_index_end( idx, NULL );
+      break;
+    }
+    /* ...and, since we are working backwards, we prepend its index
+     * to that of any stream which we have already processed.
+     */
+    combined = idx; padding = 0;
+  }
+  if( pos != 0 )
+  {
+    /* We failed to reach the start of the file; (probably it is not
+     * an xz archive at all); in any case, we have no usable index.
+     */
+    if( combined != NULL ) lzma_index_end( combined, NULL );
+    combined = NULL;
+  }
+  return combined;
+}
+
+pkgTarArchiveIndex *pkgOpenArchiveIndex( const char *archive )
+{
+  /* Factory function, to create a sidecar index object for the named
+   * archive, but only if it is an xz archive; we identify this by the
+   * magic number at the start of the file, (as pkgOpenArchiveStream()
+   * does), rather than by its name.
+   */
+  int fd;
+  uint8_t magic[6];
+  static const uint8_t xz_magic[] = { 0xFD, '7', 'z', 'X', 'Z', 0x00 };
+  if( (fd = open( archive, O_RDONLY | O_BINARY )) < 0 )
+    return NULL;
+
+  bool is_xz = read_xz_bytes( fd, 0, magic, sizeof( magic ) )
+    && (memcmp( magic, xz_magic, sizeof( magic ) ) == 0);
+  close( fd );
+  return is_xz ? new pkgTarArchiveIndex( archive ) : NULL;
+}
+
+/*****
+ *
+ * Class Implementation: pkgTarArchiveIndex
+ *
+ */
+pkgTarArchiveIndex::pkgTarArchiveIndex( const char *archive ):
+archive_size( 0 ), archive_mtime( 0 ), current( false ),
+members( NULL ), count( 0 ), capacity( 0 )
+{
+  /* The constructor notes the names of both the archive, and its
+   * sidecar index file, and establishes whether the latter exists,
+   * and remains current.
+   */
+  struct stat info;
+  archive_name = strdup( archive );
+  if( (index_name = (char *)(malloc( strlen( archive ) + sizeof( TAR_INDEX_SUFFIX )))) != NULL )
+    strcat( strcpy( index_name, archive ), TAR_INDEX_SUFFIX );
+
+  if( stat( archive, &info ) == 0 )
+  {
+    archive_size = info.st_size;
+    archive_mtime = info.st_mtime;
+
+    FILE *fp;
+    if( (index_name != NULL) && ((fp = fopen( index_name, "rb" )) != NULL) )
+    {
+      /* We found an existing index file; it remains current, if its
+       * signature is valid, and it matches the archive's size and
+       * modification time.
+       */
+      char signature[sizeof( TAR_INDEX_SIGNATURE )];
+      uint64_t size = 0, mtime = 0;
+      current = (fread( signature, sizeof( signature ), 1, fp ) == 1)
+	&& (memcmp( signature, TAR_INDEX_SIGNATURE, sizeof( signature ) ) == 0)
+	&& read_u64( fp, &size ) && (size == archive_size)
+	&& read_u64( fp, &mtime ) && (mtime == archive_mtime);
+      fclose( fp );
+    }
+  }
+}
+
+pkgTarArchiveIndex::~pkgTarArchiveIndex()
+{
+  /* The destructor releases all heap memory, which may have been
+   * allocated to the index object.
+   */
+  while( count > 0 ) free( members[--count].name );
+  free( members );
+  free( index_name );
+  free( archive_name );
+}
+
+void pkgTarArchiveIndex::Record( const char *name, uint64_t offset )
+{
+  /* Method to record the name and offset of each archive member, as
+   * it is encountered, during a sequential pass through the archive;
+   * we need do this only when we do not already have a current index,
+   * and we must disregard any names which embed a newline, since we
+   * would be unable to reliably match them, (and any which are too
+   * long to be represented in the index).
+   */
+  if( current || (strchr( name, '\n' ) != NULL) || (strlen( name ) > 0xFFFF) )
+    return;
+
+  if( count == capacity )
+  {
+    /* The member table is full; extend it.
+     */
+    unsigned extent = capacity ? capacity << 1 : 64;
+    struct member_offset *tmp = (struct member_offset *)(realloc( members,
+	  extent * sizeof( struct member_offset )
+	));
+    if( tmp == NULL ) return;
+    members = tmp; capacity = extent;
+  }
+  if( (members[count].name = strdup( name )) != NULL )
+    members[count++].offset = offset;
+}
+
+void pkgTarArchiveIndex::Commit()
+{
+  /* Method to write the sidecar index, after a complete sequential pass
+   * through the archive; this is possible only if the archive is an xz
+   * archive, (with a valid block index), and is unnecessary if we already
+   * have a current sidecar index.
+   */
+  int fd;
+  if( current || (count == 0) || (index_name == NULL)
+  ||  ((fd = open( archive_name, O_RDONLY | O_BINARY )) < 0)  )
+    return;
+
+  lzma_index *idx = read_xz_index( fd );
+  close( fd );
+  if( idx == NULL )
+    return;
+
+  /* We write the index to a temporary file, renaming it only when it
+   * is complete, so that no other process will ever see a partially
+   * written index.
+   */
+  FILE *fp;
+  char tmpname[strlen( index_name ) + 2];
+  strcat( strcpy( tmpname, index_name ), "~" );
+  if( (fp = fopen( tmpname, "wb" )) != NULL )
+  {
+    bool ok = (fwrite( TAR_INDEX_SIGNATURE, sizeof( TAR_INDEX_SIGNATURE ), 1, fp ) == 1)
+      && write_u64( fp, archive_size ) && write_u64( fp, archive_mtime );
+
+    lzma_index_iter iter;
+    lzma_index_iter_init( &iter, idx );
+    lzma_vli limit = lzma_index_uncompressed_size( idx );
+    for( unsigned i = 0; ok && (i < count); i++ )
+    {
+      /* For each member, identify the stream which contains the last
+       * byte of its extent, (which ends where the next member begins);
+       * (note that lzma_index_iter_locate() returns false on success).
+       */
+      lzma_vli end = (i + 1 < count) ? members[i + 1].offset : limit;
+      if( (end <= members[i].offset) || lzma_index_iter_locate( &iter, end - 1 ) )
+	ok = false;
+
+      else
+      { /* Now locate the block which contains the member's header...
+	 */
+	lzma_vli stream = iter.stream.number;
+	if( lzma_index_iter_locate( &iter, members[i].offset ) )
+	  ok = false;
+
+	else
+	{ uint16_t len = strlen( members[i].name );
+	  uint8_t check = iter.stream.flags->check;
+	  uint64_t base = iter.block.compressed_file_offset;
+	  uint64_t offset = members[i].offset - iter.block.uncompressed_file_offset;
+	  if( iter.stream.number != stream )
+	  {
+	    /* ...but, if the member's extent crosses a stream boundary,
+	     * the synthetic stream which we would construct, to read the
+	     * block in isolation, would fail at the end of the original
+	     * stream; in this case, we must index it relative to the
+	     * start of its original stream.
+	     */
+	    check = TAR_INDEX_STREAM_START;
+	    base = iter.stream.compressed_offset;
+	    offset = members[i].offset - iter.stream.uncompressed_offset;
+	  }
+	  ok = write_u64( fp, base ) && write_u64( fp, offset )
+	    && (fwrite( &check, sizeof( check ), 1, fp ) == 1)
+	    && (fwrite( &len, sizeof( len ), 1, fp ) == 1)
+	    && (fwrite( members[i].name, len, 1, fp ) == 1);
+	}
+      }
+    }
+    if( (fclose( fp ) == 0) && ok )
+    {
+      /* The index is complete; (note that, on MS-Windows, rename()
+       * will fail, if the target already exists).
+       */
+      unlink( index_name );
+      current = (rename( tmpname, index_name ) == 0);
+    }
+    if( ! current ) unlink( tmpname );
+  }
+  lzma_index_end( idx, NULL );
+
+  /* Whether or not we succeeded, there is nothing to be gained by
+   * retaining the member records.
+   */
+  while( count > 0 ) free( members[--count].name );
+}
+
+pkgArchiveStream *pkgTarArchiveIndex::OpenMember( const char *name )
+{
+  /* Method to locate a named member, within a current sidecar index,
+   * and to return a new archive stream, positioned at its header.
+   */
+  FILE *fp;
+  if( ! current || ((fp = fopen( index_name, "rb" )) == NULL) )
+    return NULL;
+
+  /* Skip the index file header, (which we have already validated),
+   * then look for a matching member record; note that we disregard
+   * any leading "./" on the name we seek, (as does the caller).
+   */
+  uint64_t block = 0, offset = 0; uint8_t check = 0;
+  uint16_t len, wanted = 0; bool found = false;
+  while( strncmp( name, "./", 2 ) == 0 ) name += 2;
+  if( fseek( fp, sizeof( TAR_INDEX_SIGNATURE ) + 2 * sizeof( uint64_t ), SEEK_SET ) == 0 )
+    wanted = strlen( name );
+  while( ! found && (wanted > 0) && read_u64( fp, &block ) && read_u64( fp, &offset )
+  &&  (fread( &check, sizeof( check ), 1, fp ) == 1)
+  &&  (fread( &len, sizeof( len ), 1, fp ) == 1)  )
+  {
+    char entry[len + 1];
+    if( fread( entry, len, 1, fp ) != 1 ) break;
+    entry[len] = '\0';
+
+    const char *p = entry;
+    while( strncmp( p, "./", 2 ) == 0 ) p += 2;
+    found = (strcmp( p, name ) == 0);
+  }
+  fclose( fp );
+  if( ! found )
+    return NULL;
+
+  /* We found the member; open the archive, and position it at the
+   * start of the block which contains the member's header...
+   */
+  int fd;
+  if( ((fd = open( archive_name, O_RDONLY | O_BINARY )) < 0)
+  ||  (_lseeki64( fd, block, SEEK_SET ) != (__int64)(block))  )
+  {
+    if( fd >= 0 ) close( fd );
+    return NULL;
+  }
+  /* ...then construct an xz stream to read from it; unless we are
+   * positioned at the start of a stream, this must be primed with a
+   * synthetic stream header, specifying the appropriate integrity check
+   * type, so that it will then decode the block, (and any which follow
+   * it), as if it was the first block in a stream.
+   */
+  pkgArchiveStream *stream = NULL;
+  if( check == TAR_INDEX_STREAM_START )
+    stream = new pkgXzArchiveStream( fd );
+
+  else
+  { uint8_t header[LZMA_STREAM_HEADER_SIZE];
+    lzma_stream_flags flags;
+    memset( &flags, 0, sizeof( flags ) );
+    flags.check = (lzma_check)(check);
+    if( lzma_stream_header_encode( &flags, header ) != LZMA_OK )
+    {
+      close( fd );
+      return NULL;
+    }
+    stream = new pkgXzArchiveStream( fd );
+    stream->PrimeInput( header, sizeof( header ) );
+  }
+
+  /* Finally, skip over any data which precedes the member's header,
+   * within the decompressed content of the block.
+   */
+  while( offset > 0 )
+  {
+    const char *data;
+    int avail = stream->GetView( &data );
+    if( avail <= 0 )
+    {
+      delete stream;
+      return NULL;
+    }
+    if( (uint64_t)(avail) > offset ) avail = offset;
+    stream->ReleaseView( avail );
+    offset -= avail;
+  }
+  return stream;
+}
+
+/* $RCSfile$: end of file */
@@ -4,7 +4,7 @@
  * $Id$
  *
  * Written by Keith Marshall <keithmarshall@users.sourceforge.net>
- * Copyright (C) 2009, 2010, 2011, 2012, 2013, MinGW.org Project
+ * Copyright (C) 2009, 2010, 2011, 2012, 2013, 2026, MinGW.org Project
  *
  *
  * Implementation of package archive processing methods, for reading
@@ -47,9 +47,18 @@
 #include "pkginfo.h"
 #include "pkgkeys.h"
 #include "pkgstat.h"
+#include "pkgopts.h"
+#include "pkgpool.h"
+#include "xxh64.h"
+#include "tarhdr.h"
+
+#include <io.h>
+#include <dirent.h>
 
 #endif /* PACKAGE_BASE_COMPONENT */
 
+#include <windows.h>
+
 #include "pkgproc.h"
 
 /*******************
@@ -57,6 +66,94 @@
  * Class Implementation: pkgArchiveProcessor
  *
  */
+struct tar_deferred_link
+{
+  /* A link which refers to an entity which has not yet been extracted,
+   * (and which may never be), or which may not be created until staged
+   * content has been committed; it is created when extraction of the
+   * entire archive has been completed.  The strings are stored in the
+   * same allocation as the record itself; "target" is NULL, for a hard
+   * link.
+   */
+  tar_deferred_link *next;
+  char *pathname, *source, *target;
+};
+
+static void discard_deferred_links( tar_deferred_link *link )
+{
+  /* Helper to release any deferred links which remain unprocessed.
+   */
+  while( link != NULL )
+  {
+    tar_deferred_link *next = link->next;
+    free( link );
+    link = next;
+  }
+}
+
+pkgArchiveProcessor::~pkgArchiveProcessor()
+{
+  /* Destructor must release the path name composition buffer, and
+   * any deferred links which remain unprocessed.
+   */
+  free( entry_path );
+  discard_deferred_links( deferred_links );
+}
+
+const char *pkgArchiveProcessor::
+EntryPathName( const char *name, const char *prefix )
+{
+  /* Helper method to map the name of an archive entry, (with optional
+   * prefix), to its equivalent file system path name, in the designated
+   * sysroot hierarchy; the result is the same as that obtained by use of
+   * mkpath(), with the sysroot_path template, but we expand the sysroot
+   * prefix, (including any "%R" substitution), only for the first entry,
+   * retaining it in a buffer which we reuse for each subsequent entry;
+   * the returned path name remains valid until the next call.
+   *
+   * The sysroot_len property counts the directory separator which
+   * follows the expanded prefix; compute the total space required...
+   */
+  size_t name_len = strlen( name ) + 1;
+  size_t prefix_len = (prefix != NULL) ? strlen( prefix ) + 1 : 0;
+  size_t want = sysroot_len + prefix_len + name_len;
+  if( want > entry_path_size )
+  {
+    /* ...and, when the current buffer is too small to accommodate
+     * it, grow it, (in reasonably sized increments).
+     */
+    size_t size = (want + 255) & ~(size_t)(255);
+    char *buf = (char *)(realloc( entry_path, size ));
+    if( buf == NULL )
+      return NULL;
+
+    /* When we've allocated the buffer for the first time, this is
+     * the occasion to expand the sysroot prefix into it.
+     */
+    if( entry_path == NULL )
+      mkpath( buf, sysroot_path, "", NULL );
+
+    entry_path = buf;
+    entry_path_size = size;
+  }
+
+  /* Append the optional prefix, and the entry name, each preceded by
+   * a directory separator, immediately following the retained sysroot
+   * prefix; (note that the entry name is copied together with its
+   * terminating NUL).
+   */
+  char *p = entry_path + sysroot_len - 1;
+  if( prefix != NULL )
+  {
+    *p++ = '/';
+    memcpy( p, prefix, --prefix_len );
+    p += prefix_len;
+  }
+  *p++ = '/';
+  memcpy( p, name, name_len );
+  return entry_path;
+}
+
 int pkgArchiveProcessor::CreateExtractionDirectory( const char *pathname )
 {
   /* Helper method for creation of the directory infrastructure
@@ -84,14 +181,12 @@ static inline int dmh_notify_archive_data_exhausted( const char *context )
     );
 }
 
-static int create_output_stream( const char *name, int mode )
+static void diagnose_output_stream_failure( const char *name )
 {
-  /* Wrapper encapsulating the set_output_stream() function, while
-   * protecting against inadvertently overwriting any unexpectedly
-   * pre-existing file.
+  /* Helper to diagnose failure of set_output_stream(), as indicated
+   * by "errno", when overwrite prevention was triggered.
    */
-  int fd = set_output_stream( name, mode );
-  if( (fd == -1) && ((errno == EEXIST) || (errno == EACCES)) )
+  if( (errno == EEXIST) || (errno == EACCES) )
   {
     /* Overwrite prevention was triggered; diagnose.
      */
@@ -115,10 +210,20 @@ static int create_output_stream( const char *name, int mode )
 	);
     }
   }
+}
+
+static int create_output_stream( const char *name, int mode )
+{
+  /* Wrapper encapsulating the set_output_stream() function, while
+   * protecting against inadvertently overwriting any unexpectedly
+   * pre-existing file.
+   */
+  int fd = set_output_stream( name, mode );
+  if( fd == -1 ) diagnose_output_stream_failure( name );
   return fd;
 }
 
-inline int pkgArchiveProcessor::SetOutputStream( const char *name, int mode )
+int pkgArchiveProcessor::SetOutputStream( const char *name, int mode )
 {
   /* Wrapper method to facilitate the set up of output streams
    * for writing extracted content to disk, except in the special
@@ -127,6 +232,37 @@ inline int pkgArchiveProcessor::SetOutputStream( const char *name, int mode )
   return save_on_extract ? create_output_stream( name, mode ) : -2;
 }
 
+static void discard_extracted_file( const char *pathname, int status )
+{
+  /* Helper to discard any target file which was not successfully
+   * and completely written, and to diagnose the failure, according
+   * to the specified "status" code.
+   */
+  unlink( pathname );
+  dmh_notify_extraction_failed( pathname );
+  switch( status )
+  {
+    case TAR_ARCHIVE_DATA_READ_ERROR:
+      dmh_notify_archive_data_exhausted( "content" );
+      break;
+
+    case TAR_ARCHIVE_DATA_WRITE_ERROR:
+      dmh_notify( DMH_ERROR, "write error extracting file content\n" );
+      break;
+
+    case ZIP_ARCHIVE_CHECKSUM_ERROR:
+      dmh_notify( DMH_ERROR, "extracted content fails CRC check\n" );
+      break;
+
+    case ZIP_ARCHIVE_METHOD_ERROR:
+      dmh_notify( DMH_ERROR, "unsupported compression method\n" );
+      break;
+
+    default:
+      dmh_notify( DMH_ERROR, "unexpected fault; status = %d\n", status );
+  }
+}
+
 int pkgArchiveProcessor::ExtractFile( int fd, const char *pathname, int status )
 {
   /* Helper method to finalise extraction of archived file entities;
@@ -142,26 +278,11 @@ int pkgArchiveProcessor::ExtractFile( int fd, const char *pathname, int status )
      */
     close( fd );
     if( status != 0 )
-    {
-      /* The target file was not successfully and completely
-       * written; discard it, and diagnose failure.
+      /*
+       * ...but, if it was not successfully and completely written,
+       * discard it, and diagnose failure.
        */
-      unlink( pathname );
-      dmh_notify_extraction_failed( pathname );
-      switch( status )
-      {
-	case TAR_ARCHIVE_DATA_READ_ERROR:
-	  dmh_notify_archive_data_exhausted( "content" );
-	  break;
-
-	case TAR_ARCHIVE_DATA_WRITE_ERROR:
-	  dmh_notify( DMH_ERROR, "write error extracting file content\n" );
-	  break;
-
-	default:
-	  dmh_notify( DMH_ERROR, "unexpected fault; status = %d\n", status );
-      }
-    }
+      discard_extracted_file( pathname, status );
   }
   /* Finally, we pass either the original status value, or the
    * failing file descriptor as an effective status, if no file
@@ -170,6 +291,40 @@ int pkgArchiveProcessor::ExtractFile( int fd, const char *pathname, int status )
   return (fd == -1) ? fd : status;
 }
 
+static int update_output_stream
+( int fd, const char *data, size_t count, bool *compare )
+{
+  /* Helper to write extracted data to an output stream, as write()
+   * does; however, while "*compare" remains set, we first compare the
+   * data with the existing content of the stream, (which we read in
+   * blocks of moderate size), skipping over it for as long as it
+   * matches, and clearing "*compare" on finding the first difference,
+   * after which we rewrite from the start of the differing block.
+   */
+  size_t offset = 0;
+  while( *compare && (offset < count) )
+  {
+    char existing[32768];
+    size_t len = count - offset;
+    if( len > sizeof( existing ) ) len = sizeof( existing );
+
+    int got = read( fd, existing, len );
+    if( (got != (int)(len)) || (memcmp( existing, data + offset, len ) != 0) )
+    {
+      if( got > 0 ) lseek( fd, -got, SEEK_CUR );
+      *compare = false;
+    }
+    else
+      offset += len;
+  }
+  if( offset < count )
+  {
+    int written = write( fd, data + offset, count - offset );
+    return (written < 0) ? written : (int)(offset) + written;
+  }
+  return count;
+}
+
 /*******************
  *
  * Class Implementation: pkgTarArchiveProcessor
@@ -180,14 +335,18 @@ int pkgArchiveProcessor::ExtractFile( int fd, const char *pathname, int status )
  * The GUI setup tool will provide a simplified substitute for
  * this constructor.
  */
-pkgTarArchiveProcessor::pkgTarArchiveProcessor( pkgXmlNode *pkg )
+pkgTarArchiveProcessor::
+pkgTarArchiveProcessor( pkgXmlNode *pkg, pkgArchiveStream *source )
 {
   /* Constructor to associate a package tar archive with its
    * nominated sysroot and respective installation directory path,
    * and prepare it for processing, using an appropriate streaming
    * decompression filter; (choice of filter is based on archive
    * file name extension; file names are restricted to the
-   * POSIX Portable Character Set).
+   * POSIX Portable Character Set).  Alternatively, the caller may
+   * furnish an archive stream which is already open, (e.g. one which
+   * is delivering the archive content as it is downloaded), in which
+   * case we adopt it, (and will ultimately delete it).
    *
    * First, we anticipate an invalid initialisation state...
    */
@@ -196,7 +355,14 @@ pkgTarArchiveProcessor::pkgTarArchiveProcessor( pkgXmlNode *pkg )
   sysroot = NULL;
   sysroot_path = NULL;
   installed = NULL;
-  stream = NULL;
+  stream = source;
+  index = NULL;
+  archive_offset = 0;
+  selected_member = NULL;
+  transfer_buffer = NULL;
+  long_linkname = NULL;
+  compare_on_extract = false;
+  content_hash = NULL;
 
   /* The 'pkg' XML database entry must be non-NULL, must
    * represent a package release, and must specify a canonical
@@ -235,13 +401,21 @@ pkgTarArchiveProcessor::pkgTarArchiveProcessor( pkgXmlNode *pkg )
      */
     pkgfile = pkg->ArchiveName();
 
-    /* Finally, initialise the data stream which we will use
-     * for reading the package content.
+    /* Finally, unless the caller has furnished it, initialise the
+     * data stream which we will use for reading the package content.
      */
-    const char *archive_path_template = pkgArchivePath();
-    char archive_path_name[mkpath( NULL, archive_path_template, pkgfile, NULL )];
-    mkpath( archive_path_name, archive_path_template, pkgfile, NULL );
-    stream = pkgOpenArchiveStream( archive_path_name );
+    if( stream == NULL )
+    {
+      const char *archive_path_template = pkgArchivePath();
+      char archive_path_name[mkpath( NULL, archive_path_template, pkgfile, NULL )];
+      mkpath( archive_path_name, archive_path_template, pkgfile, NULL );
+      stream = pkgOpenArchiveStream( archive_path_name );
+
+      /* The archive will normally be stored in the package cache; if
+       * it is xz compressed, we may maintain a sidecar index for it.
+       */
+      index = pkgOpenArchiveIndex( archive_path_name );
+    }
   }
 }
 
@@ -253,54 +427,381 @@ pkgTarArchiveProcessor::~pkgTarArchiveProcessor()
    * data stream.
    */
   free( (void *)(sysroot_path) );
+  free( transfer_buffer );
   delete installed;
+  delete index;
+
+  /* When transaction tracing is enabled, report how often data
+   * read-ahead stalled, on either side of its buffer ring, before
+   * we discard the stream.
+   */
+  DEBUG_INVOKE_IF( DEBUG_REQUEST( DEBUG_TRACE_TRANSACTIONS ) && (stream != NULL),
+      dmh_printf( "  read-ahead stalls: decoder %lu, reader %lu\n",
+	  stream->DecoderStalls(), stream->ReaderStalls()
+	)
+    );
   delete stream;
 }
 
 #endif /* PACKAGE_BASE_COMPONENT */
 
+/* Hard links, and symbolic links, are created by Win32 API functions
+ * which are not supported on all host platforms; (CreateHardLink()
+ * requires Win2K, or later, and an NTFS file system, while use of
+ * CreateSymbolicLink() requires Vista, or later, and, unless the host
+ * is running in developer mode, an elevated privilege).  Thus, we look
+ * up each entry point at run time, and we fall back to making physical
+ * copies of the linked files, when any link cannot be created.
+ */
+#ifndef SYMBOLIC_LINK_FLAG_DIRECTORY
+#define SYMBOLIC_LINK_FLAG_DIRECTORY			0x1
+#endif
+#ifndef SYMBOLIC_LINK_FLAG_ALLOW_UNPRIVILEGED_CREATE
+#define SYMBOLIC_LINK_FLAG_ALLOW_UNPRIVILEGED_CREATE	0x2
+#endif
+
+typedef BOOL (WINAPI *hard_link_api)( LPCSTR, LPCSTR, LPSECURITY_ATTRIBUTES );
+typedef BOOLEAN (WINAPI *symbolic_link_api)( LPCSTR, LPCSTR, DWORD );
+
+static FARPROC kernel32_entry_point( const char *entry )
+{
+  /* Helper to look up the address of a kernel32.dll entry point, (which
+   * will be NULL, if the running host does not support it); kernel32.dll
+   * is always loaded, so we need not acquire any reference to it.
+   */
+  HMODULE kernel32 = GetModuleHandle( "kernel32.dll" );
+  return (kernel32 != NULL) ? GetProcAddress( kernel32, entry ) : NULL;
+}
+
+static bool create_hard_link( const char *pathname, const char *target )
+{
+  /* Helper to create "pathname" as a hard link to "target", when the
+   * host supports it; returns false if the link could not be created.
+   */
+  static hard_link_api CreateHardLinkA
+    = (hard_link_api)(kernel32_entry_point( "CreateHardLinkA" ));
+  return (CreateHardLinkA != NULL) && CreateHardLinkA( pathname, target, NULL );
+}
+
+static bool create_symbolic_link( const char *pathname, const char *target, bool dir )
+{
+  /* Helper to create "pathname" as a symbolic link to "target", (which
+   * must be specified with native directory separators), when the host
+   * supports it; we first attempt to create it without privilege, but,
+   * since older hosts reject this, we retry without asking for it.
+   * Returns false if the link could not be created.
+   */
+  static symbolic_link_api CreateSymbolicLinkA
+    = (symbolic_link_api)(kernel32_entry_point( "CreateSymbolicLinkA" ));
+  DWORD flags = dir ? SYMBOLIC_LINK_FLAG_DIRECTORY : 0;
+  return (CreateSymbolicLinkA != NULL)
+    && (CreateSymbolicLinkA( pathname, target,
+	  flags | SYMBOLIC_LINK_FLAG_ALLOW_UNPRIVILEGED_CREATE
+	) || CreateSymbolicLinkA( pathname, target, flags ));
+}
+
+static int create_linked_entity
+( const char *pathname, const char *source, const char *target )
+{
+  /* Helper to create "pathname" as a link to "source", which must be
+   * identified by its full path name; "target" is NULL, to request a
+   * hard link, otherwise it is the content of a symbolic link, (using
+   * native directory separators).  When the link cannot be created, we
+   * make a physical copy of "source", in its place.
+   */
+  if( target != NULL )
+  {
+    struct stat info;
+    bool dir = (stat( source, &info ) == 0) && S_ISDIR( info.st_mode );
+    if( create_symbolic_link( pathname, target, dir ) )
+      return 0;
+
+    /* We cannot make a physical copy of a directory.
+     */
+    if( dir )
+    {
+      dmh_notify( DMH_ERROR, "%s: cannot link to directory %s\n", pathname, source );
+      return -1;
+    }
+  }
+  else if( create_hard_link( pathname, source ) )
+    return 0;
+
+  /* The link could not be created; make a physical copy of the file
+   * to which it refers, in its place.
+   */
+  if( CopyFile( source, pathname, FALSE ) )
+    return 0;
+
+  dmh_notify( DMH_ERROR, "%s: cannot link to, or copy %s\n", pathname, source );
+  return -1;
+}
+
 int pkgTarArchiveProcessor::ProcessLinkedEntity( const char *pathname )
 {
-  /* FIXME: Win32 links need special handling; for hard links, we
-   * may be able to create them directly, with >= Win2K and NTFS;
-   * for symlinks on *all* Win32 variants, and for hard links on
-   * FAT32 or Win9x, we need to make physical copies of the source
-   * file, at the link target location.
-   *
-   * For now, we simply ignore links.
+  /* Extract a hard link, or a symbolic link entity; in either case,
+   * the archive records the name of the linked entity, (which must have
+   * been extracted already, if it is to be copied), but no content.
+   */
+  if( ! save_on_extract )
+    return 0;
+
+  /* The name of the linked entity may have been specified by a GNU
+   * long link name entry, or a pax extended header; otherwise, it is
+   * recorded within the header, where it is not necessarily NUL
+   * terminated.  In either case, take a terminated copy, and create
+   * the link to it.
    */
-  dmh_printf(
-      "FIXME:ProcessLinkedEntity<stub>:Ignoring link: %s --> %s\n",
-       pathname, header.field.linkname
+  size_t len = (long_linkname != NULL) ? strlen( long_linkname )
+    : sizeof( header.field.linkname );
+  char linkname[len + 1];
+  memcpy( linkname, (long_linkname != NULL) ? long_linkname
+      : header.field.linkname, len
+    );
+  linkname[len] = '\0';
+  return CreateLink( pathname, linkname,
+      *header.field.typeflag == TAR_ENTITY_TYPE_SYMLINK
     );
-  return 0;
 }
 
-static
-uint64_t compute_octval( const char *p, size_t len )
-# define octval( FIELD ) compute_octval( FIELD, sizeof( FIELD ) )
+static bool normalise_link_source( char *path, size_t base )
+{
+  /* Helper to collapse any redundant directory separators, and any "."
+   * or ".." components, in the portion of "path" which follows its first
+   * "base" characters, (i.e. the sysroot prefix, with its separator), in
+   * place; returns false, if any ".." component would refer to a parent
+   * of the sysroot itself.
+   */
+  char *root = path + base, *out = root;
+  const char *in = root;
+  while( *(in += strspn( in, "/\\" )) != '\0' )
+  {
+    size_t len = strcspn( in, "/\\" );
+    if( (len == 2) && (strncmp( in, "..", 2 ) == 0) )
+    {
+      /* Step back over the most recently retained component, (and its
+       * preceding separator); there must be one.
+       */
+      if( out == root )
+	return false;
+      while( (out > root) && (out[-1] != '/') ) --out;
+      if( out > root ) --out;
+    }
+    else if( (len != 1) || (*in != '.') )
+    {
+      /* Retain any other component, (but not "."), preceded by a single
+       * separator, unless it is the first.
+       */
+      if( out > root ) *out++ = '/';
+      memmove( out, in, len );
+      out += len;
+    }
+    in += len;
+  }
+  *out = '\0';
+  return true;
+}
+
+int pkgArchiveProcessor::CreateLink
+( const char *pathname, const char *linkname, bool symbolic )
 {
-  /* Helper to convert the ASCII representation of octal values,
-   * (as recorded within tar archive header fields), to their actual
-   * numeric values, ignoring leading or trailing garbage.
+  /* Create "pathname" as a hard link, or as a symbolic link, to the
+   * entity which "linkname" identifies, exactly as it is recorded in
+   * the archive; this is shared by all archive processors, (although
+   * only tar archives may specify hard links).
    */
-  uint64_t value = 0LL;
+  if( *linkname == '\0' )
+  {
+    dmh_notify( DMH_ERROR, "%s: link has no target\n", pathname );
+    return -1;
+  }
 
-  while( (len > 0) && ((*p < '0') || (*p > '7')) )
+  /* Identify the file system entity to which the link refers; for a
+   * hard link, (or for a symbolic link with an absolute target), its
+   * name is relative to the sysroot, while for a symbolic link with a
+   * relative target, it is relative to the directory which will hold
+   * the link itself.
+   */
+  bool absolute = (*linkname == '/') || (*linkname == '\\');
+  const char *dirname = pathname + sysroot_len;
+  if( symbolic && ! absolute )
+    for( const char *p = dirname; *p; p++ )
+      if( (*p == '/') || (*p == '\\') )
+	dirname = p + 1;
+
+  int dirlen = dirname - pathname;
+  char source[dirlen + strlen( linkname ) + 1];
+  memcpy( source, pathname, dirlen );
+  strcpy( source + dirlen, linkname + strspn( linkname, "/\\" ) );
+
+  /* Whichever way it is specified, the linked entity must lie within
+   * the sysroot; we must reject any link which would refer to anything
+   * outside it, (whether by ".." components, or by a drive designator).
+   */
+  if( (strchr( linkname, ':' ) != NULL)
+  ||  ! normalise_link_source( source, sysroot_len )  )
   {
-    /* Step over leading garbage.
-     */
-    ++p; --len;
+    dmh_notify( DMH_ERROR, "%s: link to %s lies outside the sysroot\n",
+	pathname, linkname
+      );
+    return -1;
   }
-  while( (len > 0) && (*p >= '0') && (*p < '8') )
+
+  /* A symbolic link with a relative target must refer to it exactly
+   * as named in the archive, whereas one with an absolute target must
+   * refer to it within the sysroot; in either case, we must use native
+   * directory separators.
+   */
+  const char *referent = absolute ? source : linkname;
+  char target[strlen( referent ) + 1];
+  for( char *p = strcpy( target, referent ); *p; p++ )
+    if( *p == '/' ) *p = '\\';
+
+  /* A symbolic link may refer to an entity which appears later in the
+   * archive; since we can neither determine whether this represents a
+   * directory, nor copy it, we defer creation of any such link until
+   * the entire archive has been extracted.
+   */
+  struct stat info;
+  if( symbolic && (stat( source, &info ) != 0) )
+    return DeferLink( pathname, source, target );
+
+  return CreateLinkedEntity( pathname, source, symbolic ? target : NULL );
+}
+
+static void prepare_link_location( const char *pathname )
+{
+  /* Helper to ensure that the directory which is to hold a link exists,
+   * and to remove any existing entity which the link is to replace.
+   */
+  const char *p = NULL;
+  for( const char *q = pathname; *q; q++ )
+    if( (*q == '/') || (*q == '\\') )
+      p = q;
+  if( p != NULL )
   {
-    /* Accumulate octal digits; (each represents exactly three
-     * bits in the accumulated value), until we either exhaust
-     * the width of the field, or we encounter trailing junk.
-     */
-    value = (value << 3) + *p++ - '0'; --len;
+    char parent[1 + p - pathname];
+    memcpy( parent, pathname, p - pathname );
+    parent[p - pathname] = '\0';
+    mkdir_recursive( parent, 0755 );
+  }
+  unlink( pathname );
+}
+
+int pkgArchiveProcessor::CreateLinkedEntity
+( const char *pathname, const char *source, const char *target )
+{
+  /* Create a link, which CreateLink() has validated, immediately; (a
+   * NULL "target" requests a hard link).  Derived classes may override
+   * this, to delay creation of the link.
+   */
+  prepare_link_location( pathname );
+  return create_linked_entity( pathname, source, target );
+}
+
+int pkgArchiveProcessor::DeferLink
+( const char *pathname, const char *source, const char *target )
+{
+  /* Record a link, which CreateLink() has validated, for creation by
+   * CreateDeferredLinks(); as for CreateLinkedEntity(), "target" is NULL
+   * for a hard link.
+   */
+  size_t pathname_len = strlen( pathname ) + 1;
+  size_t source_len = strlen( source ) + 1;
+  size_t target_len = (target != NULL) ? strlen( target ) + 1 : 0;
+  tar_deferred_link *link = (tar_deferred_link *)(malloc(
+	sizeof( tar_deferred_link ) + pathname_len + source_len + target_len
+      ));
+  if( link == NULL )
+  {
+    dmh_notify( DMH_ERROR, "%s: cannot record deferred link\n", pathname );
+    return -1;
+  }
+  link->pathname = (char *)(link + 1);
+  link->source = (char *)(memcpy( link->pathname, pathname, pathname_len )) + pathname_len;
+  memcpy( link->source, source, source_len );
+  link->target = NULL;
+  if( target != NULL )
+    link->target = (char *)(memcpy( link->source + source_len, target, target_len ));
+  link->next = deferred_links;
+  deferred_links = link;
+  return 0;
+}
+
+void pkgArchiveProcessor::CreateDeferredLinks()
+{
+  /* Create any links which CreateLink() has deferred; these have been
+   * accumulated in reverse order, so we must reverse the list, to process
+   * them in archive order, (thus allowing any link to refer to another
+   * which precedes it in the archive).
+   */
+  tar_deferred_link *link = NULL;
+  while( deferred_links != NULL )
+  {
+    tar_deferred_link *next = deferred_links->next;
+    deferred_links->next = link;
+    link = deferred_links;
+    deferred_links = next;
+  }
+  while( link != NULL )
+  {
+    tar_deferred_link *next = link->next;
+    prepare_link_location( link->pathname );
+    create_linked_entity( link->pathname, link->source, link->target );
+    free( link );
+    link = next;
+  }
+}
+
+/* Numeric values within tar header fields are interpreted by the
+ * compute_octval() helper, from tarhdr.h, with the width of each field
+ * implied by the field itself.
+ */
+#define octval( FIELD ) compute_octval( FIELD, sizeof( FIELD ) )
+
+static
+void store_header_number( char *field, size_t len, int64_t value )
+# define set_octval( FIELD, VALUE ) store_header_number( FIELD, sizeof( FIELD ), VALUE )
+{
+  /* Helper to record a numeric value, which has been specified in
+   * a pax extended header, in place of that within the header field
+   * which it overrides, so that any subsequent octval() reference to
+   * the field will retrieve it; we always use the base-256 notation,
+   * as decoded by compute_octval(), since the value may not be
+   * representable in the octal digits which the field accommodates.
+   */
+  *field = (value < 0) ? 0xFF : 0x80;
+  while( --len > 0 )
+  {
+    field[len] = (char)(value & 0xFF);
+    value >>= 8;
   }
-  return value;
+}
+
+static
+void release_extended_attributes( tar_extended_attributes *attrs )
+{
+  /* Helper to discard any attributes which have been collected from
+   * GNU long name, or long link name entries, or from pax extended
+   * headers, leaving the collection empty.
+   */
+  free( attrs->path );
+  free( attrs->linkpath );
+  attrs->path = attrs->linkpath = NULL;
+  attrs->flags = 0;
+}
+
+static inline
+bool is_tar_metadata_entry( char type )
+{
+  /* Helper to identify those archive entries which do not represent
+   * file system entities, but rather specify attributes for the entry,
+   * (or entries), which follow them.
+   */
+  return (type == TAR_ENTITY_TYPE_GNU_LONGNAME)
+    ||   (type == TAR_ENTITY_TYPE_GNU_LONGLINK)
+    ||   (type == TAR_ENTITY_TYPE_PAX_HEADER)
+    ||   (type == TAR_ENTITY_TYPE_PAX_GLOBAL);
 }
 
 int pkgTarArchiveProcessor::GetArchiveEntry()
@@ -311,6 +812,7 @@ int pkgTarArchiveProcessor::GetArchiveEntry()
    */
   char *buf = header.aggregate;
   size_t count = stream->Read( buf, sizeof( header ) );
+  if( count == sizeof( header ) ) archive_offset += count;
 
   if( count < sizeof( header ) )
   {
@@ -320,49 +822,29 @@ int pkgTarArchiveProcessor::GetArchiveEntry()
     return TAR_ARCHIVE_DATA_READ_ERROR;
   }
 
-  while( count-- )
+  /* Check for an all zero header, while computing both the unsigned,
+   * and the signed, forms of the checksum...
+   */
+  unsigned sums[2];
+  if( ! sum_tar_header( buf, header.field.chksum, sums ) )
     /*
-     * Outer loop checks for an all zero header...
+     * ...returning zero, to indicate end of archive, on finding
+     * an all zero header.
      */
-    if( *buf++ != '\0' )
-    {
-      /* Any non-zero byte transfers control to an inner loop,
-       * to rescan the entire header, accumulating its checksum...
-       */
-      uint64_t sum = 0;
-      for( buf = header.aggregate, count = sizeof( header ); count--; ++buf )
-      {
-	if( (buf < header.field.chksum) || (buf >= header.field.typeflag) )
-	  /*
-	   * ...counting the actual binary value of each byte,
-	   * in all but the checksum field itself...
-	   */
-	  sum += *buf;
-	else
-	  /* ...while treating each byte within the checksum field as
-	   * having an effective value equivalent to ASCII <space>.
-	   */
-	  sum += 0x20;
-      }
-      /* After computing the checksum for a non-zero header,
-       * verify it against the value recorded in the checksum field;
-       * return +1 for a successful match...
-       */
-      if( sum == octval( header.field.chksum ) )
-       	return 1;
+    return 0;
 
-      /* ...otherwise diagnose checksum validation failure, and
-       * return the fault status.
-       */
-      dmh_notify( DMH_ERROR, "checksum validation failed\n" );
-      return TAR_ARCHIVE_FORMAT_ERROR;
-    }
+  /* Verify either checksum against the value recorded in the checksum
+   * field; return +1 for a successful match...
+   */
+  uint64_t expected = octval( header.field.chksum );
+  if( (expected == sums[0]) || (expected == sums[1]) )
+    return 1;
 
-  /* If we get to here, then the inner loop was never entered;
-   * the outer loop has completed, confirming an all zero header;
-   * return zero, to indicate end of archive.
+  /* ...otherwise diagnose checksum validation failure, and
+   * return the fault status.
    */
-  return 0;
+  dmh_notify( DMH_ERROR, "checksum validation failed\n" );
+  return TAR_ARCHIVE_FORMAT_ERROR;
 }
 
 int pkgTarArchiveProcessor::Process()
@@ -371,48 +853,147 @@ int pkgTarArchiveProcessor::Process()
    * content; loops over each archive entry in turn...
    */
   int status;
+  uint64_t entry_offset = archive_offset;
+  tar_extended_attributes global = { NULL, NULL, 0, 0, 0 };
   while( (status = GetArchiveEntry()) > 0 )
   {
-    char *prefix = *header.field.prefix ? header.field.prefix : NULL;
-    char *name = header.field.name;
-
-    /* Handle the GNU long name header format. 
-     * If the pathname overflows the name field, GNU tar creates a special
-     * entry type, where the data contains the full pathname for the
-     * following entry.
+    /* Any archive entry may be preceded by a GNU long name, or long
+     * link name entry, (which GNU tar creates, when the name, or link
+     * name, overflows its header field), and, or by a pax extended
+     * header, (which specifies attributes such as path, size, or mtime,
+     * which override the header fields); each is itself represented as
+     * a pseudo-entry, the data for which specifies the attributes for
+     * the entry which follows.  Similarly, a pax global header specifies
+     * attributes which apply to all subsequent entries, (unless they are
+     * overridden by an extended header); collect all such attributes,
+     * until we find the entry to which they apply.
      */
-    char *longname = NULL;
-    if( *header.field.typeflag == TAR_ENTITY_TYPE_GNU_LONGNAME )
+    tar_extended_attributes local = { NULL, NULL, 0, 0, 0 };
+    const char *metadata = NULL;
+    while( (status > 0) && is_tar_metadata_entry( *header.field.typeflag ) )
     {
-      /* Extract the full pathname from the data of this entry.
-       */
-      if( (longname = EntityDataAsString()) == NULL )
+      char **longname;
+      switch( *header.field.typeflag )
+      {
+	case TAR_ENTITY_TYPE_GNU_LONGNAME:
+	  metadata = "long name";
+	  longname = &local.path;
+	  break;
+
+	case TAR_ENTITY_TYPE_GNU_LONGLINK:
+	  metadata = "long link name";
+	  longname = &local.linkpath;
+	  break;
+
+	case TAR_ENTITY_TYPE_PAX_HEADER:
+	  metadata = "pax extended header";
+	  longname = NULL;
+	  break;
+
+	default:
+	  longname = NULL;
+      }
+      if( longname != NULL )
       {
-        dmh_notify( DMH_ERROR, "Unable to read a long name entry\n" );
-	return TAR_ARCHIVE_FORMAT_ERROR;
+	/* Extract the full long name, or long link name, from the data
+	 * of this entry; (when more than one is specified, for any one
+	 * entry, the last takes precedence).
+	 */
+	free( *longname );
+	if( (*longname = EntityDataAsString()) == NULL )
+	{
+	  dmh_notify( DMH_ERROR, "Unable to read a %s entry\n", metadata );
+	  status = TAR_ARCHIVE_FORMAT_ERROR;
+	  break;
+	}
       }
+      /* Otherwise, parse the pax header records, collecting attributes
+       * for the next entry, or for all subsequent entries, as required.
+       */
+      else if( (status = ProcessExtendedHeader(
+	      (*header.field.typeflag == TAR_ENTITY_TYPE_PAX_GLOBAL) ? &global : &local
+	    )) < 0 )
+	break;
 
-      /* Read the entry for which this long name is intended.
+      /* Read the header for the entry which follows; (an end of archive
+       * mark is acceptable, only after a pax global header).
        */
-      if( GetArchiveEntry() <= 0 )
+      if( ((status = GetArchiveEntry()) == 0) && (metadata != NULL) )
       {
-        dmh_notify( DMH_ERROR, "Expected a new entry after a long name entry\n" );
-	return TAR_ARCHIVE_FORMAT_ERROR;
+	dmh_notify( DMH_ERROR, "Expected a new entry after a %s entry\n", metadata );
+	status = TAR_ARCHIVE_FORMAT_ERROR;
       }
-
-      /* Use the previously determined long name as the pathname for this entry.
+    }
+    if( status <= 0 )
+    {
+      /* We reached the end of the archive, after a pax global header,
+       * or we failed to read the attributes for, or the header of, the
+       * entry to which they were to apply.
        */
+      release_extended_attributes( &local );
+      break;
+    }
+    char *prefix = *header.field.prefix ? header.field.prefix : NULL;
+    char *name = header.field.name;
+
+    /* Apply the collected attributes; those specified for this entry
+     * take precedence over any which have been specified globally.  We
+     * must use any specified path as is, (disregarding the prefix field
+     * of the header), and we override the size, and mtime fields of the
+     * header itself, so that they will be honoured by all handlers.
+     */
+    if( (local.path != NULL) || (global.path != NULL) )
+    {
+      name = (local.path != NULL) ? local.path : global.path;
       prefix = NULL;
-      name = longname;
+    }
+    long_linkname = (local.linkpath != NULL) ? local.linkpath : global.linkpath;
+    if( ((local.flags | global.flags) & TAR_EXTENDED_SIZE) != 0 )
+      set_octval( header.field.size, (int64_t)(((local.flags & TAR_EXTENDED_SIZE) != 0)
+	  ? local.size : global.size)
+	);
+    if( ((local.flags | global.flags) & TAR_EXTENDED_MTIME) != 0 )
+      set_octval( header.field.mtime, ((local.flags & TAR_EXTENDED_MTIME) != 0)
+	  ? local.mtime : global.mtime
+	);
+
+    /* When we are processing only one selected archive member, we
+     * skip over any entry which does not match it.
+     */
+    if( ! SelectArchiveEntry( entry_offset, name, prefix ) )
+    {
+      release_extended_attributes( &local );
+      long_linkname = NULL;
+      ProcessEntityData( -1 );
+      entry_offset = archive_offset;
+      continue;
     }
 
     /* Found an archive entry; map it to an equivalent file system
      * path name, within the designated sysroot hierarchy.
      */
-    char pathname[mkpath( NULL, sysroot_path, name, prefix )];
-    mkpath( pathname, sysroot_path, name, prefix );
+    char *pathname = (char *)(EntryPathName( name, prefix ));
+    if( pathname == NULL )
+    {
+      dmh_notify( DMH_ERROR, "Unable to allocate an extraction path name\n" );
+      release_extended_attributes( &local );
+      release_extended_attributes( &global );
+      long_linkname = NULL;
+      return TAR_ARCHIVE_FORMAT_ERROR;
+    }
 
-    free( longname );
+    /* A specialisation may elect to exclude this entry, (in which case
+     * it is responsible for keeping any record of having done so); we
+     * simply skip over any associated data, to the next entry.
+     */
+    if( ExcludeArchiveEntry( pathname ) )
+    {
+      release_extended_attributes( &local );
+      long_linkname = NULL;
+      ProcessEntityData( -1 );
+      entry_offset = archive_offset;
+      continue;
+    }
 
     /* Direct further processing to the appropriate handler; (this
      * is specific to the archive entry classification)...
@@ -434,7 +1015,7 @@ int pkgTarArchiveProcessor::Process()
 	    * to call stat(), to check if the specified directory already
 	    * exists), we remove any such trailing slashes.
 	    */
-	   char *p = pathname + sizeof( pathname ) - 1;
+	   char *p = pathname + strlen( pathname );
 	   while( (p > pathname) && ((*--p == '/') || (*p == '\\')) )
 	     *p = '\0';
 	 }
@@ -477,84 +1058,231 @@ int pkgTarArchiveProcessor::Process()
 	    "unexpected archive entry classification: type %d\n",
 	    (int)(*header.field.typeflag)
 	  );
+	release_extended_attributes( &local );
+	release_extended_attributes( &global );
+	long_linkname = NULL;
 	return -1;
     }
+    /* Attributes which were specified for this entry, (but not those
+     * which were specified globally), are no longer required.
+     */
+    release_extended_attributes( &local );
+    long_linkname = NULL;
+
+    /* When we were seeking only one selected member, we are done;
+     * otherwise, we go on to process the next archive entry.
+     */
+    if( selected_member != NULL )
+    {
+      release_extended_attributes( &global );
+      return 0;
+    }
+    entry_offset = archive_offset;
   }
+  release_extended_attributes( &global );
+
+#if IMPLEMENTATION_LEVEL == PACKAGE_BASE_COMPONENT
+  /* When we have read the entire archive, through to its end marker,
+   * we have the information we need to store a sidecar index.
+   */
+  if( (status == 0) && (index != NULL) )
+    index->Commit();
+#endif
+
   /* If we didn't bail out before getting to here, then the archive
-   * was processed successfully; return the success code.
+   * was processed successfully, unless we failed to read a complete
+   * header, (e.g. because the archive was truncated, or its download
+   * was interrupted), or we were seeking a selected member, and didn't
+   * find it; return the appropriate code.
    */
-  return 0;
+  if( status < 0 )
+    return status;
+  return (selected_member != NULL) ? TAR_ARCHIVE_MEMBER_NOT_FOUND : 0;
 }
 
-int pkgTarArchiveProcessor::ProcessEntityData( int fd )
+bool pkgTarArchiveProcessor::SelectArchiveEntry
+( uint64_t offset, const char *name, const char *prefix )
 {
-  /* Generic method for reading past the data associated with
-   * a specific header within a tar archive; if given a negative
-   * value for `fd', it will simply skip over the data, otherwise
-   * `fd' is assumed to represent a descriptor for an opened file
-   * stream, to which the data will be copied (extracted).
+  /* Helper method to record the offset of an archive entry, within the
+   * decompressed archive stream, in the sidecar index, (if any), then
+   * to decide whether it should be processed; (this is always the case,
+   * unless we are processing a selected member, by name, only).
    */
-   int status = 0;
+  char member[(prefix ? strlen( prefix ) + 1 : 0) + strlen( name ) + 1];
+  *member = '\0';
+  if( prefix != NULL ) strcat( strcat( member, prefix ), "/" );
+  strcat( member, name );
 
-  /* Initialise a counter for the length of the data content, and
-   * specify the default size for the transfer buffer in which to
-   * process it; make the initial size of the transfer buffer 16
-   * times the header size.
-   */
-  uint64_t bytes_to_copy = octval( header.field.size );
-  size_t block_size = sizeof( header ) << 4;
+#if IMPLEMENTATION_LEVEL == PACKAGE_BASE_COMPONENT
+  if( index != NULL ) index->Record( member, offset );
+#endif
 
-  /* While we still have unread data, and no processing error...
+  if( selected_member == NULL )
+    return true;
+
+  /* We have a selected member; compare its name with that of the
+   * current entry, disregarding any leading "./" on either.
+   */
+  const char *wanted = selected_member, *entry = member;
+  while( strncmp( wanted, "./", 2 ) == 0 ) wanted += 2;
+  while( strncmp( entry, "./", 2 ) == 0 ) entry += 2;
+  return strcmp( wanted, entry ) == 0;
+}
+
+#if IMPLEMENTATION_LEVEL == PACKAGE_BASE_COMPONENT
+
+int pkgTarArchiveProcessor::ProcessMember( const char *name )
+{
+  /* Method to process one archive member, selected by name; when we
+   * have a sidecar index, we use it to locate the member directly...
    */
-  while( (bytes_to_copy > 0) && (status == 0) )
+  pkgArchiveStream *member;
+  int status = TAR_ARCHIVE_MEMBER_NOT_FOUND;
+
+  selected_member = name;
+  if( (index != NULL) && ((member = index->OpenMember( name )) != NULL) )
   {
-    /* Adjust the requested size for the transfer buffer, shrinking
-     * it by 50% at each step, until it is smaller than the remaining
-     * data length, but never smaller than the header record length.
+    /* ...temporarily substituting a stream which begins at the member's
+     * header, for the archive stream, (so that, if we need to fall back
+     * to a sequential scan, we may resume that from its current state).
+     */
+    pkgArchiveStream *archive = stream;
+    uint64_t offset = archive_offset;
+
+    stream = member;
+    status = pkgTarArchiveProcessor::Process();
+    stream = archive;
+    archive_offset = offset;
+    delete member;
+  }
+  if( status == TAR_ARCHIVE_MEMBER_NOT_FOUND )
+    /*
+     * ...otherwise, (or if the index proved to be unreliable), we
+     * fall back to scanning the archive stream, sequentially.
      */
-    while( (bytes_to_copy < block_size) && (block_size > sizeof( header )) )
-      block_size >>= 1;
+    status = pkgTarArchiveProcessor::Process();
+
+  selected_member = NULL;
+  return status;
+}
+
+#endif /* PACKAGE_BASE_COMPONENT */
+
+int pkgTarArchiveProcessor::ProcessEntityData( int fd )
+{
+  /* Generic method for reading past the data associated with
+   * a specific header within a tar archive; if given a negative
+   * value for `fd', it will simply skip over the data, otherwise
+   * `fd' is assumed to represent a descriptor for an opened file
+   * stream, to which the data will be copied (extracted).
+   */
+   int status = 0;
+
+  /* Initialise a counter for the length of the data content, and
+   * another for the total length of the archive records which it
+   * occupies, (i.e. rounded up to a multiple of the header size, to
+   * include any padding bytes which follow the data).
+   */
+  uint64_t bytes_to_copy = octval( header.field.size );
+  uint64_t bytes_to_skip = bytes_to_copy + sizeof( header ) - 1;
+  bytes_to_skip -= bytes_to_skip % sizeof( header );
 
-    /* Allocate a transfer buffer of the requested size, and populate
-     * it, by reading data from the archive; (since the transfer buffer
-     * is never smaller than the header length, this will also capture
-     * any additional padding bytes, which may be required to keep the
-     * data length equal to an exact multiple of the header length).
+  /* Data which is not written directly from the stream's view, (as
+   * described below), is accumulated in our transfer buffer; count how
+   * many bytes are pending within it.
+   */
+  size_t buffered = 0;
+
+  /* While we still have unread data, and no processing error...
+   */
+  while( (bytes_to_skip > 0) && (status == 0) )
+  {
+    /* Ask the archive stream to lend us a view of its next available
+     * block of decoded data; we may then write it directly from the
+     * decoder's own output buffer, without copying it.
      */
-    char buffer[block_size];
-    if( stream->Read( buffer, block_size ) < (int)(block_size) )
+    const char *data;
+    int block_size = stream->GetView( &data );
+    if( block_size <= 0 )
       /*
-       * Failure to fully populate the transfer buffer, (i.e. a short
-       * read), indicates a corrupt archive; bail out immediately.
+       * Failure to obtain any data, before we have read the entire
+       * content of the archive entry, indicates a corrupt archive;
+       * bail out immediately.
        */
       return TAR_ARCHIVE_DATA_READ_ERROR;
 
-    /* When the number of actual data bytes expected is fewer than the
-     * total number of bytes in the transfer buffer...
+    /* The view may extend beyond the records which represent the
+     * current archive entry; we must not consume any such excess.
      */
-    if( bytes_to_copy < block_size )
-      /*
-       * ...then we have reached the end of the data for the current
-       * archived entity; adjust the block size to reflect the number
-       * of actual data bytes present in the transfer buffer...
-       */
-      block_size = bytes_to_copy;
+    if( (uint64_t)(block_size) > bytes_to_skip )
+      block_size = bytes_to_skip;
 
-    /* With the number of actual data bytes present now accurately
-     * reflected by the block size, we save that data to the stream
-     * specified for archive extraction, (if any).
+    /* Any data bytes within the view, (excluding padding), are saved
+     * to the stream specified for archive extraction, (if any).
      */
-    if( (fd >= 0) && (write( fd, buffer, block_size ) != (int)(block_size)) )
-      /*
-       * An extraction error occurred; set the status code to
-       * indicate failure.
+    size_t count = (bytes_to_copy < (uint64_t)(block_size))
+      ? bytes_to_copy : block_size;
+    if( (fd >= 0) && (count > 0) )
+    {
+      /* When nothing is pending in the transfer buffer, and the view
+       * either includes all remaining data for the entry, (as it will,
+       * for the majority of small files, which are then written with a
+       * single system call), or it is at least as large as the transfer
+       * buffer, we write directly from the view...
        */
-      status = TAR_ARCHIVE_DATA_WRITE_ERROR;
+      if( (buffered == 0)
+      &&  ((count == bytes_to_copy) || (count >= TransferBufferSize))  )
+      {
+	if( update_output_stream( fd, data, count, &compare_on_extract ) != (int)(count) )
+	  /*
+	   * An extraction error occurred; set the status code to
+	   * indicate failure.
+	   */
+	  status = TAR_ARCHIVE_DATA_WRITE_ERROR;
+      }
+      else if( (transfer_buffer != NULL)
+      ||  ((transfer_buffer = (char *)(malloc( TransferBufferSize ))) != NULL)  )
+      {
+	/* ...otherwise, we coalesce successive views, in the transfer
+	 * buffer, (consuming no more of the current view than will fit),
+	 * and we write the buffer content only when it is full, or when
+	 * it contains all remaining data for the entry.
+	 */
+	if( count > (TransferBufferSize - buffered) )
+	  block_size = count = TransferBufferSize - buffered;
+	memcpy( transfer_buffer + buffered, data, count );
+	if( (((buffered += count) == TransferBufferSize) || (count == bytes_to_copy))
+	&&  (update_output_stream( fd, transfer_buffer, buffered, &compare_on_extract )
+	      != (int)(buffered))  )
+	  status = TAR_ARCHIVE_DATA_WRITE_ERROR;
+	if( buffered == TransferBufferSize ) buffered = 0;
+      }
+      else if( update_output_stream( fd, data, count, &compare_on_extract ) != (int)(count) )
+	/*
+	 * We were unable to allocate a transfer buffer; fall back to
+	 * writing directly from each view, in turn.
+	 */
+	status = TAR_ARCHIVE_DATA_WRITE_ERROR;
+
+#if IMPLEMENTATION_LEVEL == PACKAGE_BASE_COMPONENT
+      /* When the caller has requested a content hash, we update it
+       * from the same view, while its data remains in cache; (note
+       * that this must include any data which was found to be left
+       * unchanged, when updating an existing file).
+       */
+      if( content_hash != NULL )
+	xxh64_update( content_hash, data, count );
+#endif
+    }
 
-    /* Adjust the count of remaining unprocessed data bytes, and begin
-     * a new processing cycle, to capture any which may be present.
+    /* Release the view, adjust the counts of remaining unprocessed
+     * bytes, and begin a new processing cycle, to capture any which
+     * may be present.
      */
-    bytes_to_copy -= block_size;
+    stream->ReleaseView( block_size );
+    archive_offset += block_size;
+    bytes_to_copy -= count;
+    bytes_to_skip -= block_size;
   }
 
   /* Finally, when all data for the current archive entry has been
@@ -572,12 +1300,14 @@ char *pkgTarArchiveProcessor::EntityDataAsString()
    *
    * It is assumed that the return data can be accommodated within available
    * heap memory.  Since the length isn't returned, we assume that the string
-   * is NUL-terminated, and that it contains no embedded NULs.
+   * contains no embedded NULs; we append a terminating NUL, in case the
+   * data doesn't already include one.
    *
    * In the event of any error, NULL is returned.
    */
   char *data;
-  uint64_t bytes_to_copy = octval( header.field.size );
+  uint64_t length = octval( header.field.size );
+  uint64_t bytes_to_copy = length;
   
   /* Round the buffer size to the smallest multiple of the record size.
    */
@@ -586,7 +1316,7 @@ char *pkgTarArchiveProcessor::EntityDataAsString()
 
   /* Allocate the data buffer.
    */
-  data = (char*)(malloc( bytes_to_copy ));
+  data = (char*)(malloc( bytes_to_copy + 1 ));
   if( !data )
     return NULL;
   
@@ -601,9 +1331,213 @@ char *pkgTarArchiveProcessor::EntityDataAsString()
     free( data );
     return NULL;
   }
+  archive_offset += count;
+  data[length] = '\0';
   return data;
 }
 
+static
+int pax_record_length( const char *record, size_t avail )
+{
+  /* Helper to interpret the decimal length field, (which includes
+   * the length of the field itself), at the start of a pax extended
+   * header record; returns the record length, or zero if "avail" bytes
+   * don't extend far enough to include the entire field, or -1 if it
+   * is malformed.
+   */
+  size_t len = 0;
+  for( size_t i = 0; i < avail; i++ )
+  {
+    if( record[i] == ' ' )
+      return ((i > 0) && (len > i + 1)) ? (int)(len) : -1;
+    if( (record[i] < '0') || (record[i] > '9') || (len > 0x7FFFFFF) )
+      return -1;
+    len = len * 10 + record[i] - '0';
+  }
+  return 0;
+}
+
+static
+int apply_extended_attribute( tar_extended_attributes *attrs, const char *record, size_t len )
+{
+  /* Helper to interpret one complete pax extended header record, of
+   * the form "<len> <keyword>=<value>\n", and to store the value in the
+   * "attrs" collection, if it is one which we support; returns zero on
+   * success, or -1 if the record is malformed.
+   */
+  const char *key = (const char *)(memchr( record, ' ', len ));
+  const char *end = record + len - 1;
+  const char *value;
+  if( (*end != '\n') || (key == NULL)
+  ||  ((value = (const char *)(memchr( ++key, '=', end - key ))) == NULL)  )
+    return -1;
+
+  size_t keylen = value++ - key;
+  size_t vlen = end - value;
+# define is_keyword( NAME ) \
+  ((keylen == sizeof( NAME ) - 1) && (memcmp( key, NAME, keylen ) == 0))
+
+  if( is_keyword( "path" ) || is_keyword( "linkpath" ) )
+  {
+    /* Path names are taken as is, (as NUL terminated strings); an empty
+     * value cancels any previous specification.
+     */
+    char **name = (*key == 'p') ? &attrs->path : &attrs->linkpath;
+    free( *name ); *name = NULL;
+    if( (vlen > 0) && ((*name = (char *)(malloc( vlen + 1 ))) != NULL) )
+    {
+      memcpy( *name, value, vlen );
+      (*name)[vlen] = '\0';
+    }
+    return ((vlen > 0) && (*name == NULL)) ? -1 : 0;
+  }
+  if( is_keyword( "size" ) || is_keyword( "mtime" ) )
+  {
+    /* Numeric values are decimal, and an empty value, once again,
+     * cancels any previous specification; an mtime may be negative,
+     * and may include a fractional part, which we must disregard,
+     * since we cannot represent it.
+     */
+    bool mtime = (*key == 'm');
+    unsigned flag = mtime ? TAR_EXTENDED_MTIME : TAR_EXTENDED_SIZE;
+    attrs->flags &= ~flag;
+    if( vlen == 0 )
+      return 0;
+
+    bool negative = mtime && (*value == '-');
+    const char *p = negative ? value + 1 : value;
+    uint64_t number = 0;
+    if( (p == end) || (*p < '0') || (*p > '9') )
+      return -1;
+    while( (p < end) && (*p >= '0') && (*p <= '9') )
+      number = number * 10 + *p++ - '0';
+    if( mtime && (p < end) && (*p == '.') )
+      while( (++p < end) && (*p >= '0') && (*p <= '9') )
+	;
+    if( p < end )
+      return -1;
+
+    if( mtime )
+      attrs->mtime = negative ? -(int64_t)(number) : (int64_t)(number);
+    else
+      attrs->size = number;
+    attrs->flags |= flag;
+  }
+  /* Any other keyword, (e.g. atime, uname, or any vendor specific
+   * attribute), is of no interest to us; we simply ignore it.
+   */
+# undef is_keyword
+  return 0;
+}
+
+int pkgTarArchiveProcessor::ProcessExtendedHeader( tar_extended_attributes *attrs )
+{
+  /* Method to interpret the data associated with a pax extended, or
+   * global header, collecting those attributes which we support; rather
+   * than reading the entire data into a heap buffer, (as we do within
+   * EntityDataAsString()), we parse each record in place, within the
+   * views lent to us by the archive stream, copying only those which
+   * happen to span the boundary between successive views.
+   */
+  int status = 0;
+  uint64_t bytes_to_copy = octval( header.field.size );
+  uint64_t bytes_to_skip = bytes_to_copy + sizeof( header ) - 1;
+  bytes_to_skip -= bytes_to_skip % sizeof( header );
+
+  /* Any record which spans a view boundary is accumulated in this
+   * buffer, until it is complete.
+   */
+  char *record = NULL;
+  size_t held = 0, capacity = 0;
+
+  while( bytes_to_skip > 0 )
+  {
+    const char *data;
+    int block_size = stream->GetView( &data );
+    if( block_size <= 0 )
+    {
+      /* The archive is truncated; bail out immediately.
+       */
+      free( record );
+      dmh_notify_archive_data_exhausted( "pax header" );
+      return TAR_ARCHIVE_DATA_READ_ERROR;
+    }
+    if( (uint64_t)(block_size) > bytes_to_skip )
+      block_size = bytes_to_skip;
+
+    /* Parse the records within the view, (excluding any padding);
+     * after any error, we simply continue to consume views, until we
+     * have skipped over all data for the header.
+     */
+    size_t count = (bytes_to_copy < (uint64_t)(block_size))
+      ? bytes_to_copy : block_size;
+    const char *p = data, *end = data + count;
+    while( (status == 0) && (p < end) )
+    {
+      size_t avail = end - p;
+      int len = pax_record_length( (held > 0) ? record : p, (held > 0) ? held : avail );
+      if( len < 0 )
+	status = -1;
+
+      else if( (held == 0) && (len > 0) && ((size_t)(len) <= avail) )
+      {
+	/* The entire record lies within the current view; interpret
+	 * it in place.
+	 */
+	status = apply_extended_attribute( attrs, p, len );
+	p += len;
+      }
+      else
+      {
+	/* The record extends beyond the current view; copy as much of
+	 * it as we can, (but, while its length remains undetermined, no
+	 * more than we need to determine it), into the record buffer.
+	 */
+	const char *space;
+	size_t take = (len > 0) ? len - held
+	  : ((space = (const char *)(memchr( p, ' ', avail ))) != NULL)
+	  ? space - p + 1 : avail;
+	if( take > avail )
+	  take = avail;
+	if( (held + take) > capacity )
+	{
+	  char *buf;
+	  size_t want = (len > 0) ? len : held + take;
+	  if( (buf = (char *)(realloc( record, want ))) == NULL )
+	  {
+	    status = -1;
+	    break;
+	  }
+	  record = buf; capacity = want;
+	}
+	memcpy( record + held, p, take );
+	held += take; p += take;
+	if( (len > 0) && (held == (size_t)(len)) )
+	{
+	  /* The buffered record is now complete; interpret it.
+	   */
+	  status = apply_extended_attribute( attrs, record, len );
+	  held = 0;
+	}
+      }
+    }
+    stream->ReleaseView( block_size );
+    archive_offset += block_size;
+    bytes_to_copy -= count;
+    bytes_to_skip -= block_size;
+  }
+  free( record );
+
+  /* Any record which remains incomplete, when we reach the end of the
+   * header data, is also malformed.
+   */
+  if( (status == 0) && (held == 0) )
+    return 0;
+
+  dmh_notify( DMH_ERROR, "malformed pax extended header\n" );
+  return TAR_ARCHIVE_FORMAT_ERROR;
+}
+
 /*******************
  *
  * Class Implementation: pkgTarArchiveExtractor
@@ -669,11 +1603,22 @@ static int commit_saved_entity( const char *pathname, __time64_t mtime )
   }
 }
 
-pkgTarArchiveExtractor::pkgTarArchiveExtractor( const char *fn, const char *dir )
+int pkgArchiveProcessor::CommitSavedEntity( const char *pathname, int64_t mtime )
+{
+  /* Expose the preceding helper to all archive processors, (including
+   * those which are implemented in other translation units).
+   */
+  return commit_saved_entity( pathname, (__time64_t)(mtime) );
+}
+
+pkgTarArchiveExtractor::pkgTarArchiveExtractor
+( const char *fn, const char *dir, const char *member )
 {
   /* A simplified variation on the installer theme; this extracts
    * the tar archive named by "fn" into any arbitrarily chosen path,
-   * specified by "dir", without creating an installation record.
+   * specified by "dir", without creating an installation record;
+   * optionally, extraction may be restricted to the one archive
+   * member which is named by "member".
    *
    * The extractor uses a specialised constructor; however, we
    * begin by initialising as for the general case.
@@ -703,10 +1648,24 @@ pkgTarArchiveExtractor::pkgTarArchiveExtractor( const char *fn, const char *dir
     sysroot_path = strdup( template_text );
   }
   /* Finally, open the specified archive using the appropriate
-   * stream type, and invoke the extraction Process() method.
+   * stream type, and invoke the extraction Process() method, (or,
+   * for a single member, the ProcessMember() method, which will
+   * make use of the archive's sidecar index, when available).
    */
   stream = pkgOpenArchiveStream( fn );
+  mkdir_cache_enable();
+#if IMPLEMENTATION_LEVEL == PACKAGE_BASE_COMPONENT
+  index = pkgOpenArchiveIndex( fn );
+  if( member != NULL )
+  {
+    if( ProcessMember( member ) == TAR_ARCHIVE_MEMBER_NOT_FOUND )
+      dmh_notify( DMH_ERROR, "%s: %s: no such archive member\n", fn, member );
+  }
+  else
+#endif
   Process();
+  CreateDeferredLinks();
+  mkdir_cache_disable( NULL );
 }
 
 int pkgTarArchiveExtractor::ProcessDirectory( const char *pathname )
@@ -740,19 +1699,688 @@ int pkgTarArchiveExtractor::ProcessDataStream( const char *pathname )
 
 #if IMPLEMENTATION_LEVEL == PACKAGE_BASE_COMPONENT
 
+EXTERN_C void report_mkdir_cache_savings( void )
+{
+  /* Helper to close the directory cache, at the end of any archive
+   * installation, reporting the savings which it achieved, when tracing
+   * of transactions is enabled.
+   */
+  unsigned long hits;
+  if( mkdir_cache_disable( &hits ) == 0 )
+  {
+    DEBUG_INVOKE_IF( DEBUG_REQUEST( DEBUG_TRACE_TRANSACTIONS ),
+	dmh_printf( "  directory cache: avoided %lu mkdir() and %lu stat() calls\n",
+	    hits, hits
+	  )
+      );
+  }
+}
+
+EXTERN_C void preallocate_output_stream( int fd, uint64_t size )
+{
+  /* Helper to reserve disk space for an extracted file, in its entirety,
+   * before any of its content is written, provided its size is at least
+   * that specified by the "preallocate-threshold" option, (in kilobytes;
+   * 1024 by default, or zero to disable); extending the file to its final
+   * length, with a single SetEndOfFile() call, allows the file system to
+   * allocate contiguous space, rather than extending the file piecemeal,
+   * as each block of content is appended.  Failure is inconsequential;
+   * the file is then simply extended, as it is written.
+   */
+  pkgOpts *options = pkgOptions();
+  uint64_t threshold = options->IsSet( OPTION_PREALLOCATE_THRESHOLD )
+    ? options->GetValue( OPTION_PREALLOCATE_THRESHOLD ) : 1024;
+  if( (fd >= 0) && (threshold > 0) && (size >= (threshold << 10)) )
+  {
+    LARGE_INTEGER offset;
+    HANDLE file = (HANDLE)(_get_osfhandle( fd ));
+    offset.QuadPart = size;
+    if( (file != INVALID_HANDLE_VALUE)
+    &&  SetFilePointerEx( file, offset, NULL, FILE_BEGIN )  )
+    {
+      /* The file pointer must be restored to the start of the file,
+       * whether or not the file could be extended.
+       */
+      SetEndOfFile( file );
+      offset.QuadPart = 0;
+      SetFilePointerEx( file, offset, NULL, FILE_BEGIN );
+    }
+  }
+}
+
+static int reuse_installed_file( const char *pathname, uint64_t size )
+{
+  /* Helper to open an existing file, belonging to the prior install
+   * of a package which is being updated in place, when its size matches
+   * that of the archive entry which is to replace it, so that we may use
+   * update_output_stream() to compare its content; any other such file,
+   * (including any symbolic link), is deleted, so that its replacement
+   * may be created afresh, just as if it had been removed along with
+   * the prior installation.  Returns a file descriptor for the reused
+   * file, or -1 if there is none.
+   */
+  struct stat info;
+  DWORD attributes = GetFileAttributesA( pathname );
+  if( (attributes == INVALID_FILE_ATTRIBUTES) || (stat( pathname, &info ) != 0)
+  ||  ((attributes & FILE_ATTRIBUTE_DIRECTORY) != 0)  )
+    return -1;
+
+  if( ((attributes & FILE_ATTRIBUTE_REPARSE_POINT) == 0)
+  &&  ((uint64_t)(info.st_size) == size)  )
+  {
+    /* The file may be read-only; its mode is reassigned, as archived,
+     * when the update has been completed.
+     */
+    int fd;
+    if( (info.st_mode & S_IWRITE) == 0 )
+      chmod( pathname, info.st_mode | S_IWRITE );
+    if( (fd = open( pathname, O_RDWR | O_BINARY )) >= 0 )
+      return fd;
+  }
+  chmod( pathname, S_IWRITE );
+  unlink( pathname );
+  return -1;
+}
+
+/*******************
+ *
+ * Class Implementation: pkgTarWriterTask
+ *
+ */
+class pkgTarWriterTask : public pkgWorkerTask
+{
+  /* A locally implemented class, representing the unit of work which
+   * pkgTarArchiveInstaller hands off to its pool of writer threads; it
+   * creates one extracted file, writes its entire content, (which the
+   * installer has already read from the archive), and sets its time
+   * stamp.  Diagnostics are deferred until the task is retired, on the
+   * installer's own thread.
+   */
+  public:
+    pkgTarWriterTask
+    ( char *content, size_t len, int file_mode, int64_t stamp, bool reuse ):
+    pathname( NULL ), target( NULL ), data( content ), size( len ), mode( file_mode ),
+    mtime( stamp ), reused( reuse ), unchanged( false ), created( false ),
+    error( 0 ), status( 0 ){}
+    virtual ~pkgTarWriterTask(){ free( data ); }
+
+    virtual void Execute();
+    int Complete();
+
+    /* The path name is assigned when the task is queued; it refers
+     * to storage which is owned by the pending entry.  When the file is
+     * to be staged, "target" is the name of the staged file, (which is
+     * then owned by the staging area); otherwise it remains NULL.
+     */
+    const char *pathname, *target;
+
+    /* When updating in place, (as the installer requests, by passing
+     * "reuse" as true), these indicate whether an existing file was
+     * reused, and if so, whether its content was left unchanged.
+     */
+    bool reused, unchanged;
+
+    /* Record the file in the installation manifest, together with
+     * its size, time stamp, and the hash of its content.
+     */
+    inline void AddManifestEntry( pkgManifest *manifest, const char *key,
+	const char *name ){ manifest->AddEntry( key, name, size, mtime, digest );
+      }
+
+    /* The file mode, as archived, is also required by the staging area.
+     */
+    inline int Mode(){ return mode; }
+
+  private:
+    char *data;
+    size_t size;
+    int mode;
+    int64_t mtime;
+    char digest[XXH64_HEXDIGEST_SIZE];
+
+    bool created;
+    int error, status;
+};
+
+void pkgTarWriterTask::Execute()
+{
+  /* Create the file, (or reuse an existing file, when updating in
+   * place), write its content, and set its time stamp; (this runs on
+   * a writer thread).
+   */
+  int fd = -1;
+  const char *name = (target != NULL) ? target : pathname;
+  if( reused && ((fd = reuse_installed_file( pathname, size )) < 0) )
+    reused = false;
+
+  if( (fd < 0) && ((fd = set_output_stream( name,
+	  (target != NULL) ? (mode | S_IWRITE) : mode )) < 0)  )
+    error = errno;
+
+  else
+  { /* The content hash is computed here, on the writer thread, while
+     * the data is about to be written, (or compared).
+     */
+    xxh64_context content;
+    xxh64_init( &content, 0 );
+    xxh64_update( &content, data, size );
+    xxh64_hexdigest( &content, digest );
+
+    created = true;
+    unchanged = reused;
+    if( (size > 0)
+    &&  (update_output_stream( fd, data, size, &unchanged ) != (int)(size))  )
+      status = TAR_ARCHIVE_DATA_WRITE_ERROR;
+    close( fd );
+    if( status == 0 )
+    {
+      if( reused )
+	chmod( pathname, mode );
+      commit_saved_entity( name, mtime );
+    }
+  }
+  /* The content is no longer required; release it now, rather than
+   * when the task is eventually retired.
+   */
+  free( data );
+  data = NULL;
+}
+
+int pkgTarWriterTask::Complete()
+{
+  /* Wait for the task to be executed, then diagnose any failure, as
+   * create_output_stream() and ExtractFile() would have done, had the
+   * file been written on the installer's own thread.
+   */
+  WaitForCompletion();
+  if( ! created )
+  {
+    errno = error;
+    diagnose_output_stream_failure( pathname );
+    return -1;
+  }
+  if( status != 0 )
+    discard_extracted_file( (target != NULL) ? target : pathname, status );
+  return status;
+}
+
+struct tar_pending_entry
+{
+  /* Record of a manifest entry, which is waiting to be retired; for
+   * a regular file, "task" refers to the writer task which must be
+   * completed, before the entry may be recorded.
+   */
+  const char *key;
+  char *pathname;
+  pkgTarWriterTask *task;
+};
+
+/*******************
+ *
+ * Class Implementation: pkgTarStagingArea
+ *
+ */
+struct tar_staged_file
+{
+  /* Record of a regular file which has been written to the staging
+   * directory; "pathname" is the location, within the sysroot, to which
+   * it is ultimately to be moved, and "mode" is its archived file mode,
+   * (which is applied only when it has been flushed to disk).  A record
+   * with no "staged_name" represents a directory, which is to be created
+   * only when the staged files are committed.  The "key" is a copy of
+   * "pathname", normalised as for a link source, (or NULL, if it cannot
+   * be so normalised), by which the record is indexed.
+   */
+  char *pathname;
+  char *staged_name;
+  char *key;
+  int mode;
+};
+
+class pkgTarSyncTask : public pkgWorkerTask
+{
+  /* A locally implemented class, representing a batch of staged files
+   * which are to be flushed to disk, on one thread of a worker pool;
+   * we flush files in batches, rather than individually, to reduce the
+   * overhead of handing them off to the pool.
+   */
+  public:
+    pkgTarSyncTask( tar_staged_file *first, unsigned long count ):
+    batch( first ), batch_size( count ), failed( 0 ){}
+
+    virtual void Execute();
+    unsigned long Failed(){ return failed; }
+
+  private:
+    tar_staged_file *batch;
+    unsigned long batch_size, failed;
+};
+
+void pkgTarSyncTask::Execute()
+{
+  /* Flush each file in the batch; (any which no longer exists was
+   * discarded, after failing to extract, and has been diagnosed as
+   * such, so we simply ignore it).
+   */
+  for( unsigned long i = 0; i < batch_size; i++ )
+  {
+    if( batch[i].staged_name == NULL )
+      continue;
+
+    int fd = open( batch[i].staged_name, O_WRONLY | O_BINARY );
+    if( fd < 0 )
+    { if( errno != ENOENT ) ++failed;
+    }
+    else
+    { if( _commit( fd ) != 0 ) ++failed;
+      close( fd );
+    }
+  }
+}
+
+/* The name of the staging directory, relative to the sysroot.
+ */
+static const char *staging_dirname = ".mingw-get-staging";
+
+class pkgTarStagingArea
+{
+  /* A locally implemented class, used by pkgTarArchiveInstaller, when
+   * durable installation has been requested; it manages the directory
+   * within the sysroot, (and thus, on the same volume), in which files
+   * are written, before being moved into place.
+   */
+  public:
+    pkgTarStagingArea( const char *, size_t );
+    ~pkgTarStagingArea();
+
+    inline bool IsOk(){ return dirname != NULL; }
+    const char *Stage( const char *, int );
+    bool StageDirectory( const char * );
+    const char *StagedName( const char * );
+    int Commit( pkgWorkerPool* );
+    void Discard();
+
+  private:
+    char *dirname;
+    size_t base;
+    tar_staged_file *staged;
+    unsigned long count, limit, serial;
+    unsigned long *index, buckets;
+    bool Reserve();
+    bool Record( const char *, char *, int );
+    unsigned long *Bucket( const char * );
+};
+
+pkgTarStagingArea::pkgTarStagingArea( const char *dir, size_t sysroot_len ):
+dirname( NULL ), base( sysroot_len ), staged( NULL ), count( 0 ), limit( 0 ),
+serial( 0 ), index( NULL ), buckets( 0 )
+{
+  /* Constructor: create the staging directory, if necessary...
+   */
+  if( mkdir_recursive( dir, 0755 ) == 0 )
+  {
+    /* ...and clear away any files which remain in it, (which can only
+     * be the residue of an earlier installation, which was interrupted
+     * before it could be committed).
+     */
+    DIR *residue;
+    if( (residue = opendir( dir )) != NULL )
+    {
+      struct dirent *entry;
+      while( (entry = readdir( residue )) != NULL )
+	if( *entry->d_name != '.' )
+	{
+	  char name[2 + strlen( dir ) + strlen( entry->d_name )];
+	  sprintf( name, "%s/%s", dir, entry->d_name );
+	  chmod( name, S_IWRITE );
+	  unlink( name );
+	}
+      closedir( residue );
+    }
+    dirname = strdup( dir );
+  }
+}
+
+pkgTarStagingArea::~pkgTarStagingArea()
+{
+  /* Destructor: discard any files which have not been committed, then
+   * remove the staging directory itself.
+   */
+  Discard();
+  if( dirname != NULL )
+    rmdir( dirname );
+  free( dirname );
+  free( staged );
+  free( index );
+}
+
+bool pkgTarStagingArea::Reserve()
+{
+  /* Helper to ensure that there is space for at least one more record
+   * of staged content, and that its index will then remain no more than
+   * half full; the index is an open addressed hash table, in which each
+   * bucket holds one more than the subscript of the most recently staged
+   * record with any one key, (so that zero marks an empty bucket).
+   */
+  if( count == limit )
+  {
+    void *tmp = realloc( staged, (limit + 256) * sizeof( tar_staged_file ) );
+    if( tmp == NULL )
+      return false;
+    staged = (tar_staged_file *)(tmp);
+    limit += 256;
+  }
+  if( (2 * (count + 1)) > buckets )
+  {
+    /* The index must grow; allocate a larger one, and rebuild it from
+     * the existing records, (in staging order, so that the most recent
+     * of any with the same key prevails).
+     */
+    unsigned long size = (buckets > 0) ? 2 * buckets : 1024;
+    unsigned long *tmp = (unsigned long *)(calloc( size, sizeof( unsigned long ) ));
+    if( tmp == NULL )
+      return false;
+    free( index );
+    index = tmp; buckets = size;
+    for( unsigned long i = 0; i < count; i++ )
+      if( staged[i].key != NULL )
+	*Bucket( staged[i].key ) = i + 1;
+  }
+  return true;
+}
+
+unsigned long *pkgTarStagingArea::Bucket( const char *key )
+{
+  /* Helper to locate the index bucket which refers to the record with
+   * the specified (normalised) "key", or, if there is none, the empty
+   * bucket in which a reference to such a record should be placed.
+   */
+  xxh64_context hash;
+  xxh64_init( &hash, 0 );
+  xxh64_update( &hash, key, strlen( key ) );
+  unsigned long i = (unsigned long)(xxh64_digest( &hash )) & (buckets - 1);
+  while( (index[i] != 0) && (strcmp( staged[index[i] - 1].key, key ) != 0) )
+    i = (i + 1) & (buckets - 1);
+  return index + i;
+}
+
+bool pkgTarStagingArea::Record( const char *pathname, char *staged_name, int mode )
+{
+  /* Helper for Stage() and StageDirectory(), to append a record, (for
+   * which space must already have been reserved), normalising its key
+   * once only, and adding it to the index.
+   */
+  if( (staged[count].pathname = strdup( pathname )) == NULL )
+    return false;
+  if( ((staged[count].key = strdup( pathname )) != NULL)
+  &&  ! normalise_link_source( staged[count].key, base )  )
+  { free( staged[count].key ); staged[count].key = NULL;
+  }
+  staged[count].staged_name = staged_name;
+  staged[count].mode = mode;
+  if( staged[count].key != NULL )
+    *Bucket( staged[count].key ) = count + 1;
+  ++count;
+  return true;
+}
+
+const char *pkgTarStagingArea::Stage( const char *pathname, int mode )
+{
+  /* Allocate a staging file name, (which is simply a serial number,
+   * within the staging directory), for a file which is to be installed
+   * as "pathname"; returns NULL, if no staging file can be allocated,
+   * in which case the caller should write the file in place.
+   */
+  if( ! Reserve() )
+    return NULL;
+
+  char *staged_name;
+  if( (staged_name = (char *)(malloc( 10 + strlen( dirname )))) == NULL )
+    return NULL;
+  sprintf( staged_name, "%s/%08lx", dirname, serial );
+  if( ! Record( pathname, staged_name, mode ) )
+  {
+    free( staged_name );
+    return NULL;
+  }
+  ++serial;
+  return staged_name;
+}
+
+bool pkgTarStagingArea::StageDirectory( const char *pathname )
+{
+  /* Record a directory, which is to be created, (unless it exists
+   * already), only when the staged files are committed; returns false,
+   * if it cannot be recorded, in which case the caller should create
+   * it immediately.
+   */
+  return Reserve() && Record( pathname, NULL, 0755 );
+}
+
+const char *pkgTarStagingArea::StagedName( const char *pathname )
+{
+  /* Identify the staging file which holds the most recently staged
+   * content for "pathname", (which must have been normalised, beyond
+   * the sysroot prefix, as for a link source); returns NULL, if there
+   * is none.
+   */
+  unsigned long *bucket;
+  if( (buckets == 0) || (*(bucket = Bucket( pathname )) == 0) )
+    return NULL;
+  return staged[*bucket - 1].staged_name;
+}
+
+static int flush_directory_once( const char *pathname, char **flushed )
+{
+  /* Helper for pkgTarStagingArea::Commit(), to flush the directory which
+   * contains "pathname", unless it is that which was most recently flushed,
+   * (as recorded in "flushed"); returns zero on success.
+   */
+  const char *sep = strrchr( pathname, '/' );
+  size_t len = (sep != NULL) ? sep - pathname : 0;
+  if( (*flushed != NULL) && (strlen( *flushed ) == len)
+  &&  (strncmp( *flushed, pathname, len ) == 0)  )
+    return 0;
+
+  free( *flushed );
+  if( (*flushed = (char *)(malloc( 1 + len ))) != NULL )
+  { memcpy( *flushed, pathname, len ); (*flushed)[len] = '\0';
+  }
+  return flush_parent_directory( pathname );
+}
+
+int pkgTarStagingArea::Commit( pkgWorkerPool *pool )
+{
+  /* Flush all staged files to disk, then move them into place; the
+   * flushing is distributed over the worker pool, (if any), in batches,
+   * so that the file system may overlap them, rather than waiting for
+   * each file in turn.
+   */
+  int status = 0;
+  const unsigned long batch_size = 64;
+  unsigned long batches = (count + batch_size - 1) / batch_size;
+  pkgTarSyncTask **task = (pkgTarSyncTask **)(malloc(
+	batches * sizeof( pkgTarSyncTask * )
+      ));
+  if( (batches > 0) && (task == NULL) )
+    status = -1;
+
+  else
+  { for( unsigned long i = 0; i < batches; i++ )
+    {
+      unsigned long offset = i * batch_size;
+      task[i] = new pkgTarSyncTask( staged + offset,
+	  (count - offset < batch_size) ? count - offset : batch_size
+	);
+      if( pool != NULL )
+	pool->Submit( task[i] );
+      else
+	task[i]->Execute();
+    }
+    for( unsigned long i = 0; i < batches; i++ )
+    {
+      if( pool != NULL )
+	task[i]->WaitForCompletion();
+      if( task[i]->Failed() > 0 )
+	status = -1;
+      delete task[i];
+    }
+  }
+  free( task );
+  if( status != 0 )
+  {
+    /* We could not confirm that every file has reached the disk; we
+     * leave the sysroot untouched, so that the caller may abandon the
+     * installation, without leaving it partially updated.
+     */
+    dmh_notify( DMH_ERROR, "%s: cannot flush staged files to disk\n", dirname );
+    Discard();
+    return TAR_ARCHIVE_DATA_WRITE_ERROR;
+  }
+
+  /* All files are now safely on disk; move each into place, in archive
+   * order, (so that, if an archive contains more than one member with
+   * any one name, the last prevails, as it would, had we not staged it).
+   * A move, (or the creation of a directory), is merely cached, until
+   * the directory which holds it has been flushed; we flush each such
+   * directory in turn, so that all are on disk before the installation
+   * is recorded.
+   */
+  char *flushed = NULL;
+  unsigned long unflushed = 0;
+  for( unsigned long i = 0; i < count; i++ )
+  {
+    char *staged_name = staged[i].staged_name;
+    if( staged_name == NULL )
+    {
+      /* This is a directory, which must now be created, (before any
+       * file which it is to contain is moved into place).
+       */
+      if( mkdir_recursive( staged[i].pathname, staged[i].mode ) != 0 )
+      {
+	dmh_notify( DMH_ERROR, "cannot create directory `%s'\n",
+	    staged[i].pathname
+	  );
+	status = TAR_ARCHIVE_DATA_WRITE_ERROR;
+      }
+      else if( flush_directory_once( staged[i].pathname, &flushed ) != 0 )
+	++unflushed;
+      continue;
+    }
+    if( GetFileAttributesA( staged_name ) == INVALID_FILE_ATTRIBUTES )
+    {
+      /* This file failed to extract, and has already been diagnosed.
+       */
+      free( staged_name );
+      staged[i].staged_name = NULL;
+      continue;
+    }
+
+    /* Apply the archived file mode, (which we could not do before the
+     * file was flushed, since it may be read only); similarly, ensure
+     * that any existing file which is to be replaced is writable.
+     */
+    const char *pathname = staged[i].pathname;
+    chmod( staged_name, staged[i].mode );
+    chmod( pathname, S_IWRITE );
+    if( ! MoveFileExA( staged_name, pathname, MOVEFILE_REPLACE_EXISTING ) )
+    {
+      /* This may fail because no directory entry in the archive has
+       * caused the parent directory to be created, (as it would have
+       * been, had the file been written in place); create it, and try
+       * again, before diagnosing failure.
+       */
+      char *p, parent[1 + strlen( pathname )];
+      if( (p = strrchr( strcpy( parent, pathname ), '/' )) != NULL )
+      { *p = '\0'; mkdir_recursive( parent, 0755 );
+      }
+      if( ! MoveFileExA( staged_name, pathname, MOVEFILE_REPLACE_EXISTING ) )
+      {
+	dmh_notify( DMH_ERROR, "%s: cannot move staged file into place\n",
+	    pathname
+	  );
+	status = TAR_ARCHIVE_DATA_WRITE_ERROR;
+	continue;
+      }
+    }
+    /* The file has been moved; it need not be discarded.
+     */
+    free( staged_name );
+    staged[i].staged_name = NULL;
+    if( flush_directory_once( pathname, &flushed ) != 0 )
+      ++unflushed;
+  }
+  free( flushed );
+  if( unflushed > 0 )
+    dmh_notify( DMH_WARNING, "%s: cannot flush %lu directories to disk\n",
+	dirname, unflushed
+      );
+
+  /* Any file which remains in the staging area could not be moved into
+   * place; discard it, leaving the staging area ready for reuse.
+   */
+  Discard();
+  return status;
+}
+
+void pkgTarStagingArea::Discard()
+{
+  /* Delete all staged files, (other than any which have already been
+   * moved into place), and release their records.
+   */
+  while( count > 0 )
+  {
+    tar_staged_file *file = staged + --count;
+    if( file->staged_name != NULL )
+    {
+      chmod( file->staged_name, S_IWRITE );
+      unlink( file->staged_name );
+      free( file->staged_name );
+    }
+    free( file->pathname );
+    free( file->key );
+  }
+  if( index != NULL )
+    memset( index, 0, buckets * sizeof( unsigned long ) );
+}
+
 /*******************
  *
  * Class Implementation: pkgTarArchiveInstaller
  *
  */
 pkgTarArchiveInstaller::
-pkgTarArchiveInstaller( pkgXmlNode *pkg ):pkgTarArchiveProcessor( pkg )
+pkgTarArchiveInstaller( pkgXmlNode *pkg, pkgArchiveStream *source ):
+pkgTarArchiveProcessor( pkg, source ), update_in_place( false ),
+files_reused( 0 ), files_unchanged( 0 ), writers( NULL ), pending( NULL ),
+pending_head( 0 ), pending_count( 0 ), pending_limit( 0 ), staging( NULL )
 {
   /* Constructor: having successfully set up the pkgTarArchiveProcessor
    * base class, we attach a pkgManifest to track the installation.
    */
   if( (tarname != NULL) && (sysroot != NULL) && stream->IsReady() )
+  {
     installed = new pkgManifest( package_key, tarname );
+
+    /* When the catalogue publishes a digest for the package archive,
+     * we compute the digest of the archive, as we read it, so that we
+     * may verify it, without reading it a second time.
+     */
+    if( origin->GetPropVal( sha256_key, NULL ) != NULL )
+      stream->EnableDigest();
+  }
+}
+
+pkgTarArchiveInstaller::~pkgTarArchiveInstaller()
+{
+  /* Destructor must release the writer pool, the ring of pending
+   * manifest entries, and the staging area, (discarding any files which
+   * remain in it), if Process() has not already done so.
+   */
+  RetirePendingEntries();
+  delete writers;
+  free( pending );
+  delete staging;
 }
 
 int pkgTarArchiveInstaller::Process()
@@ -760,14 +2388,112 @@ int pkgTarArchiveInstaller::Process()
   /* Specialisation of the base class Process() method.
    */
   int status;
-  /* First, process the archive as for the base class...
+  unsigned threads = pkgWorkerPool::ThreadCount( OPTION_WRITER_THREADS );
+  if( (installed != NULL) && (threads > 1)
+  &&  ! DEBUG_REQUEST( DEBUG_SUPPRESS_INSTALLATION )  )
+  {
+    /* The user has not disabled the pool of writer threads; start
+     * it, and allocate a ring of pending manifest entries, allowing
+     * up to four of these for each writer thread.
+     */
+    writers = new pkgWorkerPool( threads );
+    if( (writers->Threads() == 0) || ((pending = (tar_pending_entry *)(malloc(
+	    (pending_limit = writers->Threads() << 2) * sizeof( tar_pending_entry )
+	  ))) == NULL)  )
+    {
+      /* We couldn't start any writer threads, (or we couldn't allocate
+       * the ring); fall back to writing all files on this thread.
+       */
+      delete writers;
+      writers = NULL;
+    }
+  }
+
+  /* When the user has requested durable installation, we establish
+   * a staging area, in which to write files, until they are committed.
+   */
+  if( (installed != NULL) && save_on_extract
+  &&  (pkgOptions()->GetValue( OPTION_DURABLE_INSTALL ) != 0)
+  &&  ! DEBUG_REQUEST( DEBUG_SUPPRESS_INSTALLATION )  )
+  {
+    char dir[mkpath( NULL, sysroot_path, staging_dirname, NULL )];
+    mkpath( dir, sysroot_path, staging_dirname, NULL );
+    if( ! (staging = new pkgTarStagingArea( dir, sysroot_len ))->IsOk() )
+    {
+      /* We couldn't create the staging directory; fall back to the
+       * non-durable mode of installation.
+       */
+      dmh_notify( DMH_WARNING, "%s: cannot create staging directory\n", dir );
+      delete staging;
+      staging = NULL;
+    }
+  }
+
+  /* First, process the archive as for the base class, (keeping track
+   * of directories which are known to exist, throughout), then wait for
+   * any files which remain pending...
    */
-  if( (status = pkgTarArchiveProcessor::Process()) == 0 )
+  mkdir_cache_enable();
+  status = pkgTarArchiveProcessor::Process();
+  RetirePendingEntries();
+
+  /* ...confirm that the archive content matches its published digest,
+   * (if any); if it does not, the archive is corrupt, or it has been
+   * tampered with, so we must not record the installation...
+   */
+  const char *expected = origin->GetPropVal( sha256_key, NULL );
+  if( (status == 0) && (expected != NULL) && ! stream->DigestMatches( expected ) )
   {
-    /* ...then, on successful completion...
-     *
-     * Update the package installation manifest, to record
-     * the installation in the current sysroot...
+    dmh_notify( DMH_ERROR, "%s: archive does not match its sha256 digest\n",
+	pkgfile
+      );
+    dmh_notify( DMH_ERROR, "%s: installation abandoned\n", tarname );
+    status = TAR_ARCHIVE_DIGEST_MISMATCH;
+  }
+
+  /* ...and, when durable installation is in effect, either commit all
+   * staged files and directories, (but only if the archive was processed
+   * successfully, and matches its digest), or otherwise discard them,
+   * leaving prior content of the sysroot undisturbed; in either case,
+   * dismiss the writer pool, (after it has helped to commit the staged
+   * files), before creating any links which may refer to such files.
+   */
+  bool staged = (staging != NULL);
+  if( staged )
+  {
+    if( status == 0 )
+      status = staging->Commit( writers );
+    delete staging; staging = NULL;
+  }
+  delete writers; writers = NULL;
+  free( pending ); pending = NULL;
+
+  if( (status != 0) && (staged || (status == TAR_ARCHIVE_DIGEST_MISMATCH)) )
+  {
+    /* Either the staged content has been discarded, or the archive
+     * content is not to be trusted; in either case, we must not create
+     * any links which it specified, and, unless we were staging its
+     * files, we must remove all content which we have already written
+     * into the sysroot.
+     */
+    discard_deferred_links( deferred_links );
+    deferred_links = NULL;
+    if( ! staged && ! DEBUG_REQUEST( DEBUG_SUPPRESS_INSTALLATION ) )
+      installed->RemoveInstalledEntities( sysroot_path );
+  }
+  CreateDeferredLinks();
+  report_mkdir_cache_savings();
+  DEBUG_INVOKE_IF( update_in_place && DEBUG_REQUEST( DEBUG_TRACE_TRANSACTIONS ),
+      dmh_printf( "  in-place update: %lu of %lu existing files unchanged\n",
+	  files_unchanged, files_reused
+	)
+    );
+
+  if( status == 0 )
+  {
+    /* ...then, on successful completion, update the package
+     * installation manifest, to record the installation in the
+     * current sysroot...
      */
     installed->BindSysRoot( sysroot, package_key );
     pkgRegister( sysroot, origin, tarname, pkgfile );
@@ -799,13 +2525,19 @@ int pkgTarArchiveInstaller::ProcessDirectory( const char *pathname )
   }
   else
   {
-    if( (status = CreateExtractionDirectory( pathname )) == 0 )
+    /* When installing durably, the directory is staged, to be created
+     * only when all staged files are committed; otherwise, (or if it
+     * cannot be staged), we create it immediately.
+     */
+    if( ((staging != NULL) && save_on_extract && staging->StageDirectory( pathname ))
+    ||  ((status = CreateExtractionDirectory( pathname )) == 0)  )
       /*
        * Either the specified directory already exists,
-       * or we just successfully created it; attach a reference
-       * in the installation manifest for the current package.
+       * or we just successfully created, (or staged), it; attach a
+       * reference in the installation manifest for the current package,
+       * (in turn, after any files which are still pending).
        */
-      installed->AddEntry( dirname_key, pathname + sysroot_len );
+      QueueManifestEntry( dirname_key, pathname );
   }
   return status;
 }
@@ -837,19 +2569,96 @@ int pkgTarArchiveInstaller::ProcessDataStream( const char *pathname )
   else
   {
     int status;
+    uint64_t size = octval( header.field.size );
+    if( (pending != NULL) && save_on_extract && (size <= TransferBufferSize) )
+    {
+      /* A pool of writer threads is available, and the file is small
+       * enough to be held in memory; read its entire content...
+       */
+      char *data = NULL;
+      if( (size > 0) && ((data = EntityDataAsString()) == NULL) )
+      {
+	/* ...diagnosing failure, as ExtractFile() would have done,
+	 * (although no file has yet been created)...
+	 */
+	RetirePendingEntries();
+	dmh_notify_extraction_failed( pathname );
+	dmh_notify_archive_data_exhausted( "content" );
+	return TAR_ARCHIVE_DATA_READ_ERROR;
+      }
+      /* ...then, after waiting for any earlier entry which is still
+       * pending, with the same path name, hand off the file to the
+       * writer pool, while queueing its manifest entry.
+       */
+      RetirePendingEntry( pathname );
+      QueueManifestEntry( filename_key, pathname, new pkgTarWriterTask( data,
+	    size, octval( header.field.mode ), octval( header.field.mtime ),
+	    update_in_place && (staging == NULL)
+	      && pkgIsRetainedFile( pathname + sysroot_len )
+	  )
+	);
+      return 0;
+    }
 
-    /* Establish an output file stream, extract the entity data,
-     * writing it to this stream...
+    /* Otherwise, we must write the file on this thread, but first, to
+     * preserve the order of entries in the manifest, we must wait for
+     * completion of any which remain pending.
+     */
+    RetirePendingEntries();
+
+    /* When installing durably, we write the file to the staging area,
+     * (leaving it writable, until it has been committed); otherwise, when
+     * updating in place, we may reuse an existing file, (which we then
+     * update only where its content differs); failing both, we establish
+     * an output file stream, (reserving space for the file, when it is
+     * large enough), extract the entity data, writing it to this stream...
      */
-    int fd = SetOutputStream( pathname, octval( header.field.mode ) );
-    if( (status = ExtractFile( fd, pathname, ProcessEntityData( fd ))) == 0 )
+    int fd = -1;
+    const char *staged, *target = pathname;
+    int mode = octval( header.field.mode );
+    if( (staging != NULL) && ((staged = staging->Stage( pathname, mode )) != NULL) )
+    { fd = SetOutputStream( target = staged, mode | S_IWRITE );
+      preallocate_output_stream( fd, size );
+    }
+    else if( update_in_place && save_on_extract
+    &&  pkgIsRetainedFile( pathname + sysroot_len )
+    &&  ((fd = reuse_installed_file( pathname, size )) >= 0)  )
+    {
+      compare_on_extract = true;
+      ++files_reused;
+    }
+    else
+    { fd = SetOutputStream( pathname, mode );
+      preallocate_output_stream( fd, size );
+    }
+    bool reused = compare_on_extract;
+    xxh64_context content;
+    xxh64_init( content_hash = &content, 0 );
+    status = ExtractFile( fd, target, ProcessEntityData( fd ));
+    if( compare_on_extract )
+      ++files_unchanged;
+    compare_on_extract = false;
+    content_hash = NULL;
+
+    if( status == 0 )
     {
       /* ...and on successful completion, commit the file
        * and record it in the installation database.
        */
+      if( reused )
+	chmod( pathname, mode );
       if( save_on_extract )
-	commit_saved_entity( pathname, octval( header.field.mtime ) );
-      installed->AddEntry( filename_key, pathname + sysroot_len );
+	commit_saved_entity( target, octval( header.field.mtime ) );
+
+      /* The manifest entry records the size and time stamp of the
+       * file, and the hash of its content, as computed during its
+       * extraction, (but only if it was actually extracted).
+       */
+      char digest[XXH64_HEXDIGEST_SIZE];
+      installed->AddEntry( filename_key, pathname + sysroot_len, size,
+	  octval( header.field.mtime ),
+	  save_on_extract ? xxh64_hexdigest( &content, digest ) : NULL
+	);
 
       /* Additionally, when the appropriate level of debug
        * tracing has been enabled, report the installation of
@@ -866,6 +2675,183 @@ int pkgTarArchiveInstaller::ProcessDataStream( const char *pathname )
   }
 }
 
+int pkgTarArchiveInstaller::ProcessLinkedEntity( const char *pathname )
+{
+  /* Any link may refer to a file which is still pending; we must wait
+   * for completion of all such files, before we process it, (but see
+   * CreateLinkedEntity(), regarding links to staged files).
+   */
+  int status;
+  RetirePendingEntries();
+
+  pkgSpinWait::Report( "Extracting %s", pathname + sysroot_len );
+  if( ((status = pkgTarArchiveProcessor::ProcessLinkedEntity( pathname )) == 0)
+  &&  save_on_extract  )
+  {
+    /* The link, (or its substitute copy), has been created; record
+     * it in the installation manifest, as a file, so that it will be
+     * removed, together with the rest of the package.
+     */
+    installed->AddEntry( filename_key, pathname + sysroot_len );
+    DEBUG_INVOKE_IF( DEBUG_REQUEST( DEBUG_TRACE_TRANSACTIONS ),
+	dmh_printf( "  %s\n", pathname )
+      );
+  }
+  return status;
+}
+
+int pkgTarArchiveInstaller::CreateLinkedEntity
+( const char *pathname, const char *source, const char *target )
+{
+  /* When installing durably, no link may be created within the sysroot
+   * until all staged files have been committed; a hard link to a staged
+   * file is itself staged, as a link to the staging file, (so that it is
+   * committed together with that file), while any other link is deferred
+   * until after the commit.  Note that we confirm the existence of the
+   * source of any hard link which we defer, so that failure to create it
+   * is diagnosed before anything is committed.
+   */
+  if( staging == NULL )
+    return pkgTarArchiveProcessor::CreateLinkedEntity( pathname, source, target );
+
+  if( target == NULL )
+  {
+    struct stat info;
+    const char *staged, *staged_source;
+    if( (staged_source = staging->StagedName( source )) != NULL )
+    {
+      if( (staged = staging->Stage( pathname, octval( header.field.mode ) )) != NULL )
+	return create_linked_entity( staged, staged_source, NULL );
+    }
+    else if( stat( source, &info ) != 0 )
+    {
+      dmh_notify( DMH_ERROR, "%s: cannot link to, or copy %s\n", pathname, source );
+      return -1;
+    }
+  }
+  return DeferLink( pathname, source, target );
+}
+
+bool pkgTarArchiveInstaller::ExcludeArchiveEntry( const char *pathname )
+{
+  /* Check the sysroot relative path name of each archive member against
+   * the "exclude" and "include" preferences; for any which is excluded,
+   * we record an "excluded" entry in the manifest, (in turn, after any
+   * which are still pending), rather than a "file" or "dir" entry, so
+   * that pkgRemove(), (which considers only the latter), will not seek
+   * to remove anything which was never installed.  Directories are never
+   * excluded, (since any member which is included may require them, and
+   * they must then be recorded, so that they may be removed).
+   */
+  if( (installed == NULL) || (*header.field.typeflag == TAR_ENTITY_TYPE_DIRECTORY) )
+    return false;
+
+  bool excluded = pkgIsExcludedEntry( pathname + sysroot_len );
+  if( ! excluded && (*header.field.typeflag == TAR_ENTITY_TYPE_LINK) )
+  {
+    /* A hard link can be created, (or copied), only from an entity which
+     * has already been extracted; thus, any hard link to a member which
+     * has been excluded must itself be excluded.  The name of the linked
+     * member is sysroot relative, exactly as is the name of the link.
+     */
+    size_t len = (long_linkname != NULL) ? strlen( long_linkname )
+      : sizeof( header.field.linkname );
+    char linkname[len + 1];
+    memcpy( linkname, (long_linkname != NULL) ? long_linkname
+	: header.field.linkname, len
+      );
+    linkname[len] = '\0';
+    excluded = (*linkname != '\0') && pkgIsExcludedEntry( linkname );
+  }
+  if( ! excluded )
+    return false;
+
+  QueueManifestEntry( excluded_key, pathname );
+  DEBUG_INVOKE_IF( DEBUG_REQUEST( DEBUG_TRACE_TRANSACTIONS ),
+      dmh_printf( "  excluded: %s\n", pathname )
+    );
+  return true;
+}
+
+void pkgTarArchiveInstaller::
+QueueManifestEntry( const char *key, const char *pathname, pkgTarWriterTask *task )
+{
+  /* Record an entry in the installation manifest; when the writer
+   * pool is active, the entry is appended to the ring of pending
+   * entries, (after retiring the oldest, if the ring is full), and
+   * any associated writer task is submitted to the pool...
+   */
+  if( pending != NULL )
+  {
+    if( pending_count == pending_limit )
+      RetirePendingEntries( pending_limit - 1 );
+
+    tar_pending_entry *entry = pending + (pending_head + pending_count++) % pending_limit;
+    entry->key = key;
+    entry->pathname = strdup( pathname );
+    if( (entry->task = task) != NULL )
+    {
+      task->pathname = entry->pathname;
+      if( staging != NULL )
+	task->target = staging->Stage( entry->pathname, task->Mode() );
+      writers->Submit( task );
+    }
+  }
+  else
+    /* ...otherwise, it is recorded immediately.
+     */
+    installed->AddEntry( key, pathname + sysroot_len );
+}
+
+void pkgTarArchiveInstaller::RetirePendingEntries( unsigned limit )
+{
+  /* Retire pending manifest entries, in the order in which they were
+   * queued, until no more than "limit" remain pending; for any regular
+   * file, we must wait for its writer task, and we record the entry
+   * only if the file was successfully written.
+   */
+  while( pending_count > limit )
+  {
+    tar_pending_entry *entry = pending + pending_head;
+    pending_head = (pending_head + 1) % pending_limit; --pending_count;
+    if( (entry->task == NULL) || (entry->task->Complete() == 0) )
+    {
+      if( (entry->task != NULL) && entry->task->reused )
+      {
+	++files_reused;
+	if( entry->task->unchanged ) ++files_unchanged;
+      }
+      if( entry->task != NULL )
+	entry->task->AddManifestEntry( installed, entry->key,
+	    entry->pathname + sysroot_len
+	  );
+      else
+	installed->AddEntry( entry->key, entry->pathname + sysroot_len );
+      DEBUG_INVOKE_IF( (entry->task != NULL)
+	  && DEBUG_REQUEST( DEBUG_TRACE_TRANSACTIONS ),
+	  dmh_printf( "  %s\n", entry->pathname )
+	);
+    }
+    delete entry->task;
+    free( entry->pathname );
+  }
+}
+
+void pkgTarArchiveInstaller::RetirePendingEntry( const char *pathname )
+{
+  /* Retire all pending entries, up to and including the most recent
+   * which refers to the specified path name, (if any); this ensures
+   * that any archive member which is intended to replace an earlier
+   * member, of the same name, is not written concurrently with it.
+   */
+  for( unsigned index = pending_count; index > 0; )
+    if( strcmp( pending[(pending_head + --index) % pending_limit].pathname, pathname ) == 0 )
+    {
+      RetirePendingEntries( pending_count - index - 1 );
+      return;
+    }
+}
+
 #endif /* PACKAGE_BASE_COMPONENT */
 
 /* $RCSfile$: end of file */
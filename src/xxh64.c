@@ -0,0 +1,228 @@
+/*
+ * xxh64.c
+ *
+ * $Id$
+ *
+ * Copyright (C) 2026, MinGW.org Project
+ *
+ *
+ * Implementation of the XXH64 hash algorithm, as published by Yann
+ * Collet; this is a fast, non-cryptographic hash, which is used to
+ * record a content fingerprint for each file in an installation
+ * manifest.  Like the SHA-256 implementation in sha256.c, the
+ * interface is incremental, so that the hash may be accumulated
+ * while each file is being extracted, rather than requiring the
+ * installed file to be read back a second time.
+ *
+ *
+ * This is free software.  Permission is granted to copy, modify and
+ * redistribute this software, under the provisions of the GNU General
+ * Public License, Version 3, (or, at your option, any later version),
+ * as published by the Free Software Foundation; see the file COPYING
+ * for licensing details.
+ *
+ * Note, in particular, that this software is provided "as is", in the
+ * hope that it may prove useful, but WITHOUT WARRANTY OF ANY KIND; not
+ * even an implied WARRANTY OF MERCHANTABILITY, nor of FITNESS FOR ANY
+ * PARTICULAR PURPOSE.  Under no circumstances will the author, or the
+ * MinGW Project, accept liability for any damages, however caused,
+ * arising from the use of this software.
+ *
+ */
+#include "xxh64.h"
+
+#include <string.h>
+
+/* The five 64-bit primes, which are specified by the algorithm.
+ */
+#define XXH64_PRIME_1	0x9E3779B185EBCA87ULL
+#define XXH64_PRIME_2	0xC2B2AE3D27D4EB4FULL
+#define XXH64_PRIME_3	0x165667B19E3779F9ULL
+#define XXH64_PRIME_4	0x85EBCA77C2B2AE63ULL
+#define XXH64_PRIME_5	0x27D4EB2F165667C5ULL
+
+static __inline__ __attribute__((__always_inline__))
+uint64_t rotl( uint64_t value, unsigned bits )
+{
+  /* Helper to rotate a 64-bit word left, by the specified number
+   * of bit positions.
+   */
+  return (value << bits) | (value >> (64 - bits));
+}
+
+static __inline__ __attribute__((__always_inline__))
+uint64_t read64( const uint8_t *p )
+{
+  /* Helper to fetch a little-endian 64-bit word from the input,
+   * without regard to its alignment...
+   */
+  return (uint64_t)(p[0]) | ((uint64_t)(p[1]) << 8)
+    | ((uint64_t)(p[2]) << 16) | ((uint64_t)(p[3]) << 24)
+    | ((uint64_t)(p[4]) << 32) | ((uint64_t)(p[5]) << 40)
+    | ((uint64_t)(p[6]) << 48) | ((uint64_t)(p[7]) << 56);
+}
+
+static __inline__ __attribute__((__always_inline__))
+uint32_t read32( const uint8_t *p )
+{
+  /* ...and its 32-bit counterpart.
+   */
+  return (uint32_t)(p[0]) | ((uint32_t)(p[1]) << 8)
+    | ((uint32_t)(p[2]) << 16) | ((uint32_t)(p[3]) << 24);
+}
+
+static __inline__ __attribute__((__always_inline__))
+uint64_t xxh64_round( uint64_t acc, uint64_t input )
+{
+  /* Incorporate one 64-bit input word into a lane accumulator.
+   */
+  acc += input * XXH64_PRIME_2;
+  return rotl( acc, 31 ) * XXH64_PRIME_1;
+}
+
+static __inline__ __attribute__((__always_inline__))
+uint64_t xxh64_merge( uint64_t hash, uint64_t lane )
+{
+  /* Fold the final state of one lane accumulator into the hash.
+   */
+  hash ^= xxh64_round( 0, lane );
+  return hash * XXH64_PRIME_1 + XXH64_PRIME_4;
+}
+
+static void xxh64_stripe( uint64_t *lane, const uint8_t *stripe )
+{
+  /* Incorporate the effect of one 32-byte stripe of input, which is
+   * interpreted as four little-endian words, one for each lane.
+   */
+  lane[0] = xxh64_round( lane[0], read64( stripe ) );
+  lane[1] = xxh64_round( lane[1], read64( stripe + 8 ) );
+  lane[2] = xxh64_round( lane[2], read64( stripe + 16 ) );
+  lane[3] = xxh64_round( lane[3], read64( stripe + 24 ) );
+}
+
+void xxh64_init( xxh64_context *ctx, uint64_t seed )
+{
+  /* Initialise the context for a new hash computation; each of the
+   * four lanes is derived from the seed, and the primes.
+   */
+  ctx->lane[0] = seed + XXH64_PRIME_1 + XXH64_PRIME_2;
+  ctx->lane[1] = seed + XXH64_PRIME_2;
+  ctx->lane[2] = seed;
+  ctx->lane[3] = seed - XXH64_PRIME_1;
+  ctx->seed = seed;
+  ctx->length = 0;
+}
+
+void xxh64_update( xxh64_context *ctx, const void *data, size_t len )
+{
+  /* Accumulate the effect of an arbitrary length sequence of input
+   * bytes, into the hash computation.
+   */
+  const uint8_t *input = (const uint8_t *)(data);
+  size_t residual = ctx->length & 31;
+  ctx->length += len;
+
+  if( residual > 0 )
+  {
+    /* There is a partial stripe, carried over from a preceding update;
+     * we must complete this first...
+     */
+    size_t count = 32 - residual;
+    if( count > len ) count = len;
+    memcpy( ctx->stripe + residual, input, count );
+    input += count; len -= count;
+
+    /* ...but, if it remains incomplete, we cannot yet process it.
+     */
+    if( (residual + count) < 32 )
+      return;
+    xxh64_stripe( ctx->lane, ctx->stripe );
+  }
+
+  /* Process as many complete stripes as we may, directly from the
+   * input buffer, before we save any residual partial stripe, for
+   * completion by a subsequent update.
+   */
+  while( len >= 32 )
+  {
+    xxh64_stripe( ctx->lane, input );
+    input += 32; len -= 32;
+  }
+  if( len > 0 ) memcpy( ctx->stripe, input, len );
+}
+
+uint64_t xxh64_digest( const xxh64_context *ctx )
+{
+  /* Compute the hash value for all input accumulated so far; note
+   * that, unlike sha256_final(), this does not disturb the context,
+   * so further input may still be added, if desired.
+   */
+  uint64_t hash;
+  const uint8_t *tail = ctx->stripe;
+  size_t len = ctx->length & 31;
+
+  if( ctx->length >= 32 )
+  {
+    /* At least one complete stripe has been processed; the lane
+     * accumulators are combined, to form the basis of the hash...
+     */
+    hash = rotl( ctx->lane[0], 1 ) + rotl( ctx->lane[1], 7 )
+      + rotl( ctx->lane[2], 12 ) + rotl( ctx->lane[3], 18 );
+    hash = xxh64_merge( hash, ctx->lane[0] );
+    hash = xxh64_merge( hash, ctx->lane[1] );
+    hash = xxh64_merge( hash, ctx->lane[2] );
+    hash = xxh64_merge( hash, ctx->lane[3] );
+  }
+  else
+    /* ...otherwise, the lanes have never been used, and the basis
+     * is derived from the seed alone.
+     */
+    hash = ctx->seed + XXH64_PRIME_5;
+
+  /* In either case, the total length is incorporated, followed by
+   * any residual input which did not complete a stripe; this is
+   * consumed in 8-byte words, then at most one 4-byte word, then
+   * any remaining individual bytes...
+   */
+  hash += ctx->length;
+  for( ; len >= 8; tail += 8, len -= 8 )
+  {
+    hash ^= xxh64_round( 0, read64( tail ) );
+    hash = rotl( hash, 27 ) * XXH64_PRIME_1 + XXH64_PRIME_4;
+  }
+  if( len >= 4 )
+  {
+    hash ^= (uint64_t)(read32( tail )) * XXH64_PRIME_1;
+    hash = rotl( hash, 23 ) * XXH64_PRIME_2 + XXH64_PRIME_3;
+    tail += 4; len -= 4;
+  }
+  for( ; len > 0; ++tail, --len )
+  {
+    hash ^= *tail * XXH64_PRIME_5;
+    hash = rotl( hash, 11 ) * XXH64_PRIME_1;
+  }
+
+  /* ...and finally, the bits are thoroughly mixed, by the avalanche
+   * procedure, to yield the hash value.
+   */
+  hash ^= hash >> 33; hash *= XXH64_PRIME_2;
+  hash ^= hash >> 29; hash *= XXH64_PRIME_3;
+  return hash ^ (hash >> 32);
+}
+
+char *xxh64_hexdigest( const xxh64_context *ctx, char *buf )
+{
+  /* Compute the hash value, and format the result as the conventional
+   * string of (lower case) hexadecimal digits.
+   */
+  int i;
+  uint64_t hash = xxh64_digest( ctx );
+  static const char hexdigit[] = "0123456789abcdef";
+
+  for( i = 0; i < 16; i++ )
+    buf[i] = hexdigit[(hash >> (60 - 4 * i)) & 0x0F];
+  buf[16] = '\0';
+  return buf;
+}
+
+/* $RCSfile$: end of file */
@@ -0,0 +1,73 @@
+#ifndef XXH64_H
+/*
+ * xxh64.h
+ *
+ * $Id$
+ *
+ * Copyright (C) 2026, MinGW.org Project
+ *
+ *
+ * Prototype declarations, and the context data structure, for the
+ * incremental XXH64 non-cryptographic hash functions, which are
+ * implemented in xxh64.c
+ *
+ *
+ * This is free software.  Permission is granted to copy, modify and
+ * redistribute this software, under the provisions of the GNU General
+ * Public License, Version 3, (or, at your option, any later version),
+ * as published by the Free Software Foundation; see the file COPYING
+ * for licensing details.
+ *
+ * Note, in particular, that this software is provided "as is", in the
+ * hope that it may prove useful, but WITHOUT WARRANTY OF ANY KIND; not
+ * even an implied WARRANTY OF MERCHANTABILITY, nor of FITNESS FOR ANY
+ * PARTICULAR PURPOSE.  Under no circumstances will the author, or the
+ * MinGW Project, accept liability for any damages, however caused,
+ * arising from the use of this software.
+ *
+ */
+#define XXH64_H  1
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifndef EXTERN_C
+# ifdef __cplusplus
+#  define EXTERN_C extern "C"
+# else
+#  define EXTERN_C
+# endif
+#endif
+
+/* The hash is a single 64-bit value; its conventional representation
+ * is as a string of sixteen hexadecimal digits, (most significant digit
+ * first), plus one more character for the terminating NUL.
+ */
+#define XXH64_HEXDIGEST_SIZE	17
+
+typedef
+struct xxh64_context
+{
+  /* The state of a hash computation which is in progress; this
+   * comprises the four lane accumulators, the seed from which they
+   * were initialised, the total number of bytes processed so far, and
+   * a buffer to accumulate any partial 32-byte stripe, pending the
+   * arrival of sufficient further input to complete it.
+   */
+  uint64_t	lane[4];
+  uint64_t	seed;
+  uint64_t	length;
+  uint8_t	stripe[32];
+} xxh64_context;
+
+EXTERN_C void xxh64_init( xxh64_context *, uint64_t );
+EXTERN_C void xxh64_update( xxh64_context *, const void *, size_t );
+EXTERN_C uint64_t xxh64_digest( const xxh64_context * );
+
+/* Convenience function to finalise a hash computation, storing the
+ * result as a NUL terminated hexadecimal string, into a buffer of at
+ * least XXH64_HEXDIGEST_SIZE bytes; returns the buffer.
+ */
+EXTERN_C char *xxh64_hexdigest( const xxh64_context *, char * );
+
+#endif /* XXH64_H: $RCSfile$: end of file */
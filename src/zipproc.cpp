@@ -0,0 +1,1047 @@
+/*
+ * zipproc.cpp
+ *
+ * $Id$
+ *
+ * Copyright (C) 2026, MinGW.org Project
+ *
+ *
+ * Implementation of package installation methods for packages which
+ * are distributed as zip archives; since each member of a zip archive
+ * is compressed independently, and its location is recorded within the
+ * archive's central directory, we may extract many members at once, on
+ * a pool of worker threads, while the package manifest is maintained
+ * on the main thread, exactly as it is for tar archives.
+ *
+ *
+ * This is free software.  Permission is granted to copy, modify and
+ * redistribute this software, under the provisions of the GNU General
+ * Public License, Version 3, (or, at your option, any later version),
+ * as published by the Free Software Foundation; see the file COPYING
+ * for licensing details.
+ *
+ * Note, in particular, that this software is provided "as is", in the
+ * hope that it may prove useful, but WITHOUT WARRANTY OF ANY KIND; not
+ * even an implied WARRANTY OF MERCHANTABILITY, nor of FITNESS FOR ANY
+ * PARTICULAR PURPOSE.  Under no circumstances will the author, or the
+ * MinGW Project, accept liability for any damages, however caused,
+ * arising from the use of this software.
+ *
+ */
+#include "pkgimpl.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <io.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <zlib.h>
+
+#include "dmh.h"
+#include "debug.h"
+#include "mkpath.h"
+
+#include "pkginfo.h"
+#include "pkgkeys.h"
+#include "pkgstat.h"
+#include "pkgopts.h"
+#include "pkgproc.h"
+#include "pkgpool.h"
+#include "sha256.h"
+#include "xxh64.h"
+
+#ifndef O_BINARY
+/* POSIX hosts don't distinguish binary from text files.
+ */
+# define O_BINARY  0
+#endif
+
+/* Signatures, and fixed sizes, of the structural records which we
+ * must interpret, within any zip archive; (all multibyte fields within
+ * these records are stored in little-endian byte order).
+ */
+#define ZIP_LOCAL_HEADER_MAGIC		0x04034B50UL
+#define ZIP_CENTRAL_HEADER_MAGIC	0x02014B50UL
+#define ZIP_END_RECORD_MAGIC		0x06054B50UL
+#define ZIP64_END_RECORD_MAGIC		0x06064B50UL
+#define ZIP64_END_LOCATOR_MAGIC 	0x07064B50UL
+
+#define ZIP_LOCAL_HEADER_SIZE		30
+#define ZIP_CENTRAL_HEADER_SIZE 	46
+#define ZIP_END_RECORD_SIZE		22
+#define ZIP64_END_RECORD_SIZE		56
+#define ZIP64_END_LOCATOR_SIZE		20
+#define ZIP_MAX_COMMENT_SIZE		0xFFFF
+
+/* Member attributes, (compression methods, flags, extra field tags,
+ * and host system identification), which we must recognise.
+ */
+#define ZIP_METHOD_STORED		0
+#define ZIP_METHOD_DEFLATED		8
+#define ZIP_FLAG_ENCRYPTED		0x0001
+#define ZIP_EXTRA_ZIP64 		0x0001
+#define ZIP_EXTRA_TIMESTAMP		0x5455
+#define ZIP_HOST_UNIX			3
+
+/* POSIX file type codes, as they may appear in the high order half
+ * of the external attributes field, for members archived on a unix
+ * host; (MS-Windows doesn't define all of these).
+ */
+#define ZIP_UNIX_TYPE_MASK		0170000
+#define ZIP_UNIX_TYPE_DIRECTORY 	0040000
+#define ZIP_UNIX_TYPE_SYMLINK		0120000
+
+/* Size of each of the buffers which is used to transfer data from the
+ * archive, and to the extracted file.
+ */
+#define ZIP_TRANSFER_BUFFER_SIZE	(256 << 10)
+
+/* Maximum length of the target of a symbolic link member, (which is
+ * recorded as the member's content).
+ */
+#define ZIP_MAX_LINK_SIZE		4096
+
+static inline unsigned get_u16( const uint8_t *p )
+{
+  /* Helpers to retrieve 16-bit, 32-bit, and 64-bit unsigned values,
+   * from little-endian byte order...
+   */
+  return p[0] | (p[1] << 8);
+}
+
+static inline uint32_t get_u32( const uint8_t *p )
+{
+  return get_u16( p ) | ((uint32_t)(get_u16( p + 2 )) << 16);
+}
+
+static inline uint64_t get_u64( const uint8_t *p )
+{
+  return get_u32( p ) | ((uint64_t)(get_u32( p + 4 )) << 32);
+}
+
+static bool read_zip_bytes( int fd, uint64_t offset, uint8_t *buf, size_t len )
+{
+  /* Helper, to read a specified number of bytes, from a specified
+   * offset within the archive file.
+   */
+  if( _lseeki64( fd, offset, SEEK_SET ) != (__int64)(offset) ) return false;
+  while( len > 0 )
+  {
+    int count = read( fd, buf, len );
+    if( count <= 0 ) return false;
+    buf += count; len -= count;
+  }
+  return true;
+}
+
+static int64_t dos_time( unsigned date, unsigned time )
+{
+  /* Helper to convert an MS-DOS format date and time stamp, (which
+   * represents local time, with a resolution of two seconds), to the
+   * equivalent time_t value.
+   */
+  struct tm stamp;
+  memset( &stamp, 0, sizeof( stamp ) );
+  stamp.tm_year = ((date >> 9) & 0x7F) + 80;
+  stamp.tm_mon = ((date >> 5) & 0x0F) - 1;
+  stamp.tm_mday = date & 0x1F;
+  stamp.tm_hour = (time >> 11) & 0x1F;
+  stamp.tm_min = (time >> 5) & 0x3F;
+  stamp.tm_sec = (time & 0x1F) << 1;
+  stamp.tm_isdst = -1;
+  return (int64_t)(mktime( &stamp ));
+}
+
+struct zip_archive_member
+{
+  /* The information which we retain from the central directory, for
+   * each member of the archive.
+   */
+  enum { ZIP_MEMBER_FILE, ZIP_MEMBER_DIRECTORY, ZIP_MEMBER_LINK } type;
+  char		*name;
+  uint64_t	offset, csize, usize;
+  uint32_t	crc;
+  unsigned	method, flags;
+  int		mode;
+  int64_t	mtime;
+};
+
+/*****
+ *
+ * Class Implementation: pkgZipArchiveReader
+ *
+ */
+class pkgZipArchiveReader
+{
+  /* A locally implemented class, which represents a zip archive, as
+   * described by its central directory; it also maintains a collection
+   * of file descriptors, on which the archive is open, so that each of
+   * any number of concurrent extraction tasks may read from it, via a
+   * file descriptor of its own.
+   */
+  public:
+    pkgZipArchiveReader( const char* );
+    ~pkgZipArchiveReader();
+
+    inline bool IsReady(){ return ready; }
+    inline const char *ArchiveName(){ return archive_name; }
+    inline unsigned Count(){ return count; }
+    inline zip_archive_member *Member( unsigned i ){ return members + i; }
+
+    int AcquireStream();
+    void ReleaseStream( int );
+
+    /* Storage for the archive digest, when one is computed.
+     */
+    char digest[SHA256_HEXDIGEST_SIZE];
+
+  private:
+    char *archive_name;
+    bool ready;
+
+    zip_archive_member *members;
+    unsigned count;
+
+    CRITICAL_SECTION lock;
+    int *streams;
+    unsigned available, capacity;
+
+    bool ReadCentralDirectory( int );
+    bool AddMember( const uint8_t*, const uint8_t* );
+};
+
+pkgZipArchiveReader::pkgZipArchiveReader( const char *archive ):
+archive_name( strdup( archive ) ), ready( false ), members( NULL ), count( 0 ),
+streams( NULL ), available( 0 ), capacity( 0 )
+{
+  /* Constructor opens the archive, and reads its central directory;
+   * we retain the file descriptor, as the first in the collection to
+   * be used by extraction tasks.
+   */
+  int fd;
+  *digest = '\0';
+  InitializeCriticalSection( &lock );
+  if( (fd = open( archive, O_RDONLY | O_BINARY )) >= 0 )
+  {
+    if( (ready = ReadCentralDirectory( fd )) == false )
+      dmh_notify( DMH_ERROR, "%s: cannot read zip archive directory\n", archive );
+    ReleaseStream( fd );
+  }
+  else
+    dmh_notify( DMH_ERROR, "%s: cannot open archive\n", archive );
+}
+
+pkgZipArchiveReader::~pkgZipArchiveReader()
+{
+  /* Destructor closes all file descriptors, and releases all memory,
+   * which is associated with the archive.
+   */
+  while( available > 0 ) close( streams[--available] );
+  while( count > 0 ) free( members[--count].name );
+  free( members );
+  free( streams );
+  free( archive_name );
+  DeleteCriticalSection( &lock );
+}
+
+int pkgZipArchiveReader::AcquireStream()
+{
+  /* Hand out a file descriptor, on which the archive is open, for the
+   * exclusive use of the caller, until it is released; we reuse any
+   * which has been previously released, or otherwise open another.
+   */
+  int fd = -1;
+  EnterCriticalSection( &lock );
+  if( available > 0 ) fd = streams[--available];
+  LeaveCriticalSection( &lock );
+  return (fd >= 0) ? fd : open( archive_name, O_RDONLY | O_BINARY );
+}
+
+void pkgZipArchiveReader::ReleaseStream( int fd )
+{
+  /* Return a file descriptor, which was previously acquired, to the
+   * collection, so that it may be reused.
+   */
+  EnterCriticalSection( &lock );
+  if( available == capacity )
+  {
+    int *ref = (int *)(realloc( streams, (capacity + 8) * sizeof( int ) ));
+    if( ref != NULL ) { streams = ref; capacity += 8; }
+  }
+  if( available < capacity ) streams[available++] = fd;
+  else close( fd );
+  LeaveCriticalSection( &lock );
+}
+
+bool pkgZipArchiveReader::ReadCentralDirectory( int fd )
+{
+  /* Locate the end of central directory record; this is the last
+   * structural record in the archive, but it may be followed by an
+   * archive comment, of up to 64 kB, so we must search for it...
+   */
+  __int64 size = _filelengthi64( fd );
+  if( size < ZIP_END_RECORD_SIZE )
+    return false;
+
+  size_t tail = ZIP_END_RECORD_SIZE + ZIP_MAX_COMMENT_SIZE;
+  if( (__int64)(tail) > size ) tail = size;
+  uint8_t *buf = (uint8_t *)(malloc( tail ));
+  if( (buf == NULL) || ! read_zip_bytes( fd, size - tail, buf, tail ) )
+  {
+    free( buf );
+    return false;
+  }
+  const uint8_t *p = buf + tail - ZIP_END_RECORD_SIZE;
+  while( (p >= buf) && ((get_u32( p ) != ZIP_END_RECORD_MAGIC)
+  ||  ((p + ZIP_END_RECORD_SIZE + get_u16( p + 20 )) > (buf + tail))) )
+    --p;
+
+  if( p < buf )
+  {
+    free( buf );
+    return false;
+  }
+  /* ...from which we may identify the extent of the central directory,
+   * and the number of members which it describes; however, if any of
+   * these exceeds the capacity of the record, then we must retrieve
+   * them from the zip64 extended end of central directory record.
+   */
+  uint64_t end_offset = size - tail + (p - buf);
+  uint64_t entries = get_u16( p + 10 );
+  uint64_t dir_size = get_u32( p + 12 );
+  uint64_t dir_offset = get_u32( p + 16 );
+  free( buf );
+
+  if( (entries == 0xFFFF) || (dir_size == 0xFFFFFFFF) || (dir_offset == 0xFFFFFFFF) )
+  {
+    uint8_t locator[ZIP64_END_LOCATOR_SIZE], record[ZIP64_END_RECORD_SIZE];
+    if( (end_offset < ZIP64_END_LOCATOR_SIZE)
+    ||  ! read_zip_bytes( fd, end_offset - ZIP64_END_LOCATOR_SIZE, locator, sizeof( locator ) )
+    ||  (get_u32( locator ) != ZIP64_END_LOCATOR_MAGIC)
+    ||  ! read_zip_bytes( fd, get_u64( locator + 8 ), record, sizeof( record ) )
+    ||  (get_u32( record ) != ZIP64_END_RECORD_MAGIC)  )
+      return false;
+
+    entries = get_u64( record + 32 );
+    dir_size = get_u64( record + 40 );
+    dir_offset = get_u64( record + 48 );
+  }
+
+  /* Read the entire central directory into memory, and interpret it;
+   * (since each entry requires at least 46 bytes, the directory size
+   * also imposes an upper bound on the plausible number of entries).
+   */
+  if( (dir_offset + dir_size > (uint64_t)(size))
+  ||  (dir_size > 0x7FFFFFFF) || (entries > dir_size / ZIP_CENTRAL_HEADER_SIZE) )
+    return false;
+
+  if( (buf = (uint8_t *)(malloc( dir_size + 1 ))) == NULL )
+    return false;
+
+  bool ok = read_zip_bytes( fd, dir_offset, buf, dir_size );
+  if( ok && ((members = (zip_archive_member *)(calloc( entries + 1,
+	  sizeof( zip_archive_member ) ))) == NULL)  )
+    ok = false;
+
+  const uint8_t *end = buf + dir_size;
+  for( p = buf; ok && (count < entries); )
+  {
+    if( ((p + ZIP_CENTRAL_HEADER_SIZE) > end)
+    ||  (get_u32( p ) != ZIP_CENTRAL_HEADER_MAGIC)  )
+      ok = false;
+
+    else
+    { const uint8_t *next = p + ZIP_CENTRAL_HEADER_SIZE
+	+ get_u16( p + 28 ) + get_u16( p + 30 ) + get_u16( p + 32 );
+      ok = (next <= end) && AddMember( p, next );
+      p = next;
+    }
+  }
+  free( buf );
+  return ok;
+}
+
+bool pkgZipArchiveReader::AddMember( const uint8_t *entry, const uint8_t *end )
+{
+  /* Helper method, to interpret one entry from the central directory,
+   * and record the member which it describes.
+   */
+  zip_archive_member *member = members + count;
+  unsigned name_len = get_u16( entry + 28 );
+  const uint8_t *extra = entry + ZIP_CENTRAL_HEADER_SIZE + name_len;
+  const uint8_t *extra_end = extra + get_u16( entry + 30 );
+
+  if( (member->name = (char *)(malloc( name_len + 1 ))) == NULL )
+    return false;
+  memcpy( member->name, entry + ZIP_CENTRAL_HEADER_SIZE, name_len );
+  member->name[name_len] = '\0';
+  ++count;
+
+  member->flags = get_u16( entry + 8 );
+  member->method = get_u16( entry + 10 );
+  member->crc = get_u32( entry + 16 );
+  member->csize = get_u32( entry + 20 );
+  member->usize = get_u32( entry + 24 );
+  member->offset = get_u32( entry + 42 );
+  member->mtime = dos_time( get_u16( entry + 14 ), get_u16( entry + 12 ) );
+
+  /* Interpret any extra fields; the zip64 field supplies those of the
+   * sizes and offset which exceed 32-bits, (in that order, but only for
+   * those which are so marked), and the extended timestamp field may
+   * supply a more precise modification time.
+   */
+  while( (extra + 4) <= extra_end )
+  {
+    unsigned tag = get_u16( extra ), len = get_u16( extra + 2 );
+    const uint8_t *data = extra + 4, *data_end = data + len;
+    if( data_end > extra_end )
+      break;
+
+    if( tag == ZIP_EXTRA_ZIP64 )
+    {
+      uint64_t *field[] = { &member->usize, &member->csize, &member->offset };
+      for( int i = 0; i < 3; i++ )
+	if( (*field[i] == 0xFFFFFFFF) && ((data + 8) <= data_end) )
+	{
+	  *field[i] = get_u64( data );
+	  data += 8;
+	}
+    }
+    else if( (tag == ZIP_EXTRA_TIMESTAMP) && (len >= 5) && ((*data & 1) != 0) )
+      member->mtime = (int32_t)(get_u32( data + 1 ));
+
+    extra = data_end;
+  }
+
+  /* Classify the member, as a directory, a symbolic link, or a regular
+   * file; for members archived on a unix host, we prefer the file type
+   * and permissions recorded in the external attributes, but otherwise
+   * we can only distinguish directories, and read-only files.
+   */
+  uint32_t attributes = get_u32( entry + 38 );
+  unsigned unix_mode = (get_u16( entry + 4 ) >> 8 == ZIP_HOST_UNIX)
+    ? attributes >> 16 : 0;
+
+  member->type = zip_archive_member::ZIP_MEMBER_FILE;
+  if( (name_len > 0) && (member->name[name_len - 1] == '/') )
+    member->type = zip_archive_member::ZIP_MEMBER_DIRECTORY;
+
+  else if( unix_mode != 0 )
+  {
+    if( (unix_mode & ZIP_UNIX_TYPE_MASK) == ZIP_UNIX_TYPE_DIRECTORY )
+      member->type = zip_archive_member::ZIP_MEMBER_DIRECTORY;
+    else if( (unix_mode & ZIP_UNIX_TYPE_MASK) == ZIP_UNIX_TYPE_SYMLINK )
+      member->type = zip_archive_member::ZIP_MEMBER_LINK;
+  }
+  else if( (attributes & 0x10) != 0 )
+    member->type = zip_archive_member::ZIP_MEMBER_DIRECTORY;
+
+  member->mode = ((unix_mode & 0777) != 0) ? (unix_mode & 0777)
+    : ((attributes & 0x01) != 0) ? 0444 : 0644;
+  return true;
+}
+
+/*****
+ *
+ * Class Implementation: pkgZipExtractionTask
+ *
+ */
+class pkgZipExtractionTask : public pkgWorkerTask
+{
+  /* A unit of work, to be dispatched to the worker pool, to extract
+   * the content of one file member of the archive, writing it to an
+   * output stream which has already been opened, (on the main thread,
+   * which will also close it, after the task has been completed); the
+   * hash of the content is accumulated as it is extracted, so that it
+   * may be recorded in the installation manifest.
+   */
+  public:
+    pkgZipExtractionTask( pkgZipArchiveReader *ref, zip_archive_member *item, int fd ):
+    archive( ref ), member( item ), output( fd ), status( 0 ), content( NULL )
+    { xxh64_init( &hash, 0 ); }
+
+    /* Alternatively, the content of a small member, (such as the target
+     * of a symbolic link), may be extracted into a caller provided buffer,
+     * which must be large enough to accommodate the member's entire size.
+     */
+    pkgZipExtractionTask( pkgZipArchiveReader *ref, zip_archive_member *item, char *buf ):
+    archive( ref ), member( item ), output( -1 ), status( 0 ), content( buf )
+    { xxh64_init( &hash, 0 ); }
+
+    virtual void Execute();
+    inline int Status(){ return status; }
+    inline const char *Digest( char *buf ){ return xxh64_hexdigest( &hash, buf ); }
+
+  private:
+    pkgZipArchiveReader *archive;
+    zip_archive_member *member;
+    int output, status;
+    char *content;
+    xxh64_context hash;
+
+    int Extract( int, uint8_t*, uint8_t* );
+    bool Deliver( const uint8_t*, int, uint64_t );
+};
+
+void pkgZipExtractionTask::Execute()
+{
+  /* Acquire a file descriptor, on which to read the archive, and the
+   * transfer buffers, then perform the extraction.
+   */
+  int input;
+  uint8_t *inbuf = (uint8_t *)(malloc( ZIP_TRANSFER_BUFFER_SIZE ));
+  uint8_t *outbuf = (uint8_t *)(malloc( ZIP_TRANSFER_BUFFER_SIZE ));
+
+  if( (member->method != ZIP_METHOD_STORED)
+  &&  (member->method != ZIP_METHOD_DEFLATED)  )
+    status = ZIP_ARCHIVE_METHOD_ERROR;
+
+  else if( (member->flags & ZIP_FLAG_ENCRYPTED) != 0 )
+    status = ZIP_ARCHIVE_METHOD_ERROR;
+
+  else if( (inbuf == NULL) || (outbuf == NULL)
+  ||  ((input = archive->AcquireStream()) < 0)  )
+    status = TAR_ARCHIVE_DATA_READ_ERROR;
+
+  else
+  { status = Extract( input, inbuf, outbuf );
+    archive->ReleaseStream( input );
+  }
+  free( outbuf );
+  free( inbuf );
+}
+
+bool pkgZipExtractionTask::Deliver( const uint8_t *data, int len, uint64_t offset )
+{
+  /* Helper to deliver extracted data, which is to be stored at the
+   * specified offset, either to the output stream, or to the content
+   * buffer; in the latter case, we must not overrun the buffer, (the
+   * size of which is that of the member, as recorded in the central
+   * directory).  In either case, we accumulate the hash of the data,
+   * which must be delivered in order.
+   */
+  xxh64_update( &hash, data, len );
+  if( content == NULL )
+    return write( output, data, len ) == len;
+
+  if( (offset + len) > member->usize )
+    return false;
+  memcpy( content + offset, data, len );
+  return true;
+}
+
+int pkgZipExtractionTask::Extract( int input, uint8_t *inbuf, uint8_t *outbuf )
+{
+  /* Locate the member's data, by way of its local header, (the size
+   * of which may differ from that of its central directory entry)...
+   */
+  uint8_t header[ZIP_LOCAL_HEADER_SIZE];
+  if( ! read_zip_bytes( input, member->offset, header, sizeof( header ) )
+  ||  (get_u32( header ) != ZIP_LOCAL_HEADER_MAGIC)  )
+    return TAR_ARCHIVE_DATA_READ_ERROR;
+
+  __int64 data_offset = member->offset + sizeof( header )
+    + get_u16( header + 26 ) + get_u16( header + 28 );
+  if( _lseeki64( input, data_offset, SEEK_SET ) != data_offset )
+    return TAR_ARCHIVE_DATA_READ_ERROR;
+
+  /* ...then transfer it, decompressing it if necessary, while also
+   * accumulating the CRC of the extracted content.
+   */
+  z_stream stream;
+  bool deflated = (member->method == ZIP_METHOD_DEFLATED);
+  if( deflated )
+  {
+    memset( &stream, 0, sizeof( stream ) );
+    if( inflateInit2( &stream, -MAX_WBITS ) != Z_OK )
+      return TAR_ARCHIVE_DATA_READ_ERROR;
+  }
+  int retval = 0, zstatus = Z_OK;
+  uint64_t remaining = member->csize, extracted = 0;
+  uLong crc = crc32( 0L, Z_NULL, 0 );
+  while( (retval == 0) && (remaining > 0) )
+  {
+    int count = read( input, inbuf, (remaining < ZIP_TRANSFER_BUFFER_SIZE)
+	? remaining : ZIP_TRANSFER_BUFFER_SIZE
+      );
+    if( count <= 0 )
+    {
+      retval = TAR_ARCHIVE_DATA_READ_ERROR;
+      break;
+    }
+    remaining -= count;
+
+    if( ! deflated )
+    {
+      /* A stored member is simply copied.
+       */
+      crc = crc32( crc, inbuf, count );
+      if( ! Deliver( inbuf, count, extracted ) )
+	retval = TAR_ARCHIVE_DATA_WRITE_ERROR;
+      extracted += count;
+    }
+    else
+    { /* A deflated member is inflated, until all input which we have
+       * read has been consumed, (or the deflated stream is complete).
+       */
+      stream.next_in = inbuf;
+      stream.avail_in = count;
+      do { stream.next_out = outbuf;
+	   stream.avail_out = ZIP_TRANSFER_BUFFER_SIZE;
+	   zstatus = inflate( &stream, Z_NO_FLUSH );
+	   if( (zstatus != Z_OK) && (zstatus != Z_STREAM_END) )
+	     retval = TAR_ARCHIVE_DATA_READ_ERROR;
+
+	   else
+	   { int len = ZIP_TRANSFER_BUFFER_SIZE - stream.avail_out;
+	     crc = crc32( crc, outbuf, len );
+	     if( (len > 0) && ! Deliver( outbuf, len, extracted ) )
+	       retval = TAR_ARCHIVE_DATA_WRITE_ERROR;
+	     extracted += len;
+	   }
+	 } while( (retval == 0) && (zstatus == Z_OK)
+	     && ((stream.avail_in > 0) || (stream.avail_out == 0))
+	   );
+    }
+  }
+  if( deflated )
+  {
+    inflateEnd( &stream );
+    if( (retval == 0) && (zstatus != Z_STREAM_END) )
+      retval = TAR_ARCHIVE_DATA_READ_ERROR;
+  }
+  /* Finally, confirm that we extracted the expected content.
+   */
+  if( (retval == 0) && ((extracted != member->usize) || (crc != member->crc)) )
+    retval = ZIP_ARCHIVE_CHECKSUM_ERROR;
+  return retval;
+}
+
+/*****
+ *
+ * Class Implementation: pkgZipDigestTask
+ *
+ */
+class pkgZipDigestTask : public pkgWorkerTask
+{
+  /* A unit of work, to be dispatched to the worker pool, to compute
+   * the digest of the entire archive file, concurrently with the
+   * extraction of its members.
+   */
+  public:
+    pkgZipDigestTask( pkgZipArchiveReader *ref ):archive( ref ){}
+    virtual void Execute();
+
+  private:
+    pkgZipArchiveReader *archive;
+};
+
+void pkgZipDigestTask::Execute()
+{
+  /* Read the archive file, through a file descriptor of our own, and
+   * store the resultant digest; (should we fail, the digest will be left
+   * as an empty string, which cannot match any expected value).
+   */
+  int fd, count;
+  sha256_context context;
+  uint8_t *buf = (uint8_t *)(malloc( ZIP_TRANSFER_BUFFER_SIZE ));
+  if( (buf != NULL)
+  &&  ((fd = open( archive->ArchiveName(), O_RDONLY | O_BINARY )) >= 0)  )
+  {
+    sha256_init( &context );
+    while( (count = read( fd, buf, ZIP_TRANSFER_BUFFER_SIZE )) > 0 )
+      sha256_update( &context, buf, count );
+    if( count == 0 ) sha256_hexdigest( &context, archive->digest );
+    close( fd );
+  }
+  free( buf );
+}
+
+/*****
+ *
+ * Class Implementation: pkgZipArchiveProcessor
+ *
+ */
+pkgZipArchiveProcessor::pkgZipArchiveProcessor( pkgXmlNode *pkg ):
+archive( NULL ), digest_requested( false )
+{
+  /* Constructor to associate a package zip archive with its nominated
+   * sysroot, and respective installation directory path; this follows
+   * the same procedure as for pkgTarArchiveProcessor, except that, in
+   * place of an archive stream, we read the archive's central directory.
+   */
+  sysroot_len = 0;
+
+  sysroot = NULL;
+  sysroot_path = NULL;
+  installed = NULL;
+
+  if( ((origin = pkg) != NULL) && pkg->IsElementOfType( release_key )
+  &&  ((tarname = pkg->GetPropVal( tarname_key, NULL )) != NULL)       )
+  {
+    pkgSpecs lookup( pkgfile = tarname );
+    if( (sysroot = pkg->GetSysRoot( lookup.GetSubSystemName() )) != NULL )
+    {
+      const char *prefix;
+      if( (prefix = sysroot->GetPropVal( pathname_key, NULL )) != NULL )
+      {
+	/* Construct the formatting template for path names of files
+	 * which are installed from this package.
+	 */
+	const char *template_format = "%F%%/M/%%F";
+	char template_text[mkpath( NULL, template_format, prefix, NULL )];
+	mkpath( template_text, template_format, prefix, NULL );
+	sysroot_len = mkpath( NULL, template_text, "", NULL ) - 1;
+	sysroot_path = strdup( template_text );
+      }
+    }
+    /* Identify the real archive file name, (which may not match the
+     * canonical tarname), and read the archive's central directory.
+     */
+    pkgfile = pkg->ArchiveName();
+
+    const char *archive_path_template = pkgArchivePath();
+    char archive_path_name[mkpath( NULL, archive_path_template, pkgfile, NULL )];
+    mkpath( archive_path_name, archive_path_template, pkgfile, NULL );
+    archive = new pkgZipArchiveReader( archive_path_name );
+  }
+}
+
+pkgZipArchiveProcessor::~pkgZipArchiveProcessor()
+{
+  /* Destructor must release the heap memory allocated in the
+   * constructor, and close the archive.
+   */
+  free( (void *)(sysroot_path) );
+  delete installed;
+  delete archive;
+}
+
+bool pkgZipArchiveProcessor::IsOk()
+{
+  /* We are ready to process the archive, only if we were able to
+   * read its central directory.
+   */
+  return (archive != NULL) && archive->IsReady();
+}
+
+struct zip_pending_member
+{
+  /* Record of a member, for which processing has been initiated, but
+   * not yet completed; we keep a ring buffer of these.
+   */
+  zip_archive_member *member;
+  pkgZipExtractionTask *task;
+  char *pathname;
+  int fd;
+};
+
+int pkgZipArchiveProcessor::Process()
+{
+  /* Generic method for extracting the content of zip archives; this
+   * uses a pool of worker threads, the size of which is determined by
+   * the same preference as for concurrent decoding of archive streams.
+   */
+  pkgWorkerPool pool( pkgWorkerPool::ThreadCount( OPTION_DECODER_THREADS ) );
+  mkdir_cache_enable();
+
+  /* When a digest is required, compute it concurrently with all other
+   * processing, on a worker thread of its own.
+   */
+  pkgZipDigestTask *digest = NULL;
+  if( digest_requested )
+    pool.Submit( digest = new pkgZipDigestTask( archive ) );
+
+  /* Members are dispatched for extraction in the order in which they
+   * appear in the central directory, and completed in the same order;
+   * to bound the memory committed to transfer buffers, we keep no more
+   * than two tasks per worker thread in progress at any time.
+   */
+  unsigned window = (pool.Threads() > 0) ? pool.Threads() << 1 : 1;
+  zip_pending_member ring[window];
+  unsigned head = 0, pending = 0;
+  int retval = 0;
+
+  for( unsigned index = 0; ((retval == 0) && (index < archive->Count())) || (pending > 0); )
+  {
+    if( (retval == 0) && (index < archive->Count()) && (pending < window) )
+    {
+      /* There is capacity to initiate processing of another member;
+       * map its name to an equivalent file system path name, within the
+       * designated sysroot hierarchy.
+       */
+      zip_archive_member *member = archive->Member( index++ );
+      const char *pathname = EntryPathName( member->name, NULL );
+      if( (pathname == NULL) || ((pathname = strdup( pathname )) == NULL) )
+      {
+	/* We cannot proceed without a path name; initiate no further
+	 * processing, but complete that of any members which are already
+	 * pending, before we bail out.
+	 */
+	dmh_notify( DMH_ERROR, "Unable to allocate an extraction path name\n" );
+	retval = TAR_ARCHIVE_FORMAT_ERROR;
+	continue;
+      }
+      zip_pending_member *slot = ring + (head + pending++) % window;
+      slot->member = member;
+      slot->pathname = (char *)(pathname);
+      slot->task = NULL;
+      slot->fd = -1;
+
+      /* Only regular files require any action to be initiated here;
+       * when an output stream can be opened, we reserve space for the
+       * member's content, (if it is large enough), and dispatch the task
+       * to extract the content into it.
+       */
+      if( (member->type == zip_archive_member::ZIP_MEMBER_FILE)
+      &&  ((slot->fd = OpenDataStream( pathname, member->mode )) >= 0)  )
+      {
+	preallocate_output_stream( slot->fd, member->usize );
+	pool.Submit( slot->task = new pkgZipExtractionTask( archive, member, slot->fd ) );
+      }
+    }
+    else
+    { /* Otherwise, complete the processing of the oldest member, for
+       * which processing has been initiated.
+       */
+      zip_pending_member *slot = ring + head;
+      head = (head + 1) % window; --pending;
+
+      char *pathname = slot->pathname;
+      switch( slot->member->type )
+      {
+	case zip_archive_member::ZIP_MEMBER_DIRECTORY:
+	  {
+	    /* As for tar archives, we must strip any trailing slashes
+	     * from directory names, before processing them.
+	     */
+	    char *p = pathname + strlen( pathname );
+	    while( (p > pathname) && ((*--p == '/') || (*p == '\\')) )
+	      *p = '\0';
+	  }
+	  ProcessDirectory( pathname );
+	  break;
+
+	case zip_archive_member::ZIP_MEMBER_LINK:
+	  {
+	    /* Unlike those in tar archives, symbolic links in zip archives
+	     * record their targets as member content; we extract this, then
+	     * create the link, (deferring it, when its target has not yet been
+	     * extracted), exactly as we would for a tar archive, and record it
+	     * in the same manner as any regular file.
+	     */
+	    int status = TAR_ARCHIVE_FORMAT_ERROR;
+	    char target[ZIP_MAX_LINK_SIZE + 1];
+	    if( slot->member->usize > ZIP_MAX_LINK_SIZE )
+	      dmh_notify( DMH_ERROR, "%s: link target is too long\n", pathname );
+
+	    else
+	    { pkgZipExtractionTask task( archive, slot->member, target );
+	      task.Execute();
+	      if( (status = task.Status()) != 0 )
+		dmh_notify( DMH_ERROR, "%s: cannot read link target\n", pathname );
+
+	      else if( save_on_extract )
+	      {
+		target[slot->member->usize] = '\0';
+		status = CreateLink( pathname, target, true );
+	      }
+	    }
+	    CommitDataStream( pathname, status, NULL, NULL );
+	  }
+	  break;
+
+	default:
+	  int status = 0;
+	  const char *hash = NULL;
+	  char digest[XXH64_HEXDIGEST_SIZE];
+	  if( slot->task != NULL )
+	  {
+	    /* Wait for extraction of the member's content, (retaining
+	     * the hash of what was extracted), then close its output
+	     * stream, diagnosing any failure...
+	     */
+	    slot->task->WaitForCompletion();
+	    status = slot->task->Status();
+	    hash = slot->task->Digest( digest );
+	    delete slot->task;
+	  }
+	  if( ((status = ExtractFile( slot->fd, pathname, status )) == 0)
+	  &&  save_on_extract && (slot->fd >= 0)  )
+	    /*
+	     * ...and commit the file after successful extraction.
+	     */
+	    CommitSavedEntity( pathname, slot->member->mtime );
+	  CommitDataStream( pathname, status, slot->member, hash );
+      }
+      free( pathname );
+    }
+  }
+  /* Create any symbolic links which referred to members which had not
+   * been extracted, when we encountered them, then wait for the digest
+   * computation, if any, before we return.
+   */
+  CreateDeferredLinks();
+  if( digest != NULL )
+  {
+    digest->WaitForCompletion();
+    delete digest;
+  }
+  report_mkdir_cache_savings();
+  return retval;
+}
+
+bool pkgZipArchiveProcessor::DigestMatches( const char *expected )
+{
+  /* Compare the computed digest, if any, with the expected value,
+   * ignoring case distinctions.
+   */
+  if( (archive == NULL) || (expected == NULL) || (*archive->digest == '\0') )
+    return false;
+
+  const char *p = archive->digest;
+  while( (*p != '\0') && (*p == tolower( *expected )) )
+    ++p, ++expected;
+  return (*p == '\0') && (*expected == '\0');
+}
+
+/*****
+ *
+ * Class Implementation: pkgZipArchiveInstaller
+ *
+ */
+pkgZipArchiveInstaller::pkgZipArchiveInstaller( pkgXmlNode *pkg ):
+pkgZipArchiveProcessor( pkg )
+{
+  /* Constructor: having successfully set up the pkgZipArchiveProcessor
+   * base class, we attach a pkgManifest to track the installation, and
+   * request a digest, if the catalogue publishes one.
+   */
+  if( (tarname != NULL) && (sysroot != NULL) && IsOk() )
+  {
+    installed = new pkgManifest( package_key, tarname );
+    if( origin->GetPropVal( sha256_key, NULL ) != NULL )
+      EnableDigest();
+  }
+}
+
+int pkgZipArchiveInstaller::Process()
+{
+  /* Specialisation of the base class Process() method; this is
+   * exactly analogous to pkgTarArchiveInstaller::Process().
+   */
+  int status;
+  if( (status = pkgZipArchiveProcessor::Process()) == 0 )
+  {
+    const char *expected = origin->GetPropVal( sha256_key, NULL );
+    if( (expected != NULL) && ! DigestMatches( expected ) )
+    {
+      dmh_notify( DMH_ERROR, "%s: archive does not match its sha256 digest\n",
+	  pkgfile
+	);
+      dmh_notify( DMH_ERROR, "%s: installation abandoned\n", tarname );
+
+      /* The archive content has already been written into the sysroot;
+       * since it is not to be trusted, we must remove it again.
+       */
+      if( ! DEBUG_REQUEST( DEBUG_SUPPRESS_INSTALLATION ) )
+	installed->RemoveInstalledEntities( sysroot_path );
+      return TAR_ARCHIVE_DIGEST_MISMATCH;
+    }
+    installed->BindSysRoot( sysroot, package_key );
+    pkgRegister( sysroot, origin, tarname, pkgfile );
+  }
+  return status;
+}
+
+int pkgZipArchiveInstaller::ProcessDirectory( const char *pathname )
+{
+  /* Create the directory infrastructure required to support a specific
+   * package installation, and record it in the installation manifest;
+   * (this is identical to pkgTarArchiveInstaller::ProcessDirectory()).
+   */
+  int status = 0;
+  if( DEBUG_REQUEST( DEBUG_SUPPRESS_INSTALLATION ) )
+  {
+    dmh_printf(
+	"FIXME:ProcessDirectory<stub>:not executing: mkdir -p %s\n",
+	 pathname
+      );
+    if( DEBUG_REQUEST( DEBUG_UPDATE_INVENTORY ) )
+      installed->AddEntry( dirname_key, pathname + sysroot_len );
+  }
+  else if( (status = CreateExtractionDirectory( pathname )) == 0 )
+    installed->AddEntry( dirname_key, pathname + sysroot_len );
+
+  return status;
+}
+
+int pkgZipArchiveInstaller::OpenDataStream( const char *pathname, int mode )
+{
+  /* Establish the output stream, to which the content of a regular
+   * file member is to be extracted.
+   */
+  pkgSpinWait::Report( "Extracting %s", pathname + sysroot_len );
+  if( DEBUG_REQUEST( DEBUG_SUPPRESS_INSTALLATION ) )
+  {
+    /* Debugging stub; as in the case of tar archives, we do not
+     * create the file, so we return the same pseudo-descriptor as
+     * SetOutputStream() does, when saving of files is disabled.
+     */
+    dmh_printf(
+	"FIXME:ProcessDataStream<stub>:not extracting: %s\n",
+	pathname
+      );
+    return -2;
+  }
+  return SetOutputStream( pathname, mode );
+}
+
+void pkgZipArchiveInstaller::CommitDataStream
+( const char *pathname, int status, zip_archive_member *member, const char *digest )
+{
+  /* Record each successfully extracted file in the installation
+   * manifest, exactly as pkgTarArchiveInstaller does; for a regular
+   * file, (but not for a link), this includes its size and time stamp,
+   * and the hash of its content, (if it was actually extracted).
+   */
+  if( DEBUG_REQUEST( DEBUG_SUPPRESS_INSTALLATION ) )
+  {
+    if( DEBUG_REQUEST( DEBUG_UPDATE_INVENTORY ) )
+      installed->AddEntry( filename_key, pathname + sysroot_len );
+  }
+  else if( status == 0 )
+  {
+    if( member == NULL )
+      installed->AddEntry( filename_key, pathname + sysroot_len );
+    else
+      installed->AddEntry( filename_key, pathname + sysroot_len,
+	  member->usize, member->mtime, digest
+	);
+    DEBUG_INVOKE_IF( DEBUG_REQUEST( DEBUG_TRACE_TRANSACTIONS ),
+	dmh_printf( "  %s\n", pathname )
+      );
+  }
+}
+
+/*****
+ *
+ * Auxiliary function: pkgIsZipArchive()
+ *
+ */
+EXTERN_C bool pkgIsZipArchive( const char *archive_name )
+{
+  /* Identify any package archive which, by its name, should be
+   * processed as a zip archive, rather than as a tar archive.
+   */
+  pkgSpecs lookup( archive_name );
+  const char *format = lookup.GetPackageFormat();
+  return (format != NULL) && (strcasecmp( format, "zip" ) == 0);
+}
+
+/* $RCSfile$: end of file */
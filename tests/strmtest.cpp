@@ -0,0 +1,844 @@
+/*
+ * strmtest.cpp
+ *
+ * $Id$
+ *
+ * Copyright (C) 2026, MinGW.org Project
+ *
+ *
+ * Regression tests for the archive stream codec selection, performed
+ * by pkgOpenArchiveStream(); each of the reference archives, within the
+ * test data directory, carries the same tar payload, compressed by each
+ * of the supported codecs, (or not at all), and stored without any file
+ * name extension.  Every one of these is presented to the stream reader
+ * under every archive name extension which mingw-get recognises, (and
+ * under none), to confirm that the codec is identified by the content of
+ * the stream, rather than by its name, and that the decoded content is
+ * always identical to the uncompressed reference.
+ *
+ * Additionally, truncated and corrupt gzip and bzip2 streams, and
+ * truncated zstd streams, must be reported as read failures, rather
+ * than silently presented as if they were merely short archives.
+ *
+ * Every archive is also delivered through a pipe, in small and irregular
+ * chunks, to an archive stream attached by the same mechanism as that
+ * which decodes a package while it is being downloaded; every decoder
+ * must then produce exactly the same result, regardless of how the raw
+ * data was fragmented by the pipe.
+ *
+ * The bzip2 archives are also presented explicitly to both the parallel
+ * and the serial bzip2 decoders, including cases which oblige the former
+ * to fall back to the latter.
+ *
+ * The SHA-256 digest of the raw content of each of several archives,
+ * as computed while decoding it, must match its reference value.
+ *
+ * A multiple block xz archive is extracted, to create its sidecar index,
+ * which must then locate each of its members; single members must then
+ * be extracted correctly, both with and without the index.
+ *
+ * Archives which specify member names, sizes, and modification times by
+ * pax extended headers, GNU long name and long link name entries, or in
+ * GNU base-256 notation, must be extracted with those attributes.
+ *
+ * Finally, the XXH64 content hash must reproduce its reference vectors.
+ *
+ * Usage:  strmtest data-directory
+ *
+ *
+ * This is free software.  Permission is granted to copy, modify and
+ * redistribute this software, under the provisions of the GNU General
+ * Public License, Version 3, (or, at your option, any later version),
+ * as published by the Free Software Foundation; see the file COPYING
+ * for licensing details.
+ *
+ * Note, in particular, that this software is provided "as is", in the
+ * hope that it may prove useful, but WITHOUT WARRANTY OF ANY KIND; not
+ * even an implied WARRANTY OF MERCHANTABILITY, nor of FITNESS FOR ANY
+ * PARTICULAR PURPOSE.  Under no circumstances will the author, or the
+ * MinGW Project, accept liability for any damages, however caused,
+ * arising from the use of this software.
+ *
+ */
+#define  PKGSTRM_H_SPECIAL  1
+
+#include "pkgimpl.h"
+#include "pkgstrm.h"
+#include "pkgproc.h"
+#include "xxh64.h"
+#include "dmh.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <windows.h>
+#include <process.h>
+#include <fcntl.h>
+#include <io.h>
+
+#ifndef O_BINARY
+/* POSIX hosts don't distinguish binary from text files.
+ */
+# define O_BINARY  0
+#endif
+
+/* The reference archives, each of which must decode to the content
+ * of the uncompressed "sniff.tar"...
+ */
+static const char *reference = "sniff.tar";
+static const char *encoded[] =
+{ "sniff.tar", "sniff-gz", "sniff-bz2", "sniff-lzma", "sniff-xz", "sniff-zst",
+  NULL
+};
+
+/* ...and the damaged archives, for which decoding must fail.
+ */
+static const char *damaged[] =
+{ "truncated-gz", "truncated-bz2", "truncated-zst", "corrupt-gz", "corrupt-bz2",
+  NULL
+};
+
+/* The bzip2 archives, intact and damaged, which are additionally
+ * presented to each of the bzip2 decoders, explicitly.
+ */
+static const char *bzip2_encoded[] =
+{ "sniff-bz2", "sniff-pbz2", "sniff-bz2-resync", NULL };
+
+static const char *bzip2_damaged[] =
+{ "truncated-bz2", "corrupt-bz2", NULL };
+
+/* The SHA-256 digests of the raw content of some of the reference
+ * archives, for the digest tests.
+ */
+static const struct { const char *archive, *sha256; } digests[] =
+{ { "sniff.tar",
+    "d168789f3b8c04142a0a13509cb8242a83317607554085752a175f7dae376ee3" },
+  { "sniff-gz",
+    "3e8a0b2e49894a414dea0fd1889f54eecebdc84022ec38bf8198e806acec55c7" },
+  { "sniff-bz2",
+    "da56e4e29905e7fe9225ac082ab85600a30d16c251473202658ffd251447e4c3" },
+  { "sniff-lzma",
+    "7e6d4d8d20f3d2fadd03ed933639e58973623f798157599d454af59e324c85a3" },
+  { "sniff-xz",
+    "b3d7fd006b46206bbf5b0f40ebbf84f1c15bd908efcbc85f7a86a5b1fafdf25e" },
+  { "sniff-zst",
+    "3a02ced6db80276e714febb26b4ad2afbc23bb65b980876afbd12391a5f767f0" },
+  { "sniff-pbz2",
+    "bdd3866d873bf4fe51620ca91458a7d6a7670cb86f6faaacb03211c02e7ba4ce" },
+  { "sniff-bz2-resync",
+    "78c61cfb44187d17527bd5d962554a6af99f50490195b351776005ecdf664573" },
+  { NULL, NULL }
+};
+
+/* The set of file name extensions, under which each archive is to be
+ * presented to pkgOpenArchiveStream(); note that the majority of these
+ * are deliberately inappropriate for most of the archives.
+ */
+static const char *extensions[] =
+{ "", ".tar", ".tar.gz", ".tgz", ".tar.bz2", ".tar.lzma", ".tar.xz",
+  ".tar.zst", ".zip", NULL
+};
+
+static const char *scratch_name = "strmtest.tmp";
+
+/* Reference XXH64 hashes, (as computed by the canonical implementation),
+ * of some short strings, of a synthetic 1000 byte pattern, (specified by
+ * a NULL text, with its length), and of the reference archive, (which is
+ * specified by a NULL text, with zero length).
+ */
+static const struct
+{ const char *text; size_t len; uint64_t seed; const char *xxh64;
+} xxh64_vectors[] =
+{ { "", 0, 0, "ef46db3751d8e999" },
+  { "", 0, 1, "d5afba1336a3be4b" },
+  { "a", 1, 0, "d24ec4f1a98c6e5b" },
+  { "abc", 3, 0, "44bc2cf5ad770999" },
+  { "abc", 3, 0x9E3779B185EBCA87ULL, "a7cb2aac405e36c7" },
+  { "Nobody inspects the spammish repetition", 39, 0, "fbcea83c8a378bf1" },
+  { "The quick brown fox jumps over the lazy dog", 43, 0, "0b242d361fda71bc" },
+  { NULL, 1000, 0, "b1280f6428126532" },
+  { NULL, 1000, 2654435761ULL, "92cd4d6037c48f96" },
+  { NULL, 0, 0, "e675a2db9189cc3f" }
+};
+#define XXH64_VECTORS  (sizeof( xxh64_vectors ) / sizeof( *xxh64_vectors ))
+
+/* A multiple block xz archive, for the sidecar index tests, and the
+ * scratch names under which it is stored, and extracted, for them.
+ */
+static const char *indexed = "members-xz";
+static const char *indexed_name = "strmtest.tmp.tar.xz";
+static const char *extract_dir = "strmtest.dir";
+
+/* Archives which represent extended attributes by pax extended headers,
+ * (local and global), or by GNU long name and long link name entries,
+ * and base-256 numeric fields, together with the names, sizes, mtimes,
+ * and leading content, of the members which they must yield.
+ */
+#define PAX_LONG_DIR	"pax/dddddddddddddddddddddddddddddddddddddddddddddddddddddddddddd/"
+#define GNU_LONG_DIR	"gnu/gggggggggggggggggggggggggggggggggggggggggggggggggggggggggggg/"
+#define LONG_NAME	"long-name-long-name-long-name-long-name-long-name-.txt"
+#define LINK_NAME	"link-name-link-name-link-name-link-name-link-name-.txt"
+
+static const struct
+{ const char *archive, *member, *content; size_t size; time_t mtime;
+} extended_members[] =
+{ { "pax-tar", PAX_LONG_DIR LONG_NAME, "pax long name\n", 14, 1700000000 },
+  { "pax-tar", "pax/sized.txt", "pax sized line 0\n", 5000, 1600000000 },
+  { "gnu-tar", GNU_LONG_DIR LONG_NAME, "gnu long name\n", 14, 1700000000 },
+  { "gnu-tar", "gnu/base256-size.txt", "gnu base-256 line 0\n", 3000, 1500000000 },
+  { "gnu-tar", GNU_LONG_DIR LINK_NAME, "gnu long name\n", 14, 1700000000 },
+  { NULL, NULL, NULL, 0, 0 }
+};
+
+/* The sizes of the successive chunks in which archives are written
+ * into a pipe; these are deliberately irregular, and mostly smaller
+ * than any decoder's input buffer, so that every decoder will see a
+ * variety of short reads.
+ */
+static const size_t chunk_sizes[] = { 1, 3, 61, 7, 509, 17, 251, 2 };
+#define CHUNK_SIZES  (sizeof( chunk_sizes ) / sizeof( *chunk_sizes ))
+
+static char *load_file( const char *dirname, const char *filename, size_t *len )
+{
+  /* Helper to read the entire content of a test data file into
+   * a dynamically allocated buffer.
+   */
+  char *buf = NULL;
+  char pathname[1 + snprintf( NULL, 0, "%s/%s", dirname, filename )];
+  sprintf( pathname, "%s/%s", dirname, filename );
+
+  FILE *fp;
+  if( (fp = fopen( pathname, "rb" )) != NULL )
+  {
+    fseek( fp, 0L, SEEK_END ); *len = ftell( fp ); rewind( fp );
+    if( ((buf = (char *)(malloc( *len ))) != NULL)
+    &&  (fread( buf, 1, *len, fp ) != *len)  )
+    { free( buf ); buf = NULL; }
+    fclose( fp );
+  }
+  if( buf == NULL )
+    fprintf( stderr, "strmtest: %s: cannot read test data\n", pathname );
+  return buf;
+}
+
+static bool store_file( const char *pathname, const char *buf, size_t len )
+{
+  /* Helper to write a copy of a test data file, under a scratch
+   * file name which carries the extension to be tested.
+   */
+  FILE *fp;
+  bool ok = false;
+  if( (fp = fopen( pathname, "wb" )) != NULL )
+  { ok = (fwrite( buf, 1, len, fp ) == len);
+    if( fclose( fp ) != 0 ) ok = false;
+  }
+  if( ! ok )
+    fprintf( stderr, "strmtest: %s: cannot create scratch file\n", pathname );
+  return ok;
+}
+
+static long decode( pkgArchiveStream *stream, char *buf, size_t max, bool by_view )
+{
+  /* Helper to decode an archive, by way of the specified stream,
+   * (which it then deletes), collecting the decoded content in the
+   * specified buffer; we exercise both the Read() method, and the
+   * GetView() and ReleaseView() methods.  Returns the number of
+   * bytes decoded, or -1 if the stream reports any failure, or if
+   * it attempts to return more data than we expect.
+   */
+  long count = 0;
+  if( (stream == NULL) || ! stream->IsReady() )
+    count = -1;
+
+  else while( count >= 0 )
+  {
+    int len;
+    if( by_view )
+    { const char *view;
+      if( (len = stream->GetView( &view )) > 0 )
+      {
+	/* Consume no more than an arbitrary part of each view,
+	 * to confirm that the remainder is presented again.
+	 */
+	if( len > 1000 ) len = 1000;
+	if( (count + len) > (long)(max) ) { count = -1; break; }
+	memcpy( buf + count, view, len );
+	stream->ReleaseView( len );
+      }
+    }
+    else
+    { len = stream->Read( buf + count, max - count );
+      if( (len > 0) && ((count + len) == (long)(max)) )
+      {
+	/* The buffer is full; any further data is an error,
+	 * but we must still detect a corrupt stream end.
+	 */
+	char excess[512];
+	count += len;
+	if( (len = stream->Read( excess, sizeof( excess ) )) > 0 ) len = -1;
+	if( len < 0 ) count = -1;
+	break;
+      }
+    }
+    if( len <= 0 )
+    { if( len < 0 ) count = -1;
+      break;
+    }
+    count += len;
+  }
+  delete stream;
+  return count;
+}
+
+struct pipe_feeder
+{
+  /* Descriptor for the data which is to be written into a pipe,
+   * by the feed_pipe() thread procedure.
+   */
+  const char	*data;
+  size_t	 len;
+  int		 fd;
+};
+
+static unsigned __stdcall feed_pipe( void *ref )
+{
+  /* Thread procedure, to write the data described by a pipe_feeder
+   * into the input end of its pipe, in chunks of irregular size, with
+   * an occasional pause, so that the reader will usually find only a
+   * part of what it requests; it closes the pipe when all data has been
+   * written, or when the reader has closed its own end of the pipe.
+   */
+  pipe_feeder *feeder = (pipe_feeder *)(ref);
+  size_t offset = 0, chunk = 0;
+  while( offset < feeder->len )
+  {
+    size_t len = chunk_sizes[chunk++ % CHUNK_SIZES];
+    if( len > (feeder->len - offset) ) len = feeder->len - offset;
+    int count = write( feeder->fd, feeder->data + offset, len );
+    if( count <= 0 ) break;
+    offset += count;
+    if( (chunk & 1) == 0 ) Sleep( 1 );
+  }
+  close( feeder->fd );
+  return 0;
+}
+
+static long decode_from_pipe
+( const char *name, const char *content, size_t len, char *buf, size_t max,
+  bool by_view
+)
+{
+  /* Helper to decode an archive which is delivered through a pipe,
+   * to a stream which is attached to the pipe's output end, just as
+   * pkgInternetArchiveStream attaches its decoder; returns as decode(),
+   * or -1 if the pipe, or the thread which feeds it, cannot be created.
+   */
+  int fd[2];
+  long count = -1;
+  if( _pipe( fd, 4096, _O_BINARY | _O_NOINHERIT ) == 0 )
+  {
+    uintptr_t thread;
+    pipe_feeder feeder = { content, len, fd[1] };
+    if( (thread = _beginthreadex( NULL, 0, feed_pipe, &feeder, 0, NULL )) != 0 )
+    {
+      /* Decoding closes the output end of the pipe, so the feeder
+       * cannot remain blocked, even if the decoder gives up early;
+       * we must wait for it to finish, before we discard its data.
+       */
+      count = decode( pkgAttachArchiveStream( fd[0], name ), buf, max, by_view );
+      WaitForSingleObject( (HANDLE)(thread), INFINITE );
+      CloseHandle( (HANDLE)(thread) );
+    }
+    else
+    { fprintf( stderr, "strmtest: %s: cannot start pipe feeder\n", name );
+      close( fd[0] ); close( fd[1] );
+    }
+  }
+  else
+    fprintf( stderr, "strmtest: %s: cannot create pipe\n", name );
+  return count;
+}
+
+struct test_data
+{
+  /* The reference data, and the running tallies, which are shared
+   * by all of the tests.
+   */
+  const char	*dirname;
+  char		*expected;
+  size_t	 expected_len;
+  char		*decoded;
+  size_t	 max;
+  int		 tests, failures;
+};
+
+static void verify
+( test_data *data, const char *archive, const char *as, const char *method,
+  bool intact, long count
+)
+{
+  /* Helper to check the outcome of one decoding test, diagnosing
+   * any failure; an intact archive must decode to exactly the reference
+   * content, whereas a damaged archive must be reported as a failure.
+   */
+  ++data->tests;
+  if( intact )
+  {
+    if( (count != (long)(data->expected_len))
+    ||  (memcmp( data->decoded, data->expected, data->expected_len ) != 0)  )
+    {
+      fprintf( stderr, "FAIL: %s as '%s' (%s): decoded content "
+	  "does not match %s\n", archive, as, method, reference
+	);
+      ++data->failures;
+    }
+  }
+  else if( count >= 0 )
+  {
+    fprintf( stderr, "FAIL: %s as '%s' (%s): damaged stream "
+	"was not diagnosed\n", archive, as, method
+      );
+    ++data->failures;
+  }
+}
+
+static void check( test_data *data, bool ok, const char *test, const char *name )
+{
+  /* Helper to tally the outcome of any test, other than decoding,
+   * diagnosing any failure.
+   */
+  ++data->tests;
+  if( ! ok )
+  { fprintf( stderr, "FAIL: %s: %s\n", name, test );
+    ++data->failures;
+  }
+}
+
+static void codec_tests( test_data *data )
+{
+  /* Present every archive, intact or damaged, to pkgOpenArchiveStream()
+   * under every extension, and then through a pipe.
+   */
+  for( int pass = 0; pass < 2; pass++ )
+  {
+    const char **archive = pass ? damaged : encoded;
+    for( ; *archive != NULL; ++archive )
+    {
+      size_t len;
+      char *content = load_file( data->dirname, *archive, &len );
+      if( content == NULL ) { ++data->failures; continue; }
+
+      for( const char **ext = extensions; *ext != NULL; ++ext )
+      {
+	char pathname[1 + snprintf( NULL, 0, "%s%s", scratch_name, *ext )];
+	sprintf( pathname, "%s%s", scratch_name, *ext );
+	if( ! store_file( pathname, content, len ) )
+	{ ++data->failures; continue; }
+
+	for( int by_view = 0; by_view < 2; by_view++ )
+	{
+	  const char *method = by_view ? "GetView" : "Read";
+	  long count = decode( pkgOpenArchiveStream( pathname ),
+	      data->decoded, data->max, by_view
+	    );
+	  verify( data, *archive, pathname, method, pass == 0, count );
+	}
+	unlink( pathname );
+      }
+
+      /* Repeat the decoding tests, with the archive delivered through
+       * a pipe, (from which short reads are to be expected).
+       */
+      for( int by_view = 0; by_view < 2; by_view++ )
+      {
+	const char *method = by_view ? "GetView" : "Read";
+	long count = decode_from_pipe( *archive, content, len,
+	    data->decoded, data->max, by_view
+	  );
+	verify( data, *archive, "<pipe>", method, pass == 0, count );
+      }
+      free( content );
+    }
+  }
+}
+
+static void bzip2_decoder_tests( test_data *data )
+{
+  /* Present every bzip2 archive, intact or damaged, explicitly to the
+   * parallel decoder, (with four worker threads), and to the serial
+   * decoder, regardless of the number of processors on the host; both
+   * must yield exactly the same result.  Note that "sniff-pbz2" holds
+   * several concatenated streams, and "sniff-bz2-resync" is followed by
+   * a spurious block signature, which forces the parallel decoder to
+   * fall back to the serial decoder, after all of the data has been
+   * delivered, (as it must, whenever a block fails to decode).
+   */
+  for( int pass = 0; pass < 2; pass++ )
+  {
+    const char **archive = pass ? bzip2_damaged : bzip2_encoded;
+    for( ; *archive != NULL; ++archive )
+    {
+      char pathname[1 + snprintf( NULL, 0, "%s/%s", data->dirname, *archive )];
+      sprintf( pathname, "%s/%s", data->dirname, *archive );
+
+      static const char *methods[] =
+      { "Read, serial", "GetView, serial", "Read, parallel", "GetView, parallel" };
+      for( int method = 0; method < 4; method++ )
+      {
+	int fd = open( pathname, O_RDONLY | O_BINARY );
+	pkgArchiveStream *stream = (method & 2)
+	  ? (pkgArchiveStream *)(new pkgBzipParallelArchiveStream( fd, 4 ))
+	  : (pkgArchiveStream *)(new pkgBzipArchiveStream( fd ));
+	long count = decode( stream, data->decoded, data->max, method & 1 );
+	verify( data, *archive, pathname, methods[method], pass == 0, count );
+      }
+    }
+  }
+}
+
+static void digest_tests( test_data *data )
+{
+  /* Confirm that the digest, which is computed over the raw archive
+   * content as the decoder consumes it, matches the reference digest,
+   * (regardless of case), but not any other; this must hold whether the
+   * client consumes all of the decoded data, or only a part of it, (in
+   * which case DigestMatches() must consume the remainder), and, for the
+   * bzip2 archives, when the parallel decoder falls back to the serial
+   * decoder.  A digest which was never enabled must never match.
+   */
+  for( int i = 0; digests[i].archive != NULL; i++ )
+  {
+    const char *archive = digests[i].archive;
+    char pathname[1 + snprintf( NULL, 0, "%s/%s", data->dirname, archive )];
+    sprintf( pathname, "%s/%s", data->dirname, archive );
+
+    char mismatch[1 + strlen( digests[i].sha256 )], uppercase[sizeof( mismatch )];
+    for( size_t j = 0; j < sizeof( mismatch ); j++ )
+      uppercase[j] = toupper( mismatch[j] = digests[i].sha256[j] );
+    mismatch[0] = (mismatch[0] == '0') ? '1' : '0';
+
+    bool is_bzip2 = strncmp( archive, "sniff-bz2", 9 ) == 0
+      || strcmp( archive, "sniff-pbz2" ) == 0;
+
+    for( int method = 0; method < (is_bzip2 ? 8 : 4); method++ )
+    {
+      /* Bit 0 of "method" selects partial consumption; bit 1 selects
+       * the mismatched digest, and bit 2 the explicit parallel decoder;
+       * (the uppercase digest is checked with the partial consumption).
+       */
+      pkgArchiveStream *stream = ((method & 4) == 0)
+	? pkgOpenArchiveStream( pathname )
+	: new pkgBzipParallelArchiveStream( open( pathname, O_RDONLY | O_BINARY ), 4 );
+      stream->EnableDigest();
+
+      int count;
+      char *buf = data->decoded;
+      size_t max = (method & 1) ? 1000 : data->max;
+      while( (max > 0) && ((count = stream->Read( buf, max )) > 0) )
+      { buf += count; max -= count;
+	if( method & 1 ) break;
+      }
+      bool matched = stream->DigestMatches( (method & 2) ? mismatch
+	  : (method & 1) ? uppercase : digests[i].sha256
+	);
+      delete stream;
+
+      static const char *outcome[] =
+      { "digest does not match, after reading all data",
+	"digest does not match, after reading partial data",
+	"incorrect digest matches, after reading all data",
+	"incorrect digest matches, after reading partial data",
+	"digest does not match, after parallel decoding",
+	"digest does not match, after partial parallel decoding",
+	"incorrect digest matches, after parallel decoding",
+	"incorrect digest matches, after partial parallel decoding"
+      };
+      check( data, matched == ((method & 2) == 0), outcome[method], archive );
+    }
+    pkgArchiveStream *stream = pkgOpenArchiveStream( pathname );
+    stream->Read( data->decoded, data->max );
+    check( data, ! stream->DigestMatches( digests[i].sha256 ),
+	"digest matches, but was never enabled", archive
+      );
+    delete stream;
+  }
+}
+
+static bool extracted( const char *member, const char *content, size_t len )
+{
+  /* Helper to check that an archive member has been extracted, with
+   * the expected content, (then remove it); returns false if it wasn't,
+   * or if its content differs.
+   */
+  size_t actual;
+  char *buf = load_file( extract_dir, member, &actual );
+  bool ok = (buf != NULL) && (actual == len) && (memcmp( buf, content, len ) == 0);
+  char pathname[1 + snprintf( NULL, 0, "%s/%s", extract_dir, member )];
+  sprintf( pathname, "%s/%s", extract_dir, member );
+  unlink( pathname );
+  free( buf );
+  return ok;
+}
+
+static void xxh64_tests( test_data *data )
+{
+  /* Confirm that the XXH64 implementation, (which computes the content
+   * hashes which are recorded in package manifests), reproduces each of
+   * the reference hashes, whether the data is presented all at once, or
+   * in a sequence of small, irregular, chunks.
+   */
+  char pattern[1000];
+  for( size_t i = 0; i < sizeof( pattern ); i++ )
+    pattern[i] = (char)((i * 31) & 0xFF);
+
+  for( size_t i = 0; i < XXH64_VECTORS; i++ )
+  {
+    const char *text = xxh64_vectors[i].text;
+    size_t len = xxh64_vectors[i].len;
+    if( text == NULL )
+    { text = len ? pattern : data->expected;
+      if( len == 0 ) len = data->expected_len;
+    }
+    char name[32];
+    snprintf( name, sizeof( name ), "XXH64 vector %u", (unsigned)(i) );
+
+    for( int chunked = 0; chunked < 2; chunked++ )
+    {
+      xxh64_context context;
+      xxh64_init( &context, xxh64_vectors[i].seed );
+      if( chunked )
+	for( size_t offset = 0, chunk = 0; offset < len; )
+	{
+	  size_t count = chunk_sizes[chunk++ % CHUNK_SIZES];
+	  if( count > (len - offset) ) count = len - offset;
+	  xxh64_update( &context, text + offset, count );
+	  offset += count;
+	}
+      else
+	xxh64_update( &context, text, len );
+
+      char hexdigest[XXH64_HEXDIGEST_SIZE];
+      xxh64_hexdigest( &context, hexdigest );
+      check( data, (strcmp( hexdigest, xxh64_vectors[i].xxh64 ) == 0)
+	  && (xxh64_digest( &context ) == strtoull( hexdigest, NULL, 16 )),
+	  chunked ? "incorrect hash, from chunked data" : "incorrect hash", name
+	);
+    }
+  }
+}
+
+static void remove_extracted_dirs( const char *member )
+{
+  /* Helper to remove the directories, within the extraction directory,
+   * which were created to accommodate an extracted archive member, (and
+   * the extraction directory itself); any which are not empty remain.
+   */
+  char pathname[1 + snprintf( NULL, 0, "%s/%s", extract_dir, member )];
+  sprintf( pathname, "%s/%s", extract_dir, member );
+  for( char *p = pathname + strlen( pathname ); p > pathname; --p )
+    if( *p == '/' ) { *p = '\0'; rmdir( pathname ); }
+}
+
+static void index_tests( test_data *data )
+{
+  /* Exercise the sidecar index, which is created beside a cached xz
+   * archive, on its first complete extraction, and thereafter used to
+   * locate individual members, (as when extracting a single member, by
+   * the "--member" option); we operate on a scratch copy of the archive,
+   * so that the index is not created within the test data directory.
+   */
+  size_t len;
+  char *content = load_file( data->dirname, indexed, &len );
+  if( content == NULL ) { ++data->failures; return; }
+  bool ok = store_file( indexed_name, content, len );
+  free( content );
+  if( ! ok ) { ++data->failures; return; }
+
+  char index_name[1 + snprintf( NULL, 0, "%s.idx", indexed_name )];
+  sprintf( index_name, "%s.idx", indexed_name );
+  unlink( index_name );
+
+  /* Retrieve the decoded content of the archive; this is our reference
+   * for the content of each member.
+   */
+  static const size_t archive_max = 1 << 17;
+  char *archive = (char *)(malloc( archive_max << 1 ));
+  char *located = archive + archive_max;
+  long archive_len = (archive == NULL) ? -1
+    : decode( pkgOpenArchiveStream( indexed_name ), archive, archive_max, false );
+  if( archive_len <= 0 )
+  { fprintf( stderr, "strmtest: %s: cannot decode archive\n", indexed );
+    ++data->failures; free( archive ); unlink( indexed_name );
+    return;
+  }
+
+  /* An index is available only for xz archives; until the first
+   * complete extraction, it cannot locate any member.
+   */
+  pkgTarArchiveIndex *index = pkgOpenArchiveIndex( indexed_name );
+  pkgArchiveStream *stream = (index != NULL) ? index->OpenMember( "members/m3.txt" ) : NULL;
+  check( data, (index != NULL) && (stream == NULL),
+      "member located before index was created", indexed
+    );
+  delete stream; delete index;
+
+  for( const char **archive = encoded; *archive != NULL; ++archive )
+    if( strcmp( *archive, "sniff-xz" ) != 0 )
+    {
+      char pathname[1 + snprintf( NULL, 0, "%s/%s", data->dirname, *archive )];
+      sprintf( pathname, "%s/%s", data->dirname, *archive );
+      index = pkgOpenArchiveIndex( pathname );
+      check( data, index == NULL, "index offered for non-xz archive", *archive );
+      delete index;
+    }
+
+  /* Extract the entire archive; this must create the index.
+   */
+  { pkgTarArchiveExtractor extractor( indexed_name, extract_dir ); }
+  check( data, access( index_name, F_OK ) == 0, "no index created", indexed );
+
+  /* Now, for every member, the index must provide a stream which begins
+   * with the member's header, followed by its data, (and all subsequent
+   * archive content)...
+   */
+  long offset = 0;
+  const char *member, *first = NULL, *last = NULL;
+  index = pkgOpenArchiveIndex( indexed_name );
+  while( (offset + 512 <= archive_len) && (*(member = archive + offset) != '\0') )
+  {
+    size_t size = strtoul( archive + offset + 124, NULL, 8 );
+    if( first == NULL ) first = member;
+    last = member;
+    check( data, extracted( member, archive + offset + 512, size ),
+	"not extracted correctly, from complete archive", member
+      );
+    long count = ((stream = index->OpenMember( member )) == NULL) ? -1
+      : decode( stream, located, archive_max, true );
+    check( data, (count == archive_len - offset)
+	&& (memcmp( located, archive + offset, count ) == 0),
+	"not located correctly, by index", member
+      );
+    offset += 512 + ((size + 511) & ~511);
+  }
+  delete index;
+
+  /* ...and we must be able to extract any single member, (we choose the
+   * last, and the first), either by way of the index, or, when the index
+   * has been removed, by sequential scanning; no other member should be
+   * extracted, nor should anything be extracted for a missing member.
+   */
+  for( int scan = 0; scan < 2; scan++ )
+  {
+    const char *method = scan ? "extracted by scanning" : "extracted by index";
+    if( scan ) unlink( index_name );
+    for( int which = 0; which < 2; which++ )
+    {
+      const char *wanted = which ? first : last;
+      const char *other = which ? last : first;
+      { pkgTarArchiveExtractor extractor( indexed_name, extract_dir, wanted ); }
+
+      size_t size = strtoul( wanted + 124, NULL, 8 );
+      check( data, extracted( wanted, wanted + 512, size ), method, wanted );
+
+      char pathname[1 + snprintf( NULL, 0, "%s/%s", extract_dir, other )];
+      sprintf( pathname, "%s/%s", extract_dir, other );
+      check( data, access( pathname, F_OK ) != 0, "extracted, but not selected", other );
+    }
+    { pkgTarArchiveExtractor extractor( indexed_name, extract_dir, "members/none" ); }
+    char pathname[1 + snprintf( NULL, 0, "%s/members/none", extract_dir )];
+    sprintf( pathname, "%s/members/none", extract_dir );
+    check( data, access( pathname, F_OK ) != 0, "extracted, but not present", "members/none" );
+  }
+
+  /* Finally, clean up the scratch files.
+   */
+  remove_extracted_dirs( first );
+  unlink( index_name ); unlink( indexed_name );
+  free( archive );
+}
+
+static void extended_header_tests( test_data *data )
+{
+  /* Extract each archive which uses extended headers, or base-256
+   * numeric fields, and confirm that every member is extracted, with
+   * the correct name, size, content, and modification time.
+   */
+  for( int i = 0; extended_members[i].archive != NULL; i++ )
+  {
+    const char *archive = extended_members[i].archive;
+    if( (i == 0) || (strcmp( archive, extended_members[i - 1].archive ) != 0) )
+    {
+      char pathname[1 + snprintf( NULL, 0, "%s/%s", data->dirname, archive )];
+      sprintf( pathname, "%s/%s", data->dirname, archive );
+      pkgTarArchiveExtractor extractor( pathname, extract_dir );
+    }
+    const char *member = extended_members[i].member;
+    char pathname[1 + snprintf( NULL, 0, "%s/%s", extract_dir, member )];
+    sprintf( pathname, "%s/%s", extract_dir, member );
+
+    struct stat info;
+    size_t len = 0, leading = strlen( extended_members[i].content );
+    char *content = (stat( pathname, &info ) == 0)
+      ? load_file( extract_dir, member, &len ) : NULL;
+    check( data, (content != NULL) && (len == extended_members[i].size)
+	&& (len >= leading)
+	&& (memcmp( content, extended_members[i].content, leading ) == 0),
+	"not extracted with expected size, and content", member
+      );
+    check( data, (content != NULL) && (info.st_mtime == extended_members[i].mtime),
+	"not extracted with expected modification time", member
+      );
+    free( content );
+  }
+  for( int i = 0; extended_members[i].archive != NULL; i++ )
+  {
+    char pathname[1 + snprintf( NULL, 0, "%s/%s", extract_dir, extended_members[i].member )];
+    sprintf( pathname, "%s/%s", extract_dir, extended_members[i].member );
+    unlink( pathname );
+  }
+  for( int i = 0; extended_members[i].archive != NULL; i++ )
+    remove_extracted_dirs( extended_members[i].member );
+}
+
+int main( int argc, char **argv )
+{
+  if( argc != 2 )
+  { fprintf( stderr, "usage: strmtest data-directory\n" );
+    return EXIT_FAILURE;
+  }
+  dmh_init( DMH_SUBSYSTEM_TTY, "strmtest" );
+
+  test_data data;
+  data.dirname = argv[1];
+  data.tests = data.failures = 0;
+  if( (data.expected = load_file( data.dirname, reference, &data.expected_len )) == NULL )
+    return EXIT_FAILURE;
+
+  /* We allow some headroom, beyond the expected length, in the buffer
+   * which will receive decoded data, so that any excess content will be
+   * detected, rather than silently truncated.
+   */
+  data.max = data.expected_len + 4096;
+  if( (data.decoded = (char *)(malloc( data.max ))) == NULL )
+    return EXIT_FAILURE;
+
+  codec_tests( &data );
+  bzip2_decoder_tests( &data );
+  digest_tests( &data );
+  index_tests( &data );
+  extended_header_tests( &data );
+  xxh64_tests( &data );
+
+  free( data.decoded );
+  free( data.expected );
+
+  printf( "strmtest: %d of %d tests passed\n",
+      data.tests - data.failures, data.tests
+    );
+  return data.failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/* $RCSfile$: end of file */
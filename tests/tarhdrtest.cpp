@@ -0,0 +1,322 @@
+/*
+ * tarhdrtest.cpp
+ *
+ * $Id$
+ *
+ * Copyright (C) 2026, MinGW.org Project
+ *
+ *
+ * Regression tests, and a micro-benchmark, for the word-at-a-time tar
+ * header helpers, in tarhdr.h; a synthetic archive of 100,000 headers,
+ * with a variety of field content, (including bytes with the high order
+ * bit set, and both unsigned and signed checksums), is validated by both
+ * sum_tar_header() and a straightforward byte-by-byte reference checksum,
+ * while its size, mtime, and mode fields are interpreted by both
+ * compute_octval() and a byte-by-byte reference conversion; the results
+ * must be identical.  Additionally, a large number of randomly generated
+ * numeric fields, of every width from one to twelve bytes, and including
+ * leading and trailing garbage, are compared in the same manner.
+ *
+ * The time taken by each implementation, to process the entire synthetic
+ * archive, is reported for information; it does not affect the outcome.
+ *
+ * Usage:  tarhdrtest
+ *
+ *
+ * This is free software.  Permission is granted to copy, modify and
+ * redistribute this software, under the provisions of the GNU General
+ * Public License, Version 3, (or, at your option, any later version),
+ * as published by the Free Software Foundation; see the file COPYING
+ * for licensing details.
+ *
+ * Note, in particular, that this software is provided "as is", in the
+ * hope that it may prove useful, but WITHOUT WARRANTY OF ANY KIND; not
+ * even an implied WARRANTY OF MERCHANTABILITY, nor of FITNESS FOR ANY
+ * PARTICULAR PURPOSE.  Under no circumstances will the author, or the
+ * MinGW Project, accept liability for any damages, however caused,
+ * arising from the use of this software.
+ *
+ */
+#include "tarhdr.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* The dimensions of the synthetic archive, the number of passes over
+ * it for the benchmark, and the number of random numeric fields.
+ */
+#define HEADER_COUNT	100000
+#define BENCH_PASSES	20
+#define FIELD_COUNT	2000000
+
+/* Offsets, and widths, of the header fields which we populate; these
+ * follow the POSIX ustar layout, as described in pkgproc.h
+ */
+#define NAME_OFFSET	0
+#define NAME_SIZE	100
+#define MODE_OFFSET	100
+#define SIZE_OFFSET	124
+#define MTIME_OFFSET	136
+#define CHKSUM_OFFSET	148
+#define TYPEFLAG_OFFSET	156
+#define MAGIC_OFFSET	257
+#define NUMBER_SIZE	12
+#define MODE_SIZE	8
+
+static uint32_t random_state = 20261017;
+
+static uint32_t random_number( void )
+{
+  /* A simple linear congruential generator, so that every run of
+   * the test processes exactly the same data, on any host.
+   */
+  random_state = random_state * 1103515245 + 12345;
+  return random_state >> 8;
+}
+
+static uint64_t reference_octval( const char *p, size_t len )
+{
+  /* Reference conversion of a numeric header field, byte by byte;
+   * this is the original implementation of compute_octval(), with the
+   * base-256 notation handled as in the current implementation.
+   */
+  uint64_t value = 0LL;
+
+  if( (len > 0) && ((*p & 0x80) != 0) )
+  {
+    value = (*p & 0x40) ? (~0ULL << 6) | (*p & 0x3F) : (*p & 0x3F);
+    while( --len > 0 )
+      value = (value << 8) | (unsigned char)(*++p);
+    return value;
+  }
+  while( (len > 0) && ((*p < '0') || (*p > '7')) )
+  {
+    ++p; --len;
+  }
+  while( (len > 0) && (*p >= '0') && (*p < '8') )
+  {
+    value = (value << 3) + *p++ - '0'; --len;
+  }
+  return value;
+}
+
+static bool reference_sums( const char *buf, unsigned *sums )
+{
+  /* Reference checksum computation, byte by byte, in both unsigned
+   * and signed forms; returns false for an all zero header.
+   */
+  bool any = false;
+  unsigned unsigned_sum = 0, signed_sum = 0;
+  for( int offset = 0; offset < TAR_HEADER_SIZE; offset++ )
+  {
+    if( buf[offset] != '\0' ) any = true;
+    if( (offset < CHKSUM_OFFSET) || (offset >= (CHKSUM_OFFSET + 8)) )
+    {
+      unsigned_sum += (unsigned char)(buf[offset]);
+      signed_sum += (signed char)(buf[offset]);
+    }
+    else
+    { unsigned_sum += 0x20;
+      signed_sum += 0x20;
+    }
+  }
+  if( any )
+  { sums[0] = unsigned_sum;
+    sums[1] = signed_sum;
+  }
+  return any;
+}
+
+static void store_number( char *field, size_t len, uint64_t value )
+{
+  /* Helper to record a numeric value in a header field, as octal
+   * digits, with the conventional leading zeros and terminal NUL, or
+   * occasionally with a trailing space, or in base-256 notation.
+   */
+  uint32_t style = random_number() % 16;
+  if( style == 0 )
+  {
+    *field = 0x80;
+    while( --len > 0 )
+    { field[len] = (char)(value & 0xFF);
+      value >>= 8;
+    }
+  }
+  else
+  { field[--len] = (style == 1) ? ' ' : '\0';
+    while( len-- > 0 )
+    { field[len] = '0' + (value & 7);
+      value >>= 3;
+    }
+  }
+}
+
+static void make_header( char *buf )
+{
+  /* Helper to populate one synthetic header; about one in ten thousand
+   * is left all zero, to represent an end of archive marker, while the
+   * remainder are given a name, (sometimes including bytes with the
+   * high order bit set), a type, mode, size and mtime, and a checksum,
+   * (sometimes computed in the historic signed form).
+   */
+  memset( buf, 0, TAR_HEADER_SIZE );
+  if( (random_number() % 10000) == 0 )
+    return;
+
+  int len = 1 + random_number() % (NAME_SIZE - 1);
+  for( int i = 0; i < len; i++ )
+  {
+    uint32_t c = random_number();
+    buf[NAME_OFFSET + i] = ((c % 8) == 0) ? (char)(0x80 | c) : 'a' + (c % 26);
+  }
+  buf[TYPEFLAG_OFFSET] = '0' + random_number() % 8;
+  memcpy( buf + MAGIC_OFFSET, "ustar\00000", 8 );
+  store_number( buf + MODE_OFFSET, MODE_SIZE, random_number() & 07777 );
+  store_number( buf + SIZE_OFFSET, NUMBER_SIZE,
+      ((uint64_t)(random_number()) << 12) ^ random_number()
+    );
+  store_number( buf + MTIME_OFFSET, NUMBER_SIZE, random_number() << 4 );
+
+  unsigned sums[2];
+  reference_sums( buf, sums );
+  sprintf( buf + CHKSUM_OFFSET, "%06o", sums[random_number() % 2] );
+  buf[CHKSUM_OFFSET + 7] = ' ';
+}
+
+static void make_field( char *field, size_t len )
+{
+  /* Helper to populate one random numeric field, drawing most of
+   * its content from the octal digits, and the remainder from those
+   * characters which may terminate, or precede, them.
+   */
+  static const char other[] = { '\0', ' ', '8', '9', 'x', '/', (char)(0xB0) };
+  for( size_t i = 0; i < len; i++ )
+  {
+    uint32_t c = random_number();
+    field[i] = ((c % 4) != 0) ? '0' + ((c >> 4) % 8)
+      : other[(c >> 4) % sizeof( other )];
+  }
+  if( (random_number() % 64) == 0 ) *field |= 0x80;
+}
+
+static unsigned long checksum_headers( const char *headers, bool reference )
+{
+  /* Benchmark kernel: validate, and interpret the size, mtime, and
+   * mode fields of, every header in the synthetic archive, using either
+   * the reference, or the word-at-a-time, helpers; returns a summary of
+   * the results, so that the work cannot be optimised away.
+   */
+  unsigned long result = 0;
+  for( int i = 0; i < HEADER_COUNT; i++ )
+  {
+    unsigned sums[2];
+    const char *buf = headers + (size_t)(i) * TAR_HEADER_SIZE;
+    if( reference ? reference_sums( buf, sums )
+	: sum_tar_header( buf, buf + CHKSUM_OFFSET, sums )  )
+    {
+      uint64_t expected = reference
+	? reference_octval( buf + CHKSUM_OFFSET, 8 )
+	: compute_octval( buf + CHKSUM_OFFSET, 8 );
+      if( (expected == sums[0]) || (expected == sums[1]) )
+	result += reference
+	  ? reference_octval( buf + SIZE_OFFSET, NUMBER_SIZE )
+	    + reference_octval( buf + MTIME_OFFSET, NUMBER_SIZE )
+	    + reference_octval( buf + MODE_OFFSET, MODE_SIZE )
+	  : compute_octval( buf + SIZE_OFFSET, NUMBER_SIZE )
+	    + compute_octval( buf + MTIME_OFFSET, NUMBER_SIZE )
+	    + compute_octval( buf + MODE_OFFSET, MODE_SIZE );
+    }
+  }
+  return result;
+}
+
+int main()
+{
+  int tests = 0, failures = 0;
+  char *headers = (char *)(malloc( (size_t)(HEADER_COUNT) * TAR_HEADER_SIZE ));
+  if( headers == NULL )
+  { fprintf( stderr, "tarhdrtest: cannot allocate synthetic archive\n" );
+    return EXIT_FAILURE;
+  }
+
+  /* Compare the results from each implementation, for every header
+   * in the synthetic archive...
+   */
+  for( int i = 0; i < HEADER_COUNT; i++ )
+  {
+    char *buf = headers + (size_t)(i) * TAR_HEADER_SIZE;
+    make_header( buf );
+
+    unsigned sums[2], expected[2];
+    bool nonzero = sum_tar_header( buf, buf + CHKSUM_OFFSET, sums );
+    ++tests;
+    if( (nonzero != reference_sums( buf, expected ))
+    ||  (nonzero && ((sums[0] != expected[0]) || (sums[1] != expected[1]))) )
+    {
+      fprintf( stderr, "FAIL: header %d: checksum mismatch\n", i );
+      ++failures;
+    }
+    static const struct { int offset, size; } fields[] =
+    { { SIZE_OFFSET, NUMBER_SIZE }, { MTIME_OFFSET, NUMBER_SIZE },
+      { MODE_OFFSET, MODE_SIZE }, { CHKSUM_OFFSET, 8 }
+    };
+    for( size_t f = 0; f < sizeof( fields ) / sizeof( *fields ); f++ )
+    {
+      const char *field = buf + fields[f].offset;
+      ++tests;
+      if( compute_octval( field, fields[f].size )
+	  != reference_octval( field, fields[f].size )  )
+      {
+	fprintf( stderr, "FAIL: header %d: field at offset %d: "
+	    "numeric value mismatch\n", i, fields[f].offset
+	  );
+	++failures;
+      }
+    }
+  }
+
+  /* ...and for every random numeric field.
+   */
+  for( int i = 0; i < FIELD_COUNT; i++ )
+  {
+    char field[NUMBER_SIZE];
+    size_t len = 1 + random_number() % NUMBER_SIZE;
+    make_field( field, len );
+    ++tests;
+    if( compute_octval( field, len ) != reference_octval( field, len ) )
+    {
+      fprintf( stderr, "FAIL: field %d: '%.*s': numeric value mismatch\n",
+	  i, (int)(len), field
+	);
+      ++failures;
+    }
+  }
+
+  /* Finally, time each implementation, over several passes through
+   * the synthetic archive; the totals must also agree.
+   */
+  unsigned long totals[2] = { 0, 0 };
+  for( int reference = 1; reference >= 0; reference-- )
+  {
+    clock_t start = clock();
+    for( int pass = 0; pass < BENCH_PASSES; pass++ )
+      totals[reference] += checksum_headers( headers, reference );
+    printf( "tarhdrtest: %s: %d passes over %d headers: %.3f s\n",
+	reference ? "byte-by-byte" : "word-at-a-time", BENCH_PASSES,
+	HEADER_COUNT, (double)(clock() - start) / CLOCKS_PER_SEC
+      );
+  }
+  ++tests;
+  if( totals[0] != totals[1] )
+  { fprintf( stderr, "FAIL: benchmark results do not agree\n" );
+    ++failures;
+  }
+  free( headers );
+
+  printf( "tarhdrtest: %d of %d tests passed\n", tests - failures, tests );
+  return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+/* $RCSfile$: end of file */